@@ -102,7 +102,8 @@ int main(int argc, const char **argv)
 
 	while(1) {
 		Stats stats;
-		Device *device = Device::create(device_info, stats, true);
+		Profiler profiler;
+		Device *device = Device::create(device_info, stats, profiler, true);
 		printf("Cycles Server with device: %s\n", device->info.description.c_str());
 		device->server_run();
 		delete device;
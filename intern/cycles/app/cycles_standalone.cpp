@@ -18,6 +18,7 @@
 
 #include "render/buffers.h"
 #include "render/camera.h"
+#include "render/denoising.h"
 #include "device/device.h"
 #include "render/scene.h"
 #include "render/session.h"
@@ -46,11 +47,14 @@ struct Options {
 	Session *session;
 	Scene *scene;
 	string filepath;
+	vector<string> filepaths;
 	int width, height;
 	SceneParams scene_params;
 	SessionParams session_params;
 	bool quiet;
 	bool show_help, interactive, pause;
+	bool denoise;
+	int denoising_neighbor_frames;
 } options;
 
 static void session_print(const string& str)
@@ -150,6 +154,70 @@ static void session_exit()
 	}
 }
 
+static void denoise_print_status(Progress *progress)
+{
+	string status, substatus;
+	progress->get_status(status, substatus);
+
+	if(substatus != "")
+		status += ": " + substatus;
+
+	session_print(status);
+}
+
+/* Denoise the input files, the output is written next to each input file
+ * unless an output file or directory is specified. */
+static bool denoise_files()
+{
+	Denoiser denoiser(options.session_params.device);
+
+	denoiser.input = options.filepaths;
+	foreach(const string& filepath, options.filepaths) {
+		const string& output_path = options.session_params.output_path;
+		string output;
+
+		if(output_path == "") {
+			string base = filepath;
+			if(string_endswith(base, ".exr"))
+				base = base.substr(0, base.size() - 4);
+			output = base + "_denoised.exr";
+		}
+		else if(options.filepaths.size() == 1)
+			output = output_path;
+		else
+			output = path_join(output_path, path_filename(filepath));
+
+		denoiser.output.push_back(output);
+	}
+
+	denoiser.radius = options.session_params.denoising_radius;
+	denoiser.strength = options.session_params.denoising_strength;
+	denoiser.feature_strength = options.session_params.denoising_feature_strength;
+	denoiser.relative_pca = options.session_params.denoising_relative_pca;
+	denoiser.neighbor_frames = options.denoising_neighbor_frames;
+	denoiser.threads = options.session_params.threads;
+	denoiser.tile_size = options.session_params.tile_size;
+
+	/* Only used for files that don't store their sample count. */
+	if(options.session_params.samples != INT_MAX)
+		denoiser.samples = options.session_params.samples;
+
+	if(!options.quiet)
+		denoiser.progress.set_update_callback(function_bind(&denoise_print_status, &denoiser.progress));
+
+	bool success = denoiser.run();
+
+	if(!options.quiet) {
+		session_print(success? "Finished Denoising.": "");
+		printf("\n");
+	}
+
+	if(!success)
+		fprintf(stderr, "%s\n", denoiser.error.c_str());
+
+	return success;
+}
+
 #ifdef WITH_CYCLES_STANDALONE_GUI
 static void display_info(Progress& progress)
 {
@@ -317,6 +385,9 @@ static int files_parse(int argc, const char *argv[])
 	if(argc > 0)
 		options.filepath = argv[0];
 
+	for(int i = 0; i < argc; i++)
+		options.filepaths.push_back(argv[i]);
+
 	return 0;
 }
 
@@ -327,6 +398,12 @@ static void options_parse(int argc, const char **argv)
 	options.filepath = "";
 	options.session = NULL;
 	options.quiet = false;
+	options.denoise = false;
+	options.denoising_neighbor_frames = 0;
+
+	/* Defaults for denoising existing files. */
+	options.session_params.denoising_strength = 0.5f;
+	options.session_params.denoising_feature_strength = 0.5f;
 
 	/* device names */
 	string device_names = "";
@@ -355,7 +432,8 @@ static void options_parse(int argc, const char **argv)
 	bool help = false, debug = false, version = false;
 	int verbosity = 1;
 
-	ap.options ("Usage: cycles [options] file.xml",
+	ap.options ("Usage: cycles [options] file.xml\n"
+	            "       cycles --denoise [options] file.exr ...",
 		"%*", files_parse, "",
 		"--device %s", &devicename, ("Devices to use: " + device_names).c_str(),
 #ifdef WITH_OSL
@@ -364,13 +442,24 @@ static void options_parse(int argc, const char **argv)
 		"--background", &options.session_params.background, "Render in background, without user interface",
 		"--quiet", &options.quiet, "In background mode, don't print progress messages",
 		"--samples %d", &options.session_params.samples, "Number of samples to render",
+		"--progressive-refine", &options.session_params.progressive_refine, "Render the whole image one sample at a time instead of tile by tile",
 		"--output %s", &options.session_params.output_path, "File path to write output image",
 		"--threads %d", &options.session_params.threads, "CPU Rendering Threads",
 		"--width  %d", &options.width, "Window width in pixel",
 		"--height %d", &options.height, "Window height in pixel",
 		"--tile-width %d", &options.session_params.tile_size.x, "Tile width in pixels",
 		"--tile-height %d", &options.session_params.tile_size.y, "Tile height in pixels",
+		"--half-tile-storage", &options.session_params.use_half_tile_storage, "Keep finished tiles as half floats instead of full frame float buffers",
+		"--profile %s", &options.session_params.profiling_report, "Profile CPU rendering and write the statistics as JSON to the given file",
+		"--path-guiding", &options.session_params.use_path_guiding, "Learn the indirect light during the first samples and guide bounces towards it (CPU only, requires progressive refine for background renders)",
+		"--guiding-training-samples %d", &options.session_params.guiding_training_samples, "Number of samples used to learn the light for path guiding",
 		"--list-devices", &list, "List information about all available devices",
+		"--denoise", &options.denoise, "Denoise multilayer EXR files with denoising data instead of rendering",
+		"--denoising-radius %d", &options.session_params.denoising_radius, "Radius of the denoising filter in pixels",
+		"--denoising-strength %f", &options.session_params.denoising_strength, "Strength of the denoising filter, from 0 to 1",
+		"--denoising-feature-strength %f", &options.session_params.denoising_feature_strength, "Strength of feature filtering, from 0 to 1",
+		"--denoising-relative-pca", &options.session_params.denoising_relative_pca, "Use a relative threshold for feature filtering",
+		"--denoising-neighbor-frames %d", &options.denoising_neighbor_frames, "Number of frames before and after each file to use for denoising (CPU only)",
 #ifdef WITH_CYCLES_LOGGING
 		"--debug", &debug, "Enable debug logging",
 		"--verbose %d", &verbosity, "Set verbosity of the logger",
@@ -424,6 +513,8 @@ static void options_parse(int argc, const char **argv)
 	/* Use progressive rendering */
 	options.session_params.progressive = true;
 
+	options.session_params.use_profiling = !options.session_params.profiling_report.empty();
+
 	/* find matching device */
 	DeviceType device_type = Device::type_from_string(devicename.c_str());
 	vector<DeviceInfo>& devices = Device::available_devices();
@@ -475,6 +566,10 @@ int main(int argc, const char **argv)
 	path_init();
 	options_parse(argc, argv);
 
+	if(options.denoise) {
+		return denoise_files()? EXIT_SUCCESS: EXIT_FAILURE;
+	}
+
 #ifdef WITH_CYCLES_STANDALONE_GUI
 	if(options.session_params.background) {
 #endif
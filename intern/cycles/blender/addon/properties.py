@@ -50,6 +50,7 @@ enum_displacement_methods = (
 enum_bvh_layouts = (
     ('BVH2', "BVH2", "", 1),
     ('BVH4', "BVH4", "", 2),
+    ('BVH8', "BVH8", "", 4),
     )
 
 enum_bvh_types = (
@@ -295,6 +296,47 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
                 min=0.0, max=1.0,
                 default=0.01,
                 )
+        cls.use_light_tree = BoolProperty(
+                name="Light Tree",
+                description="Pick lights by their estimated contribution to the shading point, "
+                            "much less noise in scenes with many lights or emissive meshes. "
+                            "Sample All Lights is ignored while it is enabled",
+                default=False,
+                )
+
+        cls.use_adaptive_sampling = BoolProperty(
+                name="Adaptive Sampling",
+                description="Automatically stop sampling pixels that have converged, "
+                            "so render time is spent on the noisy regions (CPU only)",
+                default=False,
+                )
+        cls.adaptive_threshold = FloatProperty(
+                name="Adaptive Noise Threshold",
+                description="Noise level at which a pixel is considered converged and stops being sampled",
+                min=0.0001, max=1.0, soft_min=0.001,
+                default=0.01,
+                precision=4,
+                )
+        cls.adaptive_min_samples = IntProperty(
+                name="Adaptive Min Samples",
+                description="Minimum number of samples to take before testing a pixel for convergence, "
+                            "automatic if 0",
+                min=0, max=4096,
+                default=0,
+                )
+        cls.use_path_guiding = BoolProperty(
+                name="Path Guiding",
+                description="Learn where indirect light comes from during the first samples and guide later bounces "
+                            "towards it, for interiors lit through small openings. Final renders need progressive "
+                            "refine (CPU only, Path integrator)",
+                default=False,
+                )
+        cls.guiding_training_samples = IntProperty(
+                name="Path Guiding Training Samples",
+                description="Number of samples used to learn the light distribution",
+                min=1, max=65536,
+                default=128,
+                )
 
         cls.caustics_reflective = BoolProperty(
                 name="Reflective Caustics",
@@ -409,6 +451,13 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
                 min=1.0, soft_max=25.0,
                 default=4.0,
                 )
+        cls.use_dicing_cache = BoolProperty(
+                name="Cache Dicing",
+                description="Keep the tessellation of adaptively subdivided meshes and reuse it when they are "
+                            "updated without changes to the base mesh, as long as the dicing camera moved only a "
+                            "little. Uses more memory, final renders need Persistent Data",
+                default=True,
+                )
 
         cls.film_exposure = FloatProperty(
                 name="Exposure",
@@ -523,6 +572,19 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
                 default=1.0,
                 )
 
+        cls.debug_use_profiling = BoolProperty(
+                name="Profiling",
+                description="Sample where CPU render time goes, per kernel stage, shader, object and shader node, "
+                            "and log the statistics when the render is done",
+                default=False,
+                )
+        cls.debug_profiling_report = StringProperty(
+                name="Profiling Report",
+                description="Absolute path of a file to write the profiling statistics to as JSON",
+                default="",
+                subtype='FILE_PATH',
+                )
+
         cls.debug_bvh_type = EnumProperty(
                 name="Viewport BVH Type",
                 description="Choose between faster updates, or faster render",
@@ -539,6 +601,25 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
                 description="Use special type BVH optimized for hair (uses more ram but renders faster)",
                 default=True,
                 )
+        cls.use_bvh_cache = BoolProperty(
+                name="Cache BVH",
+                description="Store BVH of final renders on disk and reuse it for unchanged geometry "
+                            "in later renders, e.g. static objects in animations",
+                default=False,
+                )
+        cls.use_bvh_refit = BoolProperty(
+                name="Refit BVH",
+                description="Update the bounds of the existing BVH instead of building it again when only "
+                            "vertex positions change, e.g. for deforming meshes. Uses more memory, final renders "
+                            "need Persistent Data",
+                default=True,
+                )
+        cls.use_ray_stream = BoolProperty(
+                name="Ray Streams",
+                description="Trace camera rays of neighboring pixels through the BVH together, "
+                            "faster for scenes without motion blur and hair (CPU only, Path integrator)",
+                default=False,
+                )
         cls.debug_bvh_time_steps = IntProperty(
                 name="BVH Time Steps",
                 description="Split BVH primitives by this number of time steps to speed up render time in cost of memory",
@@ -560,6 +641,12 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
                             "but time can be saved by manually stopping the render when the noise is low enough)",
                 default=False,
                 )
+        cls.use_tile_splitting = BoolProperty(
+                name="Split Tiles",
+                description="Split the remaining tiles near the end of the render, "
+                            "so that all threads keep busy until the last tile is done",
+                default=True,
+                )
 
         cls.bake_type = EnumProperty(
             name="Bake Type",
@@ -649,6 +736,19 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
             items=enum_texture_limit
             )
 
+        cls.use_texture_cache = BoolProperty(
+            name="Texture Cache",
+            description="Read tiled and mipmapped image files (e.g. .tx or tiled EXR) on demand "
+                        "instead of loading them into memory, only for CPU rendering with SVM",
+            default=False,
+            )
+        cls.texture_cache_size = IntProperty(
+            name="Cache Size",
+            description="Maximum memory used by tiles of the texture cache, in megabytes",
+            default=1024,
+            min=64, max=1024 * 1024,
+            )
+
         cls.ao_bounces = IntProperty(
             name="AO Bounces",
             default=0,
@@ -1241,6 +1341,12 @@ class CyclesRenderLayerSettings(bpy.types.PropertyGroup):
                 default=False,
                 update=update_render_passes,
                 )
+        cls.pass_debug_sample_count = BoolProperty(
+                name="Debug Sample Count",
+                description="Number of samples taken per pixel with adaptive sampling",
+                default=False,
+                update=update_render_passes,
+                )
         cls.use_pass_volume_direct = BoolProperty(
                 name="Volume Direct",
                 description="Deliver direct volumetric scattering pass",
@@ -172,6 +172,7 @@ class CYCLES_RENDER_PT_sampling(CyclesButtonsPanel, Panel):
         sub.prop(cscene, "sample_clamp_direct")
         sub.prop(cscene, "sample_clamp_indirect")
         sub.prop(cscene, "light_sampling_threshold")
+        sub.prop(cscene, "use_light_tree")
 
         if cscene.progressive == 'PATH' or use_branched_path(context) is False:
             col = split.column()
@@ -200,11 +201,27 @@ class CYCLES_RENDER_PT_sampling(CyclesButtonsPanel, Panel):
             sub.prop(cscene, "volume_samples", text="Volume")
 
             col = layout.column(align=True)
+            col.active = not cscene.use_light_tree
             col.prop(cscene, "sample_all_lights_direct")
             col.prop(cscene, "sample_all_lights_indirect")
 
         layout.row().prop(cscene, "sampling_pattern", text="Pattern")
 
+        row = layout.row()
+        row.prop(cscene, "use_adaptive_sampling")
+        sub = row.row(align=True)
+        sub.active = cscene.use_adaptive_sampling
+        sub.prop(cscene, "adaptive_threshold", text="Threshold")
+        sub.prop(cscene, "adaptive_min_samples", text="Min Samples")
+
+        row = layout.row()
+        row.active = (cscene.progressive == 'PATH' and
+                      cscene.use_progressive_refine and not scene.render.use_save_buffers)
+        row.prop(cscene, "use_path_guiding")
+        sub = row.row()
+        sub.active = cscene.use_path_guiding
+        sub.prop(cscene, "guiding_training_samples", text="Training Samples")
+
         for rl in scene.render.layers:
             if rl.samples > 0:
                 layout.separator()
@@ -247,6 +264,7 @@ class CYCLES_RENDER_PT_geometry(CyclesButtonsPanel, Panel):
             col.prop(cscene, "max_subdivisions")
 
             layout.prop(cscene, "dicing_camera")
+            layout.prop(cscene, "use_dicing_cache")
 
             layout.separator()
 
@@ -420,11 +438,15 @@ class CYCLES_RENDER_PT_performance(CyclesButtonsPanel, Panel):
                 subsub.active = False
         subsub.prop(cscene, "use_progressive_refine")
 
+        subsub = sub.column()
+        subsub.active = not rd.use_save_buffers and not cscene.use_progressive_refine
+        subsub.prop(cscene, "use_tile_splitting")
+
         col = split.column()
 
         col.label(text="Final Render:")
         col.prop(rd, "use_save_buffers")
-        col.prop(rd, "use_persistent_data", text="Persistent Images")
+        col.prop(rd, "use_persistent_data", text="Persistent Data")
 
         col.separator()
 
@@ -435,6 +457,18 @@ class CYCLES_RENDER_PT_performance(CyclesButtonsPanel, Panel):
         row = col.row()
         row.active = not cscene.debug_use_spatial_splits
         row.prop(cscene, "debug_bvh_time_steps")
+        col.prop(cscene, "use_bvh_cache")
+        col.prop(cscene, "use_bvh_refit")
+        sub = col.row()
+        sub.active = cscene.progressive == 'PATH'
+        sub.prop(cscene, "use_ray_stream")
+
+        col.separator()
+
+        col.prop(cscene, "use_texture_cache")
+        sub = col.row()
+        sub.active = cscene.use_texture_cache
+        sub.prop(cscene, "texture_cache_size")
 
         col = layout.column()
         col.label(text="Viewport Resolution:")
@@ -556,6 +590,7 @@ class CYCLES_RENDER_PT_layer_passes(CyclesButtonsPanel, Panel):
 
         col = layout.column()
         col.prop(crl, "pass_debug_render_time")
+        col.prop(crl, "pass_debug_sample_count")
         if _cycles.with_cycles_debug:
             col.prop(crl, "pass_debug_bvh_traversed_nodes")
             col.prop(crl, "pass_debug_bvh_traversed_instances")
@@ -1650,6 +1685,14 @@ class CYCLES_RENDER_PT_debug(CyclesButtonsPanel, Panel):
         col = layout.column()
         col.prop(cscene, "debug_bvh_type")
 
+        col.separator()
+
+        col = layout.column()
+        col.prop(cscene, "debug_use_profiling")
+        sub = col.column()
+        sub.active = cscene.debug_use_profiling
+        sub.prop(cscene, "debug_profiling_report", text="Report")
+
 
 class CYCLES_PARTICLE_PT_curve_settings(CyclesButtonsPanel, Panel):
     bl_label = "Cycles Hair Settings"
@@ -1155,6 +1155,9 @@ Mesh *BlenderSync::sync_mesh(BL::Object& b_ob,
 	oldcurve_keys.steal_data(mesh->curve_keys);
 	oldcurve_radius.steal_data(mesh->curve_radius);
 
+	/* clear() drops the applied transform, so such meshes always change */
+	bool old_transform_applied = mesh->transform_applied;
+
 	mesh->clear();
 	mesh->used_shaders = used_shaders;
 	mesh->name = ustring(b_ob_data.name().c_str());
@@ -1215,6 +1218,30 @@ Mesh *BlenderSync::sync_mesh(BL::Object& b_ob,
 	/* fluid motion */
 	sync_mesh_fluid_motion(b_ob, scene, mesh);
 
+	/* skip the update if the exported mesh is identical to what is already
+	 * on the device, only restoring the normals that clear() removed. This
+	 * excludes meshes whose data gets modified during the device update. */
+	string content_hash = mesh->compute_content_hash();
+
+	if(content_hash == mesh->content_hash &&
+	   !old_transform_applied &&
+	   !mesh->use_motion_blur &&
+	   mesh->subdivision_type == Mesh::SUBDIVISION_NONE &&
+	   !mesh->has_true_displacement() &&
+	   !mesh->need_update)
+	{
+		mesh->add_face_normals();
+		mesh->add_vertex_normals();
+
+		if(mesh->need_attribute(scene, ATTR_STD_POSITION_UNDISPLACED)) {
+			mesh->add_undisplaced();
+		}
+
+		return mesh;
+	}
+
+	mesh->content_hash = content_hash;
+
 	/* tag update */
 	bool rebuild = (oldtriangles != mesh->triangles) ||
 	               (oldsubd_faces != mesh->subd_faces) ||
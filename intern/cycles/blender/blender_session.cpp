@@ -193,6 +193,9 @@ void BlenderSession::reset_session(BL::BlendData& b_data_, BL::Scene& b_scene_)
 		 * them rather than trying to distinguish which settings need to be updated
 		 */
 
+		delete sync;
+		sync = NULL;
+
 		delete session;
 
 		create_session();
@@ -201,7 +204,6 @@ void BlenderSession::reset_session(BL::BlendData& b_data_, BL::Scene& b_scene_)
 	}
 
 	session->progress.reset();
-	scene->reset();
 
 	session->tile_manager.set_tile_order(session_params.tile_order);
 
@@ -210,8 +212,16 @@ void BlenderSession::reset_session(BL::BlendData& b_data_, BL::Scene& b_scene_)
 	 */
 	session->stats.mem_peak = session->stats.mem_used;
 
-	/* sync object should be re-created */
-	sync = new BlenderSync(b_engine, b_data, b_scene, scene, !background, session->progress);
+	if(sync) {
+		/* scene data of the previous frame was kept, sync everything again
+		 * and only update what actually changed */
+		sync->reset(b_data, b_scene);
+	}
+	else {
+		/* sync object should be re-created */
+		scene->reset();
+		sync = new BlenderSync(b_engine, b_data, b_scene, scene, !background, session->progress);
+	}
 
 	/* for final render we will do full data sync per render layer, only
 	 * do some basic syncing here, no objects or materials for speed */
@@ -431,6 +441,7 @@ void BlenderSession::render()
 		scene->film->tag_update(scene);
 		scene->integrator->tag_update(scene);
 
+		int layer_samples = 0;
 		int view_index = 0;
 		for(b_rr.views.begin(b_view_iter); b_view_iter != b_rr.views.end(); ++b_view_iter, ++view_index) {
 			b_rview_name = b_view_iter->name();
@@ -464,6 +475,8 @@ void BlenderSession::render()
 			else
 				effective_layer_samples = session_params.samples;
 
+			layer_samples = effective_layer_samples;
+
 			/* Update tile manager if we're doing resumable render. */
 			update_resumable_tile_manager(effective_layer_samples);
 
@@ -478,6 +491,15 @@ void BlenderSession::render()
 				break;
 		}
 
+		/* Store the sample count of the layer, which is needed to interpret
+		 * its denoising passes when denoising the file afterwards. */
+		if(use_denoising && get_boolean(crl, "denoising_store_passes")) {
+			BL::RenderResult b_full_rr = b_engine.get_result();
+			string num_layer_samples = string_printf("%d", layer_samples);
+			b_full_rr.stamp_data_add_field(("cycles." + b_rlay_name + ".samples").c_str(),
+			                               num_layer_samples.c_str());
+		}
+
 		if(is_single_layer) {
 			BL::RenderResult b_rr = b_engine.get_result();
 			string num_aa_samples = string_printf("%d", session->params.samples);
@@ -499,18 +521,33 @@ void BlenderSession::render()
 	VLOG(1) << "Total render time: " << total_time;
 	VLOG(1) << "Render time (without synchronization): " << render_time;
 
+	vector<float> utilization = session->progress.get_thread_utilization();
+	for(size_t i = 0; i < utilization.size(); i++) {
+		/* Skip threads which did not render any tile. */
+		if(utilization[i] == 0.0f) {
+			continue;
+		}
+		VLOG(1) << "Thread " << i << " utilization: " << utilization[i]*100.0f << "%";
+	}
+
 	/* clear callback */
 	session->write_render_tile_cb = function_null;
 	session->update_render_tile_cb = function_null;
 
 	/* free all memory used (host and device), so we wouldn't leave render
-	 * engine with extra memory allocated
+	 * engine with extra memory allocated. With persistent data the scene and
+	 * sync are kept to render the next frame incrementally.
 	 */
 
-	session->device_free();
+	if(scene->params.persistent_data && !session->progress.get_cancel()) {
+		session->tile_manager.device_free();
+	}
+	else {
+		session->device_free();
 
-	delete sync;
-	sync = NULL;
+		delete sync;
+		sync = NULL;
+	}
 }
 
 static void populate_bake_data(BakeData *data, const
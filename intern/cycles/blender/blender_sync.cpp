@@ -76,6 +76,23 @@ BlenderSync::~BlenderSync()
 
 /* Sync */
 
+void BlenderSync::reset(BL::BlendData& b_data, BL::Scene& b_scene)
+{
+	/* Used to render a new frame into the scene kept from the previous one.
+	 * Blender recalc flags are not available for frame changes in final
+	 * renders, so check all data again. Meshes with unchanged content and
+	 * objects with unchanged transform are not tagged for update. */
+	this->b_data = b_data;
+	this->b_scene = b_scene;
+
+	shader_map.set_recalc_all();
+	object_map.set_recalc_all();
+	mesh_map.set_recalc_all();
+	light_map.set_recalc_all();
+	particle_system_map.set_recalc_all();
+	world_recalc = true;
+}
+
 bool BlenderSync::sync_recalc()
 {
 	/* sync recalc flags from blender to cycles. actual update is done separate,
@@ -285,6 +302,16 @@ void BlenderSync::sync_integrator()
 	integrator->sample_all_lights_indirect = get_boolean(cscene, "sample_all_lights_indirect");
 	integrator->light_sampling_threshold = get_float(cscene, "light_sampling_threshold");
 
+	bool use_light_tree = get_boolean(cscene, "use_light_tree");
+	if(integrator->use_light_tree != use_light_tree) {
+		scene->light_manager->tag_update(scene);
+	}
+	integrator->use_light_tree = use_light_tree;
+	integrator->use_ray_stream = get_boolean(cscene, "use_ray_stream");
+
+	integrator->adaptive_threshold = get_float(cscene, "adaptive_threshold");
+	integrator->adaptive_min_samples = get_int(cscene, "adaptive_min_samples");
+
 	int diffuse_samples = get_int(cscene, "diffuse_samples");
 	int glossy_samples = get_int(cscene, "glossy_samples");
 	int transmission_samples = get_int(cscene, "transmission_samples");
@@ -517,6 +544,7 @@ PassType BlenderSync::get_pass_type(BL::RenderPass& b_pass)
 	MAP_PASS("Debug Ray Bounces", PASS_RAY_BOUNCES);
 #endif
 	MAP_PASS("Debug Render Time", PASS_RENDER_TIME);
+	MAP_PASS("Debug Sample Count", PASS_SAMPLE_COUNT);
 #undef MAP_PASS
 
 	return PASS_NONE;
@@ -607,6 +635,14 @@ array<Pass> BlenderSync::sync_render_passes(BL::RenderLayer& b_rlay,
 		b_engine.add_pass("Debug Render Time", 1, "X", b_srlay.name().c_str());
 		Pass::add(PASS_RENDER_TIME, passes);
 	}
+	if(get_boolean(crp, "pass_debug_sample_count")) {
+		b_engine.add_pass("Debug Sample Count", 1, "X", b_srlay.name().c_str());
+		Pass::add(PASS_SAMPLE_COUNT, passes);
+	}
+	PointerRNA cscene = RNA_pointer_get(&b_scene.ptr, "cycles");
+	if(get_boolean(cscene, "use_adaptive_sampling")) {
+		Pass::add(PASS_ADAPTIVE_AUX_BUFFER, passes);
+	}
 	if(get_boolean(crp, "use_pass_volume_direct")) {
 		b_engine.add_pass("VolumeDir", 3, "RGB", b_srlay.name().c_str());
 		Pass::add(PASS_VOLUME_DIRECT, passes);
@@ -642,12 +678,20 @@ SceneParams BlenderSync::get_scene_params(BL::Scene& b_scene,
 	params.use_bvh_spatial_split = RNA_boolean_get(&cscene, "debug_use_spatial_splits");
 	params.use_bvh_unaligned_nodes = RNA_boolean_get(&cscene, "debug_use_hair_bvh");
 	params.num_bvh_time_steps = RNA_int_get(&cscene, "debug_bvh_time_steps");
+	params.use_bvh_cache = background && RNA_boolean_get(&cscene, "use_bvh_cache");
 
 	if(background && params.shadingsystem != SHADINGSYSTEM_OSL)
 		params.persistent_data = r.use_persistent_data();
 	else
 		params.persistent_data = false;
 
+	/* Final renders only benefit from refitting when the scene is kept
+	 * between frames. */
+	params.use_bvh_refit = RNA_boolean_get(&cscene, "use_bvh_refit") &&
+	                       (!background || params.persistent_data);
+	params.use_dicing_cache = RNA_boolean_get(&cscene, "use_dicing_cache") &&
+	                          (!background || params.persistent_data);
+
 	int texture_limit;
 	if(background) {
 		texture_limit = RNA_enum_get(&cscene, "texture_limit_render");
@@ -662,6 +706,9 @@ SceneParams BlenderSync::get_scene_params(BL::Scene& b_scene,
 		params.texture_limit = 0;
 	}
 
+	params.use_texture_cache = RNA_boolean_get(&cscene, "use_texture_cache");
+	params.texture_cache_size = RNA_int_get(&cscene, "texture_cache_size");
+
 	params.bvh_layout = DebugFlags().cpu.bvh_layout;
 
 	return params;
@@ -836,10 +883,25 @@ SessionParams BlenderSync::get_session_params(BL::RenderEngine& b_engine,
 	params.reset_timeout = (double)get_float(cscene, "debug_reset_timeout");
 	params.text_timeout = (double)get_float(cscene, "debug_text_timeout");
 
+	/* profiling */
+	params.use_profiling = get_boolean(cscene, "debug_use_profiling");
+	if(params.use_profiling) {
+		params.profiling_report = get_string(cscene, "debug_profiling_report");
+	}
+
 	/* progressive refine */
 	params.progressive_refine = get_boolean(cscene, "use_progressive_refine") &&
 	                            !b_r.use_save_buffers();
 
+	/* path guiding, final renders only use it with progressive refine */
+	params.use_path_guiding = get_boolean(cscene, "use_path_guiding");
+	params.guiding_training_samples = get_int(cscene, "guiding_training_samples");
+
+	/* split tiles don't match the tiles of the saved buffers */
+	params.use_tile_splitting = background &&
+	                            get_boolean(cscene, "use_tile_splitting") &&
+	                            !b_r.use_save_buffers();
+
 	if(params.progressive_refine) {
 		BL::RenderSettings::layers_iterator b_rlay;
 		for(b_r.layers.begin(b_rlay); b_rlay != b_r.layers.end(); ++b_rlay) {
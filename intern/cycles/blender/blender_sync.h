@@ -58,6 +58,7 @@ public:
 	~BlenderSync();
 
 	/* sync */
+	void reset(BL::BlendData& b_data, BL::Scene& b_scene);
 	bool sync_recalc();
 	void sync_data(BL::RenderSettings& b_render,
 	               BL::SpaceView3D& b_v3d,
@@ -599,6 +599,7 @@ public:
 	id_map(vector<T*> *scene_data_)
 	{
 		scene_data = scene_data_;
+		recalc_all = false;
 	}
 
 	T *find(const BL::ID& id)
@@ -621,9 +622,16 @@ public:
 		b_recalc.insert(id.ptr.data);
 	}
 
+	/* Tag all existing data for recalc on the next sync, for when there are
+	 * no reliable recalc flags from Blender. */
+	void set_recalc_all()
+	{
+		recalc_all = true;
+	}
+
 	bool has_recalc()
 	{
-		return !(b_recalc.empty());
+		return recalc_all || !(b_recalc.empty());
 	}
 
 	void pre_sync()
@@ -649,7 +657,7 @@ public:
 			recalc = true;
 		}
 		else {
-			recalc = (b_recalc.find(id.ptr.data) != b_recalc.end());
+			recalc = recalc_all || (b_recalc.find(id.ptr.data) != b_recalc.end());
 			if(parent.ptr.data)
 				recalc = recalc || (b_recalc.find(parent.ptr.data) != b_recalc.end());
 		}
@@ -711,6 +719,7 @@ public:
 
 		used_set.clear();
 		b_recalc.clear();
+		recalc_all = false;
 		b_map = new_map;
 
 		return deleted;
@@ -721,6 +730,7 @@ protected:
 	map<K, T*> b_map;
 	set<T*> used_set;
 	set<void*> b_recalc;
+	bool recalc_all;
 };
 
 /* Object Key */
@@ -22,12 +22,17 @@
 
 #include "bvh/bvh2.h"
 #include "bvh/bvh4.h"
+#include "bvh/bvh8.h"
 #include "bvh/bvh_build.h"
 #include "bvh/bvh_node.h"
 
 #include "util/util_foreach.h"
 #include "util/util_logging.h"
+#include "util/util_map.h"
+#include "util/util_md5.h"
+#include "util/util_path.h"
 #include "util/util_progress.h"
+#include "util/util_time.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -38,6 +43,7 @@ const char *bvh_layout_name(BVHLayout layout)
 	switch(layout) {
 		case BVH_LAYOUT_BVH2: return "BVH2";
 		case BVH_LAYOUT_BVH4: return "BVH4";
+		case BVH_LAYOUT_BVH8: return "BVH8";
 		case BVH_LAYOUT_NONE: return "NONE";
 		case BVH_LAYOUT_ALL:  return "ALL";
 	}
@@ -83,6 +89,12 @@ int BVHStackEntry::encodeIdx() const
 BVH::BVH(const BVHParams& params_, const vector<Object*>& objects_)
 : params(params_), objects(objects_)
 {
+	build_leaf_cost = 0.0f;
+	refit_leaf_cost = 0.0;
+	refit_bounds = BoundBox::empty;
+	top_level_num_prims = 0;
+	top_level_num_nodes = 0;
+	top_level_num_leaf_nodes = 0;
 }
 
 BVH *BVH::create(const BVHParams& params, const vector<Object*>& objects)
@@ -92,6 +104,8 @@ BVH *BVH::create(const BVHParams& params, const vector<Object*>& objects)
 			return new BVH2(params, objects);
 		case BVH_LAYOUT_BVH4:
 			return new BVH4(params, objects);
+		case BVH_LAYOUT_BVH8:
+			return new BVH8(params, objects);
 		case BVH_LAYOUT_NONE:
 		case BVH_LAYOUT_ALL:
 			break;
@@ -102,8 +116,34 @@ BVH *BVH::create(const BVHParams& params, const vector<Object*>& objects)
 
 /* Building */
 
+/* Sum of leaf areas weighted by their number of primitives, which is the
+ * primitive part of the SAH cost. Unlike the inner nodes the leaves are the
+ * same for all BVH layouts, so this can be compared against refitted trees. */
+static double bvh_leaf_cost(const BVHNode *node)
+{
+	if(node->is_leaf()) {
+		return (double)node->num_triangles() * node->bounds.safe_area();
+	}
+
+	double cost = 0.0;
+	for(int i = 0; i < node->num_children(); i++) {
+		cost += bvh_leaf_cost(node->get_child(i));
+	}
+	return cost;
+}
+
 void BVH::build(Progress& progress)
 {
+	if(params.use_cache) {
+		progress.set_substatus("Looking in BVH cache");
+		cache_name = cache_compute_name();
+
+		if(cache_read()) {
+			VLOG(1) << "Loaded BVH from cache " << cache_name << ".";
+			return;
+		}
+	}
+
 	progress.set_substatus("Building BVH");
 
 	/* build nodes */
@@ -121,6 +161,11 @@ void BVH::build(Progress& progress)
 		return;
 	}
 
+	if(root) {
+		const float root_area = root->bounds.safe_area();
+		build_leaf_cost = (root_area > 0.0f)? (float)(bvh_leaf_cost(root)/root_area): 0.0f;
+	}
+
 	/* pack triangles */
 	progress.set_substatus("Packing BVH triangles and strands");
 	pack_primitives();
@@ -136,24 +181,382 @@ void BVH::build(Progress& progress)
 
 	/* free build nodes */
 	root->deleteSubtree();
+
+	if(params.use_cache) {
+		progress.set_substatus("Writing BVH cache");
+		if(!cache_write()) {
+			VLOG(1) << "Failed to write BVH cache " << cache_name << ".";
+		}
+	}
+}
+
+/* Disk Cache
+ *
+ * The packed BVH is stored in the user cache directory, with the file name
+ * derived from an MD5 hash of everything the build depends on: the build
+ * parameters and the geometry of all objects. Identical geometry in later
+ * renders, e.g. static meshes in an animation or the same frame rendered on
+ * another farm job, loads the result instead of building it again. */
+
+#define BVH_CACHE_MAGIC   0x48564243  /* "CBVH" */
+#define BVH_CACHE_VERSION 4
+
+/* Entries store arrays in the native memory layout, so they can only be read
+ * back on the same architecture. The byte order mark changes its value when
+ * read with the other byte order, the pointer size separates 32 and 64 bit. */
+static int cache_arch()
+{
+	return 0x0102 | ((int)sizeof(void*) << 16);
+}
+
+static void cache_hash_data(MD5Hash& md5, const void *data, size_t size)
+{
+	/* MD5Hash takes int sizes, feed large arrays in chunks. */
+	const uint8_t *bytes = (const uint8_t*)data;
+	const size_t chunk_size = (size_t)1 << 30;
+
+	while(size > 0) {
+		const size_t num = min(size, chunk_size);
+		md5.append(bytes, (int)num);
+		bytes += num;
+		size -= num;
+	}
+}
+
+template<typename T>
+static void cache_hash_value(MD5Hash& md5, const T& value)
+{
+	cache_hash_data(md5, &value, sizeof(T));
+}
+
+template<typename T>
+static void cache_hash_array(MD5Hash& md5, const array<T>& data)
+{
+	cache_hash_value(md5, data.size());
+	if(data.size()) {
+		cache_hash_data(md5, &data[0], data.size()*sizeof(T));
+	}
+}
+
+static void cache_hash_float3(MD5Hash& md5, const float3 *data, size_t size)
+{
+	/* The fourth component of float3 is padding and may contain garbage. */
+	const size_t block_size = 4096;
+	float block[block_size*3];
+
+	cache_hash_value(md5, size);
+
+	for(size_t i = 0; i < size; i += block_size) {
+		const size_t num = min(block_size, size - i);
+		for(size_t j = 0; j < num; j++) {
+			block[j*3 + 0] = data[i + j].x;
+			block[j*3 + 1] = data[i + j].y;
+			block[j*3 + 2] = data[i + j].z;
+		}
+		cache_hash_data(md5, block, num*3*sizeof(float));
+	}
+}
+
+static void cache_hash_mesh(MD5Hash& md5, const Mesh *mesh)
+{
+	cache_hash_float3(md5, (mesh->verts.size())? &mesh->verts[0]: NULL, mesh->verts.size());
+	cache_hash_array(md5, mesh->triangles);
+	cache_hash_float3(md5, (mesh->curve_keys.size())? &mesh->curve_keys[0]: NULL, mesh->curve_keys.size());
+	cache_hash_array(md5, mesh->curve_radius);
+	cache_hash_array(md5, mesh->curve_first_key);
+
+	cache_hash_value(md5, mesh->use_motion_blur);
+	cache_hash_value(md5, mesh->motion_steps);
+
+	if(mesh->use_motion_blur) {
+		const Attribute *attr = mesh->attributes.find(ATTR_STD_MOTION_VERTEX_POSITION);
+		if(attr) {
+			cache_hash_float3(md5, attr->data_float3(), attr->buffer.size()/sizeof(float3));
+		}
+
+		const Attribute *curve_attr = mesh->curve_attributes.find(ATTR_STD_MOTION_VERTEX_POSITION);
+		if(curve_attr) {
+			cache_hash_float3(md5, curve_attr->data_float3(), curve_attr->buffer.size()/sizeof(float3));
+		}
+	}
+}
+
+string BVH::cache_compute_name()
+{
+	MD5Hash md5;
+
+	cache_hash_value(md5, BVH_CACHE_VERSION);
+
+	/* Parameters. */
+	cache_hash_value(md5, params.use_spatial_split);
+	cache_hash_value(md5, params.spatial_split_alpha);
+	cache_hash_value(md5, params.unaligned_split_threshold);
+	cache_hash_value(md5, params.sah_node_cost);
+	cache_hash_value(md5, params.sah_primitive_cost);
+	cache_hash_value(md5, params.min_leaf_size);
+	cache_hash_value(md5, params.max_triangle_leaf_size);
+	cache_hash_value(md5, params.max_motion_triangle_leaf_size);
+	cache_hash_value(md5, params.max_curve_leaf_size);
+	cache_hash_value(md5, params.max_motion_curve_leaf_size);
+	cache_hash_value(md5, params.top_level);
+	cache_hash_value(md5, params.bvh_layout);
+	cache_hash_value(md5, params.primitive_mask);
+	cache_hash_value(md5, params.use_unaligned_nodes);
+	cache_hash_value(md5, params.num_motion_curve_steps);
+	cache_hash_value(md5, params.num_motion_triangle_steps);
+	cache_hash_value(md5, params.max_curve_subsegment_level);
+
+	/* Objects, instanced meshes are only hashed once.
+	 *
+	 * Object level BVHs are built in object space and their primitive indices
+	 * only get offset into the global arrays when merged into the top level,
+	 * so transforms and offsets are left out to reuse them when other objects
+	 * change. */
+	map<const Mesh*, int> mesh_index;
+
+	cache_hash_value(md5, objects.size());
+
+	foreach(Object *ob, objects) {
+		const Mesh *mesh = ob->mesh;
+
+		cache_hash_value(md5, ob->visibility_for_tracing());
+		cache_hash_value(md5, mesh->need_build_bvh());
+
+		if(params.top_level) {
+			cache_hash_float3(md5, &ob->bounds.min, 1);
+			cache_hash_float3(md5, &ob->bounds.max, 1);
+			cache_hash_value(md5, ob->tfm);
+			cache_hash_value(md5, ob->use_motion);
+			if(ob->use_motion) {
+				cache_hash_value(md5, ob->motion);
+			}
+			cache_hash_value(md5, mesh->tri_offset);
+			cache_hash_value(md5, mesh->curve_offset);
+		}
+
+		map<const Mesh*, int>::iterator it = mesh_index.find(mesh);
+		if(it != mesh_index.end()) {
+			cache_hash_value(md5, it->second);
+		}
+		else {
+			const int index = mesh_index.size();
+			mesh_index[mesh] = index;
+			cache_hash_value(md5, index);
+			cache_hash_mesh(md5, mesh);
+		}
+	}
+
+	return "bvh_" + md5.get_hex();
+}
+
+/* Remaining is the number of bytes left in the file, a corrupted element count
+ * fails here instead of allocating more memory than the file can hold. */
+template<typename T>
+static bool cache_read_array(FILE *f, size_t& remaining, array<T>& data)
+{
+	uint64_t size;
+	if(remaining < sizeof(size) || fread(&size, sizeof(size), 1, f) != 1) {
+		return false;
+	}
+	remaining -= sizeof(size);
+
+	data.clear();
+	if(size == 0) {
+		return true;
+	}
+	if(size > remaining / sizeof(T)) {
+		return false;
+	}
+	remaining -= size * sizeof(T);
+
+	T *ptr = data.resize(size);
+	return (fread(ptr, sizeof(T), size, f) == size);
 }
 
-/* Refitting */
+template<typename T>
+static bool cache_write_array(FILE *f, const array<T>& data)
+{
+	uint64_t size = data.size();
+	if(fwrite(&size, sizeof(size), 1, f) != 1) {
+		return false;
+	}
+
+	return (size == 0 || fwrite(&data[0], sizeof(T), size, f) == size);
+}
+
+bool BVH::cache_read()
+{
+	string filepath = path_cache_get(cache_name);
+	size_t remaining = path_file_size(filepath);
+	if(remaining == (size_t)-1) {
+		return false;
+	}
+
+	FILE *f = path_fopen(filepath, "rb");
+
+	if(!f) {
+		return false;
+	}
+
+	int header[4];
+	bool ok = (remaining >= sizeof(header)) &&
+	          (fread(header, sizeof(header), 1, f) == 1) &&
+	          (header[0] == BVH_CACHE_MAGIC) &&
+	          (header[1] == BVH_CACHE_VERSION) &&
+	          (header[2] == cache_arch());
+
+	if(ok) {
+		remaining -= sizeof(header);
+		pack.root_index = header[3];
+
+		ok = cache_read_array(f, remaining, pack.nodes) &&
+		     cache_read_array(f, remaining, pack.leaf_nodes) &&
+		     cache_read_array(f, remaining, pack.object_node) &&
+		     cache_read_array(f, remaining, pack.prim_tri_index) &&
+		     cache_read_array(f, remaining, pack.prim_tri_verts) &&
+		     cache_read_array(f, remaining, pack.prim_type) &&
+		     cache_read_array(f, remaining, pack.prim_visibility) &&
+		     cache_read_array(f, remaining, pack.prim_index) &&
+		     cache_read_array(f, remaining, pack.prim_object) &&
+		     cache_read_array(f, remaining, pack.prim_time);
+	}
+
+	fclose(f);
+
+	if(!ok) {
+		/* Truncated, outdated or foreign entry, rebuild and overwrite it. */
+		VLOG(1) << "Invalid BVH cache " << filepath << ".";
+		pack = PackedBVH();
+	}
 
-void BVH::refit(Progress& progress)
+	return ok;
+}
+
+bool BVH::cache_write()
 {
+	string filepath = path_cache_get(cache_name);
+
+	/* Write to a temporary file first, so other processes sharing the cache
+	 * directory never read a partially written entry. */
+	string temp_filepath = string_printf("%s.%p.%.0f.tmp",
+	                                     filepath.c_str(),
+	                                     (void*)this,
+	                                     time_dt()*1e6);
+
+	path_create_directories(filepath);
+	FILE *f = path_fopen(temp_filepath, "wb");
+
+	if(!f) {
+		return false;
+	}
+
+	int header[4] = {BVH_CACHE_MAGIC,
+	                 BVH_CACHE_VERSION,
+	                 cache_arch(),
+	                 pack.root_index};
+	bool ok = (fwrite(header, sizeof(header), 1, f) == 1) &&
+	          cache_write_array(f, pack.nodes) &&
+	          cache_write_array(f, pack.leaf_nodes) &&
+	          cache_write_array(f, pack.object_node) &&
+	          cache_write_array(f, pack.prim_tri_index) &&
+	          cache_write_array(f, pack.prim_tri_verts) &&
+	          cache_write_array(f, pack.prim_type) &&
+	          cache_write_array(f, pack.prim_visibility) &&
+	          cache_write_array(f, pack.prim_index) &&
+	          cache_write_array(f, pack.prim_object) &&
+	          cache_write_array(f, pack.prim_time);
+
+	ok = (fclose(f) == 0) && ok;
+
+	if(ok) {
+		path_remove(filepath);
+		ok = (rename(temp_filepath.c_str(), filepath.c_str()) == 0);
+	}
+	if(!ok) {
+		path_remove(temp_filepath);
+	}
+
+	return ok;
+}
+
+/* Refitting
+ *
+ * When only primitive positions change, the existing tree topology is kept
+ * and the bounds are recomputed bottom-up. This is much faster than a build,
+ * but the tree gets worse the more primitives move relative to each other.
+ * The cost of the leaves is tracked to detect when to build again. */
+
+bool BVH::refit(Progress& progress)
+{
+	if(params.top_level) {
+		/* Instance BVHs were merged into the packed arrays, and primitive
+		 * indices offset into the global arrays. Strip them to get the
+		 * state right after building, they get merged again after refit. */
+		if(top_level_num_prims == 0) {
+			return false;
+		}
+
+		pack.prim_index.resize(top_level_num_prims);
+		pack.prim_type.resize(top_level_num_prims);
+		pack.prim_object.resize(top_level_num_prims);
+		if(pack.prim_time.size()) {
+			pack.prim_time.resize(top_level_num_prims);
+		}
+		pack.nodes.resize(top_level_num_nodes);
+		pack.leaf_nodes.resize(top_level_num_leaf_nodes);
+
+		for(size_t i = 0; i < pack.prim_index.size(); i++) {
+			if(pack.prim_index[i] != -1) {
+				const Mesh *mesh = objects[pack.prim_object[i]]->mesh;
+				if(pack.prim_type[i] & PRIMITIVE_ALL_CURVE)
+					pack.prim_index[i] -= mesh->curve_offset;
+				else
+					pack.prim_index[i] -= mesh->tri_offset;
+			}
+		}
+	}
+
 	progress.set_substatus("Packing BVH primitives");
 	pack_primitives();
 
-	if(progress.get_cancel()) return;
+	if(progress.get_cancel()) return false;
 
 	progress.set_substatus("Refitting BVH nodes");
+	refit_leaf_cost = 0.0;
+	refit_bounds = BoundBox::empty;
 	refit_nodes();
+
+	if(params.top_level) {
+		pack_instances(top_level_num_nodes, top_level_num_leaf_nodes);
+	}
+
+	const float root_area = refit_bounds.safe_area();
+	const float leaf_cost = (root_area > 0.0f)? (float)(refit_leaf_cost/root_area): 0.0f;
+
+	if(build_leaf_cost == 0.0f) {
+		/* Loaded from cache, use the first refit as reference. */
+		build_leaf_cost = leaf_cost;
+	}
+	else if(leaf_cost > build_leaf_cost*params.refit_max_cost_ratio) {
+		VLOG(1) << "Refitted BVH leaf cost " << leaf_cost
+		        << " exceeds built cost " << build_leaf_cost
+		        << ", rebuilding.";
+		return false;
+	}
+
+	return true;
 }
 
 void BVH::refit_primitives(int start, int end, BoundBox& bbox, uint& visibility)
 {
-	/* Refit range of primitives. */
+	/* Leaves of object instances store the inverted index of their single
+	 * primitive. */
+	if(start < 0) {
+		start = ~start;
+		end = start + 1;
+	}
+
+	/* Refit range of primitives, indices are local to the mesh. */
 	for(int prim = start; prim < end; prim++) {
 		int pidx = pack.prim_index[prim];
 		int tob = pack.prim_object[prim];
@@ -169,11 +572,17 @@ void BVH::refit_primitives(int start, int end, BoundBox& bbox, uint& visibility)
 
 			if(pack.prim_type[prim] & PRIMITIVE_ALL_CURVE) {
 				/* Curves. */
-				int str_offset = (params.top_level)? mesh->curve_offset: 0;
-				Mesh::Curve curve = mesh->get_curve(pidx - str_offset);
+				Mesh::Curve curve = mesh->get_curve(pidx);
 				int k = PRIMITIVE_UNPACK_SEGMENT(pack.prim_type[prim]);
+				float t_start, t_end;
+				curve_subsegment_range(pack.prim_type[prim], &t_start, &t_end);
 
-				curve.bounds_grow(k, &mesh->curve_keys[0], &mesh->curve_radius[0], bbox);
+				curve.bounds_grow(k,
+				                  &mesh->curve_keys[0],
+				                  &mesh->curve_radius[0],
+				                  bbox,
+				                  t_start,
+				                  t_end);
 
 				visibility |= PATH_RAY_CURVE;
 
@@ -193,8 +602,7 @@ void BVH::refit_primitives(int start, int end, BoundBox& bbox, uint& visibility)
 			}
 			else {
 				/* Triangles. */
-				int tri_offset = (params.top_level)? mesh->tri_offset: 0;
-				Mesh::Triangle triangle = mesh->get_triangle(pidx - tri_offset);
+				Mesh::Triangle triangle = mesh->get_triangle(pidx);
 				const float3 *vpos = &mesh->verts[0];
 
 				triangle.bounds_grow(vpos, bbox);
@@ -216,6 +624,10 @@ void BVH::refit_primitives(int start, int end, BoundBox& bbox, uint& visibility)
 		}
 		visibility |= ob->visibility_for_tracing();
 	}
+
+	/* Leaf bounds are expected to start out empty. */
+	refit_leaf_cost += (double)(end - start) * bbox.safe_area();
+	refit_bounds.grow(bbox);
 }
 
 /* Triangles */
@@ -291,8 +703,13 @@ void BVH::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
 	 * BVH's are stored in global arrays. This function merges them into the
 	 * top level BVH, adjusting indexes and offsets where appropriate.
 	 */
-	/* TODO(sergey): This code needs adjustment for wider BVH than 4. */
 	const bool use_qbvh = (params.bvh_layout == BVH_LAYOUT_BVH4);
+	const bool use_obvh = (params.bvh_layout == BVH_LAYOUT_BVH8);
+
+	/* Remember the top level part for refitting. */
+	top_level_num_prims = pack.prim_index.size();
+	top_level_num_nodes = nodes_size;
+	top_level_num_leaf_nodes = leaf_nodes_size;
 
 	/* Adjust primitive index to point to the triangle in the global array, for
 	 * meshes with transform applied and already in the top level BVH.
@@ -468,15 +885,29 @@ void BVH::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
 
 			for(size_t i = 0, j = 0; i < bvh_nodes_size; j++) {
 				size_t nsize, nsize_bbox;
+				/* Number of int4 holding child indices. */
+				size_t nsize_children = (use_obvh)? 2: 1;
 				if(bvh_nodes[i].x & PATH_RAY_NODE_UNALIGNED) {
-					nsize = use_qbvh
-					            ? BVH_UNALIGNED_QNODE_SIZE
-					            : BVH_UNALIGNED_NODE_SIZE;
-					nsize_bbox = (use_qbvh)? 13: 0;
+					if(use_obvh) {
+						nsize = BVH_UNALIGNED_ONODE_SIZE;
+						nsize_bbox = BVH_UNALIGNED_ONODE_SIZE - 2;
+					}
+					else {
+						nsize = use_qbvh
+						            ? BVH_UNALIGNED_QNODE_SIZE
+						            : BVH_UNALIGNED_NODE_SIZE;
+						nsize_bbox = (use_qbvh)? 13: 0;
+					}
 				}
 				else {
-					nsize = (use_qbvh)? BVH_QNODE_SIZE: BVH_NODE_SIZE;
-					nsize_bbox = (use_qbvh)? 7: 0;
+					if(use_obvh) {
+						nsize = BVH_ONODE_SIZE;
+						nsize_bbox = BVH_ONODE_SIZE - 2;
+					}
+					else {
+						nsize = (use_qbvh)? BVH_QNODE_SIZE: BVH_NODE_SIZE;
+						nsize_bbox = (use_qbvh)? 7: 0;
+					}
 				}
 
 				memcpy(pack_nodes + pack_nodes_offset,
@@ -484,24 +915,26 @@ void BVH::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
 				       nsize_bbox*sizeof(int4));
 
 				/* Modify offsets into arrays */
-				int4 data = bvh_nodes[i + nsize_bbox];
+				for(size_t k = 0; k < nsize_children; k++) {
+					int4 data = bvh_nodes[i + nsize_bbox + k];
 
-				data.z += (data.z < 0)? -noffset_leaf: noffset;
-				data.w += (data.w < 0)? -noffset_leaf: noffset;
+					data.z += (data.z < 0)? -noffset_leaf: noffset;
+					data.w += (data.w < 0)? -noffset_leaf: noffset;
 
-				if(use_qbvh) {
-					data.x += (data.x < 0)? -noffset_leaf: noffset;
-					data.y += (data.y < 0)? -noffset_leaf: noffset;
-				}
+					if(use_qbvh || use_obvh) {
+						data.x += (data.x < 0)? -noffset_leaf: noffset;
+						data.y += (data.y < 0)? -noffset_leaf: noffset;
+					}
 
-				pack_nodes[pack_nodes_offset + nsize_bbox] = data;
+					pack_nodes[pack_nodes_offset + nsize_bbox + k] = data;
+				}
 
 				/* Usually this copies nothing, but we better
 				 * be prepared for possible node size extension.
 				 */
-				memcpy(&pack_nodes[pack_nodes_offset + nsize_bbox+1],
-				       &bvh_nodes[i + nsize_bbox+1],
-				       sizeof(int4) * (nsize - (nsize_bbox+1)));
+				memcpy(&pack_nodes[pack_nodes_offset + nsize_bbox + nsize_children],
+				       &bvh_nodes[i + nsize_bbox + nsize_children],
+				       sizeof(int4) * (nsize - (nsize_bbox + nsize_children)));
 
 				pack_nodes_offset += nsize;
 				i += nsize;
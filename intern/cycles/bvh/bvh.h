@@ -20,6 +20,8 @@
 
 #include "bvh/bvh_params.h"
 
+#include "util/util_boundbox.h"
+#include "util/util_string.h"
 #include "util/util_types.h"
 #include "util/util_vector.h"
 
@@ -28,7 +30,6 @@ CCL_NAMESPACE_BEGIN
 class BVHNode;
 struct BVHStackEntry;
 class BVHParams;
-class BoundBox;
 class LeafNode;
 class Object;
 class Progress;
@@ -81,17 +82,40 @@ public:
 	PackedBVH pack;
 	BVHParams params;
 	vector<Object*> objects;
+	/* File name of the disk cache entry, empty if the cache is not used. */
+	string cache_name;
 
 	static BVH *create(const BVHParams& params, const vector<Object*>& objects);
 	virtual ~BVH() {}
 
 	void build(Progress& progress);
-	void refit(Progress& progress);
+
+	/* Refit node bounds to changed primitive positions, keeping the topology
+	 * of the tree. Returns false if the BVH can not be refitted or its quality
+	 * degraded too much, in which case it needs to be built again. */
+	bool refit(Progress& progress);
 
 protected:
 	BVH(const BVHParams& params, const vector<Object*>& objects);
 
-	/* Refit range of primitives. */
+	/* Cost of intersecting the leaves relative to the root bounds, after the
+	 * last build and accumulated during refit. Zero if unknown. */
+	float build_leaf_cost;
+	double refit_leaf_cost;
+	BoundBox refit_bounds;
+
+	/* Size of the top level part of the packed arrays, before the BVHs of
+	 * instances were merged in by pack_instances(). */
+	size_t top_level_num_prims;
+	size_t top_level_num_nodes;
+	size_t top_level_num_leaf_nodes;
+
+	/* disk cache */
+	string cache_compute_name();
+	bool cache_read();
+	bool cache_write();
+
+	/* Refit range of primitives of a leaf. */
 	void refit_primitives(int start, int end, BoundBox& bbox, uint& visibility);
 
 	/* triangles and strands */
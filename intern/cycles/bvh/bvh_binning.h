@@ -27,7 +27,7 @@ CCL_NAMESPACE_BEGIN
 
 class BVHBuild;
 
-/* Single threaded object binner. Finds the split with the best SAH heuristic
+/* Object binner. Finds the split with the best SAH heuristic
  * by testing for each dimension multiple partitionings for regular spaced
  * partition locations. A partitioning for a partition location is computed,
  * by putting primitives whose centroid is on the left and right of the split
@@ -69,6 +69,25 @@ protected:
 	enum { MAX_BINS = 32 };
 	enum { LOG_BLOCK_SIZE = 2 };
 
+	/* Ranges from this size on are binned in parallel, by tasks of at least
+	 * PARALLEL_BINNING_TASK_SIZE primitives. */
+	enum { PARALLEL_BINNING_MIN_SIZE = 65536 };
+	enum { PARALLEL_BINNING_TASK_SIZE = 16384 };
+
+	/* Number of primitives and bounds of every bin in every dimension. */
+	struct Bins {
+		int4 count[MAX_BINS];
+		BoundBox bounds[MAX_BINS][4];
+
+		void reset(size_t num_bins);
+		void merge(const Bins& other, size_t num_bins);
+	};
+
+	void bin_primitives(const BVHReference *prims,
+	                    size_t begin,
+	                    size_t end,
+	                    Bins *bins) const;
+
 	/* computes the bin numbers for each dimension for a box. */
 	__forceinline int4 get_bin(const BoundBox& box) const
 	{
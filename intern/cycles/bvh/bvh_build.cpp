@@ -223,6 +223,83 @@ void BVHBuild::add_reference_triangles(BoundBox& root, BoundBox& center, Mesh *m
 	}
 }
 
+static float curve_subsegments_area(const Mesh *mesh,
+                                    const Mesh::Curve& curve,
+                                    int k,
+                                    int level,
+                                    const Transform *aligned_space)
+{
+	const int num_subsegments = 1 << level;
+	const float step = 1.0f / num_subsegments;
+	float area = 0.0f;
+	for(int s = 0; s < num_subsegments; s++) {
+		BoundBox bounds = BoundBox::empty;
+		if(aligned_space) {
+			curve.bounds_grow(k,
+			                  &mesh->curve_keys[0],
+			                  &mesh->curve_radius[0],
+			                  *aligned_space,
+			                  bounds,
+			                  s * step,
+			                  (s + 1) * step);
+		}
+		else {
+			curve.bounds_grow(k,
+			                  &mesh->curve_keys[0],
+			                  &mesh->curve_radius[0],
+			                  bounds,
+			                  s * step,
+			                  (s + 1) * step);
+		}
+		if(bounds.valid()) {
+			area += bounds.safe_area();
+		}
+	}
+	return area;
+}
+
+static int curve_subsegment_level(const BVHParams& params,
+                                  const Mesh *mesh,
+                                  const Mesh::Curve& curve,
+                                  int k)
+{
+	const int max_level = min(params.max_curve_subsegment_level,
+	                          PRIMITIVE_MAX_SUBSEGMENT_LEVEL);
+	if(max_level <= 0) {
+		return 0;
+	}
+	/* Measure bounds in the space unaligned nodes would use for the segment,
+	 * so splitting is only done when it tightens the nodes actually built.
+	 */
+	Transform aligned_space;
+	const Transform *space = NULL;
+	if(params.use_unaligned_nodes) {
+		const int key = curve.first_key + k;
+		float length;
+		const float3 axis = normalize_len(mesh->curve_keys[key + 1] -
+		                                  mesh->curve_keys[key],
+		                                  &length);
+		if(length > 1e-6f) {
+			aligned_space = make_transform_frame(axis);
+			space = &aligned_space;
+		}
+	}
+	/* Only split further while it noticeably reduces the total surface
+	 * area, more references cost memory and build time.
+	 */
+	int level = 0;
+	float area = curve_subsegments_area(mesh, curve, k, 0, space);
+	while(level < max_level) {
+		const float split_area = curve_subsegments_area(mesh, curve, k, level + 1, space);
+		if(!(split_area < 0.75f * area)) {
+			break;
+		}
+		area = split_area;
+		level++;
+	}
+	return level;
+}
+
 void BVHBuild::add_reference_curves(BoundBox& root, BoundBox& center, Mesh *mesh, int i)
 {
 	const Attribute *curve_attr_mP = NULL;
@@ -235,14 +312,29 @@ void BVHBuild::add_reference_curves(BoundBox& root, BoundBox& center, Mesh *mesh
 		const float *curve_radius = &mesh->curve_radius[0];
 		for(int k = 0; k < curve.num_keys - 1; k++) {
 			if(curve_attr_mP == NULL) {
-				/* Really simple logic for static hair. */
-				BoundBox bounds = BoundBox::empty;
-				curve.bounds_grow(k, &mesh->curve_keys[0], curve_radius, bounds);
-				if(bounds.valid()) {
-					int packed_type = PRIMITIVE_PACK_SEGMENT(PRIMITIVE_CURVE, k);
-					references.push_back(BVHReference(bounds, j, i, packed_type));
-					root.grow(bounds);
-					center.grow(bounds.center2());
+				/* Static hair, strongly curved segments are split into
+				 * sub-segments with tighter bounds.
+				 */
+				const int level = curve_subsegment_level(params, mesh, curve, k);
+				const int num_subsegments = 1 << level;
+				const float step = 1.0f / num_subsegments;
+				for(int s = 0; s < num_subsegments; s++) {
+					BoundBox bounds = BoundBox::empty;
+					curve.bounds_grow(k,
+					                  &mesh->curve_keys[0],
+					                  curve_radius,
+					                  bounds,
+					                  s * step,
+					                  (s + 1) * step);
+					if(bounds.valid()) {
+						int packed_type = PRIMITIVE_PACK_SEGMENT(PRIMITIVE_CURVE, k);
+						if(level > 0) {
+							packed_type = PRIMITIVE_PACK_SUBSEGMENT(packed_type, level, s);
+						}
+						references.push_back(BVHReference(bounds, j, i, packed_type));
+						root.grow(bounds);
+						center.grow(bounds.center2());
+					}
 				}
 			}
 			else if(params.num_motion_curve_steps == 0 || params.use_spatial_split) {
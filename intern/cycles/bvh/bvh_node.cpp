@@ -131,6 +131,31 @@ int BVHNode::getSubtreeSize(BVH_STAT stat) const
 		case BVH_STAT_UNALIGNED_LEAF_COUNT:
 			cnt = (is_leaf() && is_unaligned) ? 1 : 0;
 			break;
+		case BVH_STAT_ONODE_COUNT:
+			cnt = 1;
+			if(!is_leaf()) {
+				const BVHNode *children[8];
+				const int num = collapse_children(children, 8);
+				for(int i = 0; i < num; i++) {
+					cnt += children[i]->getSubtreeSize(stat);
+				}
+			}
+			return cnt;
+		case BVH_STAT_ALIGNED_INNER_ONODE_COUNT:
+		case BVH_STAT_UNALIGNED_INNER_ONODE_COUNT:
+			if(!is_leaf()) {
+				const BVHNode *children[8];
+				const int num = collapse_children(children, 8);
+				bool has_unaligned = false;
+				for(int i = 0; i < num; i++) {
+					cnt += children[i]->getSubtreeSize(stat);
+					has_unaligned |= children[i]->is_unaligned;
+				}
+				if(has_unaligned == (stat == BVH_STAT_UNALIGNED_INNER_ONODE_COUNT)) {
+					cnt += 1;
+				}
+			}
+			return cnt;
 		case BVH_STAT_DEPTH:
 			if(is_leaf()) {
 				cnt = 1;
@@ -153,6 +178,40 @@ int BVHNode::getSubtreeSize(BVH_STAT stat) const
 	return cnt;
 }
 
+int BVHNode::collapse_children(const BVHNode **children, int max_children) const
+{
+	if(is_leaf()) {
+		return 0;
+	}
+
+	int num_children = 2;
+	children[0] = get_child(0);
+	children[1] = get_child(1);
+
+	while(num_children < max_children) {
+		int best = -1;
+		float best_area = -FLT_MAX;
+		for(int i = 0; i < num_children; i++) {
+			if(children[i]->is_leaf()) {
+				continue;
+			}
+			const float area = children[i]->bounds.safe_area();
+			if(area > best_area) {
+				best = i;
+				best_area = area;
+			}
+		}
+		if(best == -1) {
+			break;
+		}
+		const BVHNode *node = children[best];
+		children[best] = node->get_child(0);
+		children[num_children++] = node->get_child(1);
+	}
+
+	return num_children;
+}
+
 void BVHNode::deleteSubtree()
 {
 	for(int i = 0; i < num_children(); i++)
@@ -39,6 +39,9 @@ enum BVH_STAT {
 	BVH_STAT_ALIGNED_LEAF_COUNT,
 	BVH_STAT_UNALIGNED_LEAF_COUNT,
 	BVH_STAT_DEPTH,
+	BVH_STAT_ONODE_COUNT,
+	BVH_STAT_ALIGNED_INNER_ONODE_COUNT,
+	BVH_STAT_UNALIGNED_INNER_ONODE_COUNT,
 };
 
 class BVHParams;
@@ -88,6 +91,12 @@ public:
 	float computeSubtreeSAHCost(const BVHParams& p, float probability = 1.0f) const;
 	void deleteSubtree();
 
+	/* Gather up to max_children descendants which become the children of
+	 * this node in a wide BVH, by repeatedly opening the inner node with the
+	 * largest surface area. Returns the number of gathered nodes.
+	 */
+	int collapse_children(const BVHNode **children, int max_children) const;
+
 	uint update_visibility();
 	void update_time();
 
@@ -90,6 +90,20 @@ public:
 	/* Same as above, but for triangle primitives. */
 	int num_motion_triangle_steps;
 
+	/* Static curve segments may be split into up to 2^level sub-segments
+	 * with tighter bounds when that reduces their total surface area.
+	 * Each sub-segment is intersected only over its own parameter range.
+	 */
+	int max_curve_subsegment_level;
+
+	/* Read and write the packed BVH from the disk cache, keyed by a hash of
+	 * the parameters and geometry. */
+	bool use_cache;
+
+	/* Refitted BVHs are rebuilt once the cost of intersecting their leaves
+	 * grows by more than this factor compared to the freshly built tree. */
+	float refit_max_cost_ratio;
+
 	/* fixed parameters */
 	enum {
 		MAX_DEPTH = 64,
@@ -123,6 +137,12 @@ public:
 
 		num_motion_curve_steps = 0;
 		num_motion_triangle_steps = 0;
+
+		max_curve_subsegment_level = 2;
+
+		use_cache = false;
+
+		refit_max_cost_ratio = 1.5f;
 	}
 
 	/* SAH costs */
@@ -194,6 +214,18 @@ protected:
 	float time_from_, time_to_;
 };
 
+/* Parameter range of the curve segment covered by a packed curve primitive
+ * type, the full segment unless it was split into sub-segments. */
+
+__forceinline void curve_subsegment_range(int prim_type, float *t_start, float *t_end)
+{
+	const int level = PRIMITIVE_UNPACK_SUBSEGMENT_LEVEL(prim_type);
+	const int index = PRIMITIVE_UNPACK_SUBSEGMENT_INDEX(prim_type);
+	const float step = 1.0f / (float)(1 << level);
+	*t_start = index * step;
+	*t_end = (index + 1) * step;
+}
+
 /* BVH Range
  *
  * Build range used during construction, to indicate the bounds and place in
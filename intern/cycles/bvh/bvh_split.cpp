@@ -24,6 +24,7 @@
 #include "render/object.h"
 
 #include "util/util_algorithm.h"
+#include "util/util_task.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -161,47 +162,50 @@ BVHSpatialSplit::BVHSpatialSplit(const BVHBuild& builder,
 
 	float3 origin = range_bounds.min;
 	float3 binSize = (range_bounds.max - origin) * (1.0f / (float)BVHParams::NUM_SPATIAL_BINS);
-	float3 invBinSize = 1.0f / binSize;
 
-	for(int dim = 0; dim < 3; dim++) {
-		for(int i = 0; i < BVHParams::NUM_SPATIAL_BINS; i++) {
-			BVHSpatialBin& bin = storage_->bins[dim][i];
-
-			bin.bounds = BoundBox::empty;
-			bin.enter = 0;
-			bin.exit = 0;
-		}
-	}
+	BVHSpatialBin *bins = &storage_->bins[0][0];
+	reset_bins(bins);
 
 	/* chop references into bins. */
-	for(unsigned int refIdx = range.start(); refIdx < range.end(); refIdx++) {
-		const BVHReference& ref = references_->at(refIdx);
-		BoundBox prim_bounds = get_prim_bounds(ref);
-		float3 firstBinf = (prim_bounds.min - origin) * invBinSize;
-		float3 lastBinf = (prim_bounds.max - origin) * invBinSize;
-		int3 firstBin = make_int3((int)firstBinf.x, (int)firstBinf.y, (int)firstBinf.z);
-		int3 lastBin = make_int3((int)lastBinf.x, (int)lastBinf.y, (int)lastBinf.z);
-
-		firstBin = clamp(firstBin, 0, BVHParams::NUM_SPATIAL_BINS - 1);
-		lastBin = clamp(lastBin, firstBin, BVHParams::NUM_SPATIAL_BINS - 1);
+	if(range.size() < PARALLEL_BINNING_MIN_SIZE) {
+		bin_references(&builder, range.start(), range.end(), origin, binSize, bins);
+	}
+	else {
+		/* Splitting references at the bin boundaries is expensive, so bin parts
+		 * of large ranges in parallel and merge the bins afterwards. */
+		const int num_tasks = max(1,
+		                          min(range.size()/PARALLEL_BINNING_TASK_SIZE,
+		                              TaskScheduler::num_threads()));
+		const int task_size = divide_up(range.size(), num_tasks);
+		vector<BVHSpatialBin> task_bins(num_tasks*3*BVHParams::NUM_SPATIAL_BINS);
+		TaskPool pool;
+
+		for(int task = 0; task < num_tasks; task++) {
+			const int task_start = range.start() + task*task_size;
+			const int task_end = min(task_start + task_size, range.end());
+			BVHSpatialBin *task_bin = &task_bins[task*3*BVHParams::NUM_SPATIAL_BINS];
+
+			reset_bins(task_bin);
+			pool.push(function_bind(&BVHSpatialSplit::bin_references,
+			                        this,
+			                        &builder,
+			                        task_start,
+			                        task_end,
+			                        origin,
+			                        binSize,
+			                        task_bin));
+		}
 
-		for(int dim = 0; dim < 3; dim++) {
-			BVHReference currRef(get_prim_bounds(ref),
-			                     ref.prim_index(),
-			                     ref.prim_object(),
-			                     ref.prim_type());
+		pool.wait_work();
 
-			for(int i = firstBin[dim]; i < lastBin[dim]; i++) {
-				BVHReference leftRef, rightRef;
+		for(int task = 0; task < num_tasks; task++) {
+			const BVHSpatialBin *task_bin = &task_bins[task*3*BVHParams::NUM_SPATIAL_BINS];
 
-				split_reference(builder, leftRef, rightRef, currRef, dim, origin[dim] + binSize[dim] * (float)(i + 1));
-				storage_->bins[dim][i].bounds.grow(leftRef.bounds());
-				currRef = rightRef;
+			for(int i = 0; i < 3*BVHParams::NUM_SPATIAL_BINS; i++) {
+				bins[i].bounds.grow(task_bin[i].bounds);
+				bins[i].enter += task_bin[i].enter;
+				bins[i].exit += task_bin[i].exit;
 			}
-
-			storage_->bins[dim][lastBin[dim]].bounds.grow(currRef.bounds());
-			storage_->bins[dim][firstBin[dim]].enter++;
-			storage_->bins[dim][lastBin[dim]].exit++;
 		}
 	}
 
@@ -238,6 +242,57 @@ BVHSpatialSplit::BVHSpatialSplit(const BVHBuild& builder,
 	}
 }
 
+void BVHSpatialSplit::reset_bins(BVHSpatialBin *bins)
+{
+	for(int i = 0; i < 3*BVHParams::NUM_SPATIAL_BINS; i++) {
+		bins[i].bounds = BoundBox::empty;
+		bins[i].enter = 0;
+		bins[i].exit = 0;
+	}
+}
+
+void BVHSpatialSplit::bin_references(const BVHBuild *builder,
+                                     int start,
+                                     int end,
+                                     const float3& origin,
+                                     const float3& binSize,
+                                     BVHSpatialBin *bins)
+{
+	const float3 invBinSize = 1.0f / binSize;
+
+	for(int refIdx = start; refIdx < end; refIdx++) {
+		const BVHReference& ref = references_->at(refIdx);
+		BoundBox prim_bounds = get_prim_bounds(ref);
+		float3 firstBinf = (prim_bounds.min - origin) * invBinSize;
+		float3 lastBinf = (prim_bounds.max - origin) * invBinSize;
+		int3 firstBin = make_int3((int)firstBinf.x, (int)firstBinf.y, (int)firstBinf.z);
+		int3 lastBin = make_int3((int)lastBinf.x, (int)lastBinf.y, (int)lastBinf.z);
+
+		firstBin = clamp(firstBin, 0, BVHParams::NUM_SPATIAL_BINS - 1);
+		lastBin = clamp(lastBin, firstBin, BVHParams::NUM_SPATIAL_BINS - 1);
+
+		for(int dim = 0; dim < 3; dim++) {
+			BVHSpatialBin *dim_bins = bins + dim*BVHParams::NUM_SPATIAL_BINS;
+			BVHReference currRef(get_prim_bounds(ref),
+			                     ref.prim_index(),
+			                     ref.prim_object(),
+			                     ref.prim_type());
+
+			for(int i = firstBin[dim]; i < lastBin[dim]; i++) {
+				BVHReference leftRef, rightRef;
+
+				split_reference(*builder, leftRef, rightRef, currRef, dim, origin[dim] + binSize[dim] * (float)(i + 1));
+				dim_bins[i].bounds.grow(leftRef.bounds());
+				currRef = rightRef;
+			}
+
+			dim_bins[lastBin[dim]].bounds.grow(currRef.bounds());
+			dim_bins[firstBin[dim]].enter++;
+			dim_bins[lastBin[dim]].exit++;
+		}
+	}
+}
+
 void BVHSpatialSplit::split(BVHBuild *builder,
                             BVHRange& left,
                             BVHRange& right,
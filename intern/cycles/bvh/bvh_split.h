@@ -108,6 +108,20 @@ protected:
 	const BVHUnaligned *unaligned_heuristic_;
 	const Transform *aligned_space_;
 
+	/* Ranges from this size on are binned in parallel, by tasks of at least
+	 * PARALLEL_BINNING_TASK_SIZE references. */
+	enum { PARALLEL_BINNING_MIN_SIZE = 16384 };
+	enum { PARALLEL_BINNING_TASK_SIZE = 4096 };
+
+	/* Bins for all three dimensions, stored one dimension after the other. */
+	void reset_bins(BVHSpatialBin *bins);
+	void bin_references(const BVHBuild *builder,
+	                    int start,
+	                    int end,
+	                    const float3& origin,
+	                    const float3& binSize,
+	                    BVHSpatialBin *bins);
+
 	/* Lower-level functions which calculates boundaries of left and right nodes
 	 * needed for spatial split.
 	 *
@@ -78,9 +78,19 @@ bool BVHUnaligned::compute_aligned_space(const BVHReference& ref,
 		const int segment = PRIMITIVE_UNPACK_SEGMENT(packed_type);
 		const Mesh *mesh = object->mesh;
 		const Mesh::Curve& curve = mesh->get_curve(curve_index);
-		const int key = curve.first_key + segment;
-		const float3 v1 = mesh->curve_keys[key],
-		             v2 = mesh->curve_keys[key + 1];
+		float t_start, t_end;
+		curve_subsegment_range(packed_type, &t_start, &t_end);
+		float3 v1, v2;
+		if(t_start == 0.0f && t_end == 1.0f) {
+			const int key = curve.first_key + segment;
+			v1 = mesh->curve_keys[key];
+			v2 = mesh->curve_keys[key + 1];
+		}
+		else {
+			/* Chord of the sub-segment. */
+			v1 = curve.evaluate(segment, &mesh->curve_keys[0], t_start);
+			v2 = curve.evaluate(segment, &mesh->curve_keys[0], t_end);
+		}
 		float length;
 		const float3 axis = normalize_len(v2 - v1, &length);
 		if(length > 1e-6f) {
@@ -105,11 +115,15 @@ BoundBox BVHUnaligned::compute_aligned_prim_boundbox(
 		const int segment = PRIMITIVE_UNPACK_SEGMENT(packed_type);
 		const Mesh *mesh = object->mesh;
 		const Mesh::Curve& curve = mesh->get_curve(curve_index);
+		float t_start, t_end;
+		curve_subsegment_range(packed_type, &t_start, &t_end);
 		curve.bounds_grow(segment,
 		                  &mesh->curve_keys[0],
 		                  &mesh->curve_radius[0],
 		                  aligned_space,
-		                  bounds);
+		                  bounds,
+		                  t_start,
+		                  t_end);
 	}
 	else {
 		bounds = prim.bounds().transformed(&aligned_space);
@@ -25,6 +25,7 @@
 #include "device/device_task.h"
 
 #include "util/util_list.h"
+#include "util/util_profiling.h"
 #include "util/util_stats.h"
 #include "util/util_string.h"
 #include "util/util_thread.h"
@@ -58,6 +59,7 @@ public:
 	bool advanced_shading;          /* Supports full shading system. */
 	bool has_half_images;           /* Support half-float textures. */
 	bool has_volume_decoupled;      /* Decoupled volume shading. */
+	bool has_sparse_volumes;        /* Support sparse tiled 3D textures. */
 	BVHLayoutMask bvh_layout_mask;  /* Bitmask of supported BVH layouts. */
 	bool has_osl;                   /* Support Open Shading Language. */
 	bool use_split_kernel;          /* Use split or mega kernel. */
@@ -74,6 +76,7 @@ public:
 		advanced_shading = true;
 		has_half_images = false;
 		has_volume_decoupled = false;
+		has_sparse_volumes = false;
 		bvh_layout_mask = BVH_LAYOUT_NONE;
 		has_osl = false;
 		use_split_kernel = false;
@@ -249,7 +252,7 @@ struct DeviceDrawParams {
 class Device {
 	friend class device_sub_ptr;
 protected:
-	Device(DeviceInfo& info_, Stats &stats_, bool background) : background(background), vertex_buffer(0), info(info_), stats(stats_) {}
+	Device(DeviceInfo& info_, Stats &stats_, Profiler &profiler_, bool background) : background(background), vertex_buffer(0), info(info_), stats(stats_), profiler(profiler_) {}
 
 	bool background;
 	string error_msg;
@@ -284,6 +287,7 @@ public:
 
 	/* statistics */
 	Stats &stats;
+	Profiler &profiler;
 
 	/* memory alignment */
 	virtual int mem_sub_ptr_alignment() { return MIN_ALIGNMENT_CPU_DATA_TYPES; }
@@ -294,6 +298,9 @@ public:
 	/* open shading language, only for CPU device */
 	virtual void *osl_memory() { return NULL; }
 
+	/* texture cache for images read on demand, only for CPU device */
+	virtual void *oiio_memory() { return NULL; }
+
 	/* load/compile kernels, must be called before adding tasks */ 
 	virtual bool load_kernels(
 	        const DeviceRequestedFeatures& /*requested_features*/)
@@ -322,7 +329,7 @@ public:
 	virtual void unmap_neighbor_tiles(Device * /*sub_device*/, RenderTile * /*tiles*/) {}
 
 	/* static */
-	static Device *create(DeviceInfo& info, Stats &stats, bool background = true);
+	static Device *create(DeviceInfo& info, Stats &stats, Profiler &profiler, bool background = true);
 
 	static DeviceType type_from_string(const char *name);
 	static string string_from_type(DeviceType type);
@@ -346,6 +353,19 @@ protected:
 
 	virtual void mem_alloc(device_memory& mem) = 0;
 	virtual void mem_copy_to(device_memory& mem) = 0;
+	/* Copy a byte range of already allocated memory, devices that don't
+	 * support this copy the whole buffer. */
+	virtual void mem_copy_to_range(device_memory& mem, size_t offset, size_t size)
+	{
+		(void)offset;
+		(void)size;
+		mem_copy_to(mem);
+	}
+	/* True if mem_copy_to_range only copies the range for this memory. */
+	virtual bool mem_copy_to_range_supported(const device_memory& /*mem*/)
+	{
+		return false;
+	}
 	virtual void mem_copy_from(device_memory& mem,
 		int y, int w, int h, int elem) = 0;
 	virtual void mem_zero(device_memory& mem) = 0;
@@ -34,6 +34,8 @@
 #include "kernel/kernel_types.h"
 #include "kernel/split/kernel_split_data.h"
 #include "kernel/kernel_globals.h"
+#include "kernel/kernel_adaptive_sampling.h"
+#include "kernel/kernel_oiio_globals.h"
 
 #include "kernel/filter/filter.h"
 
@@ -169,12 +171,17 @@ public:
 #ifdef WITH_OSL
 	OSLGlobals osl_globals;
 #endif
+	OIIOGlobals oiio_globals;
 
 	bool use_split_kernel;
 
 	DeviceRequestedFeatures requested_features;
+	bool use_basic_kernel;
 
 	KernelFunctions<void(*)(KernelGlobals *, float *, int, int, int, int, int)>             path_trace_kernel;
+	KernelFunctions<void(*)(KernelGlobals *, float *, int, int, int, int, int, int, int)>   path_trace_stream_kernel;
+	KernelFunctions<void(*)(KernelGlobals *, float *, int, int, int, int, int)>             basic_path_trace_kernel;
+	KernelFunctions<void(*)(KernelGlobals *, float *, int, int, int, int, int, int, int)>   basic_path_trace_stream_kernel;
 	KernelFunctions<void(*)(KernelGlobals *, uchar4 *, float *, float, int, int, int, int)> convert_to_half_float_kernel;
 	KernelFunctions<void(*)(KernelGlobals *, uchar4 *, float *, float, int, int, int, int)> convert_to_byte_kernel;
 	KernelFunctions<void(*)(KernelGlobals *, uint4 *, float4 *, int, int, int, int, int)>   shader_kernel;
@@ -184,14 +191,14 @@ public:
 	KernelFunctions<void(*)(int, int, float*, float*, float*, float*, int*, int)>                               filter_detect_outliers_kernel;
 	KernelFunctions<void(*)(int, int, float*, float*, float*, float*, int*, int)>                               filter_combine_halves_kernel;
 
-	KernelFunctions<void(*)(int, int, float*, float*, float*, int*, int, int, float, float)> filter_nlm_calc_difference_kernel;
+	KernelFunctions<void(*)(int, int, int, float*, float*, float*, int*, int, int, float, float)> filter_nlm_calc_difference_kernel;
 	KernelFunctions<void(*)(float*, float*, int*, int, int)>                                 filter_nlm_blur_kernel;
 	KernelFunctions<void(*)(float*, float*, int*, int, int)>                                 filter_nlm_calc_weight_kernel;
 	KernelFunctions<void(*)(int, int, float*, float*, float*, float*, int*, int, int)>       filter_nlm_update_output_kernel;
 	KernelFunctions<void(*)(float*, float*, int*, int)>                                      filter_nlm_normalize_kernel;
 
 	KernelFunctions<void(*)(float*, int, int, int, float*, int*, int*, int, int, float)>                         filter_construct_transform_kernel;
-	KernelFunctions<void(*)(int, int, float*, float*, float*, int*, float*, float3*, int*, int*, int, int, int)> filter_nlm_construct_gramian_kernel;
+	KernelFunctions<void(*)(int, int, int, float*, float*, float*, int*, float*, float3*, int*, int*, int, int, int)> filter_nlm_construct_gramian_kernel;
 	KernelFunctions<void(*)(int, int, int, float*, int*, float*, float3*, int*, int)>                            filter_finalize_kernel;
 
 	KernelFunctions<void(*)(KernelGlobals *, ccl_constant KernelData*, ccl_global void*, int, ccl_global char*,
@@ -207,11 +214,14 @@ public:
 	      KERNEL_NAME_EVAL(cpu_avx, name), \
 	      KERNEL_NAME_EVAL(cpu_avx2, name)
 
-	CPUDevice(DeviceInfo& info_, Stats &stats_, bool background_)
-	: Device(info_, stats_, background_),
+	CPUDevice(DeviceInfo& info_, Stats &stats_, Profiler &profiler_, bool background_)
+	: Device(info_, stats_, profiler_, background_),
 	  texture_info(this, "__texture_info", MEM_TEXTURE),
 #define REGISTER_KERNEL(name) name ## _kernel(KERNEL_FUNCTIONS(name))
 	  REGISTER_KERNEL(path_trace),
+	  REGISTER_KERNEL(path_trace_stream),
+	  REGISTER_KERNEL(basic_path_trace),
+	  REGISTER_KERNEL(basic_path_trace_stream),
 	  REGISTER_KERNEL(convert_to_half_float),
 	  REGISTER_KERNEL(convert_to_byte),
 	  REGISTER_KERNEL(shader),
@@ -237,11 +247,14 @@ public:
 #ifdef WITH_OSL
 		kernel_globals.osl = &osl_globals;
 #endif
+		kernel_globals.oiio = &oiio_globals;
+		kernel_globals.oiio_tdata = NULL;
 		use_split_kernel = DebugFlags().cpu.split_kernel;
 		if(use_split_kernel) {
 			VLOG(1) << "Will be using split kernel.";
 		}
 		need_texture_info = false;
+		use_basic_kernel = false;
 
 #define REGISTER_SPLIT_KERNEL(name) split_kernels[#name] = KernelFunctions<void(*)(KernelGlobals*, KernelData*)>(KERNEL_FUNCTIONS(name))
 		REGISTER_SPLIT_KERNEL(path_init);
@@ -330,6 +343,22 @@ public:
 		}
 	}
 
+	bool mem_copy_to_range_supported(const device_memory& mem)
+	{
+		/* Data textures use the host memory directly, like other memory.
+		 * Image textures are repacked on copy. */
+		return (mem.type != MEM_TEXTURE || mem.interpolation == INTERPOLATION_NONE);
+	}
+
+	void mem_copy_to_range(device_memory& mem, size_t /*offset*/, size_t /*size*/)
+	{
+		if(!mem_copy_to_range_supported(mem) || !mem.device_pointer) {
+			mem_copy_to(mem);
+		}
+
+		/* copy is no-op */
+	}
+
 	void mem_copy_from(device_memory& /*mem*/,
 	                   int /*y*/, int /*w*/, int /*h*/,
 	                   int /*elem*/)
@@ -411,6 +440,8 @@ public:
 			info.width = mem.data_width;
 			info.height = mem.data_height;
 			info.depth = mem.data_depth;
+			info.sparse_offsets = (mem.sparse_offsets)?
+				(uint64_t)mem.sparse_offsets->host_pointer: 0;
 
 			need_texture_info = true;
 		}
@@ -439,10 +470,15 @@ public:
 #endif
 	}
 
-	void thread_run(DeviceTask *task)
+	void *oiio_memory()
+	{
+		return &oiio_globals;
+	}
+
+	void thread_run(DeviceTask *task, int thread_id)
 	{
 		if(task->type == DeviceTask::RENDER) {
-			thread_render(*task);
+			thread_render(*task, thread_id);
 		}
 		else if(task->type == DeviceTask::FILM_CONVERT)
 			thread_film_convert(*task);
@@ -455,7 +491,7 @@ public:
 		CPUDeviceTask(CPUDevice *device, DeviceTask& task)
 		: DeviceTask(task)
 		{
-			run = function_bind(&CPUDevice::thread_run, device, this);
+			run = function_bind(&CPUDevice::thread_run, device, this, _1);
 		}
 	};
 
@@ -495,7 +531,7 @@ public:
 			int dx = i % (2*r+1) - r;
 
 			int local_rect[4] = {max(0, -dx), max(0, -dy), rect.z-rect.x - max(0, dx), rect.w-rect.y - max(0, dy)};
-			filter_nlm_calc_difference_kernel()(dx, dy,
+			filter_nlm_calc_difference_kernel()(dx, dy, 0,
 			                                    (float*) guide_ptr,
 			                                    (float*) variance_ptr,
 			                                    difference,
@@ -553,14 +589,18 @@ public:
 		float *blurDifference = (float*) task->reconstruction_state.temporary_2_ptr;
 
 		int r = task->radius;
-		for(int i = 0; i < (2*r+1)*(2*r+1); i++) {
-			int dy = i / (2*r+1) - r;
+		int num_frames = 1 + task->render_buffer.neighbor_frames;
+		for(int i = 0; i < (2*r+1)*(2*r+1)*num_frames; i++) {
+			int dy = (i / (2*r+1)) % (2*r+1) - r;
 			int dx = i % (2*r+1) - r;
+			/* Pixels of neighboring frames are weighted like the ones of the
+			 * current frame, through the similarity of their prefiltered color. */
+			int frame_offset = (i / ((2*r+1)*(2*r+1))) * task->buffer.frame_stride;
 
 			int local_rect[4] = {max(0, -dx), max(0, -dy),
 			                     task->reconstruction_state.source_w - max(0, dx),
 			                     task->reconstruction_state.source_h - max(0, dy)};
-			filter_nlm_calc_difference_kernel()(dx, dy,
+			filter_nlm_calc_difference_kernel()(dx, dy, frame_offset,
 			                                    (float*) color_ptr,
 			                                    (float*) color_variance_ptr,
 			                                    difference,
@@ -572,7 +612,7 @@ public:
 			filter_nlm_blur_kernel()(difference, blurDifference, local_rect, task->buffer.stride, 4);
 			filter_nlm_calc_weight_kernel()(blurDifference, difference, local_rect, task->buffer.stride, 4);
 			filter_nlm_blur_kernel()(difference, blurDifference, local_rect, task->buffer.stride, 4);
-			filter_nlm_construct_gramian_kernel()(dx, dy,
+			filter_nlm_construct_gramian_kernel()(dx, dy, frame_offset,
 			                                      blurDifference,
 			                                      (float*)  task->buffer.mem.device_pointer,
 			                                      (float*)  task->storage.transform.device_pointer,
@@ -684,6 +724,56 @@ public:
 		return true;
 	}
 
+	/* Mark converged pixels of the tile, returns true when all of them are. */
+	bool adaptive_sampling_filter(KernelGlobals *kg, RenderTile &tile, int sample)
+	{
+		float *render_buffer = (float*)tile.buffer;
+
+		for(int y = tile.y; y < tile.y + tile.h; y++) {
+			for(int x = tile.x; x < tile.x + tile.w; x++) {
+				float *buffer = kernel_adaptive_pixel_buffer(kg, render_buffer, x, y, tile.offset, tile.stride);
+				kernel_do_adaptive_stopping(kg, buffer, sample);
+			}
+		}
+
+		bool any = false;
+		for(int y = tile.y; y < tile.y + tile.h; y++) {
+			any |= kernel_do_adaptive_filter_x(kg, render_buffer, sample, y, tile.x, tile.w, tile.offset, tile.stride);
+		}
+		for(int x = tile.x; x < tile.x + tile.w; x++) {
+			any |= kernel_do_adaptive_filter_y(kg, render_buffer, sample, x, tile.y, tile.h, tile.offset, tile.stride);
+		}
+
+		return !any;
+	}
+
+	/* Scale converged pixels as if they were sampled up to the tile's sample count. */
+	void adaptive_sampling_post(KernelGlobals *kg, RenderTile &tile)
+	{
+		float *render_buffer = (float*)tile.buffer;
+
+		for(int y = tile.y; y < tile.y + tile.h; y++) {
+			for(int x = tile.x; x < tile.x + tile.w; x++) {
+				float *buffer = kernel_adaptive_pixel_buffer(kg, render_buffer, x, y, tile.offset, tile.stride);
+				kernel_adaptive_post_adjust(kg, buffer, tile.sample);
+			}
+		}
+	}
+
+	/* Hand the recorded path guiding samples over to the session, when the
+	 * buffer might not fit the given number of new samples. */
+	void guiding_flush(DeviceTask &task, KernelGlobals *kg, int num_new_samples)
+	{
+		if(kg->num_guiding_samples == 0 ||
+		   kg->num_guiding_samples + num_new_samples <= kg->max_guiding_samples)
+		{
+			return;
+		}
+
+		task.record_guiding_samples(kg->guiding_samples, kg->num_guiding_samples);
+		kg->num_guiding_samples = 0;
+	}
+
 	void path_trace(DeviceTask &task, RenderTile &tile, KernelGlobals *kg)
 	{
 		scoped_timer timer(&tile.buffers->render_time);
@@ -691,6 +781,27 @@ public:
 		float *render_buffer = (float*)tile.buffer;
 		int start_sample = tile.start_sample;
 		int end_sample = tile.start_sample + tile.num_samples;
+		const bool use_adaptive_sampling = (kernel_data.film.pass_adaptive_aux_buffer != 0);
+		const bool use_ray_stream = (kernel_data.integrator.use_ray_stream != 0);
+
+		/* OSL shaders can use closures that are not in the requested features,
+		 * so they always run the full kernel. */
+		const bool use_basic = (use_basic_kernel && !kernel_osl_use(kg));
+		void (*path_trace_func)(KernelGlobals *, float *, int, int, int, int, int) =
+			(use_basic)? basic_path_trace_kernel(): path_trace_kernel();
+		void (*path_trace_stream_func)(KernelGlobals *, float *, int, int, int, int, int, int, int) =
+			(use_basic)? basic_path_trace_stream_kernel(): path_trace_stream_kernel();
+
+		/* Samples are collected per row of pixels, the buffer fits a few of
+		 * them for regular tile sizes. */
+		const bool use_guiding_record = (kernel_data.integrator.guiding_record != 0) &&
+		                                task.record_guiding_samples;
+		const int guiding_row_samples = tile.w*GUIDING_MAX_VERTICES;
+		if(use_guiding_record && kg->guiding_samples == NULL) {
+			kg->max_guiding_samples = max(guiding_row_samples*16, 1 << 16);
+			kg->guiding_samples = (GuidingSample*)malloc(sizeof(GuidingSample)*kg->max_guiding_samples);
+			kg->num_guiding_samples = 0;
+		}
 
 		for(int sample = start_sample; sample < end_sample; sample++) {
 			if(task.get_cancel() || task_pool.canceled()) {
@@ -698,17 +809,70 @@ public:
 					break;
 			}
 
-			for(int y = tile.y; y < tile.y + tile.h; y++) {
-				for(int x = tile.x; x < tile.x + tile.w; x++) {
-					path_trace_kernel()(kg, render_buffer,
-					                    sample, x, y, tile.offset, tile.stride);
+			if(use_ray_stream) {
+				/* Square blocks of pixels keep the camera rays of a stream
+				 * coherent, converged pixels are skipped by the kernel. */
+				const int block_size = 4;
+				static_assert(block_size*block_size <= RAY_STREAM_SIZE, "Block does not fit in ray stream");
+
+				for(int y = tile.y; y < tile.y + tile.h; y += block_size) {
+					for(int x = tile.x; x < tile.x + tile.w; x += block_size) {
+						int w = min(block_size, tile.x + tile.w - x);
+						int h = min(block_size, tile.y + tile.h - y);
+
+						path_trace_stream_func(kg, render_buffer,
+						                       sample, x, y, w, h, tile.offset, tile.stride);
+					}
+
+					if(use_guiding_record) {
+						guiding_flush(task, kg, guiding_row_samples*block_size);
+					}
+				}
+			}
+			else {
+				for(int y = tile.y; y < tile.y + tile.h; y++) {
+					for(int x = tile.x; x < tile.x + tile.w; x++) {
+						if(use_adaptive_sampling) {
+							float *buffer = kernel_adaptive_pixel_buffer(kg, render_buffer, x, y, tile.offset, tile.stride);
+							if(kernel_adaptive_pixel_converged(kg, buffer) > 0.0f) {
+								continue;
+							}
+						}
+
+						path_trace_func(kg, render_buffer,
+						                sample, x, y, tile.offset, tile.stride);
+					}
+
+					if(use_guiding_record) {
+						guiding_flush(task, kg, guiding_row_samples);
+					}
 				}
 			}
 
 			tile.sample = sample + 1;
 
+			if(use_adaptive_sampling && kernel_adaptive_sampling_need_check(kg, sample)) {
+				if(adaptive_sampling_filter(kg, tile, sample)) {
+					/* The whole tile converged, account for the skipped
+					 * samples so the thread can move on to the next tile. */
+					tile.sample = end_sample;
+					task.update_progress(&tile, tile.w*tile.h*(end_sample - sample));
+					break;
+				}
+			}
+
 			task.update_progress(&tile, tile.w*tile.h);
 		}
+
+		if(use_adaptive_sampling) {
+			adaptive_sampling_post(kg, tile);
+		}
+
+		/* The session updates the guiding distribution once all tiles are
+		 * done, so nothing may be left behind. */
+		if(use_guiding_record) {
+			guiding_flush(task, kg, kg->max_guiding_samples);
+		}
 	}
 
 	void denoise(DeviceTask &task, DenoisingTask& denoising, RenderTile &tile)
@@ -741,7 +905,7 @@ public:
 		task.update_progress(&tile, tile.w*tile.h);
 	}
 
-	void thread_render(DeviceTask& task)
+	void thread_render(DeviceTask& task, int thread_id)
 	{
 		if(task_pool.canceled()) {
 			if(task.need_finish_queue == false)
@@ -768,7 +932,11 @@ public:
 		RenderTile tile;
 		DenoisingTask denoising(this);
 
+		profiler.add_state(&kg->profiler);
+
 		while(task.acquire_tile(this, tile)) {
+			double tile_start_time = time_dt();
+
 			if(tile.task == RenderTile::PATH_TRACE) {
 				if(use_split_kernel) {
 					device_only_memory<uchar> void_buffer(this, "void_buffer");
@@ -782,6 +950,10 @@ public:
 				denoise(task, denoising, tile);
 			}
 
+			if(task.update_thread_busy_time) {
+				task.update_thread_busy_time(thread_id, time_dt() - tile_start_time);
+			}
+
 			task.release_tile(tile);
 
 			if(task_pool.canceled()) {
@@ -790,6 +962,8 @@ public:
 			}
 		}
 
+		profiler.remove_state(&kg->profiler);
+
 		thread_kernel_globals_free((KernelGlobals*)kgbuffer.device_pointer);
 		kg->~KernelGlobals();
 		kgbuffer.free();
@@ -822,6 +996,9 @@ public:
 #ifdef WITH_OSL
 		OSLShader::thread_init(&kg, &kernel_globals, &osl_globals);
 #endif
+		thread_texture_cache_init(&kg);
+		profiler.add_state(&kg.profiler);
+
 		for(int sample = 0; sample < task.num_samples; sample++) {
 			for(int x = task.shader_x; x < task.shader_x + task.shader_w; x++)
 				shader_kernel()(&kg,
@@ -840,6 +1017,8 @@ public:
 
 		}
 
+		profiler.remove_state(&kg.profiler);
+
 #ifdef WITH_OSL
 		OSLShader::thread_free(&kg);
 #endif
@@ -891,12 +1070,28 @@ protected:
 			kg.decoupled_volume_steps[i] = NULL;
 		}
 		kg.decoupled_volume_steps_index = 0;
+		kg.guiding_samples = NULL;
+		kg.num_guiding_samples = 0;
+		kg.max_guiding_samples = 0;
 #ifdef WITH_OSL
 		OSLShader::thread_init(&kg, &kernel_globals, &osl_globals);
 #endif
+		thread_texture_cache_init(&kg);
 		return kg;
 	}
 
+	inline void thread_texture_cache_init(KernelGlobals *kg)
+	{
+		/* Per-thread data of the texture system belongs to the calling thread
+		 * and is owned by the texture system. */
+		if(oiio_globals.tex_sys) {
+			kg->oiio_tdata = oiio_globals.tex_sys->get_perthread_info();
+		}
+		else {
+			kg->oiio_tdata = NULL;
+		}
+	}
+
 	inline void thread_kernel_globals_free(KernelGlobals *kg)
 	{
 		if(kg == NULL) {
@@ -913,6 +1108,9 @@ protected:
 				free(kg->decoupled_volume_steps[i]);
 			}
 		}
+		if(kg->guiding_samples != NULL) {
+			free(kg->guiding_samples);
+		}
 #ifdef WITH_OSL
 		OSLShader::thread_free(kg);
 #endif
@@ -921,6 +1119,16 @@ protected:
 	virtual bool load_kernels(const DeviceRequestedFeatures& requested_features_) {
 		requested_features = requested_features_;
 
+		/* Must match the features disabled by __KERNEL_BASIC__. */
+		use_basic_kernel = !(requested_features.use_hair ||
+		                     requested_features.use_object_motion ||
+		                     requested_features.use_camera_motion ||
+		                     requested_features.use_volume ||
+		                     requested_features.use_subsurface ||
+		                     requested_features.use_baking ||
+		                     requested_features.use_patch_evaluation);
+		VLOG(1) << "Will be using " << (use_basic_kernel? "basic": "full") << " path tracing kernel.";
+
 		return true;
 	}
 };
@@ -1032,9 +1240,9 @@ uint64_t CPUSplitKernel::state_buffer_size(device_memory& kernel_globals, device
 	return split_data_buffer_size(kg, num_threads);
 }
 
-Device *device_cpu_create(DeviceInfo& info, Stats &stats, bool background)
+Device *device_cpu_create(DeviceInfo& info, Stats &stats, Profiler &profiler, bool background)
 {
-	return new CPUDevice(info, stats, background);
+	return new CPUDevice(info, stats, profiler, background);
 }
 
 void device_cpu_info(vector<DeviceInfo>& devices)
@@ -1050,7 +1258,15 @@ void device_cpu_info(vector<DeviceInfo>& devices)
 	if (system_cpu_support_sse2()) {
 		info.bvh_layout_mask |= BVH_LAYOUT_BVH4;
 	}
+#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_AVX2
+	/* Must match the kernel selection in KernelFunctions, traversal of 8-wide
+	 * nodes is only compiled into the AVX2 kernel. */
+	if(DebugFlags().cpu.has_avx2() && system_cpu_support_avx2()) {
+		info.bvh_layout_mask |= BVH_LAYOUT_BVH8;
+	}
+#endif
 	info.has_volume_decoupled = true;
+	info.has_sparse_volumes = true;
 	info.has_osl = true;
 	info.has_half_images = true;
 
@@ -232,8 +232,8 @@ public:
 		cuda_error_documentation();
 	}
 
-	CUDADevice(DeviceInfo& info, Stats &stats, bool background_)
-	: Device(info, stats, background_),
+	CUDADevice(DeviceInfo& info, Stats &stats, Profiler &profiler, bool background_)
+	: Device(info, stats, profiler, background_),
 	  texture_info(this, "__texture_info", MEM_TEXTURE)
 	{
 		first_error = true;
@@ -943,6 +943,28 @@ public:
 		}
 	}
 
+	bool mem_copy_to_range_supported(const device_memory& mem)
+	{
+		/* Data textures are plain device buffers too, only image textures
+		 * are stored in arrays. */
+		return (mem.type == MEM_READ_ONLY ||
+		        mem.type == MEM_READ_WRITE ||
+		        (mem.type == MEM_TEXTURE && mem.interpolation == INTERPOLATION_NONE));
+	}
+
+	void mem_copy_to_range(device_memory& mem, size_t offset, size_t size)
+	{
+		if(!mem_copy_to_range_supported(mem) || !mem.device_pointer) {
+			mem_copy_to(mem);
+		}
+		else if(mem.host_pointer != mem.shared_pointer) {
+			CUDAContextScope scope(this);
+			cuda_assert(cuMemcpyHtoD(cuda_device_ptr(mem.device_pointer) + offset,
+			                         (uchar*)mem.host_pointer + offset,
+			                         size));
+		}
+	}
+
 	void mem_copy_from(device_memory& mem, int y, int w, int h, int elem)
 	{
 		if(mem.type == MEM_PIXELS && !background) {
@@ -1222,6 +1244,7 @@ public:
 		info.width = mem.data_width;
 		info.height = mem.data_height;
 		info.depth = mem.data_depth;
+		info.sparse_offsets = 0;
 		need_texture_info = true;
 	}
 
@@ -2425,9 +2448,9 @@ bool device_cuda_init(void)
 #endif /* WITH_CUDA_DYNLOAD */
 }
 
-Device *device_cuda_create(DeviceInfo& info, Stats &stats, bool background)
+Device *device_cuda_create(DeviceInfo& info, Stats &stats, Profiler &profiler, bool background)
 {
-	return new CUDADevice(info, stats, background);
+	return new CUDADevice(info, stats, profiler, background);
 }
 
 static CUresult device_cuda_safe_init()
@@ -55,6 +55,8 @@ void DenoisingTask::init_from_devicetask(const DeviceTask &task)
 	render_buffer.pass_stride = task.pass_stride;
 	render_buffer.denoising_data_offset  = task.pass_denoising_data;
 	render_buffer.denoising_clean_offset = task.pass_denoising_clean;
+	render_buffer.neighbor_frames = task.denoising_neighbor_frames;
+	render_buffer.frame_stride = task.denoising_frame_stride;
 
 	/* Expand filter_area by radius pixels and clamp the result to the extent of the neighboring tiles */
 	rect = rect_from_shape(filter_area.x, filter_area.y, filter_area.z, filter_area.w);
@@ -66,9 +68,8 @@ void DenoisingTask::tiles_from_rendertiles(RenderTile *rtiles)
 {
 	tiles = (TilesInfo*) tiles_mem.alloc(sizeof(TilesInfo)/sizeof(int));
 
-	device_ptr buffers[9];
 	for(int i = 0; i < 9; i++) {
-		buffers[i] = rtiles[i].buffer;
+		tile_buffers[i] = rtiles[i].buffer;
 		tiles->offsets[i] = rtiles[i].offset;
 		tiles->strides[i] = rtiles[i].stride;
 	}
@@ -85,115 +86,149 @@ void DenoisingTask::tiles_from_rendertiles(RenderTile *rtiles)
 	render_buffer.stride = rtiles[4].stride;
 	render_buffer.ptr    = rtiles[4].buffer;
 
+	functions.set_tiles(tile_buffers);
+}
+
+void DenoisingTask::tiles_set_frame(int frame)
+{
+	device_ptr buffers[9];
+	for(int i = 0; i < 9; i++) {
+		buffers[i] = tile_buffers[i];
+		if(buffers[i]) {
+			buffers[i] += frame*render_buffer.frame_stride*sizeof(float);
+		}
+	}
+
 	functions.set_tiles(buffers);
 }
 
+void DenoisingTask::prefilter_shadowing(int frame)
+{
+	const int frame_offset = frame*buffer.frame_stride;
+	device_ptr null_ptr = (device_ptr) 0;
+
+	device_sub_ptr unfiltered_a   (buffer.mem, frame_offset,                      buffer.pass_stride);
+	device_sub_ptr unfiltered_b   (buffer.mem, frame_offset + 1*buffer.pass_stride, buffer.pass_stride);
+	device_sub_ptr sample_var     (buffer.mem, frame_offset + 2*buffer.pass_stride, buffer.pass_stride);
+	device_sub_ptr sample_var_var (buffer.mem, frame_offset + 3*buffer.pass_stride, buffer.pass_stride);
+	device_sub_ptr buffer_var     (buffer.mem, frame_offset + 5*buffer.pass_stride, buffer.pass_stride);
+	device_sub_ptr filtered_var   (buffer.mem, frame_offset + 6*buffer.pass_stride, buffer.pass_stride);
+	device_sub_ptr nlm_temporary_1(buffer.mem, frame_offset + 7*buffer.pass_stride, buffer.pass_stride);
+	device_sub_ptr nlm_temporary_2(buffer.mem, frame_offset + 8*buffer.pass_stride, buffer.pass_stride);
+	device_sub_ptr nlm_temporary_3(buffer.mem, frame_offset + 9*buffer.pass_stride, buffer.pass_stride);
+
+	nlm_state.temporary_1_ptr = *nlm_temporary_1;
+	nlm_state.temporary_2_ptr = *nlm_temporary_2;
+	nlm_state.temporary_3_ptr = *nlm_temporary_3;
+
+	/* Get the A/B unfiltered passes, the combined sample variance, the estimated variance of the sample variance and the buffer variance. */
+	functions.divide_shadow(*unfiltered_a, *unfiltered_b, *sample_var, *sample_var_var, *buffer_var);
+
+	/* Smooth the (generally pretty noisy) buffer variance using the spatial information from the sample variance. */
+	nlm_state.set_parameters(6, 3, 4.0f, 1.0f);
+	functions.non_local_means(*buffer_var, *sample_var, *sample_var_var, *filtered_var);
+
+	/* Reuse memory, the previous data isn't needed anymore. */
+	device_ptr filtered_a = *buffer_var,
+	           filtered_b = *sample_var;
+	/* Use the smoothed variance to filter the two shadow half images using each other for weight calculation. */
+	nlm_state.set_parameters(5, 3, 1.0f, 0.25f);
+	functions.non_local_means(*unfiltered_a, *unfiltered_b, *filtered_var, filtered_a);
+	functions.non_local_means(*unfiltered_b, *unfiltered_a, *filtered_var, filtered_b);
+
+	device_ptr residual_var = *sample_var_var;
+	/* Estimate the residual variance between the two filtered halves. */
+	functions.combine_halves(filtered_a, filtered_b, null_ptr, residual_var, 2, rect);
+
+	device_ptr final_a = *unfiltered_a,
+	           final_b = *unfiltered_b;
+	/* Use the residual variance for a second filter pass. */
+	nlm_state.set_parameters(4, 2, 1.0f, 0.5f);
+	functions.non_local_means(filtered_a, filtered_b, residual_var, final_a);
+	functions.non_local_means(filtered_b, filtered_a, residual_var, final_b);
+
+	/* Combine the two double-filtered halves to a final shadow feature. */
+	device_sub_ptr shadow_pass(buffer.mem, frame_offset + 4*buffer.pass_stride, buffer.pass_stride);
+	functions.combine_halves(final_a, final_b, *shadow_pass, null_ptr, 0, rect);
+}
+
+void DenoisingTask::prefilter_features(int frame)
+{
+	const int frame_offset = frame*buffer.frame_stride;
+
+	device_sub_ptr unfiltered     (buffer.mem, frame_offset +  8*buffer.pass_stride, buffer.pass_stride);
+	device_sub_ptr variance       (buffer.mem, frame_offset +  9*buffer.pass_stride, buffer.pass_stride);
+	device_sub_ptr nlm_temporary_1(buffer.mem, frame_offset + 10*buffer.pass_stride, buffer.pass_stride);
+	device_sub_ptr nlm_temporary_2(buffer.mem, frame_offset + 11*buffer.pass_stride, buffer.pass_stride);
+	device_sub_ptr nlm_temporary_3(buffer.mem, frame_offset + 12*buffer.pass_stride, buffer.pass_stride);
+
+	nlm_state.temporary_1_ptr = *nlm_temporary_1;
+	nlm_state.temporary_2_ptr = *nlm_temporary_2;
+	nlm_state.temporary_3_ptr = *nlm_temporary_3;
+
+	int mean_from[]     = { 0, 1, 2, 12, 6,  7, 8 };
+	int variance_from[] = { 3, 4, 5, 13, 9, 10, 11};
+	int pass_to[]       = { 1, 2, 3, 0,  5,  6,  7};
+	for(int pass = 0; pass < 7; pass++) {
+		device_sub_ptr feature_pass(buffer.mem, frame_offset + pass_to[pass]*buffer.pass_stride, buffer.pass_stride);
+		/* Get the unfiltered pass and its variance from the RenderBuffers. */
+		functions.get_feature(mean_from[pass], variance_from[pass], *unfiltered, *variance);
+		/* Smooth the pass and store the result in the denoising buffers. */
+		nlm_state.set_parameters(2, 2, 1.0f, 0.25f);
+		functions.non_local_means(*unfiltered, *unfiltered, *variance, *feature_pass);
+	}
+}
+
+void DenoisingTask::prefilter_color(int frame)
+{
+	const int frame_offset = frame*buffer.frame_stride;
+
+	int mean_from[]     = {20, 21, 22};
+	int variance_from[] = {23, 24, 25};
+	int mean_to[]       = { 8,  9, 10};
+	int variance_to[]   = {11, 12, 13};
+	int num_color_passes = 3;
+
+	for(int pass = 0; pass < num_color_passes; pass++) {
+		device_sub_ptr color_pass(storage.temporary_color, pass*buffer.pass_stride, buffer.pass_stride);
+		device_sub_ptr color_var_pass(buffer.mem, frame_offset + variance_to[pass]*buffer.pass_stride, buffer.pass_stride);
+		functions.get_feature(mean_from[pass], variance_from[pass], *color_pass, *color_var_pass);
+	}
+
+	device_sub_ptr depth_pass    (buffer.mem, frame_offset,                                   buffer.pass_stride);
+	device_sub_ptr color_var_pass(buffer.mem, frame_offset + variance_to[0]*buffer.pass_stride, 3*buffer.pass_stride);
+	device_sub_ptr output_pass   (buffer.mem, frame_offset +     mean_to[0]*buffer.pass_stride, 3*buffer.pass_stride);
+	functions.detect_outliers(storage.temporary_color.device_pointer, *color_var_pass, *depth_pass, *output_pass);
+}
+
 bool DenoisingTask::run_denoising()
 {
 	/* Allocate denoising buffer. */
+	const int num_frames = 1 + render_buffer.neighbor_frames;
 	buffer.passes = 14;
 	buffer.width = rect.z - rect.x;
 	buffer.stride = align_up(buffer.width, 4);
 	buffer.h = rect.w - rect.y;
 	buffer.pass_stride = align_up(buffer.stride * buffer.h, divide_up(device->mem_sub_ptr_alignment(), sizeof(float)));
-	buffer.mem.alloc_to_device(buffer.pass_stride * buffer.passes, false);
-
-	device_ptr null_ptr = (device_ptr) 0;
+	buffer.frame_stride = buffer.pass_stride * buffer.passes;
+	buffer.mem.alloc_to_device(buffer.frame_stride * num_frames, false);
 
-	/* Prefilter shadow feature. */
-	{
-		device_sub_ptr unfiltered_a   (buffer.mem, 0,                    buffer.pass_stride);
-		device_sub_ptr unfiltered_b   (buffer.mem, 1*buffer.pass_stride, buffer.pass_stride);
-		device_sub_ptr sample_var     (buffer.mem, 2*buffer.pass_stride, buffer.pass_stride);
-		device_sub_ptr sample_var_var (buffer.mem, 3*buffer.pass_stride, buffer.pass_stride);
-		device_sub_ptr buffer_var     (buffer.mem, 5*buffer.pass_stride, buffer.pass_stride);
-		device_sub_ptr filtered_var   (buffer.mem, 6*buffer.pass_stride, buffer.pass_stride);
-		device_sub_ptr nlm_temporary_1(buffer.mem, 7*buffer.pass_stride, buffer.pass_stride);
-		device_sub_ptr nlm_temporary_2(buffer.mem, 8*buffer.pass_stride, buffer.pass_stride);
-		device_sub_ptr nlm_temporary_3(buffer.mem, 9*buffer.pass_stride, buffer.pass_stride);
-
-		nlm_state.temporary_1_ptr = *nlm_temporary_1;
-		nlm_state.temporary_2_ptr = *nlm_temporary_2;
-		nlm_state.temporary_3_ptr = *nlm_temporary_3;
-
-		/* Get the A/B unfiltered passes, the combined sample variance, the estimated variance of the sample variance and the buffer variance. */
-		functions.divide_shadow(*unfiltered_a, *unfiltered_b, *sample_var, *sample_var_var, *buffer_var);
-
-		/* Smooth the (generally pretty noisy) buffer variance using the spatial information from the sample variance. */
-		nlm_state.set_parameters(6, 3, 4.0f, 1.0f);
-		functions.non_local_means(*buffer_var, *sample_var, *sample_var_var, *filtered_var);
-
-		/* Reuse memory, the previous data isn't needed anymore. */
-		device_ptr filtered_a = *buffer_var,
-		           filtered_b = *sample_var;
-		/* Use the smoothed variance to filter the two shadow half images using each other for weight calculation. */
-		nlm_state.set_parameters(5, 3, 1.0f, 0.25f);
-		functions.non_local_means(*unfiltered_a, *unfiltered_b, *filtered_var, filtered_a);
-		functions.non_local_means(*unfiltered_b, *unfiltered_a, *filtered_var, filtered_b);
-
-		device_ptr residual_var = *sample_var_var;
-		/* Estimate the residual variance between the two filtered halves. */
-		functions.combine_halves(filtered_a, filtered_b, null_ptr, residual_var, 2, rect);
-
-		device_ptr final_a = *unfiltered_a,
-		           final_b = *unfiltered_b;
-		/* Use the residual variance for a second filter pass. */
-		nlm_state.set_parameters(4, 2, 1.0f, 0.5f);
-		functions.non_local_means(filtered_a, filtered_b, residual_var, final_a);
-		functions.non_local_means(filtered_b, filtered_a, residual_var, final_b);
-
-		/* Combine the two double-filtered halves to a final shadow feature. */
-		device_sub_ptr shadow_pass(buffer.mem, 4*buffer.pass_stride, buffer.pass_stride);
-		functions.combine_halves(final_a, final_b, *shadow_pass, null_ptr, 0, rect);
-	}
+	storage.temporary_color.alloc_to_device(3*buffer.pass_stride, false);
 
-	/* Prefilter general features. */
-	{
-		device_sub_ptr unfiltered     (buffer.mem,  8*buffer.pass_stride, buffer.pass_stride);
-		device_sub_ptr variance       (buffer.mem,  9*buffer.pass_stride, buffer.pass_stride);
-		device_sub_ptr nlm_temporary_1(buffer.mem, 10*buffer.pass_stride, buffer.pass_stride);
-		device_sub_ptr nlm_temporary_2(buffer.mem, 11*buffer.pass_stride, buffer.pass_stride);
-		device_sub_ptr nlm_temporary_3(buffer.mem, 12*buffer.pass_stride, buffer.pass_stride);
-
-		nlm_state.temporary_1_ptr = *nlm_temporary_1;
-		nlm_state.temporary_2_ptr = *nlm_temporary_2;
-		nlm_state.temporary_3_ptr = *nlm_temporary_3;
-
-		int mean_from[]     = { 0, 1, 2, 12, 6,  7, 8 };
-		int variance_from[] = { 3, 4, 5, 13, 9, 10, 11};
-		int pass_to[]       = { 1, 2, 3, 0,  5,  6,  7};
-		for(int pass = 0; pass < 7; pass++) {
-			device_sub_ptr feature_pass(buffer.mem, pass_to[pass]*buffer.pass_stride, buffer.pass_stride);
-			/* Get the unfiltered pass and its variance from the RenderBuffers. */
-			functions.get_feature(mean_from[pass], variance_from[pass], *unfiltered, *variance);
-			/* Smooth the pass and store the result in the denoising buffers. */
-			nlm_state.set_parameters(2, 2, 1.0f, 0.25f);
-			functions.non_local_means(*unfiltered, *unfiltered, *variance, *feature_pass);
+	/* Prefilter the features of the current frame, followed by the ones
+	 * of the neighboring frames. */
+	for(int frame = 0; frame < num_frames; frame++) {
+		if(frame > 0) {
+			tiles_set_frame(frame);
 		}
-	}
 
-	/* Copy color passes. */
-	{
-		int mean_from[]     = {20, 21, 22};
-		int variance_from[] = {23, 24, 25};
-		int mean_to[]       = { 8,  9, 10};
-		int variance_to[]   = {11, 12, 13};
-		int num_color_passes = 3;
-
-		storage.temporary_color.alloc_to_device(3*buffer.pass_stride, false);
-
-		for(int pass = 0; pass < num_color_passes; pass++) {
-			device_sub_ptr color_pass(storage.temporary_color, pass*buffer.pass_stride, buffer.pass_stride);
-			device_sub_ptr color_var_pass(buffer.mem, variance_to[pass]*buffer.pass_stride, buffer.pass_stride);
-			functions.get_feature(mean_from[pass], variance_from[pass], *color_pass, *color_var_pass);
-		}
+		prefilter_shadowing(frame);
+		prefilter_features(frame);
+		prefilter_color(frame);
+	}
 
-		{
-			device_sub_ptr depth_pass    (buffer.mem,                                 0,   buffer.pass_stride);
-			device_sub_ptr color_var_pass(buffer.mem, variance_to[0]*buffer.pass_stride, 3*buffer.pass_stride);
-			device_sub_ptr output_pass   (buffer.mem,     mean_to[0]*buffer.pass_stride, 3*buffer.pass_stride);
-			functions.detect_outliers(storage.temporary_color.device_pointer, *color_var_pass, *depth_pass, *output_pass);
-		}
+	if(num_frames > 1) {
+		tiles_set_frame(0);
 	}
 
 	storage.w = filter_area.z;
@@ -41,11 +41,17 @@ public:
 		int stride;
 		device_ptr ptr;
 		int samples;
+		/* Neighboring frames are stored after the current frame, with this
+		 * distance in floats between them. */
+		int neighbor_frames;
+		int frame_stride;
 	} render_buffer;
 
 	TilesInfo *tiles;
 	device_vector<int> tiles_mem;
 	void tiles_from_rendertiles(RenderTile *rtiles);
+	/* Point the tiles to the given frame of the render buffers. */
+	void tiles_set_frame(int frame);
 
 	int4 rect;
 	int4 filter_area;
@@ -134,7 +140,8 @@ public:
 		  XtWY(device, "denoising XtWY"),
 		  temporary_1(device, "denoising NLM temporary 1"),
 		  temporary_2(device, "denoising NLM temporary 2"),
-		  temporary_color(device, "denoising temporary color")
+		  temporary_color(device, "denoising temporary color"),
+		  w(0), h(0)
 		{}
 	} storage;
 
@@ -151,6 +158,9 @@ public:
 		int stride;
 		int h;
 		int width;
+		/* Prefiltered features of neighboring frames follow the ones of the
+		 * current frame, with this distance in floats between them. */
+		int frame_stride;
 		device_only_memory<float> mem;
 
 		DenoiseBuffers(Device *device)
@@ -160,6 +170,13 @@ public:
 
 protected:
 	Device *device;
+
+	/* Render buffers of the neighboring tiles in the current frame. */
+	device_ptr tile_buffers[9];
+
+	void prefilter_shadowing(int frame);
+	void prefilter_features(int frame);
+	void prefilter_color(int frame);
 };
 
 CCL_NAMESPACE_END
@@ -33,6 +33,7 @@ device_memory::device_memory(Device *device, const char *name, MemoryType type)
   name(name),
   interpolation(INTERPOLATION_NONE),
   extension(EXTENSION_REPEAT),
+  sparse_offsets(NULL),
   device(device),
   device_pointer(0),
   host_pointer(0),
@@ -91,6 +92,18 @@ void device_memory::device_copy_to()
 	}
 }
 
+void device_memory::device_copy_to_range(size_t offset, size_t size)
+{
+	if(host_pointer && size) {
+		device->mem_copy_to_range(*this, offset, size);
+	}
+}
+
+bool device_memory::device_copy_to_range_supported() const
+{
+	return device_pointer && device->mem_copy_to_range_supported(*this);
+}
+
 void device_memory::device_copy_from(int y, int w, int h, int elem)
 {
 	assert(type != MEM_TEXTURE && type != MEM_READ_ONLY);
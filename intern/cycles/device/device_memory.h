@@ -191,6 +191,10 @@ public:
 	const char *name;
 	InterpolationType interpolation;
 	ExtensionType extension;
+	/* Tile offsets of sparse 3D textures, only the active tiles are stored
+	 * in the data while data_width, data_height and data_depth keep the
+	 * dimensions of the full grid. */
+	device_memory *sparse_offsets;
 
 	/* Pointers. */
 	Device *device;
@@ -220,6 +224,8 @@ protected:
 	void device_alloc();
 	void device_free();
 	void device_copy_to();
+	void device_copy_to_range(size_t offset, size_t size);
+	bool device_copy_to_range_supported() const;
 	void device_copy_from(int y, int w, int h, int elem);
 	void device_zero();
 };
@@ -401,6 +407,28 @@ public:
 		device_copy_to();
 	}
 
+	/* Whether copying a range is cheaper than copying everything, devices
+	 * without ranged copies for this memory type copy the whole buffer. */
+	bool copy_to_device_range_supported() const
+	{
+		return device_copy_to_range_supported();
+	}
+
+	/* Copy only elements [offset, offset + size) to an already allocated
+	 * device buffer, falls back to a full copy if not allocated yet. */
+	void copy_to_device(size_t offset, size_t size)
+	{
+		assert(offset + size <= data_size);
+
+		if(device_pointer) {
+			device_copy_to_range(memory_elements_size(offset),
+			                     memory_elements_size(size));
+		}
+		else {
+			device_copy_to();
+		}
+	}
+
 	void copy_from_device(int y, int w, int h)
 	{
 		device_copy_from(y, w, h, sizeof(T));
@@ -28,6 +28,7 @@ CCL_NAMESPACE_BEGIN
 /* Device Task */
 
 class Device;
+struct GuidingSample;
 class RenderBuffers;
 class RenderTile;
 class Tile;
@@ -64,9 +65,11 @@ public:
 	function<void(long, int)> update_progress_sample;
 	function<void(RenderTile&)> update_tile_sample;
 	function<void(RenderTile&)> release_tile;
+	function<void(int, double)> update_thread_busy_time;
 	function<bool(void)> get_cancel;
 	function<void(RenderTile*, Device*)> map_neighbor_tiles;
 	function<void(RenderTile*, Device*)> unmap_neighbor_tiles;
+	function<void(const GuidingSample*, int)> record_guiding_samples;
 
 	int denoising_radius;
 	float denoising_strength;
@@ -75,6 +78,10 @@ public:
 	int pass_stride;
 	int pass_denoising_data;
 	int pass_denoising_clean;
+	/* Neighboring frames stored right after the current frame in the render
+	 * buffers, with the distance between two frames in floats. */
+	int denoising_neighbor_frames;
+	int denoising_frame_stride;
 
 	bool need_finish_queue;
 	bool integrator_branched;
@@ -324,7 +324,7 @@ public:
 	void opencl_error(const string& message);
 	void opencl_assert_err(cl_int err, const char* where);
 
-	OpenCLDeviceBase(DeviceInfo& info, Stats &stats, bool background_);
+	OpenCLDeviceBase(DeviceInfo& info, Stats &stats, Profiler &profiler, bool background_);
 	~OpenCLDeviceBase();
 
 	static void CL_CALLBACK context_notify_callback(const char *err_info,
@@ -342,6 +342,8 @@ public:
 
 	void mem_alloc(device_memory& mem);
 	void mem_copy_to(device_memory& mem);
+	void mem_copy_to_range(device_memory& mem, size_t offset, size_t size);
+	bool mem_copy_to_range_supported(const device_memory& mem);
 	void mem_copy_from(device_memory& mem, int y, int w, int h, int elem);
 	void mem_zero(device_memory& mem);
 	void mem_free(device_memory& mem);
@@ -561,8 +563,8 @@ protected:
 	void flush_texture_buffers();
 };
 
-Device *opencl_create_mega_device(DeviceInfo& info, Stats& stats, bool background);
-Device *opencl_create_split_device(DeviceInfo& info, Stats& stats, bool background);
+Device *opencl_create_mega_device(DeviceInfo& info, Stats& stats, Profiler& profiler, bool background);
+Device *opencl_create_split_device(DeviceInfo& info, Stats& stats, Profiler& profiler, bool background);
 
 CCL_NAMESPACE_END
 
@@ -72,8 +72,8 @@ void OpenCLDeviceBase::opencl_assert_err(cl_int err, const char* where)
 	}
 }
 
-OpenCLDeviceBase::OpenCLDeviceBase(DeviceInfo& info, Stats &stats, bool background_)
-: Device(info, stats, background_),
+OpenCLDeviceBase::OpenCLDeviceBase(DeviceInfo& info, Stats &stats, Profiler &profiler, bool background_)
+: Device(info, stats, profiler, background_),
   memory_manager(this),
   texture_info(this, "__texture_info", MEM_TEXTURE)
 {
@@ -370,6 +370,29 @@ void OpenCLDeviceBase::mem_copy_to(device_memory& mem)
 	}
 }
 
+bool OpenCLDeviceBase::mem_copy_to_range_supported(const device_memory& mem)
+{
+	return (mem.type != MEM_TEXTURE);
+}
+
+void OpenCLDeviceBase::mem_copy_to_range(device_memory& mem, size_t offset, size_t size)
+{
+	if(mem.type == MEM_TEXTURE || !mem.device_pointer) {
+		mem_copy_to(mem);
+		return;
+	}
+
+	/* this is blocking */
+	opencl_assert(clEnqueueWriteBuffer(cqCommandQueue,
+	                                   CL_MEM_PTR(mem.device_pointer),
+	                                   CL_TRUE,
+	                                   offset,
+	                                   size,
+	                                   (uchar*)mem.host_pointer + offset,
+	                                   0,
+	                                   NULL, NULL));
+}
+
 void OpenCLDeviceBase::mem_copy_from(device_memory& mem, int y, int w, int h, int elem)
 {
 	size_t offset = elem*y*w;
@@ -676,6 +699,7 @@ void OpenCLDeviceBase::flush_texture_buffers()
 		MemoryManager::BufferDescriptor desc = memory_manager.get_descriptor(slot.name);
 		info.data = desc.offset;
 		info.cl_buffer = desc.device_buffer;
+		info.sparse_offsets = 0;
 
 		if(string_startswith(slot.name, "__tex_image")) {
 			device_memory *mem = textures[slot.name];
@@ -0,0 +1,403 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Ray Stream Traversal
+ *
+ * Traverses a small batch of coherent rays through the wide BVH together.
+ * Every node is fetched once for all rays that are still active below it,
+ * and the child boxes are tested against four rays at a time with the rays
+ * stored as structure of arrays. Primitives are intersected per ray.
+ *
+ * Only static triangle geometry is supported, with or without instancing.
+ * Motion blur and hair fall back to the single ray traversal, see
+ * bvh_stream_supported(). */
+
+#define RAY_STREAM_GROUPS (RAY_STREAM_SIZE/4)
+
+struct RayStreamStackItem {
+	int addr;
+	/* Rays that entered this node. */
+	uint mask;
+};
+
+/* Rays of the stream in the space of the currently traversed object. */
+struct RayStreamSoA {
+	ssef P_x[RAY_STREAM_GROUPS], P_y[RAY_STREAM_GROUPS], P_z[RAY_STREAM_GROUPS];
+	ssef idir_x[RAY_STREAM_GROUPS], idir_y[RAY_STREAM_GROUPS], idir_z[RAY_STREAM_GROUPS];
+	ssef tfar[RAY_STREAM_GROUPS];
+};
+
+ccl_device_inline bool bvh_stream_supported(KernelGlobals *kg)
+{
+	if(kernel_data.bvh.have_motion || kernel_data.bvh.have_curves) {
+		return false;
+	}
+#ifdef __OBVH__
+	if(kernel_data.bvh.bvh_layout == BVH_LAYOUT_BVH8) {
+		return true;
+	}
+#endif
+	return (kernel_data.bvh.bvh_layout == BVH_LAYOUT_BVH4);
+}
+
+ccl_device_inline void bvh_stream_lane_set(ssef *v, int i, float f)
+{
+	((float*)&v[i >> 2])[i & 3] = f;
+}
+
+ccl_device_inline void bvh_stream_ray_update(RayStreamSoA *soa,
+                                             int i,
+                                             const float3& P,
+                                             const float3& idir,
+                                             float t)
+{
+	bvh_stream_lane_set(soa->P_x, i, P.x);
+	bvh_stream_lane_set(soa->P_y, i, P.y);
+	bvh_stream_lane_set(soa->P_z, i, P.z);
+	bvh_stream_lane_set(soa->idir_x, i, idir.x);
+	bvh_stream_lane_set(soa->idir_y, i, idir.y);
+	bvh_stream_lane_set(soa->idir_z, i, idir.z);
+	bvh_stream_lane_set(soa->tfar, i, t);
+}
+
+/* Test a single child box against all rays in mask, returns the rays which
+ * hit it and the closest entry distance among them. */
+ccl_device_inline uint bvh_stream_box_intersect(const RayStreamSoA *soa,
+                                                const float bounds[6],
+                                                const uint mask,
+                                                float *dist)
+{
+	const ssef min_x(bounds[0]), max_x(bounds[1]);
+	const ssef min_y(bounds[2]), max_y(bounds[3]);
+	const ssef min_z(bounds[4]), max_z(bounds[5]);
+	ssef closest(FLT_MAX);
+	uint hit_mask = 0;
+
+	for(int g = 0; g < RAY_STREAM_GROUPS; g++) {
+		const uint group_mask = (mask >> (g*4)) & 0xf;
+		if(group_mask == 0) {
+			continue;
+		}
+
+		/* Rays in a group do not share direction signs, so the near and far
+		 * planes are selected per lane. */
+		const sseb neg_x = soa->idir_x[g] < ssef(0.0f);
+		const sseb neg_y = soa->idir_y[g] < ssef(0.0f);
+		const sseb neg_z = soa->idir_z[g] < ssef(0.0f);
+
+		const ssef tnear_x = (select(neg_x, max_x, min_x) - soa->P_x[g]) * soa->idir_x[g];
+		const ssef tnear_y = (select(neg_y, max_y, min_y) - soa->P_y[g]) * soa->idir_y[g];
+		const ssef tnear_z = (select(neg_z, max_z, min_z) - soa->P_z[g]) * soa->idir_z[g];
+		const ssef tfar_x = (select(neg_x, min_x, max_x) - soa->P_x[g]) * soa->idir_x[g];
+		const ssef tfar_y = (select(neg_y, min_y, max_y) - soa->P_y[g]) * soa->idir_y[g];
+		const ssef tfar_z = (select(neg_z, min_z, max_z) - soa->P_z[g]) * soa->idir_z[g];
+
+		const ssef tnear = max(max(tnear_x, tnear_y), max(tnear_z, ssef(0.0f)));
+		const ssef tfar = min(min(tfar_x, tfar_y), min(tfar_z, soa->tfar[g]));
+		const sseb vmask = tnear <= tfar;
+		const uint group_hit = (uint)movemask(vmask) & group_mask;
+
+		if(group_hit) {
+			closest = min(closest, select(vmask, tnear, ssef(FLT_MAX)));
+			hit_mask |= group_hit << (g*4);
+		}
+	}
+
+	*dist = reduce_min(closest);
+	return hit_mask;
+}
+
+/* Fetch bounds and address of one child of a QBVH or OBVH aligned node. */
+ccl_device_inline int bvh_stream_child_fetch(KernelGlobals *kg,
+                                             const int node_addr,
+                                             const int child,
+                                             const bool use_obvh,
+                                             float bounds[6])
+{
+	if(use_obvh) {
+		const int offset = node_addr + child/4;
+		const int elem = child & 3;
+		for(int row = 0; row < 6; row++) {
+			bounds[row] = kernel_tex_fetch(__bvh_nodes, offset + 2*(row + 1))[elem];
+		}
+		return __float_as_int(kernel_tex_fetch(__bvh_nodes, offset + 14)[elem]);
+	}
+	else {
+		for(int row = 0; row < 6; row++) {
+			bounds[row] = kernel_tex_fetch(__bvh_nodes, node_addr + row + 1)[child];
+		}
+		return __float_as_int(kernel_tex_fetch(__bvh_nodes, node_addr + 7)[child]);
+	}
+}
+
+/* Intersect up to RAY_STREAM_SIZE rays with the scene, the result for each ray
+ * is written to the matching intersection. Returns a bit mask of the rays
+ * that hit something. Rays with zero length are skipped. */
+ccl_device uint bvh_intersect_stream(KernelGlobals *kg,
+                                     const Ray *rays,
+                                     Intersection *isects,
+                                     const int num_rays,
+                                     const uint visibility)
+{
+	kernel_assert(num_rays <= RAY_STREAM_SIZE);
+
+	PROFILING_INIT(kg, PROFILING_INTERSECT);
+	PROFILING_RAYS(kg, PROFILING_RAY_CAMERA, num_rays);
+
+	RayStreamStackItem traversal_stack[BVH_OSTACK_SIZE];
+	traversal_stack[0].addr = ENTRYPOINT_SENTINEL;
+	traversal_stack[0].mask = 0;
+
+	float3 P[RAY_STREAM_SIZE], dir[RAY_STREAM_SIZE], idir[RAY_STREAM_SIZE];
+	RayStreamSoA soa;
+	uint active = 0;
+
+	for(int g = 0; g < RAY_STREAM_GROUPS; g++) {
+		soa.P_x[g] = soa.P_y[g] = soa.P_z[g] = ssef(0.0f);
+		soa.idir_x[g] = soa.idir_y[g] = soa.idir_z[g] = ssef(1.0f);
+		soa.tfar[g] = ssef(-FLT_MAX);
+	}
+
+	for(int i = 0; i < num_rays; i++) {
+		Intersection *isect = &isects[i];
+
+		isect->t = rays[i].t;
+		isect->u = 0.0f;
+		isect->v = 0.0f;
+		isect->prim = PRIM_NONE;
+		isect->object = OBJECT_NONE;
+
+		BVH_DEBUG_INIT();
+
+		P[i] = rays[i].P;
+		dir[i] = bvh_clamp_direction(rays[i].D);
+		idir[i] = bvh_inverse_direction(dir[i]);
+
+		if(rays[i].t > 0.0f && isfinite(P[i].x)) {
+			bvh_stream_ray_update(&soa, i, P[i], idir[i], isect->t);
+			active |= (1u << i);
+		}
+	}
+
+#ifdef __OBVH__
+	const bool use_obvh = (kernel_data.bvh.bvh_layout == BVH_LAYOUT_BVH8);
+#else
+	const bool use_obvh = false;
+#endif
+	const int num_children = (use_obvh)? 8: 4;
+
+	/* Traversal variables in registers. */
+	int stack_ptr = 0;
+	int node_addr = kernel_data.bvh.root;
+	uint mask = active;
+	int object = OBJECT_NONE;
+
+	/* Traversal loop. */
+	do {
+		do {
+			/* Traverse internal nodes. */
+			while(node_addr >= 0 && node_addr != ENTRYPOINT_SENTINEL) {
+				float4 inodes = kernel_tex_fetch(__bvh_nodes, node_addr+0);
+				(void)inodes;
+
+				/* Rays may have terminated since the node was pushed. */
+				mask &= active;
+
+				if(mask == 0
+#ifdef __VISIBILITY_FLAG__
+				   || (__float_as_uint(inodes.x) & visibility) == 0
+#endif
+				 )
+				{
+					/* Pop. */
+					node_addr = traversal_stack[stack_ptr].addr;
+					mask = traversal_stack[stack_ptr].mask;
+					--stack_ptr;
+					continue;
+				}
+
+				/* Gather hit children, sorted from far to near. */
+				int child_addr[8];
+				uint child_mask[8];
+				float child_dist[8];
+				int num_hits = 0;
+
+				for(int c = 0; c < num_children; c++) {
+					float bounds[6];
+					const int addr = bvh_stream_child_fetch(kg, node_addr, c, use_obvh, bounds);
+
+					/* Empty child slots point to the root. */
+					if(addr == 0) {
+						continue;
+					}
+
+					float dist;
+					const uint hit_mask = bvh_stream_box_intersect(&soa, bounds, mask, &dist);
+					if(hit_mask == 0) {
+						continue;
+					}
+
+					int j = num_hits++;
+					for(; j > 0 && child_dist[j - 1] < dist; j--) {
+						child_addr[j] = child_addr[j - 1];
+						child_mask[j] = child_mask[j - 1];
+						child_dist[j] = child_dist[j - 1];
+					}
+					child_addr[j] = addr;
+					child_mask[j] = hit_mask;
+					child_dist[j] = dist;
+				}
+
+				if(num_hits == 0) {
+					/* Pop. */
+					node_addr = traversal_stack[stack_ptr].addr;
+					mask = traversal_stack[stack_ptr].mask;
+					--stack_ptr;
+					continue;
+				}
+
+				/* Push far children and continue with the closest one. */
+				for(int j = 0; j < num_hits - 1; j++) {
+					++stack_ptr;
+					kernel_assert(stack_ptr < BVH_OSTACK_SIZE);
+					traversal_stack[stack_ptr].addr = child_addr[j];
+					traversal_stack[stack_ptr].mask = child_mask[j];
+				}
+
+				node_addr = child_addr[num_hits - 1];
+				mask = child_mask[num_hits - 1];
+			}
+
+			/* If node is leaf, fetch triangle list. */
+			if(node_addr < 0) {
+				float4 leaf = kernel_tex_fetch(__bvh_leaf_nodes, (-node_addr-1));
+				const uint leaf_mask = mask & active;
+
+#ifdef __VISIBILITY_FLAG__
+				if(UNLIKELY((leaf_mask == 0) ||
+				            ((__float_as_uint(leaf.z) & visibility) == 0)))
+#else
+				if(UNLIKELY(leaf_mask == 0))
+#endif
+				{
+					/* Pop. */
+					node_addr = traversal_stack[stack_ptr].addr;
+					mask = traversal_stack[stack_ptr].mask;
+					--stack_ptr;
+					continue;
+				}
+
+				int prim_addr = __float_as_int(leaf.x);
+
+#ifdef __INSTANCING__
+				if(prim_addr >= 0) {
+#endif
+					int prim_addr2 = __float_as_int(leaf.y);
+					const uint type = __float_as_int(leaf.w);
+
+					/* Pop. */
+					node_addr = traversal_stack[stack_ptr].addr;
+					mask = traversal_stack[stack_ptr].mask;
+					--stack_ptr;
+
+					/* Primitive intersection, only triangles are expected
+					 * without motion blur and hair. */
+					kernel_assert((type & PRIMITIVE_ALL) == PRIMITIVE_TRIANGLE);
+					(void)type;
+
+					for(; prim_addr < prim_addr2; prim_addr++) {
+						uint ray_mask = leaf_mask & active;
+						while(ray_mask) {
+							const int i = __bscf(ray_mask);
+							Intersection *isect = &isects[i];
+
+							BVH_DEBUG_NEXT_INTERSECTION();
+							if(triangle_intersect(kg,
+							                      isect,
+							                      P[i],
+							                      dir[i],
+							                      visibility,
+							                      object,
+							                      prim_addr))
+							{
+								bvh_stream_lane_set(soa.tfar, i, isect->t);
+								/* Shadow ray early termination. */
+								if(visibility & PATH_RAY_SHADOW_OPAQUE) {
+									active &= ~(1u << i);
+								}
+							}
+						}
+					}
+#ifdef __INSTANCING__
+				}
+				else {
+					/* Instance push. */
+					object = kernel_tex_fetch(__prim_object, -prim_addr-1);
+
+					uint ray_mask = leaf_mask;
+					while(ray_mask) {
+						const int i = __bscf(ray_mask);
+						Intersection *isect = &isects[i];
+
+						isect->t = bvh_instance_push(kg, object, &rays[i], &P[i], &dir[i], &idir[i], isect->t);
+						bvh_stream_ray_update(&soa, i, P[i], idir[i], isect->t);
+
+						BVH_DEBUG_NEXT_INSTANCE();
+					}
+
+					/* The sentinel remembers which rays to transform back. */
+					++stack_ptr;
+					kernel_assert(stack_ptr < BVH_OSTACK_SIZE);
+					traversal_stack[stack_ptr].addr = ENTRYPOINT_SENTINEL;
+					traversal_stack[stack_ptr].mask = leaf_mask;
+
+					node_addr = kernel_tex_fetch(__object_node, object);
+					mask = leaf_mask;
+				}
+#endif  /* __INSTANCING__ */
+			}
+		} while(node_addr != ENTRYPOINT_SENTINEL);
+
+#ifdef __INSTANCING__
+		if(stack_ptr >= 0) {
+			kernel_assert(object != OBJECT_NONE);
+
+			/* Instance pop, also for rays that terminated inside it. */
+			uint ray_mask = mask;
+			while(ray_mask) {
+				const int i = __bscf(ray_mask);
+				Intersection *isect = &isects[i];
+
+				isect->t = bvh_instance_pop(kg, object, &rays[i], &P[i], &dir[i], &idir[i], isect->t);
+				bvh_stream_ray_update(&soa, i, P[i], idir[i], isect->t);
+			}
+
+			object = OBJECT_NONE;
+			node_addr = traversal_stack[stack_ptr].addr;
+			mask = traversal_stack[stack_ptr].mask;
+			--stack_ptr;
+		}
+#endif  /* __INSTANCING__ */
+	} while(node_addr != ENTRYPOINT_SENTINEL);
+
+	uint hit = 0;
+	for(int i = 0; i < num_rays; i++) {
+		if(isects[i].prim != PRIM_NONE) {
+			hit |= (1u << i);
+		}
+	}
+	return hit;
+}
@@ -17,6 +17,7 @@
 CCL_NAMESPACE_BEGIN
 
 ccl_device_inline void kernel_filter_nlm_calc_difference(int dx, int dy,
+                                                         int frame_offset,
                                                          const float *ccl_restrict weight_image,
                                                          const float *ccl_restrict variance_image,
                                                          float *difference_image,
@@ -31,9 +32,10 @@ ccl_device_inline void kernel_filter_nlm_calc_difference(int dx, int dy,
 			float diff = 0.0f;
 			int numChannels = channel_offset? 3 : 1;
 			for(int c = 0; c < numChannels; c++) {
-				float cdiff = weight_image[c*channel_offset + y*stride + x] - weight_image[c*channel_offset + (y+dy)*stride + (x+dx)];
+				int q_idx = c*channel_offset + (y+dy)*stride + (x+dx) + frame_offset;
+				float cdiff = weight_image[c*channel_offset + y*stride + x] - weight_image[q_idx];
 				float pvar = variance_image[c*channel_offset + y*stride + x];
-				float qvar = variance_image[c*channel_offset + (y+dy)*stride + (x+dx)];
+				float qvar = variance_image[q_idx];
 				diff += (cdiff*cdiff - a*(pvar + min(pvar, qvar))) / (1e-8f + k_2*(pvar+qvar));
 			}
 			if(numChannels > 1) {
@@ -125,6 +127,7 @@ ccl_device_inline void kernel_filter_nlm_update_output(int dx, int dy,
 }
 
 ccl_device_inline void kernel_filter_nlm_construct_gramian(int dx, int dy,
+                                                           int frame_offset,
                                                            const float *ccl_restrict difference_image,
                                                            const float *ccl_restrict buffer,
                                                            float *transform,
@@ -155,7 +158,7 @@ ccl_device_inline void kernel_filter_nlm_construct_gramian(int dx, int dy,
 			int    *l_rank = rank + storage_ofs;
 
 			kernel_filter_construct_gramian(x, y, 1,
-			                                dx, dy,
+			                                dx, dy, frame_offset,
 			                                stride,
 			                                pass_stride,
 			                                buffer,
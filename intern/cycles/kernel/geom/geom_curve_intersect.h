@@ -25,6 +25,39 @@ ccl_device_inline ssef transform_point_T3(const ssef t[3], const ssef &a)
 }
 #endif
 
+/* Subdivision depth needed to intersect the ribbon between u_st and u_en, between
+ * min_depth and max_depth. Ribbons are intersected against a chord of each leaf, which
+ * only has to stay close to the curve in ray space x-y. The inner control points of the
+ * bezier form of the range bound the distance between curve and chord, and each halving
+ * of the range reduces it by about four, so nearly straight ribbons need fewer levels. */
+ccl_device_inline int curve_ribbon_depth(const float3 *curve_coef,
+                                         float u_st,
+                                         float u_en,
+                                         float tolerance,
+                                         int min_depth,
+                                         int max_depth)
+{
+	const float h = (u_en - u_st) * (1.0f / 3.0f);
+	const float3 p_st = ((curve_coef[3] * u_st + curve_coef[2]) * u_st + curve_coef[1]) * u_st + curve_coef[0];
+	const float3 p_en = ((curve_coef[3] * u_en + curve_coef[2]) * u_en + curve_coef[1]) * u_en + curve_coef[0];
+	const float3 dp_st = (3 * curve_coef[3] * u_st + 2 * curve_coef[2]) * u_st + curve_coef[1];
+	const float3 dp_en = (3 * curve_coef[3] * u_en + 2 * curve_coef[2]) * u_en + curve_coef[1];
+
+	/* control points relative to the chord at 1/3 and 2/3 */
+	const float3 d1 = dp_st * h - (p_en - p_st) * (1.0f / 3.0f);
+	const float3 d2 = (p_en - p_st) * (1.0f / 3.0f) - dp_en * h;
+	float dist_sq = max(d1.x * d1.x + d1.y * d1.y, d2.x * d2.x + d2.y * d2.y);
+	const float tolerance_sq = tolerance * tolerance;
+
+	int depth = min_depth;
+	while(depth < max_depth && dist_sq > tolerance_sq) {
+		dist_sq *= 1.0f / 16.0f;
+		depth++;
+	}
+
+	return depth;
+}
+
 /* On CPU pass P and dir by reference to aligned vector. */
 ccl_device_forceinline bool cardinal_curve_intersect(
         KernelGlobals *kg,
@@ -236,14 +269,33 @@ ccl_device_forceinline bool cardinal_curve_intersect(
 	if(lower > r_ext || upper < -r_ext)
 		return false;
 
-	/* setup recurrent loop */
-	int level = 1 << depth;
-	int tree = 0;
-	float resol = 1.0f / (float)level;
+	/* setup recurrent loop, restricted to the part of the subdivision tree
+	 * covering the sub-segment referenced by this primitive. sub-segments finer
+	 * than the subdivision depth start at the node containing them, and leave
+	 * hits outside of their range to the neighboring sub-segments. */
+	const int sub_level = PRIMITIVE_UNPACK_SUBSEGMENT_LEVEL(type);
+	const int sub_index = PRIMITIVE_UNPACK_SUBSEGMENT_INDEX(type);
+	const float u_min = sub_index / (float)(1 << sub_level);
+	const float u_max = (sub_index + 1) / (float)(1 << sub_level);
+
+	const int tree_level = min(sub_level, depth);
+
+	/* ribbon fast path, nearly straight ribbons skip subdivision levels that
+	 * wouldn't bring the chords much closer to the curve than a fraction of its width */
+	if(flags & CURVE_KN_RIBBONS) {
+		const float node_st = (sub_index >> (sub_level - tree_level)) / (float)(1 << tree_level);
+		const float node_en = node_st + 1.0f / (float)(1 << tree_level);
+		depth = curve_ribbon_depth(curve_coef, node_st, node_en, 0.1f * r_curr, tree_level, depth);
+	}
+
+	int level = 1 << (depth - tree_level);
+	int tree = (sub_index >> (sub_level - tree_level)) * level;
+	const int tree_end = tree + level;
+	float resol = 1.0f / (float)(1 << depth);
 	bool hit = false;
 
 	/* begin loop */
-	while(!(tree >> (depth))) {
+	while(tree < tree_end) {
 		const float i_st = tree * resol;
 		const float i_en = i_st + (level * resol);
 
@@ -341,6 +393,11 @@ ccl_device_forceinline bool cardinal_curve_intersect(
 
 				/* compute u on the curve segment */
 				u = i_st * (1 - w) + i_en * w;
+				if(u < u_min || u > u_max) {
+					tree++;
+					level = tree & -tree;
+					continue;
+				}
 				r_curr = r_st + (r_en - r_st) * u;
 				/* compare x-y distances */
 				float3 p_curr = ((curve_coef[3] * u + curve_coef[2]) * u + curve_coef[1]) * u + curve_coef[0];
@@ -458,6 +515,11 @@ ccl_device_forceinline bool cardinal_curve_intersect(
 				w = saturate(w);
 				/* compute u on the curve segment */
 				u = i_st * (1 - w) + i_en * w;
+				if(u < u_min || u > u_max) {
+					tree++;
+					level = tree & -tree;
+					continue;
+				}
 
 				/* stochastic fade from minimum width */
 				if(difl != 0.0f && lcg_state) {
@@ -532,6 +594,11 @@ ccl_device_forceinline bool curve_intersect(KernelGlobals *kg,
 	/* curve Intersection check */
 	int flags = kernel_data.curve.curveflags;
 
+	/* part of the segment referenced by this primitive */
+	const float sub_scale = 1.0f / (float)(1 << PRIMITIVE_UNPACK_SUBSEGMENT_LEVEL(type));
+	const float u_min = PRIMITIVE_UNPACK_SUBSEGMENT_INDEX(type) * sub_scale;
+	const float u_max = u_min + sub_scale;
+
 	int prim = kernel_tex_fetch(__prim_index, curveAddr);
 	float4 v00 = kernel_tex_fetch(__curves, prim);
 
@@ -713,7 +780,9 @@ ccl_device_forceinline bool curve_intersect(KernelGlobals *kg,
 		}
 		/* --- */
 
-		if(t > 0.0f && t < isect->t && z >= 0 && z <= l) {
+		float u = z*invl;
+
+		if(t > 0.0f && t < isect->t && z >= 0 && z <= l && u >= u_min && u <= u_max) {
 
 			if(flags & CURVE_KN_ENCLOSEFILTER) {
 				float enc_ratio = 1.01f;
@@ -733,7 +802,7 @@ ccl_device_forceinline bool curve_intersect(KernelGlobals *kg,
 			{
 				/* record intersection */
 				isect->t = t;
-				isect->u = z*invl;
+				isect->u = u;
 				isect->v = gd;
 				isect->prim = curveAddr;
 				isect->object = object;
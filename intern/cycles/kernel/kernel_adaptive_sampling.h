@@ -0,0 +1,254 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __KERNEL_ADAPTIVE_SAMPLING_H__
+#define __KERNEL_ADAPTIVE_SAMPLING_H__
+
+CCL_NAMESPACE_BEGIN
+
+/* Adaptive Sampling
+ *
+ * Every odd sample is additionally accumulated into the auxiliary pass with
+ * double weight, which gives a second, independent estimate of the pixel
+ * from half of the samples. The difference between the two estimates is used
+ * as per-pixel error. Once it drops below the threshold the pixel is marked as
+ * converged by storing the number of samples it received in the fourth
+ * component of the auxiliary pass, and no more samples are taken for it.
+ *
+ * At the end of a tile all passes of converged pixels are scaled up as if they
+ * had been sampled with the full sample count, so that the film conversion and
+ * render result code can keep dividing by a single sample count. */
+
+ccl_device_inline ccl_global float *kernel_adaptive_pixel_buffer(KernelGlobals *kg,
+                                                                 ccl_global float *buffer,
+                                                                 int x, int y,
+                                                                 int offset, int stride)
+{
+	int index = offset + x + y*stride;
+	return buffer + index*kernel_data.film.pass_stride;
+}
+
+ccl_device_inline bool kernel_adaptive_sampling_need_check(KernelGlobals *kg, int sample)
+{
+	int num_samples = sample + 1;
+	return (num_samples >= kernel_data.integrator.adaptive_min_samples) &&
+	       (num_samples % kernel_data.integrator.adaptive_step == 0);
+}
+
+/* Returns the number of samples a converged pixel received, zero otherwise. */
+ccl_device_inline float kernel_adaptive_pixel_converged(KernelGlobals *kg, ccl_global float *buffer)
+{
+	return buffer[kernel_data.film.pass_adaptive_aux_buffer + 3];
+}
+
+/* Error estimate from section 2.1 of "A hierarchical automatic stopping
+ * condition for Monte Carlo global illumination", Dammertz et al. 2010.
+ * Both estimates are normalized to the sample count first so the threshold
+ * does not depend on how many samples were taken. */
+ccl_device void kernel_do_adaptive_stopping(KernelGlobals *kg, ccl_global float *buffer, int sample)
+{
+	ccl_global float *aux = buffer + kernel_data.film.pass_adaptive_aux_buffer;
+
+	if(aux[3] > 0.0f) {
+		return;
+	}
+
+	float num_samples = (float)(sample + 1);
+	float inv_samples = 1.0f/num_samples;
+	float3 I = max(make_float3(buffer[0], buffer[1], buffer[2])*inv_samples, make_float3(0.0f, 0.0f, 0.0f));
+	float3 A = max(make_float3(aux[0], aux[1], aux[2])*inv_samples, make_float3(0.0f, 0.0f, 0.0f));
+
+	float error = (fabsf(I.x - A.x) + fabsf(I.y - A.y) + fabsf(I.z - A.z)) /
+	              (1e-4f + sqrtf(I.x + I.y + I.z));
+
+	if(error < kernel_data.integrator.adaptive_threshold) {
+		aux[3] = num_samples;
+	}
+}
+
+/* Pixels that converged at this very check are sent back to sampling if one
+ * of their direct neighbors in the row or column did not converge yet. This
+ * avoids hard borders between converged and noisy regions. Pixels that
+ * converged at an earlier check have already stopped sampling and are left
+ * alone, since un-marking them would leave gaps in their sample sequence. */
+ccl_device bool kernel_do_adaptive_filter_x(KernelGlobals *kg,
+                                            ccl_global float *buffer,
+                                            int sample,
+                                            int y, int tile_x, int tile_w,
+                                            int offset, int stride)
+{
+	const float num_samples = (float)(sample + 1);
+	const int aux_offset = kernel_data.film.pass_adaptive_aux_buffer;
+	bool any = false;
+	bool prev = false;
+
+	for(int x = tile_x; x < tile_x + tile_w; x++) {
+		ccl_global float *aux = kernel_adaptive_pixel_buffer(kg, buffer, x, y, offset, stride) + aux_offset;
+
+		if(aux[3] == 0.0f) {
+			any = true;
+			if(x > tile_x && !prev) {
+				ccl_global float *aux_prev = aux - kernel_data.film.pass_stride;
+				if(aux_prev[3] == num_samples) {
+					aux_prev[3] = 0.0f;
+				}
+			}
+			prev = true;
+		}
+		else {
+			if(prev && aux[3] == num_samples) {
+				aux[3] = 0.0f;
+			}
+			prev = false;
+		}
+	}
+
+	return any;
+}
+
+ccl_device bool kernel_do_adaptive_filter_y(KernelGlobals *kg,
+                                            ccl_global float *buffer,
+                                            int sample,
+                                            int x, int tile_y, int tile_h,
+                                            int offset, int stride)
+{
+	const float num_samples = (float)(sample + 1);
+	const int aux_offset = kernel_data.film.pass_adaptive_aux_buffer;
+	bool any = false;
+	bool prev = false;
+
+	for(int y = tile_y; y < tile_y + tile_h; y++) {
+		ccl_global float *aux = kernel_adaptive_pixel_buffer(kg, buffer, x, y, offset, stride) + aux_offset;
+
+		if(aux[3] == 0.0f) {
+			any = true;
+			if(y > tile_y && !prev) {
+				ccl_global float *aux_prev = aux - stride*kernel_data.film.pass_stride;
+				if(aux_prev[3] == num_samples) {
+					aux_prev[3] = 0.0f;
+				}
+			}
+			prev = true;
+		}
+		else {
+			if(prev && aux[3] == num_samples) {
+				aux[3] = 0.0f;
+			}
+			prev = false;
+		}
+	}
+
+	return any;
+}
+
+ccl_device_inline void kernel_adaptive_scale_float(ccl_global float *buffer, int num, float scale)
+{
+	for(int i = 0; i < num; i++) {
+		buffer[i] *= scale;
+	}
+}
+
+/* Scale all accumulated passes of a converged pixel to the full sample count
+ * of the tile. Passes that are only written for the first sample (depth,
+ * object and material ID) and the sample count itself are left untouched. */
+ccl_device void kernel_adaptive_post_adjust(KernelGlobals *kg, ccl_global float *buffer, int num_samples)
+{
+	ccl_global float *aux = buffer + kernel_data.film.pass_adaptive_aux_buffer;
+	float converged_samples = aux[3];
+
+	if(converged_samples <= 0.0f || converged_samples >= (float)num_samples) {
+		return;
+	}
+
+	const float scale = (float)num_samples/converged_samples;
+
+	kernel_adaptive_scale_float(buffer + kernel_data.film.pass_combined, 4, scale);
+	kernel_adaptive_scale_float(aux, 3, scale);
+	aux[3] = (float)num_samples;
+
+#ifdef __PASSES__
+	int flag = kernel_data.film.pass_flag;
+	int light_flag = kernel_data.film.light_pass_flag;
+
+	if(flag & PASSMASK(NORMAL))
+		kernel_adaptive_scale_float(buffer + kernel_data.film.pass_normal, 3, scale);
+	if(flag & PASSMASK(UV))
+		kernel_adaptive_scale_float(buffer + kernel_data.film.pass_uv, 3, scale);
+	if(flag & PASSMASK(MOTION)) {
+		kernel_adaptive_scale_float(buffer + kernel_data.film.pass_motion, 4, scale);
+		kernel_adaptive_scale_float(buffer + kernel_data.film.pass_motion_weight, 1, scale);
+	}
+
+	if(kernel_data.film.use_light_pass) {
+		if(light_flag & PASSMASK(MIST))
+			kernel_adaptive_scale_float(buffer + kernel_data.film.pass_mist, 1, scale);
+		if(light_flag & PASSMASK(EMISSION))
+			kernel_adaptive_scale_float(buffer + kernel_data.film.pass_emission, 3, scale);
+		if(light_flag & PASSMASK(BACKGROUND))
+			kernel_adaptive_scale_float(buffer + kernel_data.film.pass_background, 3, scale);
+		if(light_flag & PASSMASK(AO))
+			kernel_adaptive_scale_float(buffer + kernel_data.film.pass_ao, 3, scale);
+		if(light_flag & PASSMASK(SHADOW))
+			kernel_adaptive_scale_float(buffer + kernel_data.film.pass_shadow, 4, scale);
+
+		if(light_flag & PASSMASK(DIFFUSE_DIRECT))
+			kernel_adaptive_scale_float(buffer + kernel_data.film.pass_diffuse_direct, 3, scale);
+		if(light_flag & PASSMASK(GLOSSY_DIRECT))
+			kernel_adaptive_scale_float(buffer + kernel_data.film.pass_glossy_direct, 3, scale);
+		if(light_flag & PASSMASK(TRANSMISSION_DIRECT))
+			kernel_adaptive_scale_float(buffer + kernel_data.film.pass_transmission_direct, 3, scale);
+		if(light_flag & PASSMASK(SUBSURFACE_DIRECT))
+			kernel_adaptive_scale_float(buffer + kernel_data.film.pass_subsurface_direct, 3, scale);
+		if(light_flag & PASSMASK(VOLUME_DIRECT))
+			kernel_adaptive_scale_float(buffer + kernel_data.film.pass_volume_direct, 3, scale);
+
+		if(light_flag & PASSMASK(DIFFUSE_INDIRECT))
+			kernel_adaptive_scale_float(buffer + kernel_data.film.pass_diffuse_indirect, 3, scale);
+		if(light_flag & PASSMASK(GLOSSY_INDIRECT))
+			kernel_adaptive_scale_float(buffer + kernel_data.film.pass_glossy_indirect, 3, scale);
+		if(light_flag & PASSMASK(TRANSMISSION_INDIRECT))
+			kernel_adaptive_scale_float(buffer + kernel_data.film.pass_transmission_indirect, 3, scale);
+		if(light_flag & PASSMASK(SUBSURFACE_INDIRECT))
+			kernel_adaptive_scale_float(buffer + kernel_data.film.pass_subsurface_indirect, 3, scale);
+		if(light_flag & PASSMASK(VOLUME_INDIRECT))
+			kernel_adaptive_scale_float(buffer + kernel_data.film.pass_volume_indirect, 3, scale);
+
+		if(light_flag & PASSMASK(DIFFUSE_COLOR))
+			kernel_adaptive_scale_float(buffer + kernel_data.film.pass_diffuse_color, 3, scale);
+		if(light_flag & PASSMASK(GLOSSY_COLOR))
+			kernel_adaptive_scale_float(buffer + kernel_data.film.pass_glossy_color, 3, scale);
+		if(light_flag & PASSMASK(TRANSMISSION_COLOR))
+			kernel_adaptive_scale_float(buffer + kernel_data.film.pass_transmission_color, 3, scale);
+		if(light_flag & PASSMASK(SUBSURFACE_COLOR))
+			kernel_adaptive_scale_float(buffer + kernel_data.film.pass_subsurface_color, 3, scale);
+	}
+#endif  /* __PASSES__ */
+
+#ifdef __DENOISING_FEATURES__
+	/* Sums of squares are scaled linearly as well, so the variance estimate
+	 * stays the one of the samples that were actually taken. */
+	if(kernel_data.film.pass_denoising_data) {
+		kernel_adaptive_scale_float(buffer + kernel_data.film.pass_denoising_data, DENOISING_PASS_SIZE_BASE, scale);
+		if(kernel_data.film.pass_denoising_clean) {
+			kernel_adaptive_scale_float(buffer + kernel_data.film.pass_denoising_clean, DENOISING_PASS_SIZE_CLEAN, scale);
+		}
+	}
+#endif  /* __DENOISING_FEATURES__ */
+}
+
+CCL_NAMESPACE_END
+
+#endif  /* __KERNEL_ADAPTIVE_SAMPLING_H__ */
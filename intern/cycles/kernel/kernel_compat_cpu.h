@@ -149,6 +149,10 @@ ccl_device_inline void print_sse3i(const char *label, sse3i& a)
 
 #endif
 
+#ifdef __KERNEL_AVX__
+typedef vector3<avxf> avx3f;
+#endif
+
 CCL_NAMESPACE_END
 
 #endif /* __KERNEL_COMPAT_CPU_H__ */
@@ -32,6 +32,21 @@ ccl_device float4 film_map(KernelGlobals *kg, float4 irradiance, float scale)
 	return result;
 }
 
+ccl_device_inline float film_get_scale(KernelGlobals *kg, ccl_global float *buffer, float sample_scale)
+{
+#ifdef __ADAPTIVE_SAMPLING__
+	/* Converged pixels stopped accumulating samples, so they are normalized
+	 * by their own sample count until the tile is finished. */
+	if(kernel_data.film.pass_adaptive_aux_buffer) {
+		float converged_samples = buffer[kernel_data.film.pass_adaptive_aux_buffer + 3];
+		if(converged_samples > 0.0f) {
+			return 1.0f/converged_samples;
+		}
+	}
+#endif
+	return sample_scale;
+}
+
 ccl_device uchar4 film_float_to_byte(float4 color)
 {
 	uchar4 result;
@@ -57,7 +72,7 @@ ccl_device void kernel_film_convert_to_byte(KernelGlobals *kg,
 
 	/* map colors */
 	float4 irradiance = *((ccl_global float4*)buffer);
-	float4 float_result = film_map(kg, irradiance, sample_scale);
+	float4 float_result = film_map(kg, irradiance, film_get_scale(kg, buffer, sample_scale));
 	uchar4 byte_result = film_float_to_byte(float_result);
 
 	*rgba = byte_result;
@@ -70,7 +85,9 @@ ccl_device void kernel_film_convert_to_half_float(KernelGlobals *kg,
 	/* buffer offset */
 	int index = offset + x + y*stride;
 
-	ccl_global float4 *in = (ccl_global float4*)(buffer + index*kernel_data.film.pass_stride);
+	buffer += index*kernel_data.film.pass_stride;
+
+	ccl_global float4 *in = (ccl_global float4*)buffer;
 	ccl_global half *out = (ccl_global half*)rgba + index*4;
 
 	float exposure = kernel_data.film.exposure;
@@ -83,7 +100,7 @@ ccl_device void kernel_film_convert_to_half_float(KernelGlobals *kg,
 		rgba_in.z *= exposure;
 	}
 
-	float4_store_half(out, rgba_in, sample_scale);
+	float4_store_half(out, rgba_in, film_get_scale(kg, buffer, sample_scale));
 }
 
 CCL_NAMESPACE_END
@@ -19,6 +19,8 @@
 #ifndef __KERNEL_GLOBALS_H__
 #define __KERNEL_GLOBALS_H__
 
+#include "kernel/kernel_profiling.h"
+
 #ifdef __KERNEL_CPU__
 #  include "util/util_vector.h"
 #endif
@@ -44,6 +46,7 @@ struct OSLShadingSystem;
 
 struct Intersection;
 struct VolumeStep;
+struct OIIOGlobals;
 
 typedef struct KernelGlobals {
 #  define KERNEL_TEX(type, name) texture<type> name;
@@ -59,6 +62,11 @@ typedef struct KernelGlobals {
 	OSLThreadData *osl_tdata;
 #  endif
 
+	/* Texture cache, the thread data is the OIIO::TextureSystem::Perthread
+	 * of the thread the globals are used on. */
+	OIIOGlobals *oiio;
+	void *oiio_tdata;
+
 	/* **** Run-time data ****  */
 
 	/* Heap-allocated storage for transparent shadows intersections. */
@@ -68,14 +76,33 @@ typedef struct KernelGlobals {
 	VolumeStep *decoupled_volume_steps[2];
 	int decoupled_volume_steps_index;
 
+	/* Radiance samples recorded for path guiding, collected by the device
+	 * after every sample. */
+	GuidingSample *guiding_samples;
+	int num_guiding_samples;
+	int max_guiding_samples;
+
 	/* split kernel */
 	SplitData split_data;
 	SplitParams split_param_data;
 
 	int2 global_size;
 	int2 global_id;
+
+	/* State of the render thread for the profiler. */
+	ProfilingState profiler;
 } KernelGlobals;
 
+/* The basic and full kernels are compiled with different features but use the
+ * same KernelGlobals allocated by the device, so its layout must not depend on
+ * them. Checked against a constant shared by all kernels, since every member
+ * after split_data would be at a different offset otherwise. */
+static_assert(sizeof(SplitData) == SPLIT_DATA_CPU_NUM_POINTERS * sizeof(void*),
+              "SplitData must have the same layout in all CPU kernels");
+static_assert(offsetof(KernelGlobals, split_param_data) ==
+              offsetof(KernelGlobals, split_data) + SPLIT_DATA_CPU_NUM_POINTERS * sizeof(void*),
+              "KernelGlobals must have the same layout in all CPU kernels");
+
 #endif  /* __KERNEL_CPU__ */
 
 /* For CUDA, constant memory textures must be globals, so we can't put them
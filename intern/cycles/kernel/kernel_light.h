@@ -457,6 +457,219 @@ ccl_device float background_light_pdf(KernelGlobals *kg, float3 P, float3 direct
 }
 #endif
 
+/* Light Distribution */
+
+/* Sample an entry of the distribution in [first, first + num) proportional to
+ * its area, randu is rescaled to be reused for sampling the light itself. */
+ccl_device int light_distribution_sample_range(KernelGlobals *kg, int first, int num, float *randu)
+{
+	/* This is basically std::upper_bound as used by pbrt, to find a point light or
+	 * triangle to emit from, proportional to area. a good improvement would be to
+	 * also sample proportional to power, though it's not so well defined with
+	 * arbitrary shaders. */
+	const int begin = first;
+	float range_min = kernel_tex_fetch(__light_distribution, begin).x;
+	float range_max = kernel_tex_fetch(__light_distribution, begin + num).x;
+	int len = num + 1;
+	float r = range_min + (*randu)*(range_max - range_min);
+
+	while(len > 0) {
+		int half_len = len >> 1;
+		int middle = first + half_len;
+
+		if(r < kernel_tex_fetch(__light_distribution, middle).x) {
+			len = half_len;
+		}
+		else {
+			first = middle + 1;
+			len = len - half_len - 1;
+		}
+	}
+
+	/* Clamping should not be needed but float rounding errors seem to
+	 * make this fail on rare occasions. */
+	int index = clamp(first-1, begin, begin + num - 1);
+
+	/* Rescale to reuse random number. this helps the 2D samples within
+	 * each area light be stratified as well. */
+	float distr_min = kernel_tex_fetch(__light_distribution, index).x;
+	float distr_max = kernel_tex_fetch(__light_distribution, index+1).x;
+	*randu = (r - distr_min)/(distr_max - distr_min);
+
+	return index;
+}
+
+ccl_device int light_distribution_sample(KernelGlobals *kg, float *randu)
+{
+	return light_distribution_sample_range(kg, 0, kernel_data.integrator.num_distribution, randu);
+}
+
+/* Light Tree
+ *
+ * Emitters with a position are stored in a binary tree, each node covering a
+ * contiguous range of the distribution. Traversal picks a child with
+ * probability proportional to its estimated contribution to the shading
+ * point, computed from the node energy, bounding box and orientation cone.
+ * Distant and background lights are kept out of the tree and are picked with
+ * the same probability as in the flat distribution.
+ *
+ * Probabilities are returned as a factor relative to the flat distribution,
+ * so the existing pdfs based on pdf_lights and pdf_triangles only need to be
+ * multiplied by it. */
+
+ccl_device float light_tree_node_importance(KernelGlobals *kg, int node, float3 P)
+{
+	float4 data0 = kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE + 0);
+	float4 data1 = kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE + 1);
+	float4 data2 = kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE + 2);
+
+	float energy = data0.w;
+	if(energy == 0.0f) {
+		return 0.0f;
+	}
+
+	float3 bbox_min = make_float3(data0.x, data0.y, data0.z);
+	float3 bbox_max = make_float3(data1.x, data1.y, data1.z);
+	float3 axis = make_float3(data2.x, data2.y, data2.z);
+	float theta_o = data1.w;
+	float theta_e = data2.w;
+
+	float3 centroid = 0.5f*(bbox_min + bbox_max);
+	float radius_squared = 0.25f*len_squared(bbox_max - bbox_min);
+	float distance;
+	float3 D = normalize_len(P - centroid, &distance);
+	float distance_squared = distance*distance;
+
+	/* Conservative bound on the angle between the emitter normals and the
+	 * direction towards P, no light is emitted beyond theta_e. */
+	float cos_theta = 1.0f;
+	if(theta_o < M_PI_F && distance_squared > radius_squared) {
+		float theta = safe_acosf(dot(axis, D));
+		float theta_u = safe_asinf(sqrtf(radius_squared/distance_squared));
+		float theta_prime = max(theta - theta_o - theta_u, 0.0f);
+
+		if(theta_prime > theta_e) {
+			return 0.0f;
+		}
+		cos_theta = cosf(theta_prime);
+	}
+
+	return energy*cos_theta/max(distance_squared, max(radius_squared, 1e-8f));
+}
+
+ccl_device_inline int light_tree_lamp_emitter(KernelGlobals *kg, int lamp)
+{
+	return (int)kernel_tex_fetch(__light_tree_emitters, lamp);
+}
+
+ccl_device_inline int light_tree_triangle_emitter(KernelGlobals *kg, int object, int prim)
+{
+	int offset = (int)kernel_tex_fetch(__light_tree_emitters, kernel_data.integrator.num_all_lights + object);
+	return (int)kernel_tex_fetch(__light_tree_emitters, offset + prim);
+}
+
+ccl_device int light_tree_sample(KernelGlobals *kg, float3 P, float *randu, float *pdf_factor)
+{
+	float pdf_tree = kernel_data.integrator.pdf_light_tree;
+	int num_tree = __float_as_int(kernel_tex_fetch(__light_tree_nodes, 3).y);
+	float r = *randu;
+
+	/* Rounding can leave a tiny probability for an empty range outside the tree. */
+	if(r >= pdf_tree && num_tree < kernel_data.integrator.num_distribution) {
+		*randu = (r - pdf_tree)/(1.0f - pdf_tree);
+		*pdf_factor = 1.0f;
+		return light_distribution_sample_range(kg,
+		                                       num_tree,
+		                                       kernel_data.integrator.num_distribution - num_tree,
+		                                       randu);
+	}
+
+	r = min(r/pdf_tree, 1.0f - 1e-6f);
+
+	int node = 0;
+	float pdf = pdf_tree;
+
+	for(;;) {
+		float4 data3 = kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE + 3);
+		int right_child = __float_as_int(data3.z);
+
+		if(right_child == -1) {
+			int first = __float_as_int(data3.x);
+			int num = __float_as_int(data3.y);
+			float mass = kernel_tex_fetch(__light_distribution, first + num).x -
+			             kernel_tex_fetch(__light_distribution, first).x;
+
+			*randu = r;
+			*pdf_factor = pdf/mass;
+			return light_distribution_sample_range(kg, first, num, randu);
+		}
+
+		float importance_left = light_tree_node_importance(kg, node + 1, P);
+		float importance_right = light_tree_node_importance(kg, right_child, P);
+		float importance_total = importance_left + importance_right;
+
+		if(importance_total == 0.0f) {
+			return -1;
+		}
+
+		float prob_left = importance_left/importance_total;
+
+		if(r < prob_left) {
+			r = r/prob_left;
+			pdf *= prob_left;
+			node = node + 1;
+		}
+		else {
+			r = (r - prob_left)/(1.0f - prob_left);
+			pdf *= 1.0f - prob_left;
+			node = right_child;
+		}
+	}
+}
+
+ccl_device float light_tree_pdf(KernelGlobals *kg, float3 P, int index)
+{
+	int node = 0;
+	float pdf = kernel_data.integrator.pdf_light_tree;
+
+	if(index < 0 || index >= __float_as_int(kernel_tex_fetch(__light_tree_nodes, 3).y)) {
+		return 0.0f;
+	}
+
+	for(;;) {
+		float4 data3 = kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE + 3);
+		int right_child = __float_as_int(data3.z);
+
+		if(right_child == -1) {
+			int first = __float_as_int(data3.x);
+			int num = __float_as_int(data3.y);
+			float mass = kernel_tex_fetch(__light_distribution, first + num).x -
+			             kernel_tex_fetch(__light_distribution, first).x;
+
+			return pdf/mass;
+		}
+
+		float importance_left = light_tree_node_importance(kg, node + 1, P);
+		float importance_right = light_tree_node_importance(kg, right_child, P);
+		float importance_total = importance_left + importance_right;
+
+		if(importance_total == 0.0f) {
+			return 0.0f;
+		}
+
+		int right_first = __float_as_int(kernel_tex_fetch(__light_tree_nodes, right_child*LIGHT_TREE_NODE_SIZE + 3).x);
+
+		if(index < right_first) {
+			pdf *= importance_left/importance_total;
+			node = node + 1;
+		}
+		else {
+			pdf *= importance_right/importance_total;
+			node = right_child;
+		}
+	}
+}
+
 /* Regular Light */
 
 ccl_device float3 disk_light_sample(float3 v, float randu, float randv)
@@ -762,6 +975,10 @@ ccl_device bool lamp_light_eval(KernelGlobals *kg, int lamp, float3 P, float3 D,
 
 	ls->pdf *= kernel_data.integrator.pdf_lights;
 
+	if(kernel_data.integrator.use_light_tree && type != LIGHT_DISTANT) {
+		ls->pdf *= light_tree_pdf(kg, P, light_tree_lamp_emitter(kg, lamp));
+	}
+
 	return true;
 }
 
@@ -814,6 +1031,15 @@ ccl_device_forceinline float triangle_light_pdf(KernelGlobals *kg, ShaderData *s
 	 * and simple area sampling, comparing the distance to the triangle plane
 	 * to the length of the edges of the triangle. */
 
+	float pdf_factor = 1.0f;
+	if(kernel_data.integrator.use_light_tree) {
+		const float3 Px = sd->P + sd->I * t;
+		pdf_factor = light_tree_pdf(kg, Px, light_tree_triangle_emitter(kg, sd->object, sd->prim));
+		if(pdf_factor == 0.0f) {
+			return 0.0f;
+		}
+	}
+
 	float3 V[3];
 	bool has_motion = triangle_world_space_vertices(kg, sd->object, sd->prim, sd->time, V);
 
@@ -856,7 +1082,7 @@ ccl_device_forceinline float triangle_light_pdf(KernelGlobals *kg, ShaderData *s
 				area = 0.5f * len(N);
 			}
 			const float pdf = area * kernel_data.integrator.pdf_triangles;
-			return pdf / solid_angle;
+			return pdf_factor * pdf / solid_angle;
 		}
 	}
 	else {
@@ -873,7 +1099,7 @@ ccl_device_forceinline float triangle_light_pdf(KernelGlobals *kg, ShaderData *s
 			const float area_pre = triangle_area(V[0], V[1], V[2]);
 			pdf = pdf * area_pre / area;
 		}
-		return pdf;
+		return pdf_factor * pdf;
 	}
 }
 
@@ -1024,44 +1250,6 @@ ccl_device_forceinline void triangle_light_sample(KernelGlobals *kg, int prim, i
 	}
 }
 
-/* Light Distribution */
-
-ccl_device int light_distribution_sample(KernelGlobals *kg, float *randu)
-{
-	/* This is basically std::upper_bound as used by pbrt, to find a point light or
-	 * triangle to emit from, proportional to area. a good improvement would be to
-	 * also sample proportional to power, though it's not so well defined with
-	 * arbitrary shaders. */
-	int first = 0;
-	int len = kernel_data.integrator.num_distribution + 1;
-	float r = *randu;
-
-	while(len > 0) {
-		int half_len = len >> 1;
-		int middle = first + half_len;
-
-		if(r < kernel_tex_fetch(__light_distribution, middle).x) {
-			len = half_len;
-		}
-		else {
-			first = middle + 1;
-			len = len - half_len - 1;
-		}
-	}
-
-	/* Clamping should not be needed but float rounding errors seem to
-	 * make this fail on rare occasions. */
-	int index = clamp(first-1, 0, kernel_data.integrator.num_distribution-1);
-
-	/* Rescale to reuse random number. this helps the 2D samples within
-	 * each area light be stratified as well. */
-	float distr_min = kernel_tex_fetch(__light_distribution, index).x;
-	float distr_max = kernel_tex_fetch(__light_distribution, index+1).x;
-	*randu = (r - distr_min)/(distr_max - distr_min);
-
-	return index;
-}
-
 /* Generic Light */
 
 ccl_device bool light_select_reached_max_bounces(KernelGlobals *kg, int index, int bounce)
@@ -1078,8 +1266,21 @@ ccl_device_noinline bool light_sample(KernelGlobals *kg,
                                       int bounce,
                                       LightSample *ls)
 {
+	PROFILING_INIT(kg, PROFILING_LIGHT_SAMPLE);
+
 	/* sample index */
-	int index = light_distribution_sample(kg, &randu);
+	int index;
+	float pdf_factor = 1.0f;
+
+	if(kernel_data.integrator.use_light_tree) {
+		index = light_tree_sample(kg, P, &randu, &pdf_factor);
+		if(index == -1) {
+			return false;
+		}
+	}
+	else {
+		index = light_distribution_sample(kg, &randu);
+	}
 
 	/* fetch light data */
 	float4 l = kernel_tex_fetch(__light_distribution, index);
@@ -1091,6 +1292,7 @@ ccl_device_noinline bool light_sample(KernelGlobals *kg,
 
 		triangle_light_sample(kg, prim, object, randu, randv, time, ls, P);
 		ls->shader |= shader_flag;
+		ls->pdf *= pdf_factor;
 		return (ls->pdf > 0.0f);
 	}
 	else {
@@ -1100,7 +1302,9 @@ ccl_device_noinline bool light_sample(KernelGlobals *kg,
 			return false;
 		}
 
-		return lamp_light_sample(kg, lamp, randu, randv, P, ls);
+		bool result = lamp_light_sample(kg, lamp, randu, randv, P, ls);
+		ls->pdf *= pdf_factor;
+		return result;
 	}
 }
 
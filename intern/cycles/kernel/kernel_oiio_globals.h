@@ -0,0 +1,57 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __KERNEL_OIIO_GLOBALS_H__
+#define __KERNEL_OIIO_GLOBALS_H__
+
+#include <OpenImageIO/texture.h>
+
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Texture Cache
+ *
+ * On the CPU, tiled and mipmapped image files can be read on demand through
+ * OpenImageIO's TextureSystem instead of being loaded into memory in full.
+ * The TextureSystem keeps a bounded pool of tiles and picks the mip level
+ * from the lookup derivatives. */
+
+struct OIIOTexture {
+	OIIOTexture()
+	: handle(NULL), channels(0), use_alpha(true),
+	  interpolation(0), extension(0) {}
+
+	OIIO::TextureSystem::TextureHandle *handle;
+	/* Number of channels in the file. */
+	int channels;
+	bool use_alpha;
+	uint interpolation, extension;
+};
+
+struct OIIOGlobals {
+	OIIOGlobals() : tex_sys(NULL) {}
+
+	OIIO::TextureSystem *tex_sys;
+
+	/* Indexed by flat image slot, the handle is NULL for images that are
+	 * loaded into memory. */
+	vector<OIIOTexture> textures;
+};
+
+CCL_NAMESPACE_END
+
+#endif  /* __KERNEL_OIIO_GLOBALS_H__ */
@@ -332,11 +332,31 @@ ccl_device_inline void kernel_write_light_passes(KernelGlobals *kg, ccl_global f
 #endif
 }
 
+#ifdef __ADAPTIVE_SAMPLING__
+ccl_device_inline void kernel_write_adaptive_sampling(KernelGlobals *kg,
+                                                      ccl_global float *buffer,
+                                                      int sample,
+                                                      float3 L_sum)
+{
+	/* Odd samples are accumulated a second time with double weight, which
+	 * gives the independent half-sample estimate used for convergence tests. */
+	if(kernel_data.film.pass_adaptive_aux_buffer && (sample & 1)) {
+		kernel_write_pass_float3(buffer + kernel_data.film.pass_adaptive_aux_buffer,
+		                         L_sum*2.0f);
+	}
+	if(kernel_data.film.pass_sample_count) {
+		kernel_write_pass_float(buffer + kernel_data.film.pass_sample_count, 1.0f);
+	}
+}
+#endif  /* __ADAPTIVE_SAMPLING__ */
+
 ccl_device_inline void kernel_write_result(KernelGlobals *kg,
                                            ccl_global float *buffer,
                                            int sample,
                                            PathRadiance *L)
 {
+	PROFILING_INIT(kg, PROFILING_WRITE_RESULT);
+
 	float alpha;
 	float3 L_sum = path_radiance_clamp_and_sum(kg, L, &alpha);
 
@@ -344,6 +364,10 @@ ccl_device_inline void kernel_write_result(KernelGlobals *kg,
 
 	kernel_write_light_passes(kg, buffer, L);
 
+#ifdef __ADAPTIVE_SAMPLING__
+	kernel_write_adaptive_sampling(kg, buffer, sample, L_sum);
+#endif
+
 #ifdef __DENOISING_FEATURES__
 	if(kernel_data.film.pass_denoising_data) {
 #  ifdef __SHADOW_TRICKS__
@@ -44,10 +44,13 @@
 #include "kernel/kernel_shadow.h"
 #include "kernel/kernel_emission.h"
 #include "kernel/kernel_path_common.h"
+#include "kernel/kernel_path_guiding.h"
 #include "kernel/kernel_path_surface.h"
 #include "kernel/kernel_path_volume.h"
 #include "kernel/kernel_path_subsurface.h"
 
+#include "kernel/kernel_adaptive_sampling.h"
+
 CCL_NAMESPACE_BEGIN
 
 ccl_device_forceinline bool kernel_path_scene_intersect(
@@ -57,6 +60,8 @@ ccl_device_forceinline bool kernel_path_scene_intersect(
 	Intersection *isect,
 	PathRadiance *L)
 {
+	PROFILING_INIT(kg, PROFILING_SCENE_INTERSECT);
+
 	uint visibility = path_state_ray_visibility(kg, state);
 
 	if(path_state_ao_bounce(kg, state)) {
@@ -96,6 +101,29 @@ ccl_device_forceinline bool kernel_path_scene_intersect(
 	return hit;
 }
 
+#ifdef __RAY_STREAM__
+/* Same as above for camera rays which were already intersected as part of a
+ * ray stream. */
+ccl_device_forceinline bool kernel_path_stream_intersect_result(
+	KernelGlobals *kg,
+	ccl_addr_space PathState *state,
+	const Intersection *first_isect,
+	Intersection *isect,
+	PathRadiance *L)
+{
+	*isect = *first_isect;
+
+#ifdef __KERNEL_DEBUG__
+	L->debug_data.num_bvh_traversed_nodes += isect->num_traversed_nodes;
+	L->debug_data.num_bvh_traversed_instances += isect->num_traversed_instances;
+	L->debug_data.num_bvh_intersections += isect->num_intersections;
+	L->debug_data.num_ray_bounces++;
+#endif  /* __KERNEL_DEBUG__ */
+
+	return (isect->prim != PRIM_NONE);
+}
+#endif  /* __RAY_STREAM__ */
+
 ccl_device_forceinline void kernel_path_lamp_emission(
 	KernelGlobals *kg,
 	ccl_addr_space PathState *state,
@@ -105,6 +133,8 @@ ccl_device_forceinline void kernel_path_lamp_emission(
 	ShaderData *emission_sd,
 	PathRadiance *L)
 {
+	PROFILING_INIT(kg, PROFILING_INDIRECT_EMISSION);
+
 #ifdef __LAMP_MIS__
 	if(kernel_data.integrator.use_lamp_mis && !(state->flag & PATH_RAY_CAMERA)) {
 		/* ray starting from previous non-transparent bounce */
@@ -135,6 +165,8 @@ ccl_device_forceinline void kernel_path_background(
 	ShaderData *sd,
 	PathRadiance *L)
 {
+	PROFILING_INIT(kg, PROFILING_INDIRECT_EMISSION);
+
 	/* eval background shader if nothing hit */
 	if(kernel_data.background.transparent && (state->flag & PATH_RAY_TRANSPARENT_BACKGROUND)) {
 		L->transparent += average(throughput);
@@ -172,6 +204,8 @@ ccl_device_forceinline VolumeIntegrateResult kernel_path_volume(
 	ShaderData *emission_sd,
 	PathRadiance *L)
 {
+	PROFILING_INIT(kg, PROFILING_VOLUME);
+
 	/* Sanitize volume stack. */
 	if(!hit) {
 		kernel_volume_clean_stack(kg, state->volume_stack);
@@ -278,6 +312,8 @@ ccl_device_forceinline bool kernel_path_shader_apply(
 	PathRadiance *L,
 	ccl_global float *buffer)
 {
+	PROFILING_INIT(kg, PROFILING_SHADER_APPLY);
+
 #ifdef __SHADOW_TRICKS__
 	if((sd->object_flag & SD_OBJECT_SHADOW_CATCHER)) {
 		if(state->flag & PATH_RAY_TRANSPARENT_BACKGROUND) {
@@ -355,6 +391,8 @@ ccl_device_noinline void kernel_path_ao(KernelGlobals *kg,
                                         float3 throughput,
                                         float3 ao_alpha)
 {
+	PROFILING_INIT(kg, PROFILING_AO);
+
 	/* todo: solve correlation */
 	float bsdf_u, bsdf_v;
 
@@ -541,11 +579,19 @@ ccl_device_forceinline void kernel_path_integrate(
 	Ray *ray,
 	PathRadiance *L,
 	ccl_global float *buffer,
-	ShaderData *emission_sd)
+	ShaderData *emission_sd,
+	const Intersection *first_isect)
 {
+	PROFILING_INIT(kg, PROFILING_PATH_INTEGRATE);
+
 	/* Shader data memory used for both volumes and surfaces, saves stack space. */
 	ShaderData sd;
 
+#ifdef __PATH_GUIDING__
+	GuidingPathState guiding_state;
+	kernel_path_guiding_init(&guiding_state);
+#endif  /* __PATH_GUIDING__ */
+
 #ifdef __SUBSURFACE__
 	SubsurfaceIndirectRays ss_indirect;
 	kernel_path_subsurface_init_indirect(&ss_indirect);
@@ -557,7 +603,19 @@ ccl_device_forceinline void kernel_path_integrate(
 	for(;;) {
 		/* Find intersection with objects in scene. */
 		Intersection isect;
-		bool hit = kernel_path_scene_intersect(kg, state, ray, &isect, L);
+		bool hit;
+
+#ifdef __RAY_STREAM__
+		if(first_isect != NULL) {
+			/* Camera ray was traced as part of a stream already. */
+			hit = kernel_path_stream_intersect_result(kg, state, first_isect, &isect, L);
+			first_isect = NULL;
+		}
+		else
+#endif  /* __RAY_STREAM__ */
+		{
+			hit = kernel_path_scene_intersect(kg, state, ray, &isect, L);
+		}
 
 		/* Find intersection with lamps and compute emission for MIS. */
 		kernel_path_lamp_emission(kg, state, ray, throughput, &isect, &sd, L);
@@ -655,11 +713,29 @@ ccl_device_forceinline void kernel_path_integrate(
 		/* direct lighting */
 		kernel_path_surface_connect_light(kg, &sd, emission_sd, throughput, state, L);
 
+#ifdef __PATH_GUIDING__
+		const int guiding_bounce = state->bounce;
+#endif  /* __PATH_GUIDING__ */
+
 		/* compute direct lighting and next bounce */
 		if(!kernel_path_surface_bounce(kg, &sd, &throughput, state, &L->state, ray))
 			break;
+
+#ifdef __PATH_GUIDING__
+		/* Transparent bounces keep the direction and singular ones can't be
+		 * guided, neither is worth learning from. */
+		if(state->bounce != guiding_bounce && !(state->flag & PATH_RAY_SINGULAR)) {
+			kernel_path_guiding_add_vertex(kg, &guiding_state, &sd, ray, throughput, state->ray_pdf, L);
+		}
+#endif  /* __PATH_GUIDING__ */
 	}
 
+#ifdef __PATH_GUIDING__
+	/* Subsurface indirect rays start new vertices, their light is not
+	 * attributed to the ones of the path so far. */
+	kernel_path_guiding_record(kg, &guiding_state, L);
+#endif  /* __PATH_GUIDING__ */
+
 #ifdef __SUBSURFACE__
 		/* Trace indirect subsurface rays by restarting the loop. this uses less
 		 * stack memory than invoking kernel_path_indirect.
@@ -683,6 +759,8 @@ ccl_device void kernel_path_trace(KernelGlobals *kg,
 	ccl_global float *buffer,
 	int sample, int x, int y, int offset, int stride)
 {
+	PROFILING_INIT(kg, PROFILING_RAY_SETUP);
+
 	/* buffer offset */
 	int index = offset + x + y*stride;
 	int pass_stride = kernel_data.film.pass_stride;
@@ -718,11 +796,95 @@ ccl_device void kernel_path_trace(KernelGlobals *kg,
 	                      &ray,
 	                      &L,
 	                      buffer,
-	                      emission_sd);
+	                      emission_sd,
+	                      NULL);
 
 	kernel_write_result(kg, buffer, sample, &L);
 }
 
+/* Path trace a block of up to RAY_STREAM_SIZE pixels. The camera rays of all
+ * pixels are traversed through the BVH together, after which every path is
+ * shaded and continued on its own. Pixels that converged with adaptive
+ * sampling are skipped. */
+ccl_device void kernel_path_trace_stream(KernelGlobals *kg,
+	ccl_global float *buffer,
+	int sample, int x, int y, int w, int h, int offset, int stride)
+{
+	PROFILING_INIT(kg, PROFILING_RAY_SETUP);
+
+	kernel_assert(w*h <= RAY_STREAM_SIZE);
+
+	const bool use_adaptive_sampling = (kernel_data.film.pass_adaptive_aux_buffer != 0);
+	const int pass_stride = kernel_data.film.pass_stride;
+
+	ShaderDataTinyStorage emission_sd_storage;
+	ShaderData *emission_sd = AS_SHADER_DATA(&emission_sd_storage);
+
+	/* Queue of paths in the stream. */
+	ccl_global float *queue_buffer[RAY_STREAM_SIZE];
+	PathState queue_state[RAY_STREAM_SIZE];
+	Ray queue_ray[RAY_STREAM_SIZE];
+	Intersection queue_isect[RAY_STREAM_SIZE];
+	int num_queued = 0;
+
+	for(int py = y; py < y + h; py++) {
+		for(int px = x; px < x + w; px++) {
+			ccl_global float *pixel_buffer = buffer + (offset + px + py*stride)*pass_stride;
+
+			if(use_adaptive_sampling && kernel_adaptive_pixel_converged(kg, pixel_buffer) > 0.0f) {
+				continue;
+			}
+
+			/* Initialize random numbers and sample ray. */
+			uint rng_hash;
+			Ray *ray = &queue_ray[num_queued];
+
+			kernel_path_trace_setup(kg, sample, px, py, &rng_hash, ray);
+
+			if(ray->t == 0.0f) {
+				continue;
+			}
+
+			path_state_init(kg, emission_sd, &queue_state[num_queued], rng_hash, sample, ray);
+			queue_buffer[num_queued] = pixel_buffer;
+			num_queued++;
+		}
+	}
+
+	if(num_queued == 0) {
+		return;
+	}
+
+#ifdef __RAY_STREAM__
+	/* All camera rays start with the same visibility. */
+	const bool use_stream = bvh_stream_supported(kg);
+	if(use_stream) {
+		const uint visibility = path_state_ray_visibility(kg, &queue_state[0]);
+		bvh_intersect_stream(kg, queue_ray, queue_isect, num_queued, visibility);
+	}
+#else
+	const bool use_stream = false;
+#endif
+
+	for(int i = 0; i < num_queued; i++) {
+		float3 throughput = make_float3(1.0f, 1.0f, 1.0f);
+
+		PathRadiance L;
+		path_radiance_init(&L, kernel_data.film.use_light_pass);
+
+		kernel_path_integrate(kg,
+		                      &queue_state[i],
+		                      throughput,
+		                      &queue_ray[i],
+		                      &L,
+		                      queue_buffer[i],
+		                      emission_sd,
+		                      (use_stream)? &queue_isect[i]: NULL);
+
+		kernel_write_result(kg, queue_buffer[i], sample, &L);
+	}
+}
+
 #endif  /* __SPLIT_KERNEL__ */
 
 CCL_NAMESPACE_END
@@ -0,0 +1,204 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+CCL_NAMESPACE_BEGIN
+
+/* Path Guiding
+ *
+ * The incident radiance learned during the first passes is stored as a
+ * spatial binary tree over the scene bounds, with a directional quadtree in
+ * every leaf (see render/guiding.h for the layout, and
+ * kernel_path_guiding_tree.h for the lookups). Bounce directions are
+ * sampled from a mixture of this distribution and the BSDF, so regions the
+ * BSDF rarely samples but that carry most of the light are found quickly,
+ * while the result stays unbiased. */
+
+#ifdef __PATH_GUIDING__
+
+/* Label of a guided direction. The bounce limits count it as the type of
+ * the closure with the highest sample weight. */
+ccl_device_inline int guiding_label(ShaderData *sd, float3 omega_in)
+{
+	int label = (dot(sd->Ng, omega_in) < 0.0f)? LABEL_TRANSMIT: LABEL_REFLECT;
+
+	const ShaderClosure *main_sc = NULL;
+	for(int i = 0; i < sd->num_closure; i++) {
+		const ShaderClosure *sc = &sd->closure[i];
+
+		if(CLOSURE_IS_BSDF(sc->type) &&
+		   (main_sc == NULL || sc->sample_weight > main_sc->sample_weight))
+		{
+			main_sc = sc;
+		}
+	}
+
+	if(main_sc != NULL &&
+	   (CLOSURE_IS_BSDF_DIFFUSE(main_sc->type) || main_sc->type == CLOSURE_BSDF_TRANSLUCENT_ID))
+	{
+		label |= LABEL_DIFFUSE;
+	}
+	else {
+		label |= LABEL_GLOSSY;
+	}
+
+	return label;
+}
+
+/* Sample a bounce direction from the mixture of the guiding distribution
+ * and the BSDF. This is one-sample MIS with the balance heuristic, so the
+ * pdf is the one of the mixture. Singular directions can only come from the
+ * BSDF, only its probability of being picked applies to them. */
+ccl_device int kernel_path_guiding_bsdf_sample(KernelGlobals *kg,
+                                               ShaderData *sd,
+                                               float randu, float randv,
+                                               BsdfEval *bsdf_eval,
+                                               float3 *omega_in,
+                                               differential3 *domega_in,
+                                               float *pdf)
+{
+	const float fraction = kernel_data.integrator.guiding_fraction;
+
+	if(randu < fraction) {
+		const int root = guiding_find_dtree(kg, sd->P);
+		float guide_pdf;
+		*omega_in = guiding_dtree_sample(kg, root, randu/fraction, randv, &guide_pdf);
+		*domega_in = differential3_zero();
+
+		float bsdf_pdf = 0.0f;
+		bsdf_eval_init(bsdf_eval, NBUILTIN_CLOSURES, make_float3(0.0f, 0.0f, 0.0f), kernel_data.film.use_light_pass);
+		_shader_bsdf_multi_eval(kg, sd, *omega_in, &bsdf_pdf, NULL, bsdf_eval, 0.0f, 0.0f);
+
+		if(bsdf_pdf == 0.0f) {
+			*pdf = 0.0f;
+			return LABEL_NONE;
+		}
+
+		*pdf = fraction*guide_pdf + (1.0f - fraction)*bsdf_pdf;
+		return guiding_label(sd, *omega_in);
+	}
+
+	randu = (randu - fraction)/(1.0f - fraction);
+	int label = shader_bsdf_sample(kg, sd, randu, randv, bsdf_eval, omega_in, domega_in, pdf);
+
+	if(*pdf != 0.0f) {
+		if(label & LABEL_SINGULAR) {
+			*pdf *= 1.0f - fraction;
+		}
+		else {
+			*pdf = guiding_mixture_pdf(kg, sd->P, *omega_in, *pdf);
+		}
+	}
+
+	return label;
+}
+
+/* Recording
+ *
+ * Path vertices are remembered along with the throughput after their
+ * bounce and the radiance gathered so far. Once the path is done, the
+ * radiance gathered after each vertex divided by its throughput estimates
+ * the radiance arriving at the vertex from the bounce direction. */
+
+typedef struct GuidingVertex {
+	float3 P;
+	float3 D;
+	float3 throughput;
+	float3 L;
+	float pdf;
+} GuidingVertex;
+
+typedef struct GuidingPathState {
+	int num_vertices;
+	GuidingVertex vertex[GUIDING_MAX_VERTICES];
+} GuidingPathState;
+
+/* Radiance of the path so far, before it is split into passes. */
+ccl_device_inline float3 path_radiance_guiding_total(PathRadiance *L)
+{
+	float3 total = L->emission;
+
+#ifdef __PASSES__
+	if(L->use_light_pass) {
+		total += L->direct_emission + L->indirect + L->direct_diffuse +
+		         L->direct_glossy + L->direct_transmission +
+		         L->direct_subsurface + L->direct_scatter;
+	}
+#endif
+
+	return total;
+}
+
+ccl_device_inline void kernel_path_guiding_init(GuidingPathState *gstate)
+{
+	gstate->num_vertices = 0;
+}
+
+ccl_device_inline void kernel_path_guiding_add_vertex(KernelGlobals *kg,
+                                                      GuidingPathState *gstate,
+                                                      ShaderData *sd,
+                                                      Ray *ray,
+                                                      float3 throughput,
+                                                      float pdf,
+                                                      PathRadiance *L)
+{
+	if(!kernel_data.integrator.guiding_record ||
+	   gstate->num_vertices == GUIDING_MAX_VERTICES)
+	{
+		return;
+	}
+
+	GuidingVertex *v = &gstate->vertex[gstate->num_vertices++];
+	v->P = sd->P;
+	v->D = ray->D;
+	v->throughput = throughput;
+	v->L = path_radiance_guiding_total(L);
+	v->pdf = pdf;
+}
+
+ccl_device_noinline void kernel_path_guiding_record(KernelGlobals *kg,
+                                                    GuidingPathState *gstate,
+                                                    PathRadiance *L)
+{
+	if(gstate->num_vertices == 0) {
+		return;
+	}
+
+	float3 L_end = path_radiance_guiding_total(L);
+
+	for(int i = 0; i < gstate->num_vertices; i++) {
+		/* Samples that don't fit are dropped, the device empties the
+		 * buffer often enough for this to be rare. */
+		if(kg->num_guiding_samples >= kg->max_guiding_samples) {
+			break;
+		}
+
+		const GuidingVertex *v = &gstate->vertex[i];
+		float radiance = average(safe_divide_color(L_end - v->L, v->throughput));
+
+		/* Paths without any light still count for the spatial refinement. */
+		GuidingSample *sample = &kg->guiding_samples[kg->num_guiding_samples++];
+		sample->P = v->P;
+		sample->D = v->D;
+		sample->radiance = (isfinite_safe(radiance))? max(radiance, 0.0f): 0.0f;
+		sample->pdf = v->pdf;
+	}
+
+	gstate->num_vertices = 0;
+}
+
+#endif  /* __PATH_GUIDING__ */
+
+CCL_NAMESPACE_END
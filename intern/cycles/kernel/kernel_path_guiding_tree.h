@@ -0,0 +1,194 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+CCL_NAMESPACE_BEGIN
+
+/* Path Guiding Distribution
+ *
+ * Lookups into the learned distribution, used for sampling guided bounces in
+ * kernel_path_guiding.h and for weighting light samples against them. */
+
+#ifdef __PATH_GUIDING__
+
+/* Directions are mapped to the unit square with a cylindrical projection,
+ * which preserves area, so densities on the square and the sphere only
+ * differ by a factor 4*pi. */
+ccl_device_inline float2 guiding_direction_to_square(float3 D)
+{
+	float u = clamp((D.z + 1.0f)*0.5f, 0.0f, 1.0f);
+	float phi = atan2f(D.y, D.x);
+	if(phi < 0.0f) {
+		phi += M_2PI_F;
+	}
+	float v = clamp(phi*(1.0f/M_2PI_F), 0.0f, 1.0f);
+	return make_float2(u, v);
+}
+
+ccl_device_inline float3 guiding_square_to_direction(float u, float v)
+{
+	float cos_theta = 2.0f*u - 1.0f;
+	float sin_theta = safe_sqrtf(1.0f - cos_theta*cos_theta);
+	float phi = M_2PI_F*v;
+	return make_float3(sin_theta*cosf(phi), sin_theta*sinf(phi), cos_theta);
+}
+
+/* Find the root of the directional tree of the spatial leaf containing P. */
+ccl_device_inline int guiding_find_dtree(KernelGlobals *kg, float3 P)
+{
+	int index = 0;
+
+	for(;;) {
+		float4 node = kernel_tex_fetch(__guiding_nodes, index);
+		int axis = __float_as_int(node.x);
+
+		if(axis < 0) {
+			return __float_as_int(node.z);
+		}
+
+		float p = (axis == 0)? P.x: (axis == 1)? P.y: P.z;
+		index = __float_as_int(node.z) + ((p < node.y)? 0: 1);
+	}
+}
+
+/* Directional tree nodes are two float4, the radiance of the four quadrants
+ * and the indices of their child nodes, zero for leaves. Quadrants are
+ * ordered with the low bit for the upper half in u and the high bit for the
+ * upper half in v. */
+ccl_device float3 guiding_dtree_sample(KernelGlobals *kg,
+                                       int root,
+                                       float randu, float randv,
+                                       float *pdf)
+{
+	int index = root;
+	float2 origin = make_float2(0.0f, 0.0f);
+	float size = 1.0f;
+	float square_pdf = 1.0f;
+
+	for(;;) {
+		float4 sums = kernel_tex_fetch(__guiding_nodes, index);
+		float total = sums.x + sums.y + sums.z + sums.w;
+
+		if(!(total > 0.0f)) {
+			/* Nothing recorded here, sample the node uniformly. */
+			break;
+		}
+
+		/* Pick the half in u first, then the quadrant in v within that half,
+		 * rescaling the random numbers to keep their stratification. */
+		float lo_u = (sums.x + sums.z)/total;
+		int qu;
+		float lo_v_sum, hi_v_sum;
+
+		if(randu < lo_u) {
+			qu = 0;
+			randu = randu/lo_u;
+			lo_v_sum = sums.x;
+			hi_v_sum = sums.z;
+		}
+		else {
+			qu = 1;
+			randu = (randu - lo_u)/(1.0f - lo_u);
+			lo_v_sum = sums.y;
+			hi_v_sum = sums.w;
+		}
+
+		float lo_v = lo_v_sum/(lo_v_sum + hi_v_sum);
+		int qv;
+
+		if(randv < lo_v) {
+			qv = 0;
+			randv = randv/lo_v;
+		}
+		else {
+			qv = 1;
+			randv = (randv - lo_v)/(1.0f - lo_v);
+		}
+
+		int quadrant = qu + 2*qv;
+		square_pdf *= 4.0f*sums[quadrant]/total;
+
+		size *= 0.5f;
+		origin.x += qu*size;
+		origin.y += qv*size;
+
+		float4 children = kernel_tex_fetch(__guiding_nodes, index + 1);
+		int child = __float_as_int(children[quadrant]);
+
+		if(child == 0) {
+			break;
+		}
+		index = child;
+	}
+
+	randu = clamp(randu, 0.0f, 1.0f);
+	randv = clamp(randv, 0.0f, 1.0f);
+
+	*pdf = square_pdf*(0.25f*M_1_PI_F);
+	return guiding_square_to_direction(origin.x + randu*size, origin.y + randv*size);
+}
+
+ccl_device float guiding_dtree_pdf(KernelGlobals *kg, int root, float3 D)
+{
+	float2 uv = guiding_direction_to_square(D);
+	int index = root;
+	float square_pdf = 1.0f;
+
+	for(;;) {
+		float4 sums = kernel_tex_fetch(__guiding_nodes, index);
+		float total = sums.x + sums.y + sums.z + sums.w;
+
+		if(!(total > 0.0f)) {
+			break;
+		}
+
+		int qu = (uv.x >= 0.5f)? 1: 0;
+		int qv = (uv.y >= 0.5f)? 1: 0;
+		int quadrant = qu + 2*qv;
+
+		square_pdf *= 4.0f*sums[quadrant]/total;
+		if(square_pdf == 0.0f) {
+			return 0.0f;
+		}
+
+		float4 children = kernel_tex_fetch(__guiding_nodes, index + 1);
+		int child = __float_as_int(children[quadrant]);
+
+		if(child == 0) {
+			break;
+		}
+
+		uv.x = uv.x*2.0f - qu;
+		uv.y = uv.y*2.0f - qv;
+		index = child;
+	}
+
+	return square_pdf*(0.25f*M_1_PI_F);
+}
+
+/* Pdf of a direction sampled from the mixture of the guiding distribution
+ * and the BSDF, which has the BSDF pdf bsdf_pdf. Light samples have to be
+ * weighted against this pdf for MIS to match guided bounces. */
+ccl_device float guiding_mixture_pdf(KernelGlobals *kg, float3 P, float3 omega_in, float bsdf_pdf)
+{
+	const float fraction = kernel_data.integrator.guiding_fraction;
+	const int root = guiding_find_dtree(kg, P);
+
+	return fraction*guiding_dtree_pdf(kg, root, omega_in) + (1.0f - fraction)*bsdf_pdf;
+}
+
+#endif  /* __PATH_GUIDING__ */
+
+CCL_NAMESPACE_END
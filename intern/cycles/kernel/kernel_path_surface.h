@@ -28,6 +28,8 @@ ccl_device_noinline void kernel_branched_path_surface_connect_light(
         PathRadiance *L,
         int sample_all_lights)
 {
+	PROFILING_INIT(kg, PROFILING_CONNECT_LIGHT);
+
 #ifdef __EMISSION__
 	/* sample illumination from lights to find path contribution */
 	if(!(sd->flag & SD_BSDF_HAS_EVAL))
@@ -154,6 +156,8 @@ ccl_device bool kernel_branched_path_surface_bounce(
         ccl_addr_space Ray *ray,
         float sum_sample_weight)
 {
+	PROFILING_INIT(kg, PROFILING_SURFACE_BOUNCE);
+
 	/* sample BSDF */
 	float bsdf_pdf;
 	BsdfEval bsdf_eval;
@@ -217,6 +221,8 @@ ccl_device_inline void kernel_path_surface_connect_light(KernelGlobals *kg,
 	ShaderData *sd, ShaderData *emission_sd, float3 throughput, ccl_addr_space PathState *state,
 	PathRadiance *L)
 {
+	PROFILING_INIT(kg, PROFILING_CONNECT_LIGHT);
+
 #ifdef __EMISSION__
 	if(!(kernel_data.integrator.use_direct_light && (sd->flag & SD_BSDF_HAS_EVAL)))
 		return;
@@ -274,6 +280,8 @@ ccl_device bool kernel_path_surface_bounce(KernelGlobals *kg,
                                            PathRadianceState *L_state,
                                            ccl_addr_space Ray *ray)
 {
+	PROFILING_INIT(kg, PROFILING_SURFACE_BOUNCE);
+
 	/* no BSDF? we can stop here */
 	if(sd->flag & SD_BSDF) {
 		/* sample BSDF */
@@ -285,8 +293,17 @@ ccl_device bool kernel_path_surface_bounce(KernelGlobals *kg,
 		path_state_rng_2D(kg, state, PRNG_BSDF_U, &bsdf_u, &bsdf_v);
 		int label;
 
-		label = shader_bsdf_sample(kg, sd, bsdf_u, bsdf_v, &bsdf_eval,
-			&bsdf_omega_in, &bsdf_domega_in, &bsdf_pdf);
+#ifdef __PATH_GUIDING__
+		if(kernel_data.integrator.use_guiding && (sd->flag & SD_BSDF_HAS_EVAL)) {
+			label = kernel_path_guiding_bsdf_sample(kg, sd, bsdf_u, bsdf_v, &bsdf_eval,
+				&bsdf_omega_in, &bsdf_domega_in, &bsdf_pdf);
+		}
+		else
+#endif  /* __PATH_GUIDING__ */
+		{
+			label = shader_bsdf_sample(kg, sd, bsdf_u, bsdf_v, &bsdf_eval,
+				&bsdf_omega_in, &bsdf_domega_in, &bsdf_pdf);
+		}
 
 		if(bsdf_pdf == 0.0f || bsdf_eval_is_zero(&bsdf_eval))
 			return false;
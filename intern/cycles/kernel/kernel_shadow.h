@@ -456,6 +456,8 @@ ccl_device_inline bool shadow_blocked(KernelGlobals *kg,
                                       Ray *ray_input,
                                       float3 *shadow)
 {
+	PROFILING_INIT(kg, PROFILING_SHADOW_BLOCKED);
+
 	Ray *ray = ray_input;
 	Intersection isect;
 	/* Some common early checks. */
@@ -59,6 +59,11 @@ KERNEL_TEX(float4, __light_distribution)
 KERNEL_TEX(float4, __light_data)
 KERNEL_TEX(float2, __light_background_marginal_cdf)
 KERNEL_TEX(float2, __light_background_conditional_cdf)
+KERNEL_TEX(float4, __light_tree_nodes)
+KERNEL_TEX(uint, __light_tree_emitters)
+
+/* path guiding */
+KERNEL_TEX(float4, __guiding_nodes)
 
 /* particles */
 KERNEL_TEX(float4, __particles)
@@ -38,6 +38,7 @@ CCL_NAMESPACE_BEGIN
 #define OBJECT_SIZE 		16
 #define OBJECT_VECTOR_SIZE	6
 #define LIGHT_SIZE		11
+#define LIGHT_TREE_NODE_SIZE	4
 #define FILTER_TABLE_SIZE	1024
 #define RAMP_TABLE_SIZE		256
 #define SHUTTER_TABLE_SIZE		256
@@ -78,11 +79,21 @@ CCL_NAMESPACE_BEGIN
 #  define SHADER_SORT_LOCAL_SIZE 1
 #endif
 
+/* Number of camera rays traced together by the CPU stream traversal. */
+#define RAY_STREAM_SIZE 16
+
+/* Path vertices per path that record incident radiance for path guiding. */
+#define GUIDING_MAX_VERTICES 8
+
 
 /* Device capabilities */
 #ifdef __KERNEL_CPU__
 #  ifdef __KERNEL_SSE2__
 #    define __QBVH__
+#    define __RAY_STREAM__
+#  endif
+#  ifdef __KERNEL_AVX2__
+#    define __OBVH__
 #  endif
 #  define __KERNEL_SHADING__
 #  define __KERNEL_ADV_SHADING__
@@ -98,6 +109,9 @@ CCL_NAMESPACE_BEGIN
 #  define __SHADOW_RECORD_ALL__
 #  define __VOLUME_DECOUPLED__
 #  define __VOLUME_RECORD_ALL__
+#  define __ADAPTIVE_SAMPLING__
+#  define __TEXTURE_CACHE__
+#  define __PATH_GUIDING__
 #endif  /* __KERNEL_CPU__ */
 
 #ifdef __KERNEL_CUDA__
@@ -202,6 +216,18 @@ CCL_NAMESPACE_BEGIN
 #  define __BAKING__
 #endif
 
+/* Specialized CPU kernel for scenes without these features, the device
+ * selects it based on the requested features. */
+#ifdef __KERNEL_BASIC__
+#  define __NO_CAMERA_MOTION__
+#  define __NO_OBJECT_MOTION__
+#  define __NO_HAIR__
+#  define __NO_VOLUME__
+#  define __NO_SUBSURFACE__
+#  define __NO_BAKING__
+#  define __NO_PATCH_EVAL__
+#endif
+
 /* Scene-based selective features compilation. */
 #ifdef __NO_CAMERA_MOTION__
 #  undef __CAMERA_MOTION__
@@ -397,6 +423,8 @@ typedef enum PassType {
 	PASS_RAY_BOUNCES,
 #endif
 	PASS_RENDER_TIME,
+	PASS_ADAPTIVE_AUX_BUFFER,
+	PASS_SAMPLE_COUNT,
 	PASS_CATEGORY_MAIN_END = 31,
 
 	PASS_MIST = 32,
@@ -583,6 +611,16 @@ typedef ccl_addr_space struct PathRadiance {
 #endif /* __KERNEL_DEBUG__ */
 } PathRadiance;
 
+/* Radiance arriving at a position from a direction, recorded by the kernel
+ * to learn the path guiding distribution, along with the pdf the direction
+ * was sampled with. */
+typedef struct GuidingSample {
+	float3 P;
+	float3 D;
+	float radiance;
+	float pdf;
+} GuidingSample;
+
 typedef struct BsdfEval {
 #ifdef __PASSES__
 	int use_light_pass;
@@ -729,8 +767,19 @@ typedef enum PrimitiveType {
 	PRIMITIVE_NUM_TOTAL = 4,
 } PrimitiveType;
 
+/* Curve primitive types store the segment index, and optionally which part of
+ * the segment a BVH reference covers: one of 2^level sub-segments of equal
+ * parameter range. */
+#define PRIMITIVE_SEGMENT_BITS 22
+#define PRIMITIVE_SUBSEGMENT_SHIFT (PRIMITIVE_NUM_TOTAL + PRIMITIVE_SEGMENT_BITS)
+#define PRIMITIVE_MAX_SUBSEGMENT_LEVEL 3
+
 #define PRIMITIVE_PACK_SEGMENT(type, segment) ((segment << PRIMITIVE_NUM_TOTAL) | (type))
-#define PRIMITIVE_UNPACK_SEGMENT(type) (type >> PRIMITIVE_NUM_TOTAL)
+#define PRIMITIVE_UNPACK_SEGMENT(type) ((type >> PRIMITIVE_NUM_TOTAL) & ((1 << PRIMITIVE_SEGMENT_BITS) - 1))
+#define PRIMITIVE_PACK_SUBSEGMENT(type, level, index) \
+	((type) | (((level) | ((index) << 2)) << PRIMITIVE_SUBSEGMENT_SHIFT))
+#define PRIMITIVE_UNPACK_SUBSEGMENT_LEVEL(type) ((type >> PRIMITIVE_SUBSEGMENT_SHIFT) & 3)
+#define PRIMITIVE_UNPACK_SUBSEGMENT_INDEX(type) ((type >> (PRIMITIVE_SUBSEGMENT_SHIFT + 2)) & 7)
 
 /* Attributes */
 
@@ -1247,7 +1296,9 @@ typedef struct KernelFilm {
 	int pass_denoising_clean;
 	int denoising_flags;
 
-	int pad1, pad2, pad3;
+	int pass_adaptive_aux_buffer;
+	int pass_sample_count;
+	int pad1;
 
 #ifdef __KERNEL_DEBUG__
 	int pass_bvh_traversed_nodes;
@@ -1343,6 +1394,24 @@ typedef struct KernelIntegrator {
 	int start_sample;
 
 	int max_closures;
+
+	/* adaptive sampling */
+	int adaptive_min_samples;
+	int adaptive_step;
+	float adaptive_threshold;
+
+	/* light tree */
+	int use_light_tree;
+	float pdf_light_tree;
+
+	/* ray streams */
+	int use_ray_stream;
+
+	/* path guiding */
+	int use_guiding;
+	int guiding_record;
+	float guiding_fraction;
+	int pad1, pad2, pad3;
 } KernelIntegrator;
 static_assert_align(KernelIntegrator, 16);
 
@@ -1351,6 +1420,7 @@ typedef enum KernelBVHLayout {
 
 	BVH_LAYOUT_BVH2 = (1 << 0),
 	BVH_LAYOUT_BVH4 = (1 << 1),
+	BVH_LAYOUT_BVH8 = (1 << 2),
 
 	BVH_LAYOUT_DEFAULT = BVH_LAYOUT_BVH4,
 	BVH_LAYOUT_ALL = (unsigned int)(-1),
@@ -70,6 +70,7 @@ void KERNEL_FUNCTION_FULL_NAME(filter_construct_transform)(float* buffer,
 
 void KERNEL_FUNCTION_FULL_NAME(filter_nlm_calc_difference)(int dx,
                                                            int dy,
+                                                           int frame_offset,
                                                            float *weight_image,
                                                            float *variance,
                                                            float *difference_image,
@@ -103,6 +104,7 @@ void KERNEL_FUNCTION_FULL_NAME(filter_nlm_update_output)(int dx,
 
 void KERNEL_FUNCTION_FULL_NAME(filter_nlm_construct_gramian)(int dx,
                                                              int dy,
+                                                             int frame_offset,
                                                              float *difference_image,
                                                              float *buffer,
                                                              float *transform,
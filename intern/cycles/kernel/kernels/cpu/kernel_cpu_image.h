@@ -17,6 +17,8 @@
 #ifndef __KERNEL_CPU_IMAGE_H__
 #define __KERNEL_CPU_IMAGE_H__
 
+#include "kernel/kernel_oiio_globals.h"
+
 CCL_NAMESPACE_BEGIN
 
 template<typename T> struct TextureInterpolator  {
@@ -453,6 +455,120 @@ template<typename T> struct TextureInterpolator  {
 #undef DATA
 	}
 
+	/* ********  3D sparse interpolation ******** */
+
+	/* Only active tiles of sparse textures are stored, voxels are looked up
+	 * through the offsets table and empty tiles read as zero. */
+	static ccl_always_inline float4 read_sparse(const TextureInfo& info,
+	                                            int x, int y, int z)
+	{
+		const int *offsets = (const int*)info.sparse_offsets;
+		const int tiles_x = (info.width + TEX_SPARSE_TILE_MASK) >> TEX_SPARSE_TILE_SHIFT;
+		const int tiles_y = (info.height + TEX_SPARSE_TILE_MASK) >> TEX_SPARSE_TILE_SHIFT;
+		const int tile = (x >> TEX_SPARSE_TILE_SHIFT) +
+		                 tiles_x*((y >> TEX_SPARSE_TILE_SHIFT) +
+		                          tiles_y*(z >> TEX_SPARSE_TILE_SHIFT));
+		const int offset = offsets[tile];
+
+		if(offset < 0) {
+			return read(T());
+		}
+
+		const T *data = (const T*)info.data + (size_t)offset*TEX_SPARSE_TILE_VOLUME;
+		return read(data[(x & TEX_SPARSE_TILE_MASK) +
+		                 TEX_SPARSE_TILE_SIZE*((y & TEX_SPARSE_TILE_MASK) +
+		                                       TEX_SPARSE_TILE_SIZE*(z & TEX_SPARSE_TILE_MASK))]);
+	}
+
+	static ccl_always_inline int wrap_sparse(int x, int width, uint extension)
+	{
+		return (extension == EXTENSION_REPEAT)? wrap_periodic(x, width): wrap_clamp(x, width);
+	}
+
+	static ccl_never_inline float4 interp_3d_sparse(const TextureInfo& info,
+	                                                float x, float y, float z,
+	                                                InterpolationType interp)
+	{
+		int width = info.width;
+		int height = info.height;
+		int depth = info.depth;
+		int ix, iy, iz;
+
+		if(info.extension == EXTENSION_CLIP) {
+			if(x < 0.0f || y < 0.0f || z < 0.0f ||
+			   x > 1.0f || y > 1.0f || z > 1.0f)
+			{
+				return make_float4(0.0f, 0.0f, 0.0f, 0.0f);
+			}
+		}
+
+		switch((interp == INTERPOLATION_NONE)? info.interpolation: interp) {
+			case INTERPOLATION_CLOSEST: {
+				frac(x*(float)width, &ix);
+				frac(y*(float)height, &iy);
+				frac(z*(float)depth, &iz);
+
+				return read_sparse(info,
+				                   wrap_sparse(ix, width, info.extension),
+				                   wrap_sparse(iy, height, info.extension),
+				                   wrap_sparse(iz, depth, info.extension));
+			}
+			case INTERPOLATION_LINEAR: {
+				const float tx = frac(x*(float)width - 0.5f, &ix);
+				const float ty = frac(y*(float)height - 0.5f, &iy);
+				const float tz = frac(z*(float)depth - 0.5f, &iz);
+
+				const int xc[2] = {wrap_sparse(ix, width, info.extension),
+				                   wrap_sparse(ix+1, width, info.extension)};
+				const int yc[2] = {wrap_sparse(iy, height, info.extension),
+				                   wrap_sparse(iy+1, height, info.extension)};
+				const int zc[2] = {wrap_sparse(iz, depth, info.extension),
+				                   wrap_sparse(iz+1, depth, info.extension)};
+				float4 r;
+
+				r  = (1.0f - tz)*(1.0f - ty)*(1.0f - tx)*read_sparse(info, xc[0], yc[0], zc[0]);
+				r += (1.0f - tz)*(1.0f - ty)*tx*read_sparse(info, xc[1], yc[0], zc[0]);
+				r += (1.0f - tz)*ty*(1.0f - tx)*read_sparse(info, xc[0], yc[1], zc[0]);
+				r += (1.0f - tz)*ty*tx*read_sparse(info, xc[1], yc[1], zc[0]);
+
+				r += tz*(1.0f - ty)*(1.0f - tx)*read_sparse(info, xc[0], yc[0], zc[1]);
+				r += tz*(1.0f - ty)*tx*read_sparse(info, xc[1], yc[0], zc[1]);
+				r += tz*ty*(1.0f - tx)*read_sparse(info, xc[0], yc[1], zc[1]);
+				r += tz*ty*tx*read_sparse(info, xc[1], yc[1], zc[1]);
+
+				return r;
+			}
+			default: {
+				/* Tricubic b-spline interpolation. */
+				const float tx = frac(x*(float)width - 0.5f, &ix);
+				const float ty = frac(y*(float)height - 0.5f, &iy);
+				const float tz = frac(z*(float)depth - 0.5f, &iz);
+				int xc[4], yc[4], zc[4];
+				float u[4], v[4], w[4];
+
+				for(int i = 0; i < 4; i++) {
+					xc[i] = wrap_sparse(ix + i - 1, width, info.extension);
+					yc[i] = wrap_sparse(iy + i - 1, height, info.extension);
+					zc[i] = wrap_sparse(iz + i - 1, depth, info.extension);
+				}
+
+				SET_CUBIC_SPLINE_WEIGHTS(u, tx);
+				SET_CUBIC_SPLINE_WEIGHTS(v, ty);
+				SET_CUBIC_SPLINE_WEIGHTS(w, tz);
+
+				float4 r = make_float4(0.0f, 0.0f, 0.0f, 0.0f);
+				for(int k = 0; k < 4; k++) {
+					for(int j = 0; j < 4; j++) {
+						for(int i = 0; i < 4; i++) {
+							r += w[k]*v[j]*u[i]*read_sparse(info, xc[i], yc[j], zc[k]);
+						}
+					}
+				}
+				return r;
+			}
+		}
+	}
+
 	static ccl_always_inline float4 interp_3d(const TextureInfo& info,
 	                                          float x, float y, float z,
 	                                          InterpolationType interp)
@@ -460,6 +576,10 @@ template<typename T> struct TextureInterpolator  {
 		if(UNLIKELY(!info.data))
 			return make_float4(0.0f, 0.0f, 0.0f, 0.0f);
 
+		if(info.sparse_offsets) {
+			return interp_3d_sparse(info, x, y, z, interp);
+		}
+
 		switch((interp == INTERPOLATION_NONE)? info.interpolation: interp) {
 			case INTERPOLATION_CLOSEST:
 				return interp_3d_closest(info, x, y, z);
@@ -472,8 +592,116 @@ template<typename T> struct TextureInterpolator  {
 #undef SET_CUBIC_SPLINE_WEIGHTS
 };
 
+/* Texture Cache */
+
+ccl_device_inline const OIIOTexture *kernel_tex_image_cache(KernelGlobals *kg, int id)
+{
+	if(kg->oiio == NULL || id >= kg->oiio->textures.size()) {
+		return NULL;
+	}
+
+	const OIIOTexture *tex = &kg->oiio->textures[id];
+	return (tex->handle)? tex: NULL;
+}
+
+ccl_device float4 kernel_tex_image_interp_cache(KernelGlobals *kg,
+                                                const OIIOTexture *tex,
+                                                int id,
+                                                float x, float y,
+                                                float2 dx, float2 dy)
+{
+	OIIO::TextureOpt options;
+
+	switch(tex->extension) {
+		case EXTENSION_REPEAT:
+			options.swrap = options.twrap = OIIO::TextureOpt::WrapPeriodic;
+			break;
+		case EXTENSION_CLIP:
+			options.swrap = options.twrap = OIIO::TextureOpt::WrapBlack;
+			break;
+		case EXTENSION_EXTEND:
+		default:
+			options.swrap = options.twrap = OIIO::TextureOpt::WrapClamp;
+			break;
+	}
+
+	switch(tex->interpolation) {
+		case INTERPOLATION_CLOSEST:
+			options.interpmode = OIIO::TextureOpt::InterpClosest;
+			break;
+		case INTERPOLATION_CUBIC:
+			options.interpmode = OIIO::TextureOpt::InterpBicubic;
+			break;
+		case INTERPOLATION_SMART:
+			options.interpmode = OIIO::TextureOpt::InterpSmartBicubic;
+			break;
+		case INTERPOLATION_LINEAR:
+		default:
+			options.interpmode = OIIO::TextureOpt::InterpBilinear;
+			break;
+	}
+
+	const int texture_type = kernel_tex_type(id);
+	const bool is_rgba = (texture_type == IMAGE_DATA_TYPE_FLOAT4 ||
+	                      texture_type == IMAGE_DATA_TYPE_HALF4 ||
+	                      texture_type == IMAGE_DATA_TYPE_BYTE4);
+	const int channels = (is_rgba)? min(tex->channels, 4): 1;
+	float result[4];
+
+	/* Images in memory are stored bottom to top, files top to bottom. */
+	bool ok = kg->oiio->tex_sys->texture(tex->handle,
+	                                     (OIIO::TextureSystem::Perthread*)kg->oiio_tdata,
+	                                     options,
+	                                     x, 1.0f - y,
+	                                     dx.x, -dx.y,
+	                                     dy.x, -dy.y,
+	                                     channels,
+	                                     result);
+
+	if(!ok) {
+		return make_float4(TEX_IMAGE_MISSING_R,
+		                   TEX_IMAGE_MISSING_G,
+		                   TEX_IMAGE_MISSING_B,
+		                   TEX_IMAGE_MISSING_A);
+	}
+
+	float4 r;
+	switch(channels) {
+		case 1:
+			r = make_float4(result[0], result[0], result[0], 1.0f);
+			break;
+		case 2:
+			r = make_float4(result[0], result[0], result[0], result[1]);
+			break;
+		case 3:
+			r = make_float4(result[0], result[1], result[2], 1.0f);
+			break;
+		default:
+			r = make_float4(result[0], result[1], result[2], result[3]);
+			break;
+	}
+
+	/* The texture system returns associated alpha, images loaded into memory
+	 * without alpha have unassociated colors and opaque alpha. */
+	if(!tex->use_alpha) {
+		if(r.w != 0.0f && r.w != 1.0f) {
+			r /= r.w;
+		}
+		r.w = 1.0f;
+	}
+
+	return r;
+}
+
 ccl_device float4 kernel_tex_image_interp(KernelGlobals *kg, int id, float x, float y)
 {
+	const OIIOTexture *tex = kernel_tex_image_cache(kg, id);
+	if(tex) {
+		return kernel_tex_image_interp_cache(kg, tex, id, x, y,
+		                                     make_float2(0.0f, 0.0f),
+		                                     make_float2(0.0f, 0.0f));
+	}
+
 	const TextureInfo& info = kernel_tex_fetch(__texture_info, id);
 
 	switch(kernel_tex_type(id)) {
@@ -493,6 +721,18 @@ ccl_device float4 kernel_tex_image_interp(KernelGlobals *kg, int id, float x, fl
 	}
 }
 
+/* Lookup with derivatives of the texture coordinates, used to pick the mip
+ * level for images in the texture cache. */
+ccl_device float4 kernel_tex_image_interp_d(KernelGlobals *kg, int id, float x, float y, float2 dx, float2 dy)
+{
+	const OIIOTexture *tex = kernel_tex_image_cache(kg, id);
+	if(tex) {
+		return kernel_tex_image_interp_cache(kg, tex, id, x, y, dx, dy);
+	}
+
+	return kernel_tex_image_interp(kg, id, x, y);
+}
+
 ccl_device float4 kernel_tex_image_interp_3d(KernelGlobals *kg, int id, float x, float y, float z, InterpolationType interp)
 {
 	const TextureInfo& info = kernel_tex_fetch(__texture_info, id);
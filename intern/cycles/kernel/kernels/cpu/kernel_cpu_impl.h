@@ -72,7 +72,13 @@ CCL_NAMESPACE_BEGIN
 
 /* Path Tracing */
 
-void KERNEL_FUNCTION_FULL_NAME(path_trace)(KernelGlobals *kg,
+#ifdef __KERNEL_BASIC__
+#  define KERNEL_PATH_FUNCTION_NAME(name) KERNEL_FUNCTION_FULL_NAME(basic_##name)
+#else
+#  define KERNEL_PATH_FUNCTION_NAME(name) KERNEL_FUNCTION_FULL_NAME(name)
+#endif
+
+void KERNEL_PATH_FUNCTION_NAME(path_trace)(KernelGlobals *kg,
                                            float *buffer,
                                            int sample,
                                            int x, int y,
@@ -99,6 +105,29 @@ void KERNEL_FUNCTION_FULL_NAME(path_trace)(KernelGlobals *kg,
 #endif /* KERNEL_STUB */
 }
 
+void KERNEL_PATH_FUNCTION_NAME(path_trace_stream)(KernelGlobals *kg,
+                                                  float *buffer,
+                                                  int sample,
+                                                  int x, int y,
+                                                  int w, int h,
+                                                  int offset,
+                                                  int stride)
+{
+#ifdef KERNEL_STUB
+	STUB_ASSERT(KERNEL_ARCH, path_trace_stream);
+#else
+	/* Ray streams are only enabled for the regular path tracer. */
+	kernel_assert(!kernel_data.integrator.branched);
+	kernel_path_trace_stream(kg, buffer, sample, x, y, w, h, offset, stride);
+#endif /* KERNEL_STUB */
+}
+
+#undef KERNEL_PATH_FUNCTION_NAME
+
+/* The specialized kernels only contain path tracing, other entry points
+ * use the full kernel. */
+#ifndef __KERNEL_BASIC__
+
 /* Film */
 
 void KERNEL_FUNCTION_FULL_NAME(convert_to_byte)(KernelGlobals *kg,
@@ -178,6 +207,8 @@ void KERNEL_FUNCTION_FULL_NAME(shader)(KernelGlobals *kg,
 #endif /* KERNEL_STUB */
 }
 
+#endif  /* __KERNEL_BASIC__ */
+
 #else  /* __SPLIT_KERNEL__ */
 
 /* Split Kernel Path Tracing */
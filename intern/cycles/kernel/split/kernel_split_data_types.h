@@ -81,9 +81,16 @@ typedef ccl_global struct SplitBranchedState {
 #define SPLIT_DATA_BRANCHED_ENTRIES
 #endif  /* __BRANCHED_PATH__ */
 
+/* On the CPU, kernels compiled with different features share the KernelGlobals
+ * allocated by the device, so disabled entries keep an empty placeholder to
+ * give SplitData the same layout in all of them. */
+
 #ifdef __SUBSURFACE__
 #  define SPLIT_DATA_SUBSURFACE_ENTRIES \
 	SPLIT_DATA_ENTRY(ccl_global SubsurfaceIndirectRays, ss_rays, 1)
+#elif defined(__KERNEL_CPU__)
+#  define SPLIT_DATA_SUBSURFACE_ENTRIES \
+	SPLIT_DATA_ENTRY(ccl_global char, _ss_rays_unused, 0)
 #else
 #  define SPLIT_DATA_SUBSURFACE_ENTRIES
 #endif /* __SUBSURFACE__ */
@@ -91,6 +98,9 @@ typedef ccl_global struct SplitBranchedState {
 #ifdef __VOLUME__
 #  define SPLIT_DATA_VOLUME_ENTRIES \
 	SPLIT_DATA_ENTRY(ccl_global PathState, state_shadow, 1)
+#elif defined(__KERNEL_CPU__)
+#  define SPLIT_DATA_VOLUME_ENTRIES \
+	SPLIT_DATA_ENTRY(ccl_global char, _state_shadow_unused, 0)
 #else
 #  define SPLIT_DATA_VOLUME_ENTRIES
 #endif /* __VOLUME__ */
@@ -140,6 +150,12 @@ typedef struct SplitData {
 	ccl_global char *ray_state;
 } SplitData;
 
+#ifdef __KERNEL_CPU__
+/* Number of pointers in SplitData in every CPU kernel, update when adding
+ * entries, see KernelGlobals. */
+#  define SPLIT_DATA_CPU_NUM_POINTERS 17
+#endif
+
 #ifndef __KERNEL_CUDA__
 #  define kernel_split_state (kg->split_data)
 #  define kernel_split_params (kg->split_param_data)
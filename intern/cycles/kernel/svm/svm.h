@@ -199,6 +199,7 @@ ccl_device_noinline void svm_eval_nodes(KernelGlobals *kg, ShaderData *sd, ccl_a
 
 	while(1) {
 		uint4 node = read_node(kg, &offset);
+		PROFILING_SVM_NODE(kg, node.x);
 
 		switch(node.x) {
 #if NODES_GROUP(NODE_GROUP_LEVEL_0)
@@ -275,7 +276,7 @@ ccl_device_noinline void svm_eval_nodes(KernelGlobals *kg, ShaderData *sd, ccl_a
 #  endif  /* NODES_FEATURE(NODE_FEATURE_BUMP) */
 #  ifdef __TEXTURES__
 			case NODE_TEX_IMAGE:
-				svm_node_tex_image(kg, sd, stack, node);
+				svm_node_tex_image(kg, sd, stack, node, &offset);
 				break;
 			case NODE_TEX_IMAGE_BOX:
 				svm_node_tex_image_box(kg, sd, stack, node);
@@ -476,9 +477,11 @@ ccl_device_noinline void svm_eval_nodes(KernelGlobals *kg, ShaderData *sd, ccl_a
 #  endif  /* __SHADER_RAYTRACE__ */
 #endif  /* NODES_GROUP(NODE_GROUP_LEVEL_3) */
 			case NODE_END:
+				PROFILING_SVM_NODE(kg, -1);
 				return;
 			default:
 				kernel_assert(!"Unknown node type was passed to the SVM machine");
+				PROFILING_SVM_NODE(kg, -1);
 				return;
 		}
 	}
@@ -16,9 +16,8 @@
 
 CCL_NAMESPACE_BEGIN
 
-ccl_device float4 svm_image_texture(KernelGlobals *kg, int id, float x, float y, uint srgb, uint use_alpha)
+ccl_device float4 svm_image_texture_color(KernelGlobals *kg, int id, float4 r, uint srgb, uint use_alpha)
 {
-	float4 r = kernel_tex_image_interp(kg, id, x, y);
 	const float alpha = r.w;
 
 	if(use_alpha && alpha != 1.0f && alpha != 0.0f) {
@@ -39,16 +38,49 @@ ccl_device float4 svm_image_texture(KernelGlobals *kg, int id, float x, float y,
 	return r;
 }
 
+ccl_device float4 svm_image_texture(KernelGlobals *kg, int id, float x, float y, uint srgb, uint use_alpha)
+{
+	float4 r = kernel_tex_image_interp(kg, id, x, y);
+	return svm_image_texture_color(kg, id, r, srgb, use_alpha);
+}
+
 /* Remap coordnate from 0..1 box to -1..-1 */
 ccl_device_inline float3 texco_remap_square(float3 co)
 {
 	return (co - make_float3(0.5f, 0.5f, 0.5f)) * 2.0f;
 }
 
-ccl_device void svm_node_tex_image(KernelGlobals *kg, ShaderData *sd, float *stack, uint4 node)
+#ifdef __TEXTURE_CACHE__
+/* Derivatives of the texture coordinates for picking the mip level in the
+ * texture cache. SVM does not track derivatives through the node graph, so
+ * they are only known when the coordinates come straight from a UV map. */
+ccl_device void svm_image_texture_derivatives(KernelGlobals *kg, ShaderData *sd, uint uv_attr, float2 *dx, float2 *dy)
+{
+	*dx = make_float2(0.0f, 0.0f);
+	*dy = make_float2(0.0f, 0.0f);
+
+#ifdef __RAY_DIFFERENTIALS__
+	if(uv_attr == ATTR_STD_NONE || sd->object == OBJECT_NONE) {
+		return;
+	}
+
+	AttributeDescriptor desc = find_attribute(kg, sd, uv_attr);
+	if(desc.offset != ATTR_STD_NOT_FOUND) {
+		float3 uv_dx, uv_dy;
+		primitive_attribute_float3(kg, sd, desc, &uv_dx, &uv_dy);
+		*dx = make_float2(uv_dx.x, uv_dx.y);
+		*dy = make_float2(uv_dy.x, uv_dy.y);
+	}
+#endif
+}
+#endif
+
+ccl_device void svm_node_tex_image(KernelGlobals *kg, ShaderData *sd, float *stack, uint4 node, int *offset)
 {
 	uint id = node.y;
 	uint co_offset, out_offset, alpha_offset, srgb;
+	/* Attribute of the UV map the coordinates come from, if any. */
+	uint4 node2 = read_node(kg, offset);
 
 	decode_node_uchar4(node.z, &co_offset, &out_offset, &alpha_offset, &srgb);
 
@@ -66,7 +98,16 @@ ccl_device void svm_node_tex_image(KernelGlobals *kg, ShaderData *sd, float *sta
 	else {
 		tex_co = make_float2(co.x, co.y);
 	}
+
+#ifdef __TEXTURE_CACHE__
+	float2 dx, dy;
+	svm_image_texture_derivatives(kg, sd, node2.x, &dx, &dy);
+	float4 r = kernel_tex_image_interp_d(kg, id, tex_co.x, tex_co.y, dx, dy);
+	float4 f = svm_image_texture_color(kg, id, r, srgb, use_alpha);
+#else
+	(void)node2;
 	float4 f = svm_image_texture(kg, id, tex_co.x, tex_co.y, srgb, use_alpha);
+#endif
 
 	if(stack_valid(out_offset))
 		stack_store_float3(stack, out_offset, make_float3(f.x, f.y, f.z));
@@ -135,6 +135,8 @@ typedef enum ShaderNodeType {
 	NODE_BEVEL,
 	NODE_DISPLACEMENT,
 	NODE_VECTOR_DISPLACEMENT,
+
+	NODE_NUM_TYPES,
 } ShaderNodeType;
 
 typedef enum NodeAttributeType {
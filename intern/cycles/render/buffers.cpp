@@ -219,12 +219,38 @@ bool RenderBuffers::get_denoising_pass_rect(int offset, float exposure, int samp
 	return true;
 }
 
+/* Converged pixels of adaptive sampling stop accumulating samples before the
+ * tile is finished. Until then they are normalized by their own sample count,
+ * same as film_get_scale() does for the display. */
+static inline float get_pixel_scale(const float *in_converged, int i, int pass_stride, float scale)
+{
+	if(in_converged) {
+		float converged_samples = in_converged[(size_t)i*pass_stride];
+		if(converged_samples > 0.0f) {
+			return 1.0f/converged_samples;
+		}
+	}
+	return scale;
+}
+
 bool RenderBuffers::get_pass_rect(PassType type, float exposure, int sample, int components, float *pixels)
 {
 	if(buffer.data() == NULL) {
 		return false;
 	}
 
+	/* Number of samples of converged pixels, stored in the adaptive sampling
+	 * auxiliary pass. */
+	const float *in_converged = NULL;
+	int aux_offset = 0;
+	for(size_t j = 0; j < params.passes.size(); j++) {
+		if(params.passes[j].type == PASS_ADAPTIVE_AUX_BUFFER) {
+			in_converged = buffer.data() + aux_offset + 3;
+			break;
+		}
+		aux_offset += params.passes[j].components;
+	}
+
 	int pass_offset = 0;
 
 	for(size_t j = 0; j < params.passes.size(); j++) {
@@ -239,7 +265,8 @@ bool RenderBuffers::get_pass_rect(PassType type, float exposure, int sample, int
 		int pass_stride = params.get_passes_size();
 
 		float scale = (pass.filter)? 1.0f/(float)sample: 1.0f;
-		float scale_exposure = (pass.exposure)? scale*exposure: scale;
+		float exposure_scale = (pass.exposure)? exposure: 1.0f;
+		const float *in_scale = (pass.filter)? in_converged: NULL;
 
 		int size = params.width*params.height;
 
@@ -250,6 +277,12 @@ bool RenderBuffers::get_pass_rect(PassType type, float exposure, int sample, int
 				pixels[0] = val;
 			}
 		}
+		else if(components == 1 && type == PASS_SAMPLE_COUNT) {
+			/* Number of samples taken per pixel, never scaled. */
+			for(int i = 0; i < size; i++, in += pass_stride, pixels++) {
+				pixels[0] = *in;
+			}
+		}
 		else if(components == 1) {
 			assert(pass.components == components);
 
@@ -257,12 +290,14 @@ bool RenderBuffers::get_pass_rect(PassType type, float exposure, int sample, int
 			if(type == PASS_DEPTH) {
 				for(int i = 0; i < size; i++, in += pass_stride, pixels++) {
 					float f = *in;
+					float scale_exposure = get_pixel_scale(in_scale, i, pass_stride, scale)*exposure_scale;
 					pixels[0] = (f == 0.0f)? 1e10f: f*scale_exposure;
 				}
 			}
 			else if(type == PASS_MIST) {
 				for(int i = 0; i < size; i++, in += pass_stride, pixels++) {
 					float f = *in;
+					float scale_exposure = get_pixel_scale(in_scale, i, pass_stride, scale)*exposure_scale;
 					pixels[0] = saturate(f*scale_exposure);
 				}
 			}
@@ -274,13 +309,14 @@ bool RenderBuffers::get_pass_rect(PassType type, float exposure, int sample, int
 			{
 				for(int i = 0; i < size; i++, in += pass_stride, pixels++) {
 					float f = *in;
-					pixels[0] = f*scale;
+					pixels[0] = f*get_pixel_scale(in_scale, i, pass_stride, scale);
 				}
 			}
 #endif
 			else {
 				for(int i = 0; i < size; i++, in += pass_stride, pixels++) {
 					float f = *in;
+					float scale_exposure = get_pixel_scale(in_scale, i, pass_stride, scale)*exposure_scale;
 					pixels[0] = f*scale_exposure;
 				}
 			}
@@ -326,6 +362,7 @@ bool RenderBuffers::get_pass_rect(PassType type, float exposure, int sample, int
 				/* RGB/vector */
 				for(int i = 0; i < size; i++, in += pass_stride, pixels += 3) {
 					float3 f = make_float3(in[0], in[1], in[2]);
+					float scale_exposure = get_pixel_scale(in_scale, i, pass_stride, scale)*exposure_scale;
 
 					pixels[0] = f.x*scale_exposure;
 					pixels[1] = f.y*scale_exposure;
@@ -374,13 +411,15 @@ bool RenderBuffers::get_pass_rect(PassType type, float exposure, int sample, int
 			else {
 				for(int i = 0; i < size; i++, in += pass_stride, pixels += 4) {
 					float4 f = make_float4(in[0], in[1], in[2], in[3]);
+					float pixel_scale = get_pixel_scale(in_scale, i, pass_stride, scale);
+					float scale_exposure = pixel_scale*exposure_scale;
 
 					pixels[0] = f.x*scale_exposure;
 					pixels[1] = f.y*scale_exposure;
 					pixels[2] = f.z*scale_exposure;
 
 					/* clamp since alpha might be > 1.0 due to russian roulette */
-					pixels[3] = saturate(f.w*scale);
+					pixels[3] = saturate(f.w*pixel_scale);
 				}
 			}
 		}
@@ -391,6 +430,69 @@ bool RenderBuffers::get_pass_rect(PassType type, float exposure, int sample, int
 	return false;
 }
 
+/* Half Float Render Buffers */
+
+HalfRenderBuffers::HalfRenderBuffers(RenderBuffers *buffers, int sample)
+: params(buffers->params), sample(sample)
+{
+	const int pass_stride = params.get_passes_size();
+	const size_t num_pixels = (size_t)params.width*params.height;
+
+	/* Scale of each component of a pixel. */
+	component_scale.resize(pass_stride);
+	for(int i = 0; i < pass_stride; i++) {
+		component_scale[i] = 1.0f;
+	}
+
+	int pass_offset = 0;
+	for(size_t j = 0; j < params.passes.size(); j++) {
+		const Pass& pass = params.passes[j];
+		for(int i = 0; i < pass.components; i++) {
+			component_scale[pass_offset + i] = (pass.filter)? 1.0f/sample: 1.0f;
+		}
+		pass_offset += pass.components;
+	}
+
+	if(params.denoising_data_pass) {
+		int size = DENOISING_PASS_SIZE_BASE;
+		if(params.denoising_clean_pass) size += DENOISING_PASS_SIZE_CLEAN;
+		for(int i = 0; i < size; i++) {
+			component_scale[pass_offset + i] = 1.0f/sample;
+		}
+	}
+
+	buffers->copy_from_device();
+
+	const float *in = buffers->buffer.data();
+	pixels.resize(num_pixels*pass_stride);
+	half *out = pixels.data();
+
+	for(size_t i = 0; i < num_pixels; i++, in += pass_stride, out += pass_stride) {
+		for(int c = 0; c < pass_stride; c++) {
+			out[c] = float_to_half(in[c]*component_scale[c]);
+		}
+	}
+}
+
+void HalfRenderBuffers::unpack(RenderBuffers *buffers)
+{
+	buffers->reset(params);
+
+	const int pass_stride = params.get_passes_size();
+	const size_t num_pixels = (size_t)params.width*params.height;
+	const half *in = pixels.data();
+	float *out = buffers->buffer.data();
+
+	for(size_t i = 0; i < num_pixels; i++, in += pass_stride, out += pass_stride) {
+		for(int c = 0; c < pass_stride; c++) {
+			/* Zero needs special care, half_to_float() doesn't handle it. */
+			out[c] = (in[c] & 0x7fff)? half_to_float(in[c])/component_scale[c]: 0.0f;
+		}
+	}
+
+	buffers->buffer.copy_to_device();
+}
+
 /* Display Buffer */
 
 DisplayBuffer::DisplayBuffer(Device *device, bool linear)
@@ -88,6 +88,29 @@ public:
 	bool get_denoising_pass_rect(int offset, float exposure, int sample, int components, float *pixels);
 };
 
+/* Half Float Render Buffers
+ *
+ * Compact copy of the render buffers of a finished tile, with all passes
+ * stored as half floats. Accumulated passes are divided by the number of
+ * samples first, to stay within half float range. */
+
+class HalfRenderBuffers {
+public:
+	BufferParams params;
+	int sample;
+
+	HalfRenderBuffers(RenderBuffers *buffers, int sample);
+
+	/* Expand into float render buffers and copy them to the device. */
+	void unpack(RenderBuffers *buffers);
+
+	size_t memory_size() const { return pixels.size()*sizeof(half); }
+
+protected:
+	array<float> component_scale;
+	array<half> pixels;
+};
+
 /* Display Buffer
  *
  * The buffer used for drawing during render, filled by converting the render
@@ -29,7 +29,7 @@ CCL_NAMESPACE_BEGIN
 
 /* Curve functions */
 
-void curvebounds(float *lower, float *upper, float3 *p, int dim)
+void curvebounds(float *lower, float *upper, float3 *p, int dim, float t_start, float t_end)
 {
 	float *p0 = &p[0].x;
 	float *p1 = &p[1].x;
@@ -51,15 +51,25 @@ void curvebounds(float *lower, float *upper, float3 *p, int dim)
 		discroot = sqrtf(discroot);
 		ta = (-curve_coef[2] - discroot) / (3 * curve_coef[3]);
 		tb = (-curve_coef[2] + discroot) / (3 * curve_coef[3]);
-		ta = (ta > 1.0f || ta < 0.0f) ? -1.0f : ta;
-		tb = (tb > 1.0f || tb < 0.0f) ? -1.0f : tb;
+		ta = (ta > t_end || ta < t_start) ? -1.0f : ta;
+		tb = (tb > t_end || tb < t_start) ? -1.0f : tb;
 	}
 
-	*upper = max(p1[dim],p2[dim]);
-	*lower = min(p1[dim],p2[dim]);
+	float p_start = p1[dim];
+	float p_end = p2[dim];
 
-	float exa = p1[dim];
-	float exb = p2[dim];
+	if(t_start != 0.0f) {
+		p_start = ((curve_coef[3] * t_start + curve_coef[2]) * t_start + curve_coef[1]) * t_start + curve_coef[0];
+	}
+	if(t_end != 1.0f) {
+		p_end = ((curve_coef[3] * t_end + curve_coef[2]) * t_end + curve_coef[1]) * t_end + curve_coef[0];
+	}
+
+	*upper = max(p_start, p_end);
+	*lower = min(p_start, p_end);
+
+	float exa = p_start;
+	float exb = p_end;
 
 	if(ta >= 0.0f) {
 		float t2 = ta * ta;
@@ -27,7 +27,10 @@ class DeviceScene;
 class Progress;
 class Scene;
 
-void curvebounds(float *lower, float *upper, float3 *p, int dim);
+/* Bounds of a cardinal curve segment in one dimension, optionally restricted
+ * to a part of its parameter range. */
+void curvebounds(float *lower, float *upper, float3 *p, int dim,
+                 float t_start = 0.0f, float t_end = 1.0f);
 
 typedef enum CurvePrimitiveType {
 	CURVE_TRIANGLES = 0,
@@ -0,0 +1,591 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "render/denoising.h"
+
+#include "render/buffers.h"
+
+#include "util/util_foreach.h"
+#include "util/util_image.h"
+#include "util/util_logging.h"
+#include "util/util_map.h"
+#include "util/util_task.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+CCL_NAMESPACE_BEGIN
+
+/* Passes read from the image. The render buffers used for denoising contain
+ * the Combined pass followed by the denoising data. */
+
+typedef struct DenoisePassInfo {
+	const char *name;
+	const char *channels;
+	/* Offset in the denoising data, -1 for the Combined pass. */
+	int offset;
+	/* Variance passes directly follow the pass they belong to. */
+	bool variance;
+} DenoisePassInfo;
+
+static const DenoisePassInfo denoise_passes[] = {
+	{"Combined",                  "RGBA", -1,                         false},
+	{"Denoising Normal",          "XYZ",  DENOISING_PASS_NORMAL,      false},
+	{"Denoising Normal Variance", "XYZ",  DENOISING_PASS_NORMAL_VAR,  true},
+	{"Denoising Albedo",          "RGB",  DENOISING_PASS_ALBEDO,      false},
+	{"Denoising Albedo Variance", "RGB",  DENOISING_PASS_ALBEDO_VAR,  true},
+	{"Denoising Depth",           "Z",    DENOISING_PASS_DEPTH,       false},
+	{"Denoising Depth Variance",  "Z",    DENOISING_PASS_DEPTH_VAR,   true},
+	{"Denoising Shadow A",        "XYV",  DENOISING_PASS_SHADOW_A,    false},
+	{"Denoising Shadow B",        "XYV",  DENOISING_PASS_SHADOW_B,    false},
+	{"Denoising Image",           "RGB",  DENOISING_PASS_COLOR,       false},
+	{"Denoising Image Variance",  "RGB",  DENOISING_PASS_COLOR_VAR,   true},
+};
+
+static const int num_denoise_passes = sizeof(denoise_passes)/sizeof(*denoise_passes);
+
+static BufferParams denoise_buffer_params()
+{
+	BufferParams params;
+	params.passes.clear();
+	params.add_pass(PASS_COMBINED);
+	params.denoising_data_pass = true;
+	return params;
+}
+
+/* Render layer of an image, with the image channel of every component of the
+ * render buffers. */
+
+struct DenoiseImageLayer {
+	string name;
+	vector<int> channels;
+	int samples;
+};
+
+/* Multilayer EXR image with all its channels loaded into memory. */
+
+class DenoiseImage {
+public:
+	ImageSpec spec;
+	vector<float> pixels;
+	vector<DenoiseImageLayer> layers;
+
+	bool load(const string& filepath, int default_samples, string& error);
+	bool save(const string& filepath, string& error);
+
+	const DenoiseImageLayer *find_layer(const string& name) const;
+
+	/* Convert the layer to render buffers as if they were rendered with the
+	 * given number of samples. */
+	void read_layer(const DenoiseImageLayer& layer, int buffer_samples, float *buffer) const;
+	void write_combined(const DenoiseImageLayer& layer, int buffer_samples, const float *buffer);
+
+protected:
+	void parse_layers(int default_samples);
+};
+
+bool DenoiseImage::load(const string& filepath, int default_samples, string& error)
+{
+	ImageInput *in = ImageInput::create(filepath);
+
+	if(!in) {
+		error = "Couldn't find a suitable reader for " + filepath;
+		return false;
+	}
+
+	if(!in->open(filepath, spec)) {
+		error = "Couldn't open " + filepath + ": " + in->geterror();
+		delete in;
+		return false;
+	}
+
+	pixels.resize((size_t)spec.width * spec.height * spec.nchannels);
+	bool success = in->read_image(TypeDesc::FLOAT, &pixels[0]);
+	if(!success) {
+		error = "Couldn't read " + filepath + ": " + in->geterror();
+	}
+
+	in->close();
+	delete in;
+
+	if(success) {
+		parse_layers(default_samples);
+	}
+
+	return success;
+}
+
+bool DenoiseImage::save(const string& filepath, string& error)
+{
+	ImageOutput *out = ImageOutput::create(filepath);
+
+	if(!out) {
+		error = "Couldn't find a suitable writer for " + filepath;
+		return false;
+	}
+
+	bool success = out->open(filepath, spec) &&
+	               out->write_image(TypeDesc::FLOAT, &pixels[0]);
+	if(!success) {
+		error = "Couldn't write " + filepath + ": " + out->geterror();
+	}
+
+	out->close();
+	delete out;
+
+	return success;
+}
+
+void DenoiseImage::parse_layers(int default_samples)
+{
+	BufferParams params = denoise_buffer_params();
+	const int pass_stride = params.get_passes_size();
+	const int denoising_offset = params.get_denoising_offset();
+
+	/* Channels are named "layer.pass.channel" in multilayer files. */
+	map<string, DenoiseImageLayer> found_layers;
+
+	for(int i = 0; i < spec.nchannels; i++) {
+		const string& name = spec.channelnames[i];
+		size_t first = name.find('.');
+		size_t last = name.rfind('.');
+		if(first == string::npos || first == last || last + 2 != name.size()) {
+			continue;
+		}
+
+		string layer_name = name.substr(0, first);
+		string pass_name = name.substr(first + 1, last - first - 1);
+		char channel = name[last + 1];
+
+		for(int pass = 0; pass < num_denoise_passes; pass++) {
+			const DenoisePassInfo& info = denoise_passes[pass];
+			const char *c = strchr(info.channels, channel);
+			if(pass_name != info.name || !c) {
+				continue;
+			}
+
+			DenoiseImageLayer& layer = found_layers[layer_name];
+			if(layer.channels.empty()) {
+				layer.name = layer_name;
+				layer.channels.resize(pass_stride, -1);
+			}
+
+			int offset = (info.offset == -1)? 0: denoising_offset + info.offset;
+			layer.channels[offset + (c - info.channels)] = i;
+		}
+	}
+
+	for(map<string, DenoiseImageLayer>::iterator it = found_layers.begin(); it != found_layers.end(); it++) {
+		DenoiseImageLayer& layer = it->second;
+
+		/* Only layers that contain all passes can be denoised. */
+		bool complete = true;
+		for(int pass = 0; pass < num_denoise_passes; pass++) {
+			const DenoisePassInfo& info = denoise_passes[pass];
+			int offset = (info.offset == -1)? 0: denoising_offset + info.offset;
+			for(int c = 0; info.channels[c]; c++) {
+				complete &= (layer.channels[offset + c] != -1);
+			}
+		}
+
+		if(!complete) {
+			VLOG(1) << "Skipping layer " << layer.name << " without denoising data.";
+			continue;
+		}
+
+		/* The sample count is stored in the file metadata when rendering
+		 * with denoising data. */
+		string samples = spec.get_string_attribute("cycles." + layer.name + ".samples");
+		if(samples.empty()) {
+			samples = spec.get_string_attribute("Cycles Samples");
+		}
+		layer.samples = samples.empty()? default_samples: atoi(samples.c_str());
+
+		if(layer.samples < 1) {
+			VLOG(1) << "Skipping layer " << layer.name << " with unknown number of samples.";
+			continue;
+		}
+
+		layers.push_back(layer);
+	}
+}
+
+const DenoiseImageLayer *DenoiseImage::find_layer(const string& name) const
+{
+	foreach(const DenoiseImageLayer& layer, layers) {
+		if(layer.name == name) {
+			return &layer;
+		}
+	}
+	return NULL;
+}
+
+void DenoiseImage::read_layer(const DenoiseImageLayer& layer, int buffer_samples, float *buffer) const
+{
+	BufferParams params = denoise_buffer_params();
+	const int pass_stride = params.get_passes_size();
+	const int denoising_offset = params.get_denoising_offset();
+	const size_t num_pixels = (size_t)spec.width * spec.height;
+
+	/* The file stores means and per-sample variances, while the render
+	 * buffers store sums and sums of squares. The variances are rescaled so
+	 * that the variance of the mean of this layer's samples is preserved, in
+	 * case the buffer sample count is taken from another frame. */
+	const float scale = (float)buffer_samples;
+	const float variance_scale = scale * (buffer_samples - 1) / max(layer.samples - 1, 1);
+
+	for(size_t i = 0; i < num_pixels; i++) {
+		const float *in = &pixels[i * spec.nchannels];
+		float *out = buffer + i * pass_stride;
+
+		for(int c = 0; c < pass_stride; c++) {
+			out[c] = (layer.channels[c] == -1)? 0.0f: in[layer.channels[c]] * scale;
+		}
+
+		for(int pass = 0; pass < num_denoise_passes; pass++) {
+			const DenoisePassInfo& info = denoise_passes[pass];
+			if(!info.variance) {
+				continue;
+			}
+
+			const int offset = denoising_offset + info.offset;
+			const int components = strlen(info.channels);
+			for(int c = 0; c < components; c++) {
+				float mean = in[layer.channels[offset - components + c]];
+				float variance = in[layer.channels[offset + c]];
+				out[offset + c] = mean*mean*scale + variance*variance_scale;
+			}
+		}
+	}
+}
+
+void DenoiseImage::write_combined(const DenoiseImageLayer& layer, int buffer_samples, const float *buffer)
+{
+	BufferParams params = denoise_buffer_params();
+	const int pass_stride = params.get_passes_size();
+	const size_t num_pixels = (size_t)spec.width * spec.height;
+	const float invsample = 1.0f/buffer_samples;
+
+	for(size_t i = 0; i < num_pixels; i++) {
+		float *out = &pixels[i * spec.nchannels];
+		const float *in = buffer + i * pass_stride;
+
+		for(int c = 0; c < 3; c++) {
+			out[layer.channels[c]] = in[c] * invsample;
+		}
+	}
+}
+
+/* Denoising of one render layer, with the neighboring frames stored after the
+ * current one in the render buffers. The whole image is a single buffer that
+ * is handed out to the device in tiles. */
+
+class DenoiseTask {
+public:
+	DenoiseTask(Device *device, Denoiser *denoiser, int width, int height, int num_frames);
+	~DenoiseTask();
+
+	float *frame_buffer(int frame);
+	bool run(int samples);
+
+protected:
+	bool acquire_tile(Device *device, RenderTile& tile);
+	void release_tile(RenderTile& tile);
+	void map_neighbor_tiles(RenderTile *tiles, Device *tile_device);
+	void unmap_neighbor_tiles(RenderTile *tiles, Device *tile_device);
+
+	Device *device;
+	Denoiser *denoiser;
+
+	int width, height;
+	int num_frames;
+	int pass_stride;
+	int denoising_offset;
+	int samples;
+
+	int tiles_x, tiles_y;
+	int next_tile;
+	thread_mutex tile_mutex;
+
+	device_vector<float> buffer;
+};
+
+DenoiseTask::DenoiseTask(Device *device, Denoiser *denoiser, int width, int height, int num_frames)
+: device(device), denoiser(denoiser), width(width), height(height), num_frames(num_frames),
+  samples(0), next_tile(0), buffer(device, "denoising pixels", MEM_READ_WRITE)
+{
+	BufferParams params = denoise_buffer_params();
+	pass_stride = params.get_passes_size();
+	denoising_offset = params.get_denoising_offset();
+
+	tiles_x = divide_up(width, denoiser->tile_size.x);
+	tiles_y = divide_up(height, denoiser->tile_size.y);
+
+	buffer.alloc((size_t)width * height * pass_stride, num_frames);
+}
+
+DenoiseTask::~DenoiseTask()
+{
+	buffer.free();
+}
+
+float *DenoiseTask::frame_buffer(int frame)
+{
+	return buffer.data() + (size_t)frame * width * height * pass_stride;
+}
+
+bool DenoiseTask::run(int samples_)
+{
+	samples = samples_;
+	next_tile = 0;
+
+	buffer.copy_to_device();
+
+	DeviceTask task(DeviceTask::RENDER);
+	task.acquire_tile = function_bind(&DenoiseTask::acquire_tile, this, _1, _2);
+	task.release_tile = function_bind(&DenoiseTask::release_tile, this, _1);
+	task.map_neighbor_tiles = function_bind(&DenoiseTask::map_neighbor_tiles, this, _1, _2);
+	task.unmap_neighbor_tiles = function_bind(&DenoiseTask::unmap_neighbor_tiles, this, _1, _2);
+	task.get_cancel = function_bind(&Progress::get_cancel, &denoiser->progress);
+	task.need_finish_queue = false;
+	task.integrator_branched = false;
+	task.requested_tile_size = denoiser->tile_size;
+	task.passes_size = pass_stride;
+
+	task.denoising_radius = denoiser->radius;
+	task.denoising_strength = denoiser->strength;
+	task.denoising_feature_strength = denoiser->feature_strength;
+	task.denoising_relative_pca = denoiser->relative_pca;
+	task.pass_stride = pass_stride;
+	task.pass_denoising_data = denoising_offset;
+	task.pass_denoising_clean = 0;
+	task.denoising_neighbor_frames = num_frames - 1;
+	task.denoising_frame_stride = width * height * pass_stride;
+
+	device->task_add(task);
+	device->task_wait();
+
+	buffer.copy_from_device(0, width * pass_stride, height);
+
+	return !denoiser->progress.get_cancel();
+}
+
+bool DenoiseTask::acquire_tile(Device * /*device*/, RenderTile& tile)
+{
+	thread_scoped_lock tile_lock(tile_mutex);
+
+	if(next_tile == tiles_x * tiles_y) {
+		return false;
+	}
+
+	const int2 tile_size = denoiser->tile_size;
+	tile.tile_index = next_tile++;
+	tile.task = RenderTile::DENOISE;
+	tile.x = (tile.tile_index % tiles_x) * tile_size.x;
+	tile.y = (tile.tile_index / tiles_x) * tile_size.y;
+	tile.w = min(tile_size.x, width - tile.x);
+	tile.h = min(tile_size.y, height - tile.y);
+	tile.start_sample = 0;
+	tile.num_samples = samples;
+	tile.sample = samples;
+	tile.resolution = 1;
+	tile.offset = 0;
+	tile.stride = width;
+	tile.buffer = buffer.device_pointer;
+	tile.buffers = NULL;
+
+	return true;
+}
+
+void DenoiseTask::release_tile(RenderTile& /*tile*/)
+{
+}
+
+void DenoiseTask::map_neighbor_tiles(RenderTile *tiles, Device * /*tile_device*/)
+{
+	const int2 tile_size = denoiser->tile_size;
+	const int tile_x = tiles[4].tile_index % tiles_x;
+	const int tile_y = tiles[4].tile_index / tiles_x;
+
+	for(int dy = -1, i = 0; dy <= 1; dy++) {
+		for(int dx = -1; dx <= 1; dx++, i++) {
+			int px = (tile_x + dx) * tile_size.x;
+			int py = (tile_y + dy) * tile_size.y;
+			if(tile_x + dx >= 0 && tile_x + dx < tiles_x &&
+			   tile_y + dy >= 0 && tile_y + dy < tiles_y) {
+				tiles[i].buffer = buffer.device_pointer;
+				tiles[i].x = px;
+				tiles[i].y = py;
+				tiles[i].w = min(tile_size.x, width - px);
+				tiles[i].h = min(tile_size.y, height - py);
+				tiles[i].offset = 0;
+				tiles[i].stride = width;
+			}
+			else {
+				tiles[i].buffer = (device_ptr)NULL;
+				tiles[i].x = clamp(px, 0, width);
+				tiles[i].y = clamp(py, 0, height);
+				tiles[i].w = tiles[i].h = 0;
+			}
+			tiles[i].buffers = NULL;
+		}
+	}
+}
+
+void DenoiseTask::unmap_neighbor_tiles(RenderTile * /*tiles*/, Device * /*tile_device*/)
+{
+}
+
+/* Denoiser */
+
+Denoiser::Denoiser(const DeviceInfo& device_info)
+: device_info(device_info), device(NULL)
+{
+	radius = 8;
+	strength = 0.5f;
+	feature_strength = 0.5f;
+	relative_pca = false;
+	neighbor_frames = 0;
+	samples = 0;
+	threads = 0;
+	tile_size = make_int2(64, 64);
+}
+
+Denoiser::~Denoiser()
+{
+	delete device;
+}
+
+bool Denoiser::run()
+{
+	if(input.empty()) {
+		error = "No input files to denoise";
+		return false;
+	}
+
+	if(output.size() != input.size()) {
+		error = "Number of output files does not match number of input files";
+		return false;
+	}
+
+	if(neighbor_frames > 0 && device_info.type != DEVICE_CPU) {
+		LOG(WARNING) << "Denoising with neighboring frames is only supported on the CPU.";
+		neighbor_frames = 0;
+	}
+
+	TaskScheduler::init(threads);
+
+	device = Device::create(device_info, stats, profiler, true);
+
+	DeviceRequestedFeatures requested_features;
+	requested_features.use_denoising = true;
+
+	bool success = true;
+
+	if(!device || !device->load_kernels(requested_features)) {
+		error = "Failed loading denoising kernels";
+		if(device && !device->error_message().empty()) {
+			error += ": " + device->error_message();
+		}
+		success = false;
+	}
+
+	for(int frame = 0; success && frame < (int)input.size(); frame++) {
+		success = denoise_frame(frame);
+	}
+
+	delete device;
+	device = NULL;
+
+	TaskScheduler::exit();
+
+	return success;
+}
+
+bool Denoiser::denoise_frame(int frame)
+{
+	progress.set_status("Loading", input[frame]);
+
+	DenoiseImage image;
+	if(!image.load(input[frame], samples, error)) {
+		return false;
+	}
+
+	if(image.layers.empty()) {
+		error = "No render layers with denoising data found in " + input[frame];
+		return false;
+	}
+
+	/* Load the neighboring frames, skipping ones that don't fit. */
+	const int first = max(frame - neighbor_frames, 0);
+	const int last = min(frame + neighbor_frames, (int)input.size() - 1);
+	vector<DenoiseImage> neighbors;
+	neighbors.reserve(last - first);
+
+	for(int neighbor = first; neighbor <= last; neighbor++) {
+		if(neighbor == frame) {
+			continue;
+		}
+
+		string neighbor_error;
+		neighbors.push_back(DenoiseImage());
+		if(!neighbors.back().load(input[neighbor], samples, neighbor_error)) {
+			LOG(WARNING) << "Skipping neighboring frame: " << neighbor_error;
+			neighbors.pop_back();
+		}
+		else if(neighbors.back().spec.width != image.spec.width ||
+		        neighbors.back().spec.height != image.spec.height)
+		{
+			LOG(WARNING) << "Skipping neighboring frame " << input[neighbor] << " with different resolution.";
+			neighbors.pop_back();
+		}
+	}
+
+	foreach(const DenoiseImageLayer& layer, image.layers) {
+		vector<const DenoiseImage*> neighbor_images;
+		vector<const DenoiseImageLayer*> neighbor_layers;
+		foreach(const DenoiseImage& neighbor, neighbors) {
+			const DenoiseImageLayer *neighbor_layer = neighbor.find_layer(layer.name);
+			if(neighbor_layer) {
+				neighbor_images.push_back(&neighbor);
+				neighbor_layers.push_back(neighbor_layer);
+			}
+		}
+
+		progress.set_status("Denoising", string_printf("Frame %d/%d, layer %s",
+		                                               frame + 1, (int)input.size(), layer.name.c_str()));
+
+		DenoiseTask task(device, this, image.spec.width, image.spec.height, 1 + neighbor_images.size());
+
+		image.read_layer(layer, layer.samples, task.frame_buffer(0));
+		for(size_t i = 0; i < neighbor_images.size(); i++) {
+			neighbor_images[i]->read_layer(*neighbor_layers[i], layer.samples, task.frame_buffer(i + 1));
+		}
+
+		if(!task.run(layer.samples)) {
+			error = "Denoising canceled";
+			return false;
+		}
+
+		image.write_combined(layer, layer.samples, task.frame_buffer(0));
+	}
+
+	progress.set_status("Saving", output[frame]);
+
+	return image.save(output[frame], error);
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DENOISING_H__
+#define __DENOISING_H__
+
+#include "device/device.h"
+
+#include "util/util_progress.h"
+#include "util/util_stats.h"
+#include "util/util_string.h"
+#include "util/util_types.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Denoiser
+ *
+ * Denoises multilayer EXR files written by an earlier render, using the
+ * denoising data passes stored in the render layers. The result replaces the
+ * Combined pass, while the denoising passes are kept so files can be denoised
+ * again with different settings. */
+
+class Denoiser {
+public:
+	explicit Denoiser(const DeviceInfo& device_info);
+	~Denoiser();
+
+	/* Denoise all input files, returns false and sets error on failure. */
+	bool run();
+
+	/* Error message in case run() failed. */
+	string error;
+
+	/* Frames to denoise, consecutive files are treated as consecutive frames
+	 * of a sequence when denoising with neighboring frames. */
+	vector<string> input;
+	/* File to write each denoised frame to, same length as the input. */
+	vector<string> output;
+
+	/* Parameters of the denoising algorithm, as for denoising during render. */
+	int radius;
+	float strength;
+	float feature_strength;
+	bool relative_pca;
+
+	/* Number of frames before and after the current one that are used for
+	 * denoising, only supported on the CPU. */
+	int neighbor_frames;
+
+	/* Samples the files were rendered with, used for files that do not
+	 * store their sample count. */
+	int samples;
+
+	int threads;
+	int2 tile_size;
+
+	Progress progress;
+
+protected:
+	bool denoise_frame(int frame);
+
+	DeviceInfo device_info;
+	Stats stats;
+	Profiler profiler;
+	Device *device;
+};
+
+CCL_NAMESPACE_END
+
+#endif  /* __DENOISING_H__ */
@@ -710,6 +710,46 @@ void ShaderGraph::compute_displacement_hash()
 	displacement_hash = md5.get_hex();
 }
 
+/* Hash of all nodes and links, to detect if a new graph is identical to the
+ * one a shader already has. Graphs with script nodes can't be compared and
+ * get an empty hash. */
+string ShaderGraph::compute_hash()
+{
+	MD5Hash md5;
+
+	foreach(ShaderNode *node, nodes) {
+		if(node->special_type == SHADER_SPECIAL_TYPE_SCRIPT) {
+			return "";
+		}
+
+		node->hash(md5);
+		md5.append((uint8_t*)&node->id, sizeof(node->id));
+
+		/* Builtin images are not identified by any socket. */
+		void *builtin_data = NULL;
+		if(node->type == ImageTextureNode::node_type) {
+			builtin_data = static_cast<ImageTextureNode*>(node)->builtin_data;
+		}
+		else if(node->type == EnvironmentTextureNode::node_type) {
+			builtin_data = static_cast<EnvironmentTextureNode*>(node)->builtin_data;
+		}
+		else if(node->type == PointDensityTextureNode::node_type) {
+			builtin_data = static_cast<PointDensityTextureNode*>(node)->builtin_data;
+		}
+		md5.append((uint8_t*)&builtin_data, sizeof(builtin_data));
+
+		foreach(ShaderInput *input, node->inputs) {
+			int link_id = (input->link) ? input->link->parent->id : -1;
+			md5.append((uint8_t*)&link_id, sizeof(link_id));
+			if(input->link) {
+				md5.append(input->link->name().string());
+			}
+		}
+	}
+
+	return md5.get_hex();
+}
+
 void ShaderGraph::clean(Scene *scene)
 {
 	/* Graph simplification */
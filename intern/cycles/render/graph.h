@@ -259,6 +259,7 @@ public:
 
 	void remove_proxy_nodes();
 	void compute_displacement_hash();
+	string compute_hash();
 	void simplify(Scene *scene);
 	void finalize(Scene *scene,
 	              bool do_bump = false,
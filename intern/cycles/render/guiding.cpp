@@ -0,0 +1,359 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "render/guiding.h"
+
+#include "util/util_atomic.h"
+#include "util/util_math.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Spatial leaves are split once they received more samples than this,
+ * scaled by the square root of the iteration length. */
+#define GUIDING_SPATIAL_THRESHOLD 12000.0f
+#define GUIDING_SPATIAL_MAX_DEPTH 24
+
+/* Directional quadrants are subdivided when they hold more than this
+ * fraction of the radiance of their tree. */
+#define GUIDING_DIRECTIONAL_THRESHOLD 0.01f
+#define GUIDING_DIRECTIONAL_MAX_DEPTH 20
+
+/* Must match guiding_direction_to_square() in the kernel. */
+static float2 guiding_direction_to_square(float3 D)
+{
+	float u = clamp((D.z + 1.0f)*0.5f, 0.0f, 1.0f);
+	float phi = atan2f(D.y, D.x);
+	if(phi < 0.0f) {
+		phi += M_2PI_F;
+	}
+	float v = clamp(phi*(1.0f/M_2PI_F), 0.0f, 1.0f);
+	return make_float2(u, v);
+}
+
+/* Directional Tree */
+
+PathGuiding::DTreeNode::DTreeNode()
+{
+	for(int quadrant = 0; quadrant < 4; quadrant++) {
+		sum[quadrant] = 0.0f;
+		child[quadrant] = 0;
+	}
+}
+
+PathGuiding::DTree::DTree()
+{
+	nodes.resize(1);
+}
+
+void PathGuiding::DTree::record(float2 uv, float radiance)
+{
+	int index = 0;
+
+	for(;;) {
+		int qu = (uv.x >= 0.5f)? 1: 0;
+		int qv = (uv.y >= 0.5f)? 1: 0;
+		int quadrant = qu + 2*qv;
+
+		DTreeNode& node = nodes[index];
+		atomic_add_and_fetch_float(&node.sum[quadrant], radiance);
+
+		if(node.child[quadrant] == 0) {
+			break;
+		}
+
+		uv.x = uv.x*2.0f - qu;
+		uv.y = uv.y*2.0f - qv;
+		index = node.child[quadrant];
+	}
+}
+
+void PathGuiding::DTree::refine(const DTree& recorded, float threshold, int max_depth)
+{
+	const float recorded_total = recorded.total();
+
+	nodes.clear();
+	nodes.resize(1);
+
+	/* Nodes still to visit, along with the recorded node at the same place,
+	 * -1 if the recorded tree ends above it. */
+	struct StackEntry {
+		int node;
+		int recorded;
+		int depth;
+	};
+
+	vector<StackEntry> stack;
+	StackEntry root = {0, 0, 1};
+	stack.push_back(root);
+
+	while(!stack.empty()) {
+		StackEntry entry = stack.back();
+		stack.pop_back();
+
+		if(entry.recorded < 0 || entry.depth >= max_depth) {
+			continue;
+		}
+
+		const DTreeNode& recorded_node = recorded.nodes[entry.recorded];
+
+		for(int quadrant = 0; quadrant < 4; quadrant++) {
+			if(!(recorded_node.sum[quadrant] > threshold*recorded_total)) {
+				continue;
+			}
+
+			int child = (int)nodes.size();
+			nodes.resize(child + 1);
+			nodes[entry.node].child[quadrant] = child;
+
+			int recorded_child = recorded_node.child[quadrant];
+			StackEntry child_entry = {child,
+			                          (recorded_child != 0)? recorded_child: -1,
+			                          entry.depth + 1};
+			stack.push_back(child_entry);
+		}
+	}
+}
+
+float PathGuiding::DTree::total() const
+{
+	const DTreeNode& root = nodes[0];
+	return root.sum[0] + root.sum[1] + root.sum[2] + root.sum[3];
+}
+
+/* Spatial Tree */
+
+PathGuiding::SpatialNode::SpatialNode()
+: bounds(BoundBox::empty),
+  depth(0),
+  child(0),
+  axis(-1),
+  split(0.0f),
+  num_samples(0)
+{
+}
+
+PathGuiding::PathGuiding()
+: iteration(0),
+  iteration_passes(0),
+  passes(0),
+  training_passes(0),
+  is_training(false),
+  have_distribution(false)
+{
+}
+
+PathGuiding::~PathGuiding()
+{
+}
+
+void PathGuiding::reset(const BoundBox& bounds, int training_passes_)
+{
+	spatial_nodes.clear();
+	spatial_nodes.resize(1);
+	spatial_nodes[0].bounds = bounds;
+
+	iteration = 0;
+	iteration_passes = 0;
+	passes = 0;
+	training_passes = training_passes_;
+	is_training = (training_passes > 0);
+	have_distribution = false;
+}
+
+int PathGuiding::find_leaf(float3 P) const
+{
+	int index = 0;
+
+	while(spatial_nodes[index].axis >= 0) {
+		const SpatialNode& node = spatial_nodes[index];
+		float p = (node.axis == 0)? P.x: (node.axis == 1)? P.y: P.z;
+		index = node.child + ((p < node.split)? 0: 1);
+	}
+
+	return index;
+}
+
+void PathGuiding::record(const GuidingSample *samples, int num_samples)
+{
+	if(!is_training) {
+		return;
+	}
+
+	for(int i = 0; i < num_samples; i++) {
+		const GuidingSample& sample = samples[i];
+
+		if(!(sample.pdf > 0.0f)) {
+			continue;
+		}
+
+		SpatialNode& leaf = spatial_nodes[find_leaf(sample.P)];
+		atomic_fetch_and_inc_uint32(&leaf.num_samples);
+
+		/* Dividing by the pdf makes the sum an estimate of the radiance
+		 * integral, no matter how the directions were sampled. */
+		if(sample.radiance > 0.0f) {
+			leaf.building.record(guiding_direction_to_square(sample.D),
+			                     sample.radiance/sample.pdf);
+		}
+	}
+}
+
+void PathGuiding::split_leaf(int index, uint32_t threshold)
+{
+	if(spatial_nodes[index].num_samples <= threshold ||
+	   spatial_nodes[index].depth >= GUIDING_SPATIAL_MAX_DEPTH)
+	{
+		return;
+	}
+
+	/* Split in the middle of the longest axis, both halves start with the
+	 * distribution of the leaf and are assumed to get half its samples. */
+	SpatialNode leaf = spatial_nodes[index];
+	float3 size = leaf.bounds.size();
+	int axis = (size.x >= size.y && size.x >= size.z)? 0: (size.y >= size.z)? 1: 2;
+	float3 center = leaf.bounds.center();
+	float split = (axis == 0)? center.x: (axis == 1)? center.y: center.z;
+
+	int child = (int)spatial_nodes.size();
+	SpatialNode left = leaf, right = leaf;
+
+	left.depth = right.depth = leaf.depth + 1;
+	left.num_samples = right.num_samples = leaf.num_samples/2;
+	if(axis == 0) {
+		left.bounds.max.x = right.bounds.min.x = split;
+	}
+	else if(axis == 1) {
+		left.bounds.max.y = right.bounds.min.y = split;
+	}
+	else {
+		left.bounds.max.z = right.bounds.min.z = split;
+	}
+
+	spatial_nodes.push_back(left);
+	spatial_nodes.push_back(right);
+
+	SpatialNode& node = spatial_nodes[index];
+	node.axis = axis;
+	node.split = split;
+	node.child = child;
+	node.sampling = DTree();
+	node.building = DTree();
+
+	split_leaf(child, threshold);
+	split_leaf(child + 1, threshold);
+}
+
+void PathGuiding::end_iteration()
+{
+	uint32_t threshold = (uint32_t)(GUIDING_SPATIAL_THRESHOLD * sqrtf((float)(1 << iteration)));
+
+	size_t num_nodes = spatial_nodes.size();
+	for(size_t i = 0; i < num_nodes; i++) {
+		if(spatial_nodes[i].axis < 0) {
+			split_leaf((int)i, threshold);
+		}
+	}
+
+	/* The recorded distribution is used for sampling, a refined copy of it
+	 * without any radiance records the next iteration. */
+	for(size_t i = 0; i < spatial_nodes.size(); i++) {
+		SpatialNode& node = spatial_nodes[i];
+
+		if(node.axis < 0) {
+			node.sampling.nodes.swap(node.building.nodes);
+			node.building.refine(node.sampling,
+			                     GUIDING_DIRECTIONAL_THRESHOLD,
+			                     GUIDING_DIRECTIONAL_MAX_DEPTH);
+			node.num_samples = 0;
+		}
+	}
+
+	have_distribution = true;
+	iteration++;
+	iteration_passes = 0;
+
+	if(passes + (1 << iteration) > training_passes) {
+		is_training = false;
+	}
+}
+
+bool PathGuiding::pass_done()
+{
+	if(!is_training) {
+		return false;
+	}
+
+	passes++;
+	iteration_passes++;
+
+	if(iteration_passes < (1 << iteration)) {
+		return false;
+	}
+
+	end_iteration();
+	return true;
+}
+
+bool PathGuiding::training() const
+{
+	return is_training;
+}
+
+bool PathGuiding::has_distribution() const
+{
+	return have_distribution;
+}
+
+void PathGuiding::pack(vector<float4>& nodes) const
+{
+	nodes.clear();
+	nodes.resize(spatial_nodes.size());
+
+	for(size_t i = 0; i < spatial_nodes.size(); i++) {
+		const SpatialNode& node = spatial_nodes[i];
+
+		if(node.axis >= 0) {
+			nodes[i] = make_float4(__int_as_float(node.axis),
+			                       node.split,
+			                       __int_as_float(node.child),
+			                       0.0f);
+			continue;
+		}
+
+		int offset = (int)nodes.size();
+		nodes[i] = make_float4(__int_as_float(-1),
+		                       0.0f,
+		                       __int_as_float(offset),
+		                       0.0f);
+
+		for(size_t j = 0; j < node.sampling.nodes.size(); j++) {
+			const DTreeNode& dnode = node.sampling.nodes[j];
+			int child[4];
+
+			for(int quadrant = 0; quadrant < 4; quadrant++) {
+				child[quadrant] = (dnode.child[quadrant] != 0)? offset + 2*dnode.child[quadrant]: 0;
+			}
+
+			nodes.push_back(make_float4(dnode.sum[0], dnode.sum[1], dnode.sum[2], dnode.sum[3]));
+			nodes.push_back(make_float4(__int_as_float(child[0]),
+			                            __int_as_float(child[1]),
+			                            __int_as_float(child[2]),
+			                            __int_as_float(child[3])));
+		}
+	}
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __GUIDING_H__
+#define __GUIDING_H__
+
+#include "kernel/kernel_types.h"
+
+#include "util/util_boundbox.h"
+#include "util/util_types.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Path Guiding
+ *
+ * Spatio-directional tree (SD-tree) of the radiance arriving in the scene,
+ * learned from the paths of the first passes. A binary tree splits the scene
+ * bounds in space, every leaf holds a quadtree over the directions mapped to
+ * the unit square.
+ *
+ * Learning happens in iterations of doubling length: the samples of an
+ * iteration are recorded into a building tree, which then becomes the
+ * distribution the kernel samples from, while the building tree is refined
+ * where the most light was recorded and cleared for the next iteration.
+ *
+ * The flattened tree used by the kernel starts with the spatial nodes, the
+ * directional nodes of all leaves follow. Spatial nodes are a single float4
+ * with the split axis, or -1 for leaves, the split position and the index of
+ * the first child or of the directional root. Directional nodes are two
+ * float4, the radiance in each quadrant and the indices of their children. */
+
+class PathGuiding {
+public:
+	PathGuiding();
+	~PathGuiding();
+
+	/* Start learning over, for a scene with the given bounds. Training ends
+	 * with the last iteration that fits in the number of passes. */
+	void reset(const BoundBox& bounds, int training_passes);
+
+	/* Add samples recorded by the kernel, safe to call from multiple render
+	 * threads during a pass. */
+	void record(const GuidingSample *samples, int num_samples);
+
+	/* Called after every pass, returns true when a new distribution is
+	 * available for the kernel. */
+	bool pass_done();
+
+	/* Whether the kernel should record samples in the next pass. */
+	bool training() const;
+	/* Whether there is a distribution the kernel can sample from. */
+	bool has_distribution() const;
+
+	void pack(vector<float4>& nodes) const;
+
+protected:
+	struct DTreeNode {
+		DTreeNode();
+
+		float sum[4];
+		int child[4];
+	};
+
+	/* Directional quadtree, the root is the first node. */
+	struct DTree {
+		DTree();
+
+		void record(float2 uv, float radiance);
+		/* Structure for the next iteration, quadrants with more than the given
+		 * fraction of the recorded radiance are subdivided, the others are
+		 * merged. */
+		void refine(const DTree& recorded, float threshold, int max_depth);
+		float total() const;
+
+		vector<DTreeNode> nodes;
+	};
+
+	struct SpatialNode {
+		SpatialNode();
+
+		BoundBox bounds;
+		int depth;
+		int child;
+		int axis;
+		float split;
+
+		/* Only used for leaves. */
+		DTree sampling;
+		DTree building;
+		uint32_t num_samples;
+	};
+
+	int find_leaf(float3 P) const;
+	void split_leaf(int index, uint32_t threshold);
+	void end_iteration();
+
+	vector<SpatialNode> spatial_nodes;
+
+	int iteration;
+	int iteration_passes;
+	int passes;
+	int training_passes;
+	bool is_training;
+	bool have_distribution;
+};
+
+CCL_NAMESPACE_END
+
+#endif  /* __GUIDING_H__ */
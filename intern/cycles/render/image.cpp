@@ -18,10 +18,13 @@
 #include "render/image.h"
 #include "render/scene.h"
 
+#include "kernel/kernel_oiio_globals.h"
+
 #include "util/util_foreach.h"
 #include "util/util_logging.h"
 #include "util/util_path.h"
 #include "util/util_progress.h"
+#include "util/util_sparse_grid.h"
 #include "util/util_texture.h"
 
 #ifdef WITH_OSL
@@ -44,11 +47,13 @@ ImageManager::ImageManager(const DeviceInfo& info)
 {
 	need_update = true;
 	osl_texture_system = NULL;
+	texture_cache = NULL;
 	animation_frame = 0;
 
 	/* Set image limits */
 	max_num_images = TEX_NUM_MAX;
 	has_half_images = info.has_half_images;
+	has_sparse_volumes = info.has_sparse_volumes;
 
 	for(size_t type = 0; type < IMAGE_DATA_NUM_TYPES; type++) {
 		tex_num_images[type] = 0;
@@ -322,6 +327,7 @@ int ImageManager::add_image(const string& filename,
 	img->users = 1;
 	img->use_alpha = use_alpha;
 	img->mem = NULL;
+	img->sparse_offsets = NULL;
 
 	images[type][slot] = img;
 
@@ -661,6 +667,60 @@ bool ImageManager::file_load_image(Image *img,
 	return true;
 }
 
+template<typename DeviceType>
+void ImageManager::make_sparse_volume(Image *img,
+                                      device_vector<DeviceType>& tex_img)
+{
+	if(!has_sparse_volumes ||
+	   img->interpolation == INTERPOLATION_NONE ||
+	   tex_img.data_depth <= 1)
+	{
+		return;
+	}
+
+	const size_t width = tex_img.data_width;
+	const size_t height = tex_img.data_height;
+	const size_t depth = tex_img.data_depth;
+
+	vector<int> offsets;
+	const size_t num_active = sparse_grid_compute_offsets(tex_img.data(),
+	                                                      width, height, depth,
+	                                                      &offsets);
+
+	/* Lookups through the offsets table are slower than dense lookups, so only
+	 * use sparse storage when a good part of the grid is empty. */
+	const size_t dense_size = tex_img.memory_size();
+	const size_t sparse_size = num_active*TEX_SPARSE_TILE_VOLUME*sizeof(DeviceType) +
+	                           offsets.size()*sizeof(int);
+	if(sparse_size*4 > dense_size*3) {
+		return;
+	}
+
+	VLOG(1) << "Sparse volume " << img->filename << ": "
+	        << num_active << " of " << offsets.size() << " tiles active, "
+	        << string_human_readable_size(dense_size) << " reduced to "
+	        << string_human_readable_size(sparse_size) << ".";
+
+	vector<DeviceType> tiles(max(num_active*TEX_SPARSE_TILE_VOLUME, (size_t)1));
+	sparse_grid_fill_tiles(tex_img.data(), width, height, depth, offsets, &tiles[0]);
+
+	thread_scoped_lock device_lock(device_mutex);
+
+	DeviceType *pixels = tex_img.alloc(tiles.size());
+	memcpy(pixels, &tiles[0], sizeof(DeviceType)*tiles.size());
+	tex_img.data_width = width;
+	tex_img.data_height = height;
+	tex_img.data_depth = depth;
+
+	device_vector<int> *tex_offsets
+		= new device_vector<int>(tex_img.device, "__tex_image_sparse_offsets", MEM_READ_ONLY);
+	memcpy(tex_offsets->alloc(offsets.size()), &offsets[0], sizeof(int)*offsets.size());
+	tex_offsets->copy_to_device();
+
+	img->sparse_offsets = tex_offsets;
+	tex_img.sparse_offsets = tex_offsets;
+}
+
 void ImageManager::device_load_image(Device *device,
                                      Scene *scene,
                                      ImageDataType type,
@@ -690,6 +750,21 @@ void ImageManager::device_load_image(Device *device,
 		delete img->mem;
 		img->mem = NULL;
 	}
+	if(img->sparse_offsets) {
+		thread_scoped_lock device_lock(device_mutex);
+		delete img->sparse_offsets;
+		img->sparse_offsets = NULL;
+	}
+
+	/* Read tiled files on demand when the texture cache is enabled. */
+	if(texture_cache) {
+		texture_cache_free_image(img, flat_slot);
+
+		if(texture_cache_load_image(img, flat_slot)) {
+			img->need_load = false;
+			return;
+		}
+	}
 
 	/* Create new texture. */
 	if(type == IMAGE_DATA_TYPE_FLOAT4) {
@@ -711,6 +786,8 @@ void ImageManager::device_load_image(Device *device,
 			pixels[3] = TEX_IMAGE_MISSING_A;
 		}
 
+		make_sparse_volume(img, *tex_img);
+
 		img->mem = tex_img;
 		img->mem->interpolation = img->interpolation;
 		img->mem->extension = img->extension;
@@ -734,6 +811,8 @@ void ImageManager::device_load_image(Device *device,
 			pixels[0] = TEX_IMAGE_MISSING_R;
 		}
 
+		make_sparse_volume(img, *tex_img);
+
 		img->mem = tex_img;
 		img->mem->interpolation = img->interpolation;
 		img->mem->extension = img->extension;
@@ -760,6 +839,8 @@ void ImageManager::device_load_image(Device *device,
 			pixels[3] = (TEX_IMAGE_MISSING_A * 255);
 		}
 
+		make_sparse_volume(img, *tex_img);
+
 		img->mem = tex_img;
 		img->mem->interpolation = img->interpolation;
 		img->mem->extension = img->extension;
@@ -782,6 +863,8 @@ void ImageManager::device_load_image(Device *device,
 			pixels[0] = (TEX_IMAGE_MISSING_R * 255);
 		}
 
+		make_sparse_volume(img, *tex_img);
+
 		img->mem = tex_img;
 		img->mem->interpolation = img->interpolation;
 		img->mem->extension = img->extension;
@@ -807,6 +890,8 @@ void ImageManager::device_load_image(Device *device,
 			pixels[3] = TEX_IMAGE_MISSING_A;
 		}
 
+		make_sparse_volume(img, *tex_img);
+
 		img->mem = tex_img;
 		img->mem->interpolation = img->interpolation;
 		img->mem->extension = img->extension;
@@ -829,6 +914,8 @@ void ImageManager::device_load_image(Device *device,
 			pixels[0] = TEX_IMAGE_MISSING_R;
 		}
 
+		make_sparse_volume(img, *tex_img);
+
 		img->mem = tex_img;
 		img->mem->interpolation = img->interpolation;
 		img->mem->extension = img->extension;
@@ -845,6 +932,10 @@ void ImageManager::device_free_image(Device *, ImageDataType type, int slot)
 	Image *img = images[type][slot];
 
 	if(img) {
+		if(texture_cache) {
+			texture_cache_free_image(img, type_index_to_flattened_slot(slot, type));
+		}
+
 		if(osl_texture_system && !img->builtin_data) {
 #ifdef WITH_OSL
 			ustring filename(images[type][slot]->filename);
@@ -856,6 +947,10 @@ void ImageManager::device_free_image(Device *, ImageDataType type, int slot)
 			thread_scoped_lock device_lock(device_mutex);
 			delete img->mem;
 		}
+		if(img->sparse_offsets) {
+			thread_scoped_lock device_lock(device_mutex);
+			delete img->sparse_offsets;
+		}
 
 		delete img;
 		images[type][slot] = NULL;
@@ -871,6 +966,8 @@ void ImageManager::device_update(Device *device,
 		return;
 	}
 
+	device_update_texture_cache(device, scene);
+
 	TaskPool pool;
 	for(int type = 0; type < IMAGE_DATA_NUM_TYPES; type++) {
 		for(size_t slot = 0; slot < images[type].size(); slot++) {
@@ -940,6 +1037,107 @@ void ImageManager::device_free(Device *device)
 		}
 		images[type].clear();
 	}
+
+	if(texture_cache) {
+		VLOG(1) << "Texture cache statistics:\n" << texture_cache_statistics();
+
+		OIIO::TextureSystem::destroy(texture_cache->tex_sys);
+		texture_cache->tex_sys = NULL;
+		texture_cache->textures.clear();
+		texture_cache = NULL;
+	}
+}
+
+/* Texture Cache */
+
+void ImageManager::device_update_texture_cache(Device *device, Scene *scene)
+{
+	/* With OSL all file images are already read through its texture system. */
+	if(!scene->params.use_texture_cache || osl_texture_system) {
+		return;
+	}
+
+	OIIOGlobals *oiio = (OIIOGlobals*)device->oiio_memory();
+	if(!oiio) {
+		return;
+	}
+
+	if(!oiio->tex_sys) {
+		/* Not shared, so the cache size and statistics are per session. */
+		oiio->tex_sys = OIIO::TextureSystem::create(false);
+		oiio->tex_sys->attribute("autotile", 0);
+		oiio->tex_sys->attribute("automip", 0);
+	}
+
+	oiio->tex_sys->attribute("max_memory_MB", (float)scene->params.texture_cache_size);
+	texture_cache = oiio;
+}
+
+bool ImageManager::texture_cache_load_image(Image *img, int flat_slot)
+{
+	if(img->builtin_data || img->filename == "") {
+		return false;
+	}
+
+	OIIO::TextureSystem *tex_sys = texture_cache->tex_sys;
+	ustring filename(img->filename);
+	ImageSpec spec;
+
+	/* Untiled files have to be read in full on first access anyway, and
+	 * sampling them from memory is faster. Volumes are not supported. */
+	if(!tex_sys->get_imagespec(filename, 0, spec)) {
+		tex_sys->geterror();
+		return false;
+	}
+	if(spec.tile_width == 0 || spec.depth > 1 ||
+	   !(spec.nchannels >= 1 && spec.nchannels <= 4))
+	{
+		return false;
+	}
+
+	OIIOTexture tex;
+	tex.handle = tex_sys->get_texture_handle(filename);
+	tex.channels = spec.nchannels;
+	tex.use_alpha = img->use_alpha;
+	tex.interpolation = img->interpolation;
+	tex.extension = img->extension;
+
+	if(!tex.handle) {
+		return false;
+	}
+
+	thread_scoped_lock device_lock(device_mutex);
+	if(flat_slot >= texture_cache->textures.size()) {
+		texture_cache->textures.resize(flat_slot + 1);
+	}
+	texture_cache->textures[flat_slot] = tex;
+
+	VLOG(1) << "Reading " << img->filename << " through texture cache, "
+	        << spec.width << "x" << spec.height << " with "
+	        << spec.tile_width << "x" << spec.tile_height << " tiles.";
+
+	return true;
+}
+
+void ImageManager::texture_cache_free_image(Image *img, int flat_slot)
+{
+	thread_scoped_lock device_lock(device_mutex);
+
+	if(flat_slot < texture_cache->textures.size() &&
+	   texture_cache->textures[flat_slot].handle)
+	{
+		texture_cache->textures[flat_slot] = OIIOTexture();
+		texture_cache->tex_sys->invalidate(ustring(img->filename));
+	}
+}
+
+string ImageManager::texture_cache_statistics()
+{
+	if(!texture_cache) {
+		return "";
+	}
+
+	return texture_cache->tex_sys->getstats(2);
 }
 
 CCL_NAMESPACE_END
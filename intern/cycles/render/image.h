@@ -30,6 +30,7 @@ CCL_NAMESPACE_BEGIN
 class Device;
 class Progress;
 class Scene;
+struct OIIOGlobals;
 
 class ImageManager {
 public:
@@ -74,6 +75,9 @@ public:
 	void set_osl_texture_system(void *texture_system);
 	bool set_animation_frame_update(int frame);
 
+	/* Statistics of the texture cache, empty if it is not used. */
+	string texture_cache_statistics();
+
 	bool need_update;
 
 	/* NOTE: Here pixels_size is a size of storage, which equals to
@@ -113,6 +117,7 @@ public:
 
 		string mem_name;
 		device_memory *mem;
+		device_memory *sparse_offsets;
 
 		int users;
 	};
@@ -121,12 +126,14 @@ private:
 	int tex_num_images[IMAGE_DATA_NUM_TYPES];
 	int max_num_images;
 	bool has_half_images;
+	bool has_sparse_volumes;
 
 	thread_mutex device_mutex;
 	int animation_frame;
 
 	vector<Image*> images[IMAGE_DATA_NUM_TYPES];
 	void *osl_texture_system;
+	OIIOGlobals *texture_cache;
 
 	bool file_load_image_generic(Image *img,
 	                             ImageInput **in,
@@ -143,6 +150,10 @@ private:
 	                     int texture_limit,
 	                     device_vector<DeviceType>& tex_img);
 
+	template<typename DeviceType>
+	void make_sparse_volume(Image *img,
+	                        device_vector<DeviceType>& tex_img);
+
 	int max_flattened_slot(ImageDataType type);
 	int type_index_to_flattened_slot(int slot, ImageDataType type);
 	int flattened_slot_to_type_index(int flat_slot, ImageDataType *type);
@@ -156,6 +167,10 @@ private:
 	void device_free_image(Device *device,
 	                       ImageDataType type,
 	                       int slot);
+
+	void device_update_texture_cache(Device *device, Scene *scene);
+	bool texture_cache_load_image(Image *img, int flat_slot);
+	void texture_cache_free_image(Image *img, int flat_slot);
 };
 
 CCL_NAMESPACE_END
@@ -64,9 +64,14 @@ NODE_DEFINE(Integrator)
 	SOCKET_INT(volume_samples, "Volume Samples", 1);
 	SOCKET_INT(start_sample, "Start Sample", 0);
 
+	SOCKET_FLOAT(adaptive_threshold, "Adaptive Threshold", 0.01f);
+	SOCKET_INT(adaptive_min_samples, "Adaptive Min Samples", 0);
+
 	SOCKET_BOOLEAN(sample_all_lights_direct, "Sample All Lights Direct", true);
 	SOCKET_BOOLEAN(sample_all_lights_indirect, "Sample All Lights Indirect", true);
 	SOCKET_FLOAT(light_sampling_threshold, "Light Sampling Threshold", 0.05f);
+	SOCKET_BOOLEAN(use_light_tree, "Use Light Tree", false);
+	SOCKET_BOOLEAN(use_ray_stream, "Use Ray Stream", false);
 
 	static NodeEnum method_enum;
 	method_enum.insert("path", PATH);
@@ -156,7 +161,11 @@ void Integrator::device_update(Device *device, DeviceScene *dscene, Scene *scene
 	kintegrator->volume_samples = volume_samples;
 	kintegrator->start_sample = start_sample;
 
-	if(method == BRANCHED_PATH) {
+	/* The light tree picks a single light per sample, so the sample all lights
+	 * strategy which expects a uniform light selection is not used with it.
+	 * The light manager updates first and only enables the tree in the kernel
+	 * when it holds emitters, otherwise lights are sampled as usual. */
+	if(method == BRANCHED_PATH && !kintegrator->use_light_tree) {
 		kintegrator->sample_all_lights_direct = sample_all_lights_direct;
 		kintegrator->sample_all_lights_indirect = sample_all_lights_indirect;
 	}
@@ -168,6 +177,21 @@ void Integrator::device_update(Device *device, DeviceScene *dscene, Scene *scene
 	kintegrator->sampling_pattern = sampling_pattern;
 	kintegrator->aa_samples = aa_samples;
 
+	/* Camera rays are traced in streams only by the regular path tracer. */
+	kintegrator->use_ray_stream = use_ray_stream && (method == PATH);
+
+	/* Adaptive sampling is enabled by the film passes, these are only the
+	 * parameters. Convergence is tested every few samples, always after an
+	 * even number of them so both halves of the error estimate are balanced. */
+	kintegrator->adaptive_threshold = adaptive_threshold;
+	kintegrator->adaptive_step = 4;
+	if(adaptive_min_samples > 0) {
+		kintegrator->adaptive_min_samples = max(adaptive_min_samples, kintegrator->adaptive_step);
+	}
+	else {
+		kintegrator->adaptive_min_samples = max((int)sqrtf((float)aa_samples), kintegrator->adaptive_step);
+	}
+
 	if(light_sampling_threshold > 0.0f) {
 		kintegrator->light_inv_rr_threshold = 1.0f / light_sampling_threshold;
 	}
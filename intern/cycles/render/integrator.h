@@ -65,9 +65,14 @@ public:
 	int volume_samples;
 	int start_sample;
 
+	float adaptive_threshold;
+	int adaptive_min_samples;
+
 	bool sample_all_lights_direct;
 	bool sample_all_lights_indirect;
 	float light_sampling_threshold;
+	bool use_light_tree;
+	bool use_ray_stream;
 
 	enum Method {
 		BRANCHED_PATH = 0,
@@ -19,6 +19,7 @@
 #include "render/integrator.h"
 #include "render/film.h"
 #include "render/light.h"
+#include "render/light_tree.h"
 #include "render/mesh.h"
 #include "render/object.h"
 #include "render/scene.h"
@@ -242,10 +243,42 @@ bool LightManager::object_usable_as_light(Object *object) {
 	return false;
 }
 
+static LightTreePrimitive light_tree_lamp_primitive(const Light *light, float energy, int index)
+{
+	LightTreePrimitive prim;
+	prim.energy = energy;
+	prim.index = index;
+
+	if(light->type == LIGHT_AREA) {
+		float3 axisu = light->axisu*(light->sizeu*light->size);
+		float3 axisv = light->axisv*(light->sizev*light->size);
+
+		prim.bounds = BoundBox(light->co - 0.5f*axisu - 0.5f*axisv);
+		prim.bounds.grow(light->co + 0.5f*axisu - 0.5f*axisv);
+		prim.bounds.grow(light->co - 0.5f*axisu + 0.5f*axisv);
+		prim.bounds.grow(light->co + 0.5f*axisu + 0.5f*axisv);
+		/* One sided with cosine falloff. */
+		prim.cone = LightTreeCone(safe_normalize(light->dir), 0.0f, M_PI_2_F);
+	}
+	else {
+		prim.bounds = BoundBox(light->co);
+		prim.bounds.grow(light->co, light->size);
+
+		if(light->type == LIGHT_SPOT) {
+			/* Nothing is emitted outside of the spot cone. */
+			prim.cone = LightTreeCone(safe_normalize(light->dir), light->spot_angle*0.5f, 0.0f);
+		}
+	}
+
+	return prim;
+}
+
 void LightManager::device_update_distribution(Device *, DeviceScene *dscene, Scene *scene, Progress& progress)
 {
 	progress.set_status("Updating Lights", "Computing distribution");
 
+	const bool had_light_tree = dscene->data.integrator.use_light_tree;
+
 	/* count */
 	size_t num_lights = 0;
 	size_t num_portals = 0;
@@ -253,6 +286,8 @@ void LightManager::device_update_distribution(Device *, DeviceScene *dscene, Sce
 	size_t num_triangles = 0;
 
 	bool background_mis = false;
+	bool use_light_tree = scene->integrator->use_light_tree;
+	vector<LightTreePrimitive> light_tree_prims;
 
 	foreach(Light *light, scene->lights) {
 		if(light->is_enabled) {
@@ -354,7 +389,19 @@ void LightManager::device_update_distribution(Device *, DeviceScene *dscene, Sce
 					p3 = transform_point(&tfm, p3);
 				}
 
-				totarea += triangle_area(p1, p2, p3);
+				float area = triangle_area(p1, p2, p3);
+				totarea += area;
+
+				if(use_light_tree) {
+					/* Mesh lights emit from both sides. */
+					LightTreePrimitive prim;
+					prim.bounds = BoundBox(p1);
+					prim.bounds.grow(p2);
+					prim.bounds.grow(p3);
+					prim.energy = area;
+					prim.index = offset - 1;
+					light_tree_prims.push_back(prim);
+				}
 			}
 		}
 
@@ -378,6 +425,10 @@ void LightManager::device_update_distribution(Device *, DeviceScene *dscene, Sce
 		distribution[offset].w = light->size;
 		totarea += lightarea;
 
+		if(use_light_tree && light->type != LIGHT_DISTANT && light->type != LIGHT_BACKGROUND) {
+			light_tree_prims.push_back(light_tree_lamp_primitive(light, lightarea, offset));
+		}
+
 		if(light->size > 0.0f && light->use_mis)
 			use_lamp_mis = true;
 		if(light->type == LIGHT_BACKGROUND) {
@@ -395,6 +446,18 @@ void LightManager::device_update_distribution(Device *, DeviceScene *dscene, Sce
 	distribution[num_distribution].z = 0.0f;
 	distribution[num_distribution].w = 0.0f;
 
+	size_t num_tree_emitters = 0;
+	if(use_light_tree && !light_tree_prims.empty() && totarea > 0.0f) {
+		num_tree_emitters = device_update_tree(dscene,
+		                                       scene,
+		                                       light_tree_prims,
+		                                       distribution,
+		                                       num_distribution,
+		                                       num_lights);
+		/* Summed in a different order, keep it exactly consistent. */
+		totarea = distribution[num_distribution].x;
+	}
+
 	if(totarea > 0.0f) {
 		for(size_t i = 0; i < num_distribution; i++)
 			distribution[i].x /= totarea;
@@ -433,6 +496,20 @@ void LightManager::device_update_distribution(Device *, DeviceScene *dscene, Sce
 
 		kintegrator->use_lamp_mis = use_lamp_mis;
 
+		/* Lights outside of the tree keep their probability from the flat
+		 * distribution, all others are picked through the tree. */
+		kintegrator->use_light_tree = (num_tree_emitters > 0);
+		if(num_tree_emitters == 0) {
+			kintegrator->pdf_light_tree = 0.0f;
+		}
+		else if(num_tree_emitters == num_distribution) {
+			/* Exact, so the kernel never samples the empty range outside the tree. */
+			kintegrator->pdf_light_tree = 1.0f;
+		}
+		else {
+			kintegrator->pdf_light_tree = distribution[num_tree_emitters].x;
+		}
+
 		/* bit of an ugly hack to compensate for emitting triangles influencing
 		 * amount of samples we get for this pass */
 		kfilm->pass_shadow_scale = 1.0f;
@@ -460,18 +537,120 @@ void LightManager::device_update_distribution(Device *, DeviceScene *dscene, Sce
 	}
 	else {
 		dscene->light_distribution.free();
+		dscene->light_tree_nodes.free();
+		dscene->light_tree_emitters.free();
 
 		kintegrator->num_distribution = 0;
 		kintegrator->num_all_lights = 0;
 		kintegrator->pdf_triangles = 0.0f;
 		kintegrator->pdf_lights = 0.0f;
 		kintegrator->use_lamp_mis = false;
+		kintegrator->use_light_tree = false;
+		kintegrator->pdf_light_tree = 0.0f;
 		kintegrator->num_portals = 0;
 		kintegrator->portal_offset = 0;
 		kintegrator->portal_pdf = 0.0f;
 
 		kfilm->pass_shadow_scale = 1.0f;
 	}
+
+	/* Sample All Lights depends on whether the tree holds emitters. */
+	if(kintegrator->use_light_tree != had_light_tree) {
+		scene->integrator->need_update = true;
+	}
+}
+
+/* Build the light tree over all emitters with a position and reorder the
+ * distribution so every tree node covers a contiguous range of it, followed
+ * by distant and background lights. The cumulative values are rebuilt for the
+ * new order, and a lookup from lamps and mesh triangles to their distribution
+ * entry is uploaded for evaluating the pdf in multiple importance sampling.
+ * Returns the number of emitters in the tree. */
+size_t LightManager::device_update_tree(DeviceScene *dscene,
+                                        Scene *scene,
+                                        const vector<LightTreePrimitive>& prims,
+                                        float4 *distribution,
+                                        size_t num_distribution,
+                                        size_t num_lights)
+{
+	LightTree tree(prims, 4);
+	const vector<LightTreePrimitive>& ordered_prims = tree.get_primitives();
+	const vector<LightTreeNode>& nodes = tree.get_nodes();
+
+	/* Reorder distribution. */
+	vector<float4> entries(distribution, distribution + num_distribution + 1);
+	vector<size_t> order;
+	vector<bool> in_tree(num_distribution, false);
+
+	order.reserve(num_distribution);
+	foreach(const LightTreePrimitive& prim, ordered_prims) {
+		order.push_back(prim.index);
+		in_tree[prim.index] = true;
+	}
+	for(size_t i = 0; i < num_distribution; i++) {
+		if(!in_tree[i]) {
+			order.push_back(i);
+		}
+	}
+
+	float cdf = 0.0f;
+	for(size_t i = 0; i < num_distribution; i++) {
+		const size_t index = order[i];
+		const float mass = entries[index + 1].x - entries[index].x;
+
+		distribution[i] = entries[index];
+		distribution[i].x = cdf;
+		cdf += mass;
+	}
+	distribution[num_distribution].x = cdf;
+
+	/* Emitter lookup: lamps first, then for every object the offset of its
+	 * triangle block relative to the mesh triangle offset, then the blocks. */
+	size_t num_objects = scene->objects.size();
+	vector<int> object_block(num_objects, -1);
+	size_t num_emitters = num_lights + num_objects;
+
+	for(size_t i = 0; i < num_objects; i++) {
+		Object *object = scene->objects[i];
+		if(object_usable_as_light(object)) {
+			object_block[i] = num_emitters;
+			num_emitters += object->mesh->num_triangles();
+		}
+	}
+
+	uint *emitters = dscene->light_tree_emitters.alloc(num_emitters);
+	memset(emitters, 0xff, sizeof(uint)*num_emitters);
+
+	for(size_t i = 0; i < num_objects; i++) {
+		if(object_block[i] != -1) {
+			Mesh *mesh = scene->objects[i]->mesh;
+			emitters[num_lights + i] = (uint)(object_block[i] - (int)mesh->tri_offset);
+		}
+	}
+
+	for(size_t i = 0; i < num_distribution; i++) {
+		int prim = __float_as_int(distribution[i].y);
+
+		if(prim >= 0) {
+			int object = __float_as_int(distribution[i].w);
+			emitters[object_block[object] - scene->objects[object]->mesh->tri_offset + prim] = i;
+		}
+		else {
+			emitters[~prim] = i;
+		}
+	}
+
+	/* Nodes. */
+	float4 *tree_nodes = dscene->light_tree_nodes.alloc(nodes.size()*LIGHT_TREE_NODE_SIZE);
+	tree.pack(tree_nodes);
+
+	VLOG(1) << "Light tree with " << nodes.size() << " nodes for "
+	        << ordered_prims.size() << " emitters.";
+
+	dscene->light_tree_nodes.copy_to_device();
+	dscene->light_tree_emitters.copy_to_device();
+
+	return ordered_prims.size();
 }
 
 static void background_cdf(int start,
@@ -845,6 +1024,8 @@ void LightManager::device_free(Device *, DeviceScene *dscene)
 	dscene->light_data.free();
 	dscene->light_background_marginal_cdf.free();
 	dscene->light_background_conditional_cdf.free();
+	dscene->light_tree_nodes.free();
+	dscene->light_tree_emitters.free();
 }
 
 void LightManager::tag_update(Scene * /*scene*/)
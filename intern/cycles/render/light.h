@@ -29,6 +29,7 @@ CCL_NAMESPACE_BEGIN
 class Device;
 class DeviceScene;
 class Object;
+struct LightTreePrimitive;
 class Progress;
 class Scene;
 class Shader;
@@ -115,6 +116,12 @@ protected:
 	                              DeviceScene *dscene,
 	                              Scene *scene,
 	                              Progress& progress);
+	size_t device_update_tree(DeviceScene *dscene,
+	                          Scene *scene,
+	                          const vector<LightTreePrimitive>& prims,
+	                          float4 *distribution,
+	                          size_t num_distribution,
+	                          size_t num_lights);
 
 	/* Check whether light manager can use the object as a light-emissive. */
 	bool object_usable_as_light(Object *object);
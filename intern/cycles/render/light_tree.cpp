@@ -0,0 +1,252 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "render/light_tree.h"
+
+#include "kernel/kernel_types.h"
+
+#include "util/util_algorithm.h"
+#include "util/util_math.h"
+#include "util/util_transform.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Orientation Bounds */
+
+float LightTreeCone::measure() const
+{
+	const float theta_w = min(theta_o + theta_e, M_PI_F);
+	const float sin_theta_o = sinf(theta_o);
+	const float cos_theta_o = cosf(theta_o);
+
+	return M_2PI_F*(1.0f - cos_theta_o) +
+	       M_PI_2_F*(2.0f*theta_w*sin_theta_o - cosf(theta_o - 2.0f*theta_w) -
+	                 2.0f*theta_o*sin_theta_o + cos_theta_o);
+}
+
+LightTreeCone merge(const LightTreeCone& cone_a, const LightTreeCone& cone_b)
+{
+	/* Algorithm 1 from "Importance Sampling of Many Lights with Adaptive Tree
+	 * Splitting", with a being the wider cone. */
+	const bool a_is_wider = (cone_a.theta_o >= cone_b.theta_o);
+	const LightTreeCone& a = (a_is_wider)? cone_a: cone_b;
+	const LightTreeCone& b = (a_is_wider)? cone_b: cone_a;
+
+	const float theta_d = safe_acosf(dot(a.axis, b.axis));
+	const float theta_e = max(a.theta_e, b.theta_e);
+
+	if(min(theta_d + b.theta_o, M_PI_F) <= a.theta_o) {
+		return LightTreeCone(a.axis, a.theta_o, theta_e);
+	}
+
+	const float theta_o = 0.5f*(a.theta_o + theta_d + b.theta_o);
+	if(theta_o >= M_PI_F) {
+		return LightTreeCone(a.axis, M_PI_F, theta_e);
+	}
+
+	/* Rotate the axis of a towards b, for opposite axes any perpendicular
+	 * rotation axis will do. */
+	float3 rotation_axis = cross(a.axis, b.axis);
+	if(len_squared(rotation_axis) < 1e-12f) {
+		float3 unused;
+		make_orthonormals(a.axis, &rotation_axis, &unused);
+	}
+
+	Transform rotation = transform_rotate(theta_o - a.theta_o, rotation_axis);
+	float3 axis = normalize(transform_direction(&rotation, a.axis));
+
+	return LightTreeCone(axis, theta_o, theta_e);
+}
+
+/* Light Tree */
+
+LightTree::LightTree(const vector<LightTreePrimitive>& prims_, int max_prims_in_leaf_)
+: prims(prims_), max_prims_in_leaf(max_prims_in_leaf_)
+{
+	if(prims.empty()) {
+		return;
+	}
+
+	nodes.reserve(2*prims.size()/max(max_prims_in_leaf, 1) + 1);
+	recursive_build(0, prims.size());
+}
+
+int LightTree::recursive_build(int start, int end)
+{
+	LightTreeNode node;
+	BoundBox centroid_bounds = BoundBox::empty;
+
+	node.bounds = BoundBox::empty;
+	node.cone = prims[start].cone;
+	node.energy = 0.0f;
+	node.first = start;
+	node.num = end - start;
+	node.right_child = -1;
+
+	for(int i = start; i < end; i++) {
+		const LightTreePrimitive& prim = prims[i];
+
+		node.bounds.grow(prim.bounds);
+		centroid_bounds.grow(prim.bounds.center());
+		node.energy += prim.energy;
+		if(i != start) {
+			node.cone = merge(node.cone, prim.cone);
+		}
+	}
+
+	const int node_index = nodes.size();
+	nodes.push_back(node);
+
+	if(node.num <= max_prims_in_leaf) {
+		return node_index;
+	}
+
+	int middle = find_split(node, centroid_bounds);
+
+	if(middle == -1) {
+		/* All centroids coincide, nothing left to separate spatially. */
+		middle = start + node.num/2;
+	}
+
+	recursive_build(start, middle);
+	const int right_child = recursive_build(middle, end);
+	nodes[node_index].right_child = right_child;
+
+	return node_index;
+}
+
+/* Binned split along the axis with the lowest surface area orientation
+ * heuristic cost. Partitions the primitives of the node and returns the first
+ * primitive of the right child, or -1 if no split was found. */
+int LightTree::find_split(const LightTreeNode& node, const BoundBox& centroid_bounds)
+{
+	const int num_buckets = 12;
+
+	struct Bucket {
+		BoundBox bounds;
+		LightTreeCone cone;
+		float energy;
+		int count;
+	};
+
+	const float3 centroid_extent = centroid_bounds.size();
+	const float3 bounds_extent = node.bounds.size();
+	const float max_extent = max3(bounds_extent);
+
+	float best_cost = FLT_MAX;
+	int best_axis = -1;
+	int best_bucket = -1;
+
+	for(int axis = 0; axis < 3; axis++) {
+		if(centroid_extent[axis] == 0.0f) {
+			continue;
+		}
+
+		Bucket buckets[num_buckets];
+		for(int b = 0; b < num_buckets; b++) {
+			buckets[b].bounds = BoundBox::empty;
+			buckets[b].energy = 0.0f;
+			buckets[b].count = 0;
+		}
+
+		const float inv_extent = 1.0f/centroid_extent[axis];
+
+		for(int i = node.first; i < node.first + node.num; i++) {
+			const LightTreePrimitive& prim = prims[i];
+			const float offset = prim.bounds.center()[axis] - centroid_bounds.min[axis];
+			const int b = min((int)(offset*inv_extent*num_buckets), num_buckets - 1);
+
+			buckets[b].cone = (buckets[b].count)? merge(buckets[b].cone, prim.cone): prim.cone;
+			buckets[b].bounds.grow(prim.bounds);
+			buckets[b].energy += prim.energy;
+			buckets[b].count++;
+		}
+
+		/* Penalize splitting thin boxes along their short axis. */
+		const float regularization = max_extent/bounds_extent[axis];
+
+		for(int split = 1; split < num_buckets; split++) {
+			Bucket left = buckets[0], right = buckets[num_buckets - 1];
+
+			for(int b = 1; b < split; b++) {
+				if(buckets[b].count == 0) continue;
+				left.cone = (left.count)? merge(left.cone, buckets[b].cone): buckets[b].cone;
+				left.bounds.grow(buckets[b].bounds);
+				left.energy += buckets[b].energy;
+				left.count += buckets[b].count;
+			}
+			for(int b = split; b < num_buckets - 1; b++) {
+				if(buckets[b].count == 0) continue;
+				right.cone = (right.count)? merge(right.cone, buckets[b].cone): buckets[b].cone;
+				right.bounds.grow(buckets[b].bounds);
+				right.energy += buckets[b].energy;
+				right.count += buckets[b].count;
+			}
+
+			if(left.count == 0 || right.count == 0) {
+				continue;
+			}
+
+			const float cost = regularization *
+				(left.energy*left.bounds.area()*left.cone.measure() +
+				 right.energy*right.bounds.area()*right.cone.measure());
+
+			if(cost < best_cost) {
+				best_cost = cost;
+				best_axis = axis;
+				best_bucket = split;
+			}
+		}
+	}
+
+	if(best_axis == -1) {
+		return -1;
+	}
+
+	/* Partition primitives in place. */
+	const float inv_extent = 1.0f/centroid_extent[best_axis];
+	int middle = node.first;
+
+	for(int i = node.first; i < node.first + node.num; i++) {
+		const float offset = prims[i].bounds.center()[best_axis] - centroid_bounds.min[best_axis];
+		const int b = min((int)(offset*inv_extent*num_buckets), num_buckets - 1);
+
+		if(b < best_bucket) {
+			swap(prims[i], prims[middle]);
+			middle++;
+		}
+	}
+
+	return middle;
+}
+
+void LightTree::pack(float4 *data) const
+{
+	for(size_t i = 0; i < nodes.size(); i++) {
+		const LightTreeNode& node = nodes[i];
+		float4 *ndata = data + i*LIGHT_TREE_NODE_SIZE;
+
+		ndata[0] = make_float4(node.bounds.min.x, node.bounds.min.y, node.bounds.min.z, node.energy);
+		ndata[1] = make_float4(node.bounds.max.x, node.bounds.max.y, node.bounds.max.z, node.cone.theta_o);
+		ndata[2] = make_float4(node.cone.axis.x, node.cone.axis.y, node.cone.axis.z, node.cone.theta_e);
+		ndata[3] = make_float4(__int_as_float(node.first),
+		                       __int_as_float(node.num),
+		                       __int_as_float(node.right_child),
+		                       0.0f);
+	}
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LIGHT_TREE_H__
+#define __LIGHT_TREE_H__
+
+#include "util/util_boundbox.h"
+#include "util/util_types.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Orientation Bounds
+ *
+ * All surface normals of the bounded emitters are within theta_o of the axis,
+ * and every one of them emits light up to theta_e away from its normal. */
+
+struct LightTreeCone {
+	float3 axis;
+	float theta_o;
+	float theta_e;
+
+	LightTreeCone()
+	: axis(make_float3(0.0f, 0.0f, 1.0f)), theta_o(M_PI_F), theta_e(M_PI_2_F) {}
+
+	LightTreeCone(const float3& axis_, float theta_o_, float theta_e_)
+	: axis(axis_), theta_o(theta_o_), theta_e(theta_e_) {}
+
+	/* Solid angle measure used by the split heuristic. */
+	float measure() const;
+};
+
+LightTreeCone merge(const LightTreeCone& a, const LightTreeCone& b);
+
+/* Emitter as seen by the builder, index refers to its light distribution entry. */
+
+struct LightTreePrimitive {
+	BoundBox bounds;
+	LightTreeCone cone;
+	float energy;
+	int index;
+};
+
+struct LightTreeNode {
+	BoundBox bounds;
+	LightTreeCone cone;
+	float energy;
+	int first;
+	int num;
+	/* Left child always directly follows its parent, -1 for leaves. */
+	int right_child;
+};
+
+/* Light Tree
+ *
+ * Binary tree over the emitters with a finite position, built top-down with
+ * the surface area orientation heuristic from "Importance Sampling of Many
+ * Lights with Adaptive Tree Splitting", Conty Estevez and Kulla 2018.
+ * Primitives are reordered so that every node covers a contiguous range. */
+
+class LightTree {
+public:
+	LightTree(const vector<LightTreePrimitive>& prims, int max_prims_in_leaf);
+
+	const vector<LightTreePrimitive>& get_primitives() const { return prims; }
+	const vector<LightTreeNode>& get_nodes() const { return nodes; }
+
+	/* Pack nodes into LIGHT_TREE_NODE_SIZE float4 each. */
+	void pack(float4 *data) const;
+
+protected:
+	int recursive_build(int start, int end);
+	int find_split(const LightTreeNode& node, const BoundBox& centroid_bounds);
+
+	vector<LightTreePrimitive> prims;
+	vector<LightTreeNode> nodes;
+	int max_prims_in_leaf;
+};
+
+CCL_NAMESPACE_END
+
+#endif /* __LIGHT_TREE_H__ */
@@ -35,6 +35,7 @@
 
 #include "util/util_foreach.h"
 #include "util/util_logging.h"
+#include "util/util_md5.h"
 #include "util/util_progress.h"
 #include "util/util_set.h"
 
@@ -129,7 +130,12 @@ bool Mesh::Triangle::valid(const float3 *verts) const
 
 /* Curve */
 
-void Mesh::Curve::bounds_grow(const int k, const float3 *curve_keys, const float *curve_radius, BoundBox& bounds) const
+void Mesh::Curve::bounds_grow(const int k,
+                              const float3 *curve_keys,
+                              const float *curve_radius,
+                              BoundBox& bounds,
+                              float t_start,
+                              float t_end) const
 {
 	float3 P[4];
 
@@ -141,11 +147,22 @@ void Mesh::Curve::bounds_grow(const int k, const float3 *curve_keys, const float
 	float3 lower;
 	float3 upper;
 
-	curvebounds(&lower.x, &upper.x, P, 0);
-	curvebounds(&lower.y, &upper.y, P, 1);
-	curvebounds(&lower.z, &upper.z, P, 2);
+	curvebounds(&lower.x, &upper.x, P, 0, t_start, t_end);
+	curvebounds(&lower.y, &upper.y, P, 1, t_start, t_end);
+	curvebounds(&lower.z, &upper.z, P, 2, t_start, t_end);
 
-	float mr = max(curve_radius[first_key + k], curve_radius[first_key + k + 1]);
+	float r0 = curve_radius[first_key + k];
+	float r1 = curve_radius[first_key + k + 1];
+	float mr = max(r0 + (r1 - r0) * t_start, r0 + (r1 - r0) * t_end);
+
+	if(t_start != 0.0f || t_end != 1.0f) {
+		/* Also contain the same range of the straight line segment, which is
+		 * intersected instead when curve interpolation is disabled. */
+		float3 l_start = P[1] + (P[2] - P[1]) * t_start;
+		float3 l_end = P[1] + (P[2] - P[1]) * t_end;
+		lower = min(lower, min(l_start, l_end));
+		upper = max(upper, max(l_start, l_end));
+	}
 
 	bounds.grow(lower, mr);
 	bounds.grow(upper, mr);
@@ -155,7 +172,9 @@ void Mesh::Curve::bounds_grow(const int k,
                               const float3 *curve_keys,
                               const float *curve_radius,
                               const Transform& aligned_space,
-                              BoundBox& bounds) const
+                              BoundBox& bounds,
+                              float t_start,
+                              float t_end) const
 {
 	float3 P[4];
 
@@ -172,11 +191,22 @@ void Mesh::Curve::bounds_grow(const int k,
 	float3 lower;
 	float3 upper;
 
-	curvebounds(&lower.x, &upper.x, P, 0);
-	curvebounds(&lower.y, &upper.y, P, 1);
-	curvebounds(&lower.z, &upper.z, P, 2);
+	curvebounds(&lower.x, &upper.x, P, 0, t_start, t_end);
+	curvebounds(&lower.y, &upper.y, P, 1, t_start, t_end);
+	curvebounds(&lower.z, &upper.z, P, 2, t_start, t_end);
 
-	float mr = max(curve_radius[first_key + k], curve_radius[first_key + k + 1]);
+	float r0 = curve_radius[first_key + k];
+	float r1 = curve_radius[first_key + k + 1];
+	float mr = max(r0 + (r1 - r0) * t_start, r0 + (r1 - r0) * t_end);
+
+	if(t_start != 0.0f || t_end != 1.0f) {
+		/* Also contain the same range of the straight line segment, which is
+		 * intersected instead when curve interpolation is disabled. */
+		float3 l_start = P[1] + (P[2] - P[1]) * t_start;
+		float3 l_end = P[1] + (P[2] - P[1]) * t_end;
+		lower = min(lower, min(l_start, l_end));
+		upper = max(upper, max(l_start, l_end));
+	}
 
 	bounds.grow(lower, mr);
 	bounds.grow(upper, mr);
@@ -204,6 +234,26 @@ void Mesh::Curve::bounds_grow(float4 keys[4], BoundBox& bounds) const
 	bounds.grow(upper, mr);
 }
 
+float3 Mesh::Curve::evaluate(const int k, const float3 *curve_keys, float t) const
+{
+	float3 P[4];
+
+	P[0] = curve_keys[max(first_key + k - 1,first_key)];
+	P[1] = curve_keys[first_key + k];
+	P[2] = curve_keys[first_key + k + 1];
+	P[3] = curve_keys[min(first_key + k + 2, first_key + num_keys - 1)];
+
+	/* Same cardinal basis as used for rendering. */
+	float fc = 0.71f;
+	float3 curve_coef[4];
+	curve_coef[0] = P[1];
+	curve_coef[1] = -fc*P[0] + fc*P[2];
+	curve_coef[2] = 2.0f * fc * P[0] + (fc - 3.0f) * P[1] + (3.0f - 2.0f * fc) * P[2] - fc * P[3];
+	curve_coef[3] = -fc * P[0] + (2.0f - fc) * P[1] + (fc - 2.0f) * P[2] + fc * P[3];
+
+	return ((curve_coef[3] * t + curve_coef[2]) * t + curve_coef[1]) * t + curve_coef[0];
+}
+
 void Mesh::Curve::motion_keys(const float3 *curve_keys,
                               const float *curve_radius,
                               const float3 *key_steps,
@@ -453,6 +503,7 @@ Mesh::Mesh()
 
 	subdivision_type = SUBDIVISION_NONE;
 	subd_params = NULL;
+	dicing_cache = NULL;
 
 	patch_table = NULL;
 }
@@ -462,6 +513,7 @@ Mesh::~Mesh()
 	delete bvh;
 	delete patch_table;
 	delete subd_params;
+	delete dicing_cache;
 }
 
 void Mesh::resize_mesh(int numverts, int numtris)
@@ -1048,12 +1100,15 @@ void Mesh::compute_bvh(Device *device,
 		vector<Object*> objects;
 		objects.push_back(&object);
 
+		bool refitted = false;
+
 		if(bvh && !need_update_rebuild) {
 			progress->set_status(msg, "Refitting BVH");
 			bvh->objects = objects;
-			bvh->refit(*progress);
+			refitted = bvh->refit(*progress);
 		}
-		else {
+
+		if(!refitted) {
 			progress->set_status(msg, "Building BVH");
 
 			BVHParams bparams;
@@ -1065,6 +1120,7 @@ void Mesh::compute_bvh(Device *device,
 			                              params->use_bvh_unaligned_nodes;
 			bparams.num_motion_triangle_steps = params->num_bvh_time_steps;
 			bparams.num_motion_curve_steps = params->num_bvh_time_steps;
+			bparams.use_cache = params->use_bvh_cache;
 
 			delete bvh;
 			bvh = BVH::create(bparams, objects);
@@ -1094,6 +1150,80 @@ void Mesh::tag_update(Scene *scene, bool rebuild)
 	scene->object_manager->need_update = true;
 }
 
+static void mesh_hash_data(MD5Hash& md5, const void *data, size_t size)
+{
+	const uint8_t *bytes = (const uint8_t*)data;
+
+	md5.append((const uint8_t*)&size, sizeof(size));
+
+	/* MD5Hash takes int sizes, split huge buffers. */
+	while(size > 0) {
+		const int chunk = (int)min(size, (size_t)(1 << 30));
+		md5.append(bytes, chunk);
+		bytes += chunk;
+		size -= chunk;
+	}
+}
+
+template<typename T>
+static void mesh_hash_array(MD5Hash& md5, const array<T>& data)
+{
+	mesh_hash_data(md5, data.data(), data.size()*sizeof(T));
+}
+
+static void mesh_hash_attributes(MD5Hash& md5, const AttributeSet& attributes)
+{
+	foreach(const Attribute& attr, attributes.attributes) {
+		md5.append(attr.name.string());
+		md5.append(attr.type.c_str());
+		md5.append((const uint8_t*)&attr.std, sizeof(attr.std));
+		md5.append((const uint8_t*)&attr.element, sizeof(attr.element));
+		md5.append((const uint8_t*)&attr.flags, sizeof(attr.flags));
+		mesh_hash_data(md5, attr.data(), attr.buffer.size());
+	}
+}
+
+string Mesh::compute_content_hash() const
+{
+	MD5Hash md5;
+
+	md5.append((const uint8_t*)&subdivision_type, sizeof(subdivision_type));
+	md5.append((const uint8_t*)&geometry_flags, sizeof(geometry_flags));
+
+	foreach(Shader *shader, used_shaders) {
+		md5.append((const uint8_t*)&shader, sizeof(shader));
+	}
+
+	mesh_hash_array(md5, verts);
+	mesh_hash_array(md5, triangles);
+	mesh_hash_array(md5, shader);
+	mesh_hash_array(md5, smooth);
+
+	mesh_hash_array(md5, curve_keys);
+	mesh_hash_array(md5, curve_radius);
+	mesh_hash_array(md5, curve_first_key);
+	mesh_hash_array(md5, curve_shader);
+
+	/* Hash face members one by one, the struct has padding. */
+	for(size_t i = 0; i < subd_faces.size(); i++) {
+		const SubdFace& face = subd_faces[i];
+		const int face_data[5] = {face.start_corner,
+		                          face.num_corners,
+		                          face.shader,
+		                          (int)face.smooth,
+		                          face.ptex_offset};
+		md5.append((const uint8_t*)face_data, sizeof(face_data));
+	}
+	mesh_hash_array(md5, subd_face_corners);
+	mesh_hash_array(md5, subd_creases);
+
+	mesh_hash_attributes(md5, attributes);
+	mesh_hash_attributes(md5, curve_attributes);
+	mesh_hash_attributes(md5, subd_attributes);
+
+	return md5.get_hex();
+}
+
 bool Mesh::has_motion_blur() const
 {
 	return (use_motion_blur &&
@@ -1133,10 +1263,12 @@ MeshManager::MeshManager()
 {
 	need_update = true;
 	need_flags_update = true;
+	bvh = NULL;
 }
 
 MeshManager::~MeshManager()
 {
+	delete bvh;
 }
 
 void MeshManager::update_osl_attributes(Device *device, Scene *scene, vector<AttributeRequestSet>& mesh_attributes)
@@ -1630,6 +1762,38 @@ void MeshManager::device_update_attributes(Device *device, DeviceScene *dscene,
 	scene->object_manager->device_update_mesh_offsets(device, dscene, scene);
 }
 
+string MeshManager::packed_mesh_layout(Scene *scene)
+{
+	MD5Hash md5;
+	ShaderManager *shader_manager = scene->shader_manager;
+
+	int default_id = shader_manager->get_shader_id(scene->default_surface);
+	md5.append((const uint8_t*)&default_id, sizeof(default_id));
+
+	foreach(Mesh *mesh, scene->meshes) {
+		const size_t layout[] = {(size_t)mesh,
+		                         mesh->vert_offset,
+		                         mesh->verts.size(),
+		                         mesh->tri_offset,
+		                         mesh->num_triangles(),
+		                         mesh->curvekey_offset,
+		                         mesh->curve_keys.size(),
+		                         mesh->curve_offset,
+		                         mesh->num_curves(),
+		                         mesh->patch_offset,
+		                         mesh->subd_faces.size()};
+		md5.append((const uint8_t*)layout, sizeof(layout));
+
+		/* Packed shader ids depend on the position of shaders in the scene. */
+		foreach(Shader *shader, mesh->used_shaders) {
+			int id = shader_manager->get_shader_id(shader);
+			md5.append((const uint8_t*)&id, sizeof(id));
+		}
+	}
+
+	return md5.get_hex();
+}
+
 void MeshManager::mesh_calc_offset(Scene *scene)
 {
 	size_t vert_size = 0;
@@ -1678,7 +1842,8 @@ void MeshManager::device_update_mesh(Device *,
                                      DeviceScene *dscene,
                                      Scene *scene,
                                      bool for_displacement,
-                                     Progress& progress)
+                                     Progress& progress,
+                                     const vector<bool> *need_pack)
 {
 	/* Count. */
 	size_t vert_size = 0;
@@ -1741,7 +1906,18 @@ void MeshManager::device_update_mesh(Device *,
 		uint *tri_patch = dscene->tri_patch.alloc(tri_size);
 		float2 *tri_patch_uv = dscene->tri_patch_uv.alloc(vert_size);
 
-		foreach(Mesh *mesh, scene->meshes) {
+		/* Devices without ranged copies for these arrays would upload all of
+		 * them for every changed mesh, upload once after packing instead.
+		 * All arrays share the same memory type. */
+		const bool copy_ranges = need_pack && dscene->tri_shader.copy_to_device_range_supported();
+
+		for(size_t i = 0; i < scene->meshes.size(); i++) {
+			Mesh *mesh = scene->meshes[i];
+
+			if(need_pack && !(*need_pack)[i]) {
+				continue;
+			}
+
 			mesh->pack_normals(scene,
 			                   &tri_shader[mesh->tri_offset],
 			                   &vnormal[mesh->vert_offset]);
@@ -1751,17 +1927,32 @@ void MeshManager::device_update_mesh(Device *,
 			                 &tri_patch_uv[mesh->vert_offset],
 			                 mesh->vert_offset,
 			                 mesh->tri_offset);
+
+			if(copy_ranges) {
+				/* Arrays are already on the device, only upload this mesh. */
+				size_t num_triangles = mesh->num_triangles();
+				size_t num_verts = mesh->verts.size();
+
+				dscene->tri_shader.copy_to_device(mesh->tri_offset, num_triangles);
+				dscene->tri_vnormal.copy_to_device(mesh->vert_offset, num_verts);
+				dscene->tri_vindex.copy_to_device(mesh->tri_offset, num_triangles);
+				dscene->tri_patch.copy_to_device(mesh->tri_offset, num_triangles);
+				dscene->tri_patch_uv.copy_to_device(mesh->vert_offset, num_verts);
+			}
+
 			if(progress.get_cancel()) return;
 		}
 
-		/* vertex coordinates */
-		progress.set_status("Updating Mesh", "Copying Mesh to device");
+		if(!copy_ranges) {
+			/* vertex coordinates */
+			progress.set_status("Updating Mesh", "Copying Mesh to device");
 
-		dscene->tri_shader.copy_to_device();
-		dscene->tri_vnormal.copy_to_device();
-		dscene->tri_vindex.copy_to_device();
-		dscene->tri_patch.copy_to_device();
-		dscene->tri_patch_uv.copy_to_device();
+			dscene->tri_shader.copy_to_device();
+			dscene->tri_vnormal.copy_to_device();
+			dscene->tri_vindex.copy_to_device();
+			dscene->tri_patch.copy_to_device();
+			dscene->tri_patch_uv.copy_to_device();
+		}
 	}
 
 	if(curve_size != 0) {
@@ -1770,13 +1961,29 @@ void MeshManager::device_update_mesh(Device *,
 		float4 *curve_keys = dscene->curve_keys.alloc(curve_key_size);
 		float4 *curves = dscene->curves.alloc(curve_size);
 
-		foreach(Mesh *mesh, scene->meshes) {
+		const bool copy_ranges = need_pack && dscene->curve_keys.copy_to_device_range_supported();
+
+		for(size_t i = 0; i < scene->meshes.size(); i++) {
+			Mesh *mesh = scene->meshes[i];
+
+			if(need_pack && !(*need_pack)[i]) {
+				continue;
+			}
+
 			mesh->pack_curves(scene, &curve_keys[mesh->curvekey_offset], &curves[mesh->curve_offset], mesh->curvekey_offset);
+
+			if(copy_ranges) {
+				dscene->curve_keys.copy_to_device(mesh->curvekey_offset, mesh->curve_keys.size());
+				dscene->curves.copy_to_device(mesh->curve_offset, mesh->num_curves());
+			}
+
 			if(progress.get_cancel()) return;
 		}
 
-		dscene->curve_keys.copy_to_device();
-		dscene->curves.copy_to_device();
+		if(!copy_ranges) {
+			dscene->curve_keys.copy_to_device();
+			dscene->curves.copy_to_device();
+		}
 	}
 
 	if(patch_size != 0) {
@@ -1784,7 +1991,13 @@ void MeshManager::device_update_mesh(Device *,
 
 		uint *patch_data = dscene->patches.alloc(patch_size);
 
-		foreach(Mesh *mesh, scene->meshes) {
+		for(size_t i = 0; i < scene->meshes.size(); i++) {
+			Mesh *mesh = scene->meshes[i];
+
+			if(need_pack && !(*need_pack)[i]) {
+				continue;
+			}
+
 			mesh->pack_patches(&patch_data[mesh->patch_offset], mesh->vert_offset, mesh->face_offset, mesh->corner_offset);
 
 			if(mesh->patch_table) {
@@ -1794,6 +2007,7 @@ void MeshManager::device_update_mesh(Device *,
 			if(progress.get_cancel()) return;
 		}
 
+		/* Patch tables are interleaved with the patches, upload everything. */
 		dscene->patches.copy_to_device();
 	}
 
@@ -1812,11 +2026,58 @@ void MeshManager::device_update_mesh(Device *,
 	}
 }
 
-void MeshManager::device_update_bvh(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress)
+/* The top level BVH can be refitted when the objects and their meshes are
+ * the same as when it was built, and no mesh changed topology. */
+bool MeshManager::bvh_can_refit(Scene *scene, const BVHParams& bparams)
+{
+	if(!bvh ||
+	   bvh->params.bvh_layout != bparams.bvh_layout ||
+	   bvh->params.use_unaligned_nodes != bparams.use_unaligned_nodes ||
+	   bvh->objects.size() != scene->objects.size())
+	{
+		return false;
+	}
+
+	for(size_t i = 0; i < scene->objects.size(); i++) {
+		const Object *object = scene->objects[i];
+
+		if(bvh->objects[i] != object ||
+		   bvh_meshes[i] != object->mesh ||
+		   bvh_instanced[i] != object->mesh->need_build_bvh())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* Copy packed BVH data to the device, the host side is kept if the BVH is
+ * kept for refitting. */
+template<typename T>
+static void bvh_pack_copy_to_device(device_vector<T>& dvec, array<T>& data, bool keep_data)
 {
-	/* bvh build */
-	progress.set_status("Updating Scene BVH", "Building");
+	if(data.size() == 0) {
+		return;
+	}
+
+	if(keep_data) {
+		T *dst = dvec.alloc(data.size());
+		memcpy(dst, data.data(), sizeof(T)*data.size());
+	}
+	else {
+		dvec.steal_data(data);
+	}
 
+	dvec.copy_to_device();
+}
+
+bool MeshManager::device_update_bvh(Device *device,
+                                    DeviceScene *dscene,
+                                    Scene *scene,
+                                    bool need_rebuild,
+                                    Progress& progress)
+{
 	BVHParams bparams;
 	bparams.top_level = true;
 	bparams.bvh_layout = BVHParams::best_bvh_layout(
@@ -1827,69 +2088,66 @@ void MeshManager::device_update_bvh(Device *device, DeviceScene *dscene, Scene *
 	                              scene->params.use_bvh_unaligned_nodes;
 	bparams.num_motion_triangle_steps = scene->params.num_bvh_time_steps;
 	bparams.num_motion_curve_steps = scene->params.num_bvh_time_steps;
+	bparams.use_cache = scene->params.use_bvh_cache;
 
 	VLOG(1) << "Using " << bvh_layout_name(bparams.bvh_layout)
 	        << " layout.";
 
-	BVH *bvh = BVH::create(bparams, scene->objects);
-	bvh->build(progress);
+	bool refitted = false;
+
+	if(scene->params.use_bvh_refit && !need_rebuild && bvh_can_refit(scene, bparams)) {
+		progress.set_status("Updating Scene BVH", "Refitting");
+		refitted = bvh->refit(progress);
+	}
+
+	if(!refitted) {
+		progress.set_status("Updating Scene BVH", "Building");
+
+		delete bvh;
+		bvh = BVH::create(bparams, scene->objects);
+		bvh->build(progress);
+
+		bvh_meshes.clear();
+		bvh_instanced.clear();
+		foreach(Object *object, scene->objects) {
+			bvh_meshes.push_back(object->mesh);
+			bvh_instanced.push_back(object->mesh->need_build_bvh());
+		}
+	}
 
 	if(progress.get_cancel()) {
 		delete bvh;
-		return;
+		bvh = NULL;
+		return false;
 	}
 
 	/* copy to device */
 	progress.set_status("Updating Scene BVH", "Copying BVH to device");
 
 	PackedBVH& pack = bvh->pack;
-
-	if(pack.nodes.size()) {
-		dscene->bvh_nodes.steal_data(pack.nodes);
-		dscene->bvh_nodes.copy_to_device();
-	}
-	if(pack.leaf_nodes.size()) {
-		dscene->bvh_leaf_nodes.steal_data(pack.leaf_nodes);
-		dscene->bvh_leaf_nodes.copy_to_device();
-	}
-	if(pack.object_node.size()) {
-		dscene->object_node.steal_data(pack.object_node);
-		dscene->object_node.copy_to_device();
-	}
-	if(pack.prim_tri_index.size()) {
-		dscene->prim_tri_index.steal_data(pack.prim_tri_index);
-		dscene->prim_tri_index.copy_to_device();
-	}
-	if(pack.prim_tri_verts.size()) {
-		dscene->prim_tri_verts.steal_data(pack.prim_tri_verts);
-		dscene->prim_tri_verts.copy_to_device();
-	}
-	if(pack.prim_type.size()) {
-		dscene->prim_type.steal_data(pack.prim_type);
-		dscene->prim_type.copy_to_device();
-	}
-	if(pack.prim_visibility.size()) {
-		dscene->prim_visibility.steal_data(pack.prim_visibility);
-		dscene->prim_visibility.copy_to_device();
-	}
-	if(pack.prim_index.size()) {
-		dscene->prim_index.steal_data(pack.prim_index);
-		dscene->prim_index.copy_to_device();
-	}
-	if(pack.prim_object.size()) {
-		dscene->prim_object.steal_data(pack.prim_object);
-		dscene->prim_object.copy_to_device();
-	}
-	if(pack.prim_time.size()) {
-		dscene->prim_time.steal_data(pack.prim_time);
-		dscene->prim_time.copy_to_device();
-	}
+	const bool keep_bvh = scene->params.use_bvh_refit;
+
+	bvh_pack_copy_to_device(dscene->bvh_nodes, pack.nodes, keep_bvh);
+	bvh_pack_copy_to_device(dscene->bvh_leaf_nodes, pack.leaf_nodes, keep_bvh);
+	bvh_pack_copy_to_device(dscene->object_node, pack.object_node, keep_bvh);
+	bvh_pack_copy_to_device(dscene->prim_tri_index, pack.prim_tri_index, keep_bvh);
+	bvh_pack_copy_to_device(dscene->prim_tri_verts, pack.prim_tri_verts, keep_bvh);
+	bvh_pack_copy_to_device(dscene->prim_type, pack.prim_type, keep_bvh);
+	bvh_pack_copy_to_device(dscene->prim_visibility, pack.prim_visibility, keep_bvh);
+	bvh_pack_copy_to_device(dscene->prim_index, pack.prim_index, keep_bvh);
+	bvh_pack_copy_to_device(dscene->prim_object, pack.prim_object, keep_bvh);
+	bvh_pack_copy_to_device(dscene->prim_time, pack.prim_time, keep_bvh);
 
 	dscene->data.bvh.root = pack.root_index;
 	dscene->data.bvh.bvh_layout = bparams.bvh_layout;
 	dscene->data.bvh.use_bvh_steps = (scene->params.num_bvh_time_steps != 0);
 
-	delete bvh;
+	if(!keep_bvh) {
+		delete bvh;
+		bvh = NULL;
+	}
+
+	return refitted;
 }
 
 void MeshManager::device_update_flags(Device * /*device*/,
@@ -1954,6 +2212,12 @@ void MeshManager::device_update_displacement_images(Device *device,
 	pool.wait_work();
 }
 
+static bool mesh_bvh_build_order(const Mesh *a, const Mesh *b)
+{
+	return a->num_triangles() + a->curve_keys.size() >
+	       b->num_triangles() + b->curve_keys.size();
+}
+
 void MeshManager::device_update(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress)
 {
 	if(!need_update)
@@ -2008,7 +2272,7 @@ void MeshManager::device_update(Device *device, DeviceScene *dscene, Scene *scen
 			progress.set_status("Updating Mesh", msg);
 
 			DiagSplit dsplit(*mesh->subd_params);
-			mesh->tessellate(&dsplit);
+			mesh->tessellate(&dsplit, scene->params.use_dicing_cache);
 
 			i++;
 
@@ -2039,9 +2303,15 @@ void MeshManager::device_update(Device *device, DeviceScene *dscene, Scene *scen
 	}
 
 	/* Device update. */
-	device_free(device, dscene);
-
 	mesh_calc_offset(scene);
+
+	/* Keep the packed mesh arrays when the meshes still map to the same
+	 * ranges in them, then only meshes tagged for update are repacked. */
+	string layout = packed_mesh_layout(scene);
+	bool repack_mesh = true_displacement_used || layout != packed_layout;
+
+	device_free(device, dscene, repack_mesh);
+
 	if(true_displacement_used) {
 		device_update_mesh(device, dscene, scene, true, progress);
 	}
@@ -2065,36 +2335,54 @@ void MeshManager::device_update(Device *device, DeviceScene *dscene, Scene *scen
 
 	/* Device re-update after displacement. */
 	if(displacement_done) {
-		device_free(device, dscene);
+		device_free(device, dscene, repack_mesh);
 
 		device_update_attributes(device, dscene, scene, progress);
 		if(progress.get_cancel()) return;
 	}
 
-	/* Update bvh. */
+	/* Update bvh. The rebuild tag is reset by building the mesh BVHs, so the
+	 * top level BVH needs to know up front whether it can be refitted. */
 	size_t num_bvh = 0;
-	foreach(Mesh *mesh, scene->meshes) {
+	bool need_bvh_rebuild = false;
+	vector<bool> need_pack(scene->meshes.size(), false);
+
+	for(size_t j = 0; j < scene->meshes.size(); j++) {
+		Mesh *mesh = scene->meshes[j];
+
 		if(mesh->need_update && mesh->need_build_bvh()) {
 			num_bvh++;
 		}
+		if(mesh->need_update && mesh->need_update_rebuild) {
+			need_bvh_rebuild = true;
+		}
+		need_pack[j] = mesh->need_update;
 	}
 
+	/* Start the largest builds first, so they do not end up running alone at
+	 * the end of the update while smaller meshes fill in the other threads. */
+	vector<Mesh*> bvh_meshes;
+	foreach(Mesh *mesh, scene->meshes) {
+		if(mesh->need_update) {
+			bvh_meshes.push_back(mesh);
+		}
+	}
+	std::stable_sort(bvh_meshes.begin(), bvh_meshes.end(), mesh_bvh_build_order);
+
 	TaskPool pool;
 
 	i = 0;
-	foreach(Mesh *mesh, scene->meshes) {
-		if(mesh->need_update) {
-			pool.push(function_bind(&Mesh::compute_bvh,
-			                        mesh,
-			                        device,
-			                        dscene,
-			                        &scene->params,
-			                        &progress,
-			                        i,
-			                        num_bvh));
-			if(mesh->need_build_bvh()) {
-				i++;
-			}
+	foreach(Mesh *mesh, bvh_meshes) {
+		pool.push(function_bind(&Mesh::compute_bvh,
+		                        mesh,
+		                        device,
+		                        dscene,
+		                        &scene->params,
+		                        &progress,
+		                        i,
+		                        num_bvh));
+		if(mesh->need_build_bvh()) {
+			i++;
 		}
 	}
 
@@ -2118,11 +2406,20 @@ void MeshManager::device_update(Device *device, DeviceScene *dscene, Scene *scen
 
 	if(progress.get_cancel()) return;
 
-	device_update_bvh(device, dscene, scene, progress);
+	bool bvh_refitted = device_update_bvh(device, dscene, scene, need_bvh_rebuild, progress);
 	if(progress.get_cancel()) return;
 
-	device_update_mesh(device, dscene, scene, false, progress);
+	/* A rebuilt BVH reorders primitives, which changes the packed vertex
+	 * indices of every mesh. */
+	if(!bvh_refitted) {
+		repack_mesh = true;
+	}
+
+	packed_layout = "";
+	device_update_mesh(device, dscene, scene, false, progress,
+	                   (repack_mesh)? NULL: &need_pack);
 	if(progress.get_cancel()) return;
+	packed_layout = layout;
 
 	need_update = false;
 
@@ -2137,7 +2434,21 @@ void MeshManager::device_update(Device *device, DeviceScene *dscene, Scene *scen
 	}
 }
 
-void MeshManager::device_free(Device *device, DeviceScene *dscene)
+void MeshManager::device_free_packed_mesh(DeviceScene *dscene)
+{
+	dscene->tri_shader.free();
+	dscene->tri_vnormal.free();
+	dscene->tri_vindex.free();
+	dscene->tri_patch.free();
+	dscene->tri_patch_uv.free();
+	dscene->curves.free();
+	dscene->curve_keys.free();
+	dscene->patches.free();
+
+	packed_layout = "";
+}
+
+void MeshManager::device_free(Device *device, DeviceScene *dscene, bool free_packed_mesh)
 {
 	dscene->bvh_nodes.free();
 	dscene->bvh_leaf_nodes.free();
@@ -2149,14 +2460,9 @@ void MeshManager::device_free(Device *device, DeviceScene *dscene)
 	dscene->prim_index.free();
 	dscene->prim_object.free();
 	dscene->prim_time.free();
-	dscene->tri_shader.free();
-	dscene->tri_vnormal.free();
-	dscene->tri_vindex.free();
-	dscene->tri_patch.free();
-	dscene->tri_patch_uv.free();
-	dscene->curves.free();
-	dscene->curve_keys.free();
-	dscene->patches.free();
+	if(free_packed_mesh) {
+		device_free_packed_mesh(dscene);
+	}
 	dscene->attributes_map.free();
 	dscene->attributes_float.free();
 	dscene->attributes_float3.free();
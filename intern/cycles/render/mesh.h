@@ -34,6 +34,7 @@ CCL_NAMESPACE_BEGIN
 
 class Attribute;
 class BVH;
+class BVHParams;
 class Device;
 class DeviceScene;
 class Mesh;
@@ -96,16 +97,24 @@ public:
 
 		int num_segments() { return num_keys - 1; }
 
+		/* Bounds of segment k, or of the part of it between t_start and t_end. */
 		void bounds_grow(const int k,
 		                 const float3 *curve_keys,
 		                 const float *curve_radius,
-		                 BoundBox& bounds) const;
+		                 BoundBox& bounds,
+		                 float t_start = 0.0f,
+		                 float t_end = 1.0f) const;
 		void bounds_grow(float4 keys[4], BoundBox& bounds) const;
 		void bounds_grow(const int k,
 		                 const float3 *curve_keys,
 		                 const float *curve_radius,
 		                 const Transform& aligned_space,
-		                 BoundBox& bounds) const;
+		                 BoundBox& bounds,
+		                 float t_start = 0.0f,
+		                 float t_end = 1.0f) const;
+
+		/* Position on segment k at parameter t. */
+		float3 evaluate(const int k, const float3 *curve_keys, float t) const;
 
 		void motion_keys(const float3 *curve_keys,
 		                 const float *curve_radius,
@@ -176,6 +185,22 @@ public:
 		float crease;
 	};
 
+	/* Geometry created by the last tessellation, reused when the mesh is
+	 * tessellated again with the same cage and similar dicing parameters. */
+	struct DicingCache {
+		string key;
+
+		array<float3> verts;
+		array<float3> normals;
+		array<float2> patch_uv;
+		array<float3> ptex_uv;
+
+		array<int> triangles;
+		array<int> shader;
+		array<int> triangle_patch;
+		array<float> ptex_face_id;
+	};
+
 	enum SubdivisionType {
 		SUBDIVISION_NONE,
 		SUBDIVISION_LINEAR,
@@ -217,6 +242,7 @@ public:
 	array<SubdEdgeCrease> subd_creases;
 
 	SubdParams *subd_params;
+	DicingCache *dicing_cache;
 
 	vector<Shader*> used_shaders;
 	AttributeSet attributes;
@@ -237,6 +263,10 @@ public:
 	bool need_update;
 	bool need_update_rebuild;
 
+	/* Hash of the exported geometry and attributes, to detect meshes that are
+	 * synced again without any actual change. */
+	string content_hash;
+
 	/* BVH */
 	BVH *bvh;
 	size_t tri_offset;
@@ -300,6 +330,8 @@ public:
 
 	void tag_update(Scene *scene, bool rebuild);
 
+	string compute_content_hash() const;
+
 	bool has_motion_blur() const;
 	bool has_true_displacement() const;
 
@@ -316,7 +348,7 @@ public:
 	/* Check if the mesh should be treated as instanced. */
 	bool is_instanced() const;
 
-	void tessellate(DiagSplit *split);
+	void tessellate(DiagSplit *split, bool use_dicing_cache = false);
 };
 
 /* Mesh Manager */
@@ -338,7 +370,7 @@ public:
 	void device_update(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress);
 	void device_update_flags(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress);
 
-	void device_free(Device *device, DeviceScene *dscene);
+	void device_free(Device *device, DeviceScene *dscene, bool free_packed_mesh = true);
 
 	void tag_update(Scene *scene);
 
@@ -355,18 +387,35 @@ protected:
 	                        DeviceScene *dscene,
 	                        Scene *scene,
 	                        bool for_displacement,
-	                        Progress& progress);
+	                        Progress& progress,
+	                        const vector<bool> *need_pack = NULL);
+
+	/* Hash of the mesh offsets and shader ids the packed mesh arrays were
+	 * created with, they are only repacked partially while it is unchanged. */
+	string packed_mesh_layout(Scene *scene);
+	string packed_layout;
+
+	void device_free_packed_mesh(DeviceScene *dscene);
 
 	void device_update_attributes(Device *device,
 	                              DeviceScene *dscene,
 	                              Scene *scene,
 	                              Progress& progress);
 
-	void device_update_bvh(Device *device,
+	bool device_update_bvh(Device *device,
 	                       DeviceScene *dscene,
 	                       Scene *scene,
+	                       bool need_rebuild,
 	                       Progress& progress);
 
+	bool bvh_can_refit(Scene *scene, const BVHParams& bparams);
+
+	/* Top level BVH kept for refitting, with the mesh and instancing state of
+	 * every object at the time it was built. */
+	BVH *bvh;
+	vector<Mesh*> bvh_meshes;
+	vector<bool> bvh_instanced;
+
 	void device_update_displacement_images(Device *device,
 	                                       Scene *scene,
 	                                       Progress& progress);
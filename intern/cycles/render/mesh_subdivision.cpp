@@ -24,6 +24,7 @@
 
 #include "util/util_foreach.h"
 #include "util/util_algorithm.h"
+#include "util/util_md5.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -335,18 +336,166 @@ struct OsdPatch : Patch {
 
 #endif
 
-void Mesh::tessellate(DiagSplit *split)
+/* Dicing Cache
+ *
+ * The key covers the subdivision cage and the dicing parameters. With a dicing
+ * camera the pixel size is sampled around the bounds of the cage, and rounded
+ * to buckets of a fraction of an octave, so that small camera moves still find
+ * the tessellation of the previous update. */
+
+#define DICING_CACHE_BUCKETS_PER_OCTAVE 4
+
+static string dicing_cache_key(Mesh *mesh, const SubdParams& params)
+{
+	MD5Hash md5;
+
+	md5.append((const uint8_t*)&mesh->subdivision_type, sizeof(mesh->subdivision_type));
+	md5.append((const uint8_t*)mesh->verts.data(), mesh->verts.size()*sizeof(float3));
+
+	/* Hash face members one by one, the struct has padding. */
+	for(size_t i = 0; i < mesh->subd_faces.size(); i++) {
+		const Mesh::SubdFace& face = mesh->subd_faces[i];
+		const int face_data[5] = {face.start_corner,
+		                          face.num_corners,
+		                          face.shader,
+		                          (int)face.smooth,
+		                          face.ptex_offset};
+		md5.append((const uint8_t*)face_data, sizeof(face_data));
+	}
+	md5.append((const uint8_t*)mesh->subd_face_corners.data(),
+	           mesh->subd_face_corners.size()*sizeof(int));
+	md5.append((const uint8_t*)mesh->subd_creases.data(),
+	           mesh->subd_creases.size()*sizeof(Mesh::SubdEdgeCrease));
+
+	Attribute *attr_vN = mesh->subd_attributes.find(ATTR_STD_VERTEX_NORMAL);
+	if(attr_vN) {
+		md5.append((const uint8_t*)attr_vN->data_float3(), mesh->verts.size()*sizeof(float3));
+	}
+
+	const int params_data[4] = {(int)params.ptex,
+	                            params.test_steps,
+	                            params.split_threshold,
+	                            params.max_level};
+	md5.append((const uint8_t*)params_data, sizeof(params_data));
+	md5.append((const uint8_t*)&params.dicing_rate, sizeof(params.dicing_rate));
+
+	if(params.camera) {
+		Camera *cam = params.camera;
+		BoundBox bounds = BoundBox::empty;
+
+		for(size_t i = 0; i < mesh->verts.size(); i++) {
+			bounds.grow(transform_point(&params.objecttoworld, mesh->verts[i]));
+		}
+
+		if(bounds.valid()) {
+			/* Bound corners, center and the point closest to the camera. */
+			float3 P[10];
+
+			for(int i = 0; i < 8; i++) {
+				P[i] = make_float3((i & 1) ? bounds.max.x : bounds.min.x,
+				                   (i & 2) ? bounds.max.y : bounds.min.y,
+				                   (i & 4) ? bounds.max.z : bounds.min.z);
+			}
+
+			float3 camera_P = transform_get_column(&cam->cameratoworld, 3);
+			P[8] = bounds.center();
+			P[9] = min(max(camera_P, bounds.min), bounds.max);
+
+			for(int i = 0; i < 10; i++) {
+				float size = max(cam->world_to_raster_size(P[i]), 1e-10f);
+				int bucket = (int)floorf(log2f(size) * DICING_CACHE_BUCKETS_PER_OCTAVE);
+				md5.append((const uint8_t*)&bucket, sizeof(bucket));
+			}
+		}
+	}
+
+	return md5.get_hex();
+}
+
+template<typename T>
+static void dicing_cache_copy(T *to, const T *from, size_t size)
+{
+	if(size) {
+		memcpy(to, from, sizeof(T)*size);
+	}
+}
+
+static void dicing_cache_store(Mesh *mesh,
+                               const SubdParams& params,
+                               size_t vert_start,
+                               size_t tri_start)
+{
+	Mesh::DicingCache *cache = mesh->dicing_cache;
+	size_t num_verts = mesh->verts.size() - vert_start;
+	size_t num_triangles = mesh->num_triangles() - tri_start;
+
+	float3 *vN = mesh->attributes.find(ATTR_STD_VERTEX_NORMAL)->data_float3();
+
+	dicing_cache_copy(cache->verts.resize(num_verts), mesh->verts.data() + vert_start, num_verts);
+	dicing_cache_copy(cache->normals.resize(num_verts), vN + vert_start, num_verts);
+	dicing_cache_copy(cache->patch_uv.resize(num_verts), mesh->vert_patch_uv.data() + vert_start, num_verts);
+
+	dicing_cache_copy(cache->triangles.resize(num_triangles*3), mesh->triangles.data() + tri_start*3, num_triangles*3);
+	dicing_cache_copy(cache->shader.resize(num_triangles), mesh->shader.data() + tri_start, num_triangles);
+	dicing_cache_copy(cache->triangle_patch.resize(num_triangles), mesh->triangle_patch.data() + tri_start, num_triangles);
+
+	if(params.ptex) {
+		float3 *ptex_uv = mesh->attributes.find(ATTR_STD_PTEX_UV)->data_float3();
+		float *ptex_face_id = mesh->attributes.find(ATTR_STD_PTEX_FACE_ID)->data_float();
+
+		dicing_cache_copy(cache->ptex_uv.resize(num_verts), ptex_uv + vert_start, num_verts);
+		dicing_cache_copy(cache->ptex_face_id.resize(num_triangles), ptex_face_id + tri_start, num_triangles);
+	}
+	else {
+		cache->ptex_uv.clear();
+		cache->ptex_face_id.clear();
+	}
+}
+
+static void dicing_cache_restore(Mesh *mesh, const SubdParams& params)
+{
+	const Mesh::DicingCache *cache = mesh->dicing_cache;
+	size_t vert_start = mesh->verts.size();
+	size_t tri_start = mesh->num_triangles();
+	size_t num_verts = cache->verts.size();
+	size_t num_triangles = cache->shader.size();
+
+	Attribute *attr_vN = mesh->attributes.add(ATTR_STD_VERTEX_NORMAL);
+	Attribute *attr_ptex_uv = NULL, *attr_ptex_face_id = NULL;
+
+	if(params.ptex) {
+		attr_ptex_uv = mesh->attributes.add(ATTR_STD_PTEX_UV);
+		attr_ptex_face_id = mesh->attributes.add(ATTR_STD_PTEX_FACE_ID);
+	}
+
+	mesh->resize_mesh(vert_start + num_verts, tri_start + num_triangles);
+	mesh->num_subd_verts += num_verts;
+
+	dicing_cache_copy(mesh->verts.data() + vert_start, cache->verts.data(), num_verts);
+	dicing_cache_copy(attr_vN->data_float3() + vert_start, cache->normals.data(), num_verts);
+	dicing_cache_copy(mesh->vert_patch_uv.data() + vert_start, cache->patch_uv.data(), num_verts);
+
+	dicing_cache_copy(mesh->triangles.data() + tri_start*3, cache->triangles.data(), num_triangles*3);
+	dicing_cache_copy(mesh->shader.data() + tri_start, cache->shader.data(), num_triangles);
+	dicing_cache_copy(mesh->triangle_patch.data() + tri_start, cache->triangle_patch.data(), num_triangles);
+
+	for(size_t i = 0; i < num_triangles; i++) {
+		mesh->smooth[tri_start + i] = true;
+	}
+
+	if(params.ptex) {
+		dicing_cache_copy(attr_ptex_uv->data_float3() + vert_start, cache->ptex_uv.data(), num_verts);
+		dicing_cache_copy(attr_ptex_face_id->data_float() + tri_start, cache->ptex_face_id.data(), num_triangles);
+	}
+}
+
+void Mesh::tessellate(DiagSplit *split, bool use_dicing_cache)
 {
 #ifdef WITH_OPENSUBDIV
 	OsdData osd_data;
 	bool need_packed_patch_table = false;
 
-	if(subdivision_type == SUBDIVISION_CATMULL_CLARK) {
-		if(subd_faces.size()) {
-			osd_data.build_from_mesh(this);
-		}
-	}
-	else
+	if(subdivision_type != SUBDIVISION_CATMULL_CLARK)
 #endif
 	{
 		/* force linear subdivision if OpenSubdiv is unavailable to avoid
@@ -360,137 +509,101 @@ void Mesh::tessellate(DiagSplit *split)
 		}
 	}
 
-	int num_faces = subd_faces.size();
-
-	Attribute *attr_vN = subd_attributes.find(ATTR_STD_VERTEX_NORMAL);
-	float3* vN = attr_vN->data_float3();
+	/* reuse the previous tessellation if nothing it depends on changed */
+	string dicing_key;
+	bool use_cached_dicing = false;
 
-	for(int f = 0; f < num_faces; f++) {
-		SubdFace& face = subd_faces[f];
-
-		if(face.is_quad()) {
-			/* quad */
-			QuadDice::SubPatch subpatch;
+	if(use_dicing_cache) {
+		dicing_key = dicing_cache_key(this, split->params);
+		use_cached_dicing = (dicing_cache && dicing_cache->key == dicing_key);
+	}
+	else {
+		delete dicing_cache;
+		dicing_cache = NULL;
+	}
 
-			LinearQuadPatch quad_patch;
 #ifdef WITH_OPENSUBDIV
-			OsdPatch osd_patch(&osd_data);
-
-			if(subdivision_type == SUBDIVISION_CATMULL_CLARK) {
-				osd_patch.patch_index = face.ptex_offset;
+	if(subdivision_type == SUBDIVISION_CATMULL_CLARK && subd_faces.size()) {
+		/* with cached dicing, patches are only needed for attribute subdivision */
+		bool need_osd_data = !use_cached_dicing;
 
-				subpatch.patch = &osd_patch;
+		foreach(Attribute& attr, subd_attributes.attributes) {
+			if(attr.flags & ATTR_SUBDIVIDED) {
+				need_osd_data = true;
 			}
-			else
+		}
+
+		if(need_osd_data) {
+			osd_data.build_from_mesh(this);
+		}
+	}
 #endif
-			{
-				float3 *hull = quad_patch.hull;
-				float3 *normals = quad_patch.normals;
 
-				quad_patch.patch_index = face.ptex_offset;
+	int num_faces = subd_faces.size();
 
-				for(int i = 0; i < 4; i++) {
-					hull[i] = verts[subd_face_corners[face.start_corner+i]];
-				}
+	if(use_cached_dicing) {
+		dicing_cache_restore(this, split->params);
+	}
+	else {
+		size_t vert_start = verts.size();
+		size_t tri_start = num_triangles();
+
+		Attribute *attr_vN = subd_attributes.find(ATTR_STD_VERTEX_NORMAL);
+		float3* vN = attr_vN->data_float3();
+
+		/* Create patches for all faces first, they are then split and diced in
+		 * parallel. Quads are one patch, ngons one patch per corner. */
+		int num_patches = 0;
+		for(int f = 0; f < num_faces; f++) {
+			SubdFace& face = subd_faces[f];
+			num_patches += face.is_quad() ? 1 : face.num_corners;
+		}
 
-				if(face.smooth) {
-					for(int i = 0; i < 4; i++) {
-						normals[i] = vN[subd_face_corners[face.start_corner+i]];
-					}
-				}
-				else {
-					float3 N = face.normal(this);
-					for(int i = 0; i < 4; i++) {
-						normals[i] = N;
-					}
-				}
+		vector<LinearQuadPatch> linear_patches;
+#ifdef WITH_OPENSUBDIV
+		vector<OsdPatch> osd_patches;
 
-				swap(hull[2], hull[3]);
-				swap(normals[2], normals[3]);
+		if(subdivision_type == SUBDIVISION_CATMULL_CLARK)
+			osd_patches.resize(num_patches, OsdPatch(&osd_data));
+		else
+#endif
+			linear_patches.resize(num_patches);
 
-				subpatch.patch = &quad_patch;
-			}
+		vector<QuadDice::SubPatch> subpatches;
+		int patch_index = 0;
 
-			subpatch.patch->shader = face.shader;
-
-			/* Quad faces need to be split at least once to line up with split ngons, we do this
-			 * here in this manner because if we do it later edge factors may end up slightly off.
-			 */
-			subpatch.P00 = make_float2(0.0f, 0.0f);
-			subpatch.P10 = make_float2(0.5f, 0.0f);
-			subpatch.P01 = make_float2(0.0f, 0.5f);
-			subpatch.P11 = make_float2(0.5f, 0.5f);
-			split->split_quad(subpatch.patch, &subpatch);
-
-			subpatch.P00 = make_float2(0.5f, 0.0f);
-			subpatch.P10 = make_float2(1.0f, 0.0f);
-			subpatch.P01 = make_float2(0.5f, 0.5f);
-			subpatch.P11 = make_float2(1.0f, 0.5f);
-			split->split_quad(subpatch.patch, &subpatch);
-
-			subpatch.P00 = make_float2(0.0f, 0.5f);
-			subpatch.P10 = make_float2(0.5f, 0.5f);
-			subpatch.P01 = make_float2(0.0f, 1.0f);
-			subpatch.P11 = make_float2(0.5f, 1.0f);
-			split->split_quad(subpatch.patch, &subpatch);
-
-			subpatch.P00 = make_float2(0.5f, 0.5f);
-			subpatch.P10 = make_float2(1.0f, 0.5f);
-			subpatch.P01 = make_float2(0.5f, 1.0f);
-			subpatch.P11 = make_float2(1.0f, 1.0f);
-			split->split_quad(subpatch.patch, &subpatch);
-		}
-		else {
-			/* ngon */
-#ifdef WITH_OPENSUBDIV
-			if(subdivision_type == SUBDIVISION_CATMULL_CLARK) {
-				OsdPatch patch(&osd_data);
+		for(int f = 0; f < num_faces; f++) {
+			SubdFace& face = subd_faces[f];
 
-				patch.shader = face.shader;
+			if(face.is_quad()) {
+				/* quad */
+				QuadDice::SubPatch subpatch;
 
-				for(int corner = 0; corner < face.num_corners; corner++) {
-					patch.patch_index = face.ptex_offset + corner;
+#ifdef WITH_OPENSUBDIV
+				if(subdivision_type == SUBDIVISION_CATMULL_CLARK) {
+					OsdPatch& osd_patch = osd_patches[patch_index++];
+
+					osd_patch.patch_index = face.ptex_offset;
 
-					split->split_quad(&patch);
+					subpatch.patch = &osd_patch;
 				}
-			}
-			else
+				else
 #endif
-			{
-				float3 center_vert = make_float3(0.0f, 0.0f, 0.0f);
-				float3 center_normal = make_float3(0.0f, 0.0f, 0.0f);
-
-				float inv_num_corners = 1.0f/float(face.num_corners);
-				for(int corner = 0; corner < face.num_corners; corner++) {
-					center_vert += verts[subd_face_corners[face.start_corner + corner]] * inv_num_corners;
-					center_normal += vN[subd_face_corners[face.start_corner + corner]] * inv_num_corners;
-				}
+				{
+					LinearQuadPatch& quad_patch = linear_patches[patch_index++];
+					float3 *hull = quad_patch.hull;
+					float3 *normals = quad_patch.normals;
 
-				for(int corner = 0; corner < face.num_corners; corner++) {
-					LinearQuadPatch patch;
-					float3 *hull = patch.hull;
-					float3 *normals = patch.normals;
+					quad_patch.patch_index = face.ptex_offset;
 
-					patch.patch_index = face.ptex_offset + corner;
-
-					patch.shader = face.shader;
-
-					hull[0] = verts[subd_face_corners[face.start_corner + mod(corner + 0, face.num_corners)]];
-					hull[1] = verts[subd_face_corners[face.start_corner + mod(corner + 1, face.num_corners)]];
-					hull[2] = verts[subd_face_corners[face.start_corner + mod(corner - 1, face.num_corners)]];
-					hull[3] = center_vert;
-
-					hull[1] = (hull[1] + hull[0]) * 0.5;
-					hull[2] = (hull[2] + hull[0]) * 0.5;
+					for(int i = 0; i < 4; i++) {
+						hull[i] = verts[subd_face_corners[face.start_corner+i]];
+					}
 
 					if(face.smooth) {
-						normals[0] = vN[subd_face_corners[face.start_corner + mod(corner + 0, face.num_corners)]];
-						normals[1] = vN[subd_face_corners[face.start_corner + mod(corner + 1, face.num_corners)]];
-						normals[2] = vN[subd_face_corners[face.start_corner + mod(corner - 1, face.num_corners)]];
-						normals[3] = center_normal;
-
-						normals[1] = (normals[1] + normals[0]) * 0.5;
-						normals[2] = (normals[2] + normals[0]) * 0.5;
+						for(int i = 0; i < 4; i++) {
+							normals[i] = vN[subd_face_corners[face.start_corner+i]];
+						}
 					}
 					else {
 						float3 N = face.normal(this);
@@ -499,9 +612,125 @@ void Mesh::tessellate(DiagSplit *split)
 						}
 					}
 
-					split->split_quad(&patch);
+					swap(hull[2], hull[3]);
+					swap(normals[2], normals[3]);
+
+					subpatch.patch = &quad_patch;
 				}
+
+				subpatch.patch->shader = face.shader;
+
+				/* Quad faces need to be split at least once to line up with split ngons, we do this
+				 * here in this manner because if we do it later edge factors may end up slightly off.
+				 */
+				subpatch.P00 = make_float2(0.0f, 0.0f);
+				subpatch.P10 = make_float2(0.5f, 0.0f);
+				subpatch.P01 = make_float2(0.0f, 0.5f);
+				subpatch.P11 = make_float2(0.5f, 0.5f);
+				subpatches.push_back(subpatch);
+
+				subpatch.P00 = make_float2(0.5f, 0.0f);
+				subpatch.P10 = make_float2(1.0f, 0.0f);
+				subpatch.P01 = make_float2(0.5f, 0.5f);
+				subpatch.P11 = make_float2(1.0f, 0.5f);
+				subpatches.push_back(subpatch);
+
+				subpatch.P00 = make_float2(0.0f, 0.5f);
+				subpatch.P10 = make_float2(0.5f, 0.5f);
+				subpatch.P01 = make_float2(0.0f, 1.0f);
+				subpatch.P11 = make_float2(0.5f, 1.0f);
+				subpatches.push_back(subpatch);
+
+				subpatch.P00 = make_float2(0.5f, 0.5f);
+				subpatch.P10 = make_float2(1.0f, 0.5f);
+				subpatch.P01 = make_float2(0.5f, 1.0f);
+				subpatch.P11 = make_float2(1.0f, 1.0f);
+				subpatches.push_back(subpatch);
 			}
+			else {
+				/* ngon */
+#ifdef WITH_OPENSUBDIV
+				if(subdivision_type == SUBDIVISION_CATMULL_CLARK) {
+					for(int corner = 0; corner < face.num_corners; corner++) {
+						OsdPatch& patch = osd_patches[patch_index++];
+
+						patch.shader = face.shader;
+						patch.patch_index = face.ptex_offset + corner;
+
+						QuadDice::SubPatch subpatch = {&patch,
+						                               make_float2(0.0f, 0.0f),
+						                               make_float2(1.0f, 0.0f),
+						                               make_float2(0.0f, 1.0f),
+						                               make_float2(1.0f, 1.0f)};
+						subpatches.push_back(subpatch);
+					}
+				}
+				else
+#endif
+				{
+					float3 center_vert = make_float3(0.0f, 0.0f, 0.0f);
+					float3 center_normal = make_float3(0.0f, 0.0f, 0.0f);
+
+					float inv_num_corners = 1.0f/float(face.num_corners);
+					for(int corner = 0; corner < face.num_corners; corner++) {
+						center_vert += verts[subd_face_corners[face.start_corner + corner]] * inv_num_corners;
+						center_normal += vN[subd_face_corners[face.start_corner + corner]] * inv_num_corners;
+					}
+
+					for(int corner = 0; corner < face.num_corners; corner++) {
+						LinearQuadPatch& patch = linear_patches[patch_index++];
+						float3 *hull = patch.hull;
+						float3 *normals = patch.normals;
+
+						patch.patch_index = face.ptex_offset + corner;
+
+						patch.shader = face.shader;
+
+						hull[0] = verts[subd_face_corners[face.start_corner + mod(corner + 0, face.num_corners)]];
+						hull[1] = verts[subd_face_corners[face.start_corner + mod(corner + 1, face.num_corners)]];
+						hull[2] = verts[subd_face_corners[face.start_corner + mod(corner - 1, face.num_corners)]];
+						hull[3] = center_vert;
+
+						hull[1] = (hull[1] + hull[0]) * 0.5;
+						hull[2] = (hull[2] + hull[0]) * 0.5;
+
+						if(face.smooth) {
+							normals[0] = vN[subd_face_corners[face.start_corner + mod(corner + 0, face.num_corners)]];
+							normals[1] = vN[subd_face_corners[face.start_corner + mod(corner + 1, face.num_corners)]];
+							normals[2] = vN[subd_face_corners[face.start_corner + mod(corner - 1, face.num_corners)]];
+							normals[3] = center_normal;
+
+							normals[1] = (normals[1] + normals[0]) * 0.5;
+							normals[2] = (normals[2] + normals[0]) * 0.5;
+						}
+						else {
+							float3 N = face.normal(this);
+							for(int i = 0; i < 4; i++) {
+								normals[i] = N;
+							}
+						}
+
+						QuadDice::SubPatch subpatch = {&patch,
+						                               make_float2(0.0f, 0.0f),
+						                               make_float2(1.0f, 0.0f),
+						                               make_float2(0.0f, 1.0f),
+						                               make_float2(1.0f, 1.0f)};
+						subpatches.push_back(subpatch);
+					}
+				}
+			}
+		}
+
+		split->split_quads(subpatches);
+		split->dice();
+
+		if(use_dicing_cache) {
+			if(!dicing_cache) {
+				dicing_cache = new DicingCache();
+			}
+
+			dicing_cache->key = dicing_key;
+			dicing_cache_store(this, split->params, vert_start, tri_start);
 		}
 	}
 
@@ -294,6 +294,35 @@ void ImageTextureNode::attributes(Shader *shader, AttributeRequestSet *attribute
 	ShaderNode::attributes(shader, attributes);
 }
 
+/* UV map the texture coordinates are read from unmodified, used by the kernel
+ * to estimate the texture footprint for mip level selection. */
+int ImageTextureNode::uv_map_attribute(SVMCompiler& compiler)
+{
+	ShaderInput *vector_in = input("Vector");
+
+	if(projection != NODE_IMAGE_PROJ_FLAT || !tex_mapping.skip() || !vector_in->link) {
+		return ATTR_STD_NONE;
+	}
+
+	ShaderNode *from = vector_in->link->parent;
+
+	if(from->type == TextureCoordinateNode::node_type) {
+		TextureCoordinateNode *texco = (TextureCoordinateNode*)from;
+		if(vector_in->link->name() == "UV" && !texco->from_dupli) {
+			return compiler.attribute(ATTR_STD_UV);
+		}
+	}
+	else if(from->type == UVMapNode::node_type) {
+		UVMapNode *uvmap = (UVMapNode*)from;
+		if(!uvmap->from_dupli) {
+			return (uvmap->attribute != "")? compiler.attribute(uvmap->attribute):
+			                                 compiler.attribute(ATTR_STD_UV);
+		}
+	}
+
+	return ATTR_STD_NONE;
+}
+
 void ImageTextureNode::compile(SVMCompiler& compiler)
 {
 	ShaderInput *vector_in = input("Vector");
@@ -328,6 +357,7 @@ void ImageTextureNode::compile(SVMCompiler& compiler)
 					compiler.stack_assign_if_linked(alpha_out),
 					srgb),
 				projection);
+			compiler.add_node(uv_map_attribute(compiler), 0, 0, 0);
 		}
 		else {
 			compiler.add_node(NODE_TEX_IMAGE_BOX,
@@ -104,6 +104,9 @@ public:
 		       builtin_data == image_node.builtin_data &&
 		       animated == image_node.animated;
 	}
+
+protected:
+	int uv_map_attribute(SVMCompiler& compiler);
 };
 
 class EnvironmentTextureNode : public ImageSlotTextureNode {
@@ -69,6 +69,9 @@ DeviceScene::DeviceScene(Device *device)
   light_data(device, "__light_data", MEM_TEXTURE),
   light_background_marginal_cdf(device, "__light_background_marginal_cdf", MEM_TEXTURE),
   light_background_conditional_cdf(device, "__light_background_conditional_cdf", MEM_TEXTURE),
+  light_tree_nodes(device, "__light_tree_nodes", MEM_TEXTURE),
+  light_tree_emitters(device, "__light_tree_emitters", MEM_TEXTURE),
+  guiding_nodes(device, "__guiding_nodes", MEM_TEXTURE),
   particles(device, "__particles", MEM_TEXTURE),
   svm_nodes(device, "__svm_nodes", MEM_TEXTURE),
   shader_flag(device, "__shader_flag", MEM_TEXTURE),
@@ -151,6 +154,9 @@ void Scene::free_memory(bool final)
 			image_manager->device_free_builtin(device);
 
 		lookup_tables->device_free(device, &dscene);
+
+		/* Filled in by the session while rendering. */
+		dscene.guiding_nodes.free();
 	}
 
 	if(final) {
@@ -100,6 +100,11 @@ public:
 	device_vector<float4> light_data;
 	device_vector<float2> light_background_marginal_cdf;
 	device_vector<float2> light_background_conditional_cdf;
+	device_vector<float4> light_tree_nodes;
+	device_vector<uint> light_tree_emitters;
+
+	/* path guiding */
+	device_vector<float4> guiding_nodes;
 
 	/* particles */
 	device_vector<float4> particles;
@@ -158,9 +163,22 @@ public:
 	bool use_bvh_spatial_split;
 	bool use_bvh_unaligned_nodes;
 	int num_bvh_time_steps;
+	/* Store built BVHs in the user cache directory and reuse them when the
+	 * geometry did not change. */
+	bool use_bvh_cache;
+	/* Keep the top level BVH in memory and refit it instead of building it
+	 * again when only vertex positions changed. */
+	bool use_bvh_refit;
+	/* Keep the tessellation of subdivision meshes and reuse it when a mesh
+	 * is synced again with an unchanged cage and a similar dicing camera. */
+	bool use_dicing_cache;
 
 	bool persistent_data;
 	int texture_limit;
+	/* Read tiled image files on demand through a texture cache of the given
+	 * size in megabytes, instead of loading them into memory. */
+	bool use_texture_cache;
+	int texture_cache_size;
 
 	SceneParams()
 	{
@@ -170,8 +188,13 @@ public:
 		use_bvh_spatial_split = false;
 		use_bvh_unaligned_nodes = true;
 		num_bvh_time_steps = 0;
+		use_bvh_cache = false;
+		use_bvh_refit = false;
+		use_dicing_cache = false;
 		persistent_data = false;
 		texture_limit = 0;
+		use_texture_cache = false;
+		texture_cache_size = 1024;
 	}
 
 	bool modified(const SceneParams& params)
@@ -181,8 +204,13 @@ public:
 		&& use_bvh_spatial_split == params.use_bvh_spatial_split
 		&& use_bvh_unaligned_nodes == params.use_bvh_unaligned_nodes
 		&& num_bvh_time_steps == params.num_bvh_time_steps
+		&& use_bvh_cache == params.use_bvh_cache
+		&& use_bvh_refit == params.use_bvh_refit
+		&& use_dicing_cache == params.use_dicing_cache
 		&& persistent_data == params.persistent_data
-		&& texture_limit == params.texture_limit); }
+		&& texture_limit == params.texture_limit
+		&& use_texture_cache == params.use_texture_cache
+		&& texture_cache_size == params.texture_cache_size); }
 };
 
 /* Scene */
@@ -27,12 +27,14 @@
 #include "render/scene.h"
 #include "render/session.h"
 #include "render/bake.h"
+#include "render/stats.h"
 
 #include "util/util_foreach.h"
 #include "util/util_function.h"
 #include "util/util_logging.h"
 #include "util/util_math.h"
 #include "util/util_opengl.h"
+#include "util/util_path.h"
 #include "util/util_task.h"
 #include "util/util_time.h"
 
@@ -51,14 +53,27 @@ Session::Session(const SessionParams& params_)
 {
 	device_use_gl = ((params.device.type != DEVICE_CPU) && !params.background);
 
+	tile_manager.use_tile_splitting = params.use_tile_splitting;
+
 	TaskScheduler::init(params.threads);
 
-	device = Device::create(params.device, stats, params.background);
+	device = Device::create(params.device, stats, profiler, params.background);
+
+	/* Half tile storage only works when each tile is finished at once. */
+	if(!params.background || params.progressive_refine || params.output_path.empty()) {
+		params.use_half_tile_storage = false;
+	}
 
 	if(params.background && params.output_path.empty()) {
 		buffers = NULL;
 		display = NULL;
 	}
+	else if(params.use_half_tile_storage) {
+		/* Tiles are rendered into their own buffers, which are kept as half
+		 * floats once finished. */
+		buffers = NULL;
+		display = new DisplayBuffer(device, false);
+	}
 	else {
 		buffers = new RenderBuffers(device);
 		display = new DisplayBuffer(device, params.display_buffer_linear);
@@ -79,6 +94,9 @@ Session::Session(const SessionParams& params_)
 	pause = false;
 	kernels_loaded = false;
 
+	use_guiding = false;
+	guiding_need_reset = true;
+
 	/* TODO(sergey): Check if it's indeed optimal value for the split kernel. */
 	max_closure_global = 1;
 }
@@ -106,14 +124,23 @@ Session::~Session()
 		delete display;
 
 		display = new DisplayBuffer(device, false);
-		display->reset(buffers->params);
-		tonemap(params.samples);
+		if(params.use_half_tile_storage) {
+			tonemap_half_tiles();
+		}
+		else {
+			display->reset(buffers->params);
+			tonemap(params.samples);
+		}
 
 		progress.set_status("Writing Image", params.output_path);
 		display->write(params.output_path);
 	}
 
 	/* clean up */
+	foreach(HalfRenderBuffers *half_tile, half_tiles) {
+		delete half_tile;
+	}
+
 	tile_manager.device_free();
 
 	delete buffers;
@@ -445,6 +472,10 @@ void Session::release_tile(RenderTile& rtile)
 			write_render_tile_cb(rtile);
 		}
 
+		if(params.use_half_tile_storage) {
+			half_tiles.push_back(new HalfRenderBuffers(rtile.buffers, rtile.sample));
+		}
+
 		if(delete_tile) {
 			delete rtile.buffers;
 			tile_manager.state.tiles[rtile.tile_index].buffers = NULL;
@@ -607,6 +638,10 @@ void Session::run_cpu()
 
 		device->task_wait();
 
+		if(!no_tiles) {
+			update_guiding();
+		}
+
 		{
 			thread_scoped_lock reset_lock(delayed_reset.mutex);
 			thread_scoped_lock buffers_lock(buffers_mutex);
@@ -729,10 +764,31 @@ void Session::run()
 		/* reset number of rendered samples */
 		progress.reset_sample();
 
+		if(params.use_profiling) {
+			profiler.start();
+		}
+
 		if(device_use_gl)
 			run_gpu();
 		else
 			run_cpu();
+
+		if(params.use_profiling) {
+			profiler.stop();
+
+			RenderStats render_stats;
+			collect_statistics(&render_stats);
+
+			VLOG(1) << "Render statistics:\n" << render_stats.full_report();
+
+			if(!params.profiling_report.empty()) {
+				string report = render_stats.json_report();
+				if(!path_write_text(params.profiling_report, report)) {
+					LOG(ERROR) << "Failed to write profiling report to "
+					           << params.profiling_report;
+				}
+			}
+		}
 	}
 
 	/* progress update */
@@ -752,6 +808,14 @@ bool Session::draw(BufferParams& buffer_params, DeviceDrawParams &draw_params)
 
 void Session::reset_(BufferParams& buffer_params, int samples)
 {
+	{
+		thread_scoped_lock tile_lock(tile_mutex);
+		foreach(HalfRenderBuffers *half_tile, half_tiles) {
+			delete half_tile;
+		}
+		half_tiles.clear();
+	}
+
 	if(buffers && buffer_params.modified(tile_manager.params)) {
 		gpu_draw_ready = false;
 		buffers->reset(buffer_params);
@@ -763,6 +827,9 @@ void Session::reset_(BufferParams& buffer_params, int samples)
 	tile_manager.reset(buffer_params, samples);
 	progress.reset_sample();
 
+	/* The scene may have changed, learn the light from scratch. */
+	guiding_need_reset = true;
+
 	bool show_progress = params.background || tile_manager.get_num_effective_samples() != INT_MAX;
 	progress.set_total_pixel_samples(show_progress? tile_manager.state.total_pixel_samples : 0);
 
@@ -868,6 +935,99 @@ void Session::update_scene()
 
 		progress.set_status("Updating Scene");
 		MEM_GUARDED_CALL(&progress, scene->device_update, device, progress);
+
+		/* Shader and object indices are only known after the update, counts
+		 * gathered so far are dropped when they change. */
+		if(params.use_profiling &&
+		   (profiler.num_shaders() != (int)scene->shaders.size() ||
+		    profiler.num_objects() != (int)scene->objects.size()))
+		{
+			profiler.reset(scene->shaders.size(),
+			               scene->objects.size(),
+			               NODE_NUM_TYPES);
+		}
+	}
+
+	if(guiding_need_reset) {
+		guiding_need_reset = false;
+		reset_guiding();
+	}
+}
+
+void Session::reset_guiding()
+{
+	/* Called from update_scene() with the scene locked, once the object
+	 * bounds are up to date. Guiding needs all tiles of a pass to be done
+	 * before it can learn from them, so it only works with progressive
+	 * passes over the whole frame, which background renders only do with
+	 * progressive refine. Only the path integrator samples from it. */
+	use_guiding = params.use_path_guiding &&
+	              params.progressive &&
+	              (params.progressive_refine || !params.background) &&
+	              device->info.type == DEVICE_CPU &&
+	              scene->integrator->method == Integrator::PATH;
+
+	BoundBox bounds = BoundBox::empty;
+	if(use_guiding) {
+		foreach(Object *object, scene->objects) {
+			bounds.grow(object->bounds);
+		}
+		use_guiding = bounds.valid();
+	}
+
+	KernelIntegrator *kintegrator = &scene->dscene.data.integrator;
+
+	if(use_guiding) {
+		guiding.reset(bounds, params.guiding_training_samples);
+		kintegrator->guiding_record = guiding.training();
+	}
+	else {
+		kintegrator->guiding_record = false;
+	}
+
+	kintegrator->use_guiding = false;
+	kintegrator->guiding_fraction = 0.5f;
+
+	device->const_copy_to("__data", &scene->dscene.data, sizeof(scene->dscene.data));
+}
+
+void Session::update_guiding()
+{
+	if(!use_guiding || !guiding.pass_done()) {
+		return;
+	}
+
+	thread_scoped_lock scene_lock(scene->mutex);
+	DeviceScene *dscene = &scene->dscene;
+
+	vector<float4> nodes;
+	guiding.pack(nodes);
+
+	dscene->guiding_nodes.free();
+	float4 *guiding_nodes = dscene->guiding_nodes.alloc(nodes.size());
+	memcpy(guiding_nodes, &nodes[0], sizeof(float4)*nodes.size());
+	dscene->guiding_nodes.copy_to_device();
+
+	KernelIntegrator *kintegrator = &dscene->data.integrator;
+	kintegrator->use_guiding = guiding.has_distribution();
+	kintegrator->guiding_record = guiding.training();
+
+	device->const_copy_to("__data", &dscene->data, sizeof(dscene->data));
+
+	VLOG(1) << "Path guiding updated, " << nodes.size() << " nodes"
+	        << (guiding.training()? ", still training.": ".");
+}
+
+void Session::record_guiding_samples(const GuidingSample *samples, int num_samples)
+{
+	guiding.record(samples, num_samples);
+}
+
+void Session::collect_statistics(RenderStats *render_stats)
+{
+	if(params.use_profiling && !profiler.active()) {
+		thread_scoped_lock scene_lock(scene->mutex);
+		render_stats->collect_profiling(scene, profiler);
 	}
 }
 
@@ -944,7 +1104,11 @@ void Session::render()
 	task.get_cancel = function_bind(&Progress::get_cancel, &this->progress);
 	task.update_tile_sample = function_bind(&Session::update_tile_sample, this, _1);
 	task.update_progress_sample = function_bind(&Progress::add_samples, &this->progress, _1, _2);
+	task.update_thread_busy_time = function_bind(&Progress::add_thread_busy_time, &this->progress, _1, _2);
 	task.need_finish_queue = params.progressive_refine;
+	if(use_guiding) {
+		task.record_guiding_samples = function_bind(&Session::record_guiding_samples, this, _1, _2);
+	}
 	task.integrator_branched = scene->integrator->method == Integrator::BRANCHED_PATH;
 	task.requested_tile_size = params.tile_size;
 	task.passes_size = tile_manager.params.get_passes_size();
@@ -990,6 +1154,46 @@ void Session::tonemap(int sample)
 	display_outdated = false;
 }
 
+void Session::tonemap_half_tiles()
+{
+	BufferParams& frame_params = tile_manager.params;
+	display->reset(frame_params);
+	uchar4 *frame_pixels = display->rgba_byte.data();
+
+	/* Expand one tile at a time to float buffers for the film conversion. */
+	RenderBuffers tile_buffers(device);
+	DisplayBuffer tile_display(device, false);
+
+	foreach(HalfRenderBuffers *half_tile, half_tiles) {
+		half_tile->unpack(&tile_buffers);
+		tile_display.reset(tile_buffers.params);
+
+		DeviceTask task(DeviceTask::FILM_CONVERT);
+		task.x = tile_buffers.params.full_x;
+		task.y = tile_buffers.params.full_y;
+		task.w = tile_buffers.params.width;
+		task.h = tile_buffers.params.height;
+		task.rgba_byte = tile_display.rgba_byte.device_pointer;
+		task.rgba_half = tile_display.rgba_half.device_pointer;
+		task.buffer = tile_buffers.buffer.device_pointer;
+		task.sample = half_tile->sample - 1;
+		tile_buffers.params.get_offset_stride(task.offset, task.stride);
+
+		device->task_add(task);
+		device->task_wait();
+
+		uchar4 *tile_pixels = tile_display.rgba_byte.copy_from_device(0, task.w, task.h);
+		for(int y = 0; y < task.h; y++) {
+			uchar4 *row = frame_pixels + (size_t)(task.y - frame_params.full_y + y)*frame_params.width +
+			              (task.x - frame_params.full_x);
+			memcpy(row, tile_pixels + (size_t)y*task.w, sizeof(uchar4)*task.w);
+		}
+	}
+
+	display->rgba_byte.copy_to_device();
+	display->draw_set(frame_params.width, frame_params.height);
+}
+
 bool Session::update_progressive_refine(bool cancel)
 {
 	int sample = tile_manager.state.sample + 1;
@@ -19,9 +19,12 @@
 
 #include "render/buffers.h"
 #include "device/device.h"
+#include "render/guiding.h"
 #include "render/shader.h"
+#include "render/stats.h"
 #include "render/tile.h"
 
+#include "util/util_profiling.h"
 #include "util/util_progress.h"
 #include "util/util_stats.h"
 #include "util/util_thread.h"
@@ -55,6 +58,10 @@ public:
 	int start_resolution;
 	int pixel_size;
 	int threads;
+	bool use_tile_splitting;
+	/* For background renders to an output file, keep finished tiles as half
+	 * floats instead of allocating full float buffers for the whole frame. */
+	bool use_half_tile_storage;
 
 	bool display_buffer_linear;
 
@@ -71,6 +78,17 @@ public:
 
 	ShadingSystem shadingsystem;
 
+	/* Sample where render time goes on the CPU, and write the statistics as
+	 * JSON to profiling_report when the render is done, if not empty. */
+	bool use_profiling;
+	string profiling_report;
+
+	/* Learn the incident light during the first passes and guide the bounces
+	 * of the path integrator with it, CPU only. Requires progressive passes
+	 * over the full frame. */
+	bool use_path_guiding;
+	int guiding_training_samples;
+
 	SessionParams()
 	{
 		background = false;
@@ -84,6 +102,8 @@ public:
 		start_resolution = INT_MAX;
 		pixel_size = 1;
 		threads = 0;
+		use_tile_splitting = false;
+		use_half_tile_storage = false;
 
 		use_denoising = false;
 		denoising_radius = 8;
@@ -100,6 +120,12 @@ public:
 
 		shadingsystem = SHADINGSYSTEM_SVM;
 		tile_order = TILE_CENTER;
+
+		use_profiling = false;
+		profiling_report = "";
+
+		use_path_guiding = false;
+		guiding_training_samples = 128;
 	}
 
 	bool modified(const SessionParams& params)
@@ -114,13 +140,19 @@ public:
 		&& start_resolution == params.start_resolution
 		&& pixel_size == params.pixel_size
 		&& threads == params.threads
+		&& use_tile_splitting == params.use_tile_splitting
+		&& use_half_tile_storage == params.use_half_tile_storage
 		&& display_buffer_linear == params.display_buffer_linear
 		&& cancel_timeout == params.cancel_timeout
 		&& reset_timeout == params.reset_timeout
 		&& text_timeout == params.text_timeout
 		&& progressive_update_timeout == params.progressive_update_timeout
 		&& tile_order == params.tile_order
-		&& shadingsystem == params.shadingsystem); }
+		&& shadingsystem == params.shadingsystem
+		&& use_profiling == params.use_profiling
+		&& profiling_report == params.profiling_report
+		&& use_path_guiding == params.use_path_guiding
+		&& guiding_training_samples == params.guiding_training_samples); }
 
 };
 
@@ -139,6 +171,7 @@ public:
 	SessionParams params;
 	TileManager tile_manager;
 	Stats stats;
+	Profiler profiler;
 
 	function<void(RenderTile&)> write_render_tile_cb;
 	function<void(RenderTile&, bool)> update_render_tile_cb;
@@ -160,6 +193,10 @@ public:
 
 	void device_free();
 
+	/* Statistics of the last render, profiling data is only included when
+	 * profiling was enabled. */
+	void collect_statistics(RenderStats *stats);
+
 	/* Returns the rendering progress or 0 if no progress can be determined
 	 * (for example, when rendering with unlimited samples). */
 	float get_progress();
@@ -177,6 +214,7 @@ protected:
 	void update_status_time(bool show_pause = false, bool show_done = false);
 
 	void tonemap(int sample);
+	void tonemap_half_tiles();
 	void render();
 	void reset_(BufferParams& params, int samples);
 
@@ -195,6 +233,15 @@ protected:
 	void map_neighbor_tiles(RenderTile *tiles, Device *tile_device);
 	void unmap_neighbor_tiles(RenderTile *tiles, Device *tile_device);
 
+	/* Path guiding, learned anew after every reset. */
+	void reset_guiding();
+	void update_guiding();
+	void record_guiding_samples(const GuidingSample *samples, int num_samples);
+
+	PathGuiding guiding;
+	bool use_guiding;
+	bool guiding_need_reset;
+
 	bool device_use_gl;
 
 	thread *session_thread;
@@ -212,6 +259,9 @@ protected:
 	thread_mutex buffers_mutex;
 	thread_mutex display_mutex;
 
+	/* Finished tiles when using half tile storage, protected by tile_mutex. */
+	vector<HalfRenderBuffers*> half_tiles;
+
 	bool kernels_loaded;
 	DeviceRequestedFeatures loaded_kernel_features;
 
@@ -243,6 +243,24 @@ void Shader::set_graph(ShaderGraph *graph_)
 		}
 	}
 
+	/* keep the current graph if the new one is identical, the graph gets
+	 * modified when compiling so the hash from before is compared. this
+	 * keeps compiled nodes and image slots of the graph valid. */
+	string new_graph_hash = "";
+	if(graph_) {
+		new_graph_hash = graph_->compute_hash();
+		if(new_graph_hash != "") {
+			new_graph_hash += string_printf("-%d", (int)displacement_method);
+		}
+	}
+
+	if(graph && graph_ && new_graph_hash != "" && new_graph_hash == graph_hash) {
+		delete graph_;
+		return;
+	}
+
+	graph_hash = new_graph_hash;
+
 	/* update geometry if displacement changed */
 	if(displacement_method != DISPLACE_BUMP) {
 		const char *old_hash = (graph)? graph->displacement_hash.c_str() : "";
@@ -33,6 +33,7 @@
 #include "util/util_string.h"
 #include "util/util_thread.h"
 #include "util/util_types.h"
+#include "util/util_vector.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -88,6 +89,8 @@ public:
 
 	/* shader graph */
 	ShaderGraph *graph;
+	/* hash of the graph and displacement method it was set with */
+	string graph_hash;
 
 	/* sampling */
 	bool use_mis;
@@ -133,6 +136,11 @@ public:
 	uint id;
 	bool used;
 
+	/* SVM nodes from the last compilation, reused while the shader and the
+	 * state it was compiled with are unchanged */
+	array<int4> svm_nodes;
+	string svm_nodes_key;
+
 #ifdef WITH_OSL
 	/* osl shading state references */
 	OSL::ShaderGroupRef osl_surface_ref;
@@ -0,0 +1,275 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "render/stats.h"
+#include "render/object.h"
+#include "render/scene.h"
+#include "render/shader.h"
+
+#include "kernel/svm/svm_types.h"
+
+#include "util/util_algorithm.h"
+#include "util/util_foreach.h"
+
+CCL_NAMESPACE_BEGIN
+
+static const char *profiling_event_names[PROFILING_NUM_EVENTS] = {
+	"unknown",
+	"ray_setup",
+	"path_integrate",
+	"scene_intersect",
+	"indirect_emission",
+	"volume",
+	"shader_setup",
+	"shader_eval",
+	"shader_apply",
+	"ao",
+	"subsurface",
+	"connect_light",
+	"surface_bounce",
+	"write_result",
+	"intersect",
+	"intersect_local",
+	"intersect_shadow_all",
+	"intersect_volume",
+	"intersect_volume_all",
+	"closure_eval",
+	"closure_sample",
+	"closure_volume_eval",
+	"closure_volume_sample",
+	"light_sample",
+	"shadow_blocked",
+};
+
+static_assert(sizeof(profiling_event_names) / sizeof(*profiling_event_names) == PROFILING_NUM_EVENTS,
+              "Profiling event names do not match the events");
+
+static const char *profiling_ray_type_names[PROFILING_NUM_RAY_TYPES] = {
+	"camera",
+	"indirect",
+	"shadow",
+	"local",
+	"volume",
+};
+
+/* Names of the SVM node types, in the order of ShaderNodeType. */
+static const char *svm_node_names[NODE_NUM_TYPES] = {
+	"end", "closure_bsdf", "closure_emission", "closure_background",
+	"closure_set_weight", "closure_weight", "mix_closure", "jump_if_zero",
+	"jump_if_one", "tex_image", "tex_image_box", "tex_sky", "geometry",
+	"geometry_dupli", "light_path", "value_f", "value_v", "mix", "attr",
+	"convert", "fresnel", "wireframe", "wavelength", "blackbody",
+	"emission_weight", "tex_gradient", "tex_voronoi", "tex_musgrave",
+	"tex_wave", "tex_magic", "tex_noise", "shader_jump", "set_displacement",
+	"geometry_bump_dx", "geometry_bump_dy", "set_bump", "math", "vector_math",
+	"vector_transform", "mapping", "tex_coord", "tex_coord_bump_dx",
+	"tex_coord_bump_dy", "attr_bump_dx", "attr_bump_dy", "tex_environment",
+	"closure_holdout", "layer_weight", "closure_volume", "separate_vector",
+	"combine_vector", "separate_hsv", "combine_hsv", "hsv", "camera",
+	"invert", "normal", "gamma", "tex_checker", "brightcontrast", "rgb_ramp",
+	"rgb_curves", "vector_curves", "min_max", "light_falloff", "object_info",
+	"particle_info", "tex_brick", "closure_set_normal",
+	"closure_ambient_occlusion", "tangent", "normal_map", "hair_info", "uvmap",
+	"tex_voxel", "enter_bump_eval", "leave_bump_eval", "bevel", "displacement",
+	"vector_displacement",
+};
+
+static_assert(sizeof(svm_node_names) / sizeof(*svm_node_names) == NODE_NUM_TYPES,
+              "SVM node names do not match the node types");
+
+static string json_escape(const string& str)
+{
+	string result;
+	result.reserve(str.size());
+	foreach(char c, str) {
+		switch(c) {
+			case '"': result += "\\\""; break;
+			case '\\': result += "\\\\"; break;
+			case '\n': result += "\\n"; break;
+			case '\t': result += "\\t"; break;
+			default:
+				if((unsigned char)c < 0x20) {
+					result += string_printf("\\u%04x", (int)c);
+				}
+				else {
+					result += c;
+				}
+				break;
+		}
+	}
+	return result;
+}
+
+static bool namedsamplecount_sort(const NamedSampleCount& a, const NamedSampleCount& b)
+{
+	return a.samples > b.samples;
+}
+
+NamedSampleCount::NamedSampleCount(const string& name, uint64_t samples)
+: name(name), samples(samples)
+{
+}
+
+NamedSampleCountStats::NamedSampleCountStats()
+: total_samples(0)
+{
+}
+
+void NamedSampleCountStats::add(const string& name, uint64_t samples)
+{
+	if(samples == 0) {
+		return;
+	}
+	entries.push_back(NamedSampleCount(name, samples));
+	total_samples += samples;
+}
+
+void NamedSampleCountStats::sort()
+{
+	std::sort(entries.begin(), entries.end(), namedsamplecount_sort);
+}
+
+string NamedSampleCountStats::full_report(int indent_level, double sample_interval)
+{
+	const string indent(indent_level * 2, ' ');
+	string result = "";
+	foreach(const NamedSampleCount& entry, entries) {
+		double percentage = 100.0 * entry.samples / total_samples;
+		result += indent + string_printf("%-32s %8.2fs  %6.2f%%\n",
+		                                 entry.name.c_str(),
+		                                 entry.samples * sample_interval,
+		                                 percentage);
+	}
+	return result;
+}
+
+string NamedSampleCountStats::json_report(double sample_interval)
+{
+	string result = "[";
+	for(size_t i = 0; i < entries.size(); i++) {
+		const NamedSampleCount& entry = entries[i];
+		result += string_printf("%s\n    {\"name\": \"%s\", \"samples\": %llu, \"time\": %.6f}",
+		                        (i == 0)? "": ",",
+		                        json_escape(entry.name).c_str(),
+		                        (unsigned long long)entry.samples,
+		                        entry.samples * sample_interval);
+	}
+	result += (entries.empty())? "]": "\n  ]";
+	return result;
+}
+
+RenderStats::RenderStats()
+: has_profiling(false),
+  render_time(0.0),
+  sample_interval(0.0)
+{
+	for(int i = 0; i < PROFILING_NUM_RAY_TYPES; i++) {
+		rays[i] = 0;
+	}
+}
+
+void RenderStats::collect_profiling(Scene *scene, Profiler& prof)
+{
+	has_profiling = true;
+
+	render_time = prof.time_active();
+	sample_interval = prof.sample_interval();
+
+	for(int event = 0; event < PROFILING_NUM_EVENTS; event++) {
+		kernel.add(profiling_event_names[event], prof.get_event((ProfilingEvent)event));
+	}
+
+	for(int i = 0; i < prof.num_shaders(); i++) {
+		string name = (i < (int)scene->shaders.size())? scene->shaders[i]->name.string():
+		                                                string_printf("shader %d", i);
+		shaders.add(name, prof.get_shader(i));
+	}
+
+	for(int i = 0; i < prof.num_objects(); i++) {
+		string name = (i < (int)scene->objects.size())? scene->objects[i]->name.string():
+		                                                string_printf("object %d", i);
+		objects.add(name, prof.get_object(i));
+	}
+
+	for(int i = 0; i < prof.num_nodes() && i < NODE_NUM_TYPES; i++) {
+		nodes.add(svm_node_names[i], prof.get_node(i));
+	}
+
+	for(int i = 0; i < PROFILING_NUM_RAY_TYPES; i++) {
+		rays[i] = prof.get_rays((ProfilingRayType)i);
+	}
+
+	kernel.sort();
+	shaders.sort();
+	objects.sort();
+	nodes.sort();
+}
+
+string RenderStats::full_report()
+{
+	string result = "";
+
+	if(!has_profiling) {
+		return result;
+	}
+
+	result += string_printf("Render time: %.2fs\n", render_time);
+
+	result += "Rays:\n";
+	for(int i = 0; i < PROFILING_NUM_RAY_TYPES; i++) {
+		double rays_per_second = (render_time > 0.0)? rays[i] / render_time: 0.0;
+		result += string_printf("  %-32s %12llu  %.2f M/s\n",
+		                        profiling_ray_type_names[i],
+		                        (unsigned long long)rays[i],
+		                        rays_per_second * 1e-6);
+	}
+
+	result += "Kernel:\n" + kernel.full_report(1, sample_interval);
+	result += "Shaders:\n" + shaders.full_report(1, sample_interval);
+	result += "Objects:\n" + objects.full_report(1, sample_interval);
+	result += "Shader nodes:\n" + nodes.full_report(1, sample_interval);
+
+	return result;
+}
+
+string RenderStats::json_report()
+{
+	string result = "{\n";
+
+	result += string_printf("  \"render_time\": %.6f,\n", render_time);
+	result += string_printf("  \"sample_interval\": %.6f,\n", sample_interval);
+
+	result += "  \"rays\": {";
+	for(int i = 0; i < PROFILING_NUM_RAY_TYPES; i++) {
+		double rays_per_second = (render_time > 0.0)? rays[i] / render_time: 0.0;
+		result += string_printf("%s\n    \"%s\": {\"count\": %llu, \"per_second\": %.2f}",
+		                        (i == 0)? "": ",",
+		                        profiling_ray_type_names[i],
+		                        (unsigned long long)rays[i],
+		                        rays_per_second);
+	}
+	result += "\n  },\n";
+
+	result += "  \"kernel\": " + kernel.json_report(sample_interval) + ",\n";
+	result += "  \"shaders\": " + shaders.json_report(sample_interval) + ",\n";
+	result += "  \"objects\": " + objects.json_report(sample_interval) + ",\n";
+	result += "  \"shader_nodes\": " + nodes.json_report(sample_interval) + "\n";
+
+	result += "}\n";
+	return result;
+}
+
+CCL_NAMESPACE_END
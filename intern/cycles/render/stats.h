@@ -0,0 +1,83 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __RENDER_STATS_H__
+#define __RENDER_STATS_H__
+
+#include "util/util_profiling.h"
+#include "util/util_string.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+class Scene;
+
+/* Number of profiler samples taken while rendering a named item, such as a
+ * shader or an object. */
+class NamedSampleCount {
+public:
+	NamedSampleCount(const string& name, uint64_t samples);
+
+	string name;
+	uint64_t samples;
+};
+
+/* List of named items sorted by their sample count. */
+class NamedSampleCountStats {
+public:
+	NamedSampleCountStats();
+
+	/* Items without samples are skipped. */
+	void add(const string& name, uint64_t samples);
+	void sort();
+
+	string full_report(int indent_level, double sample_interval);
+	string json_report(double sample_interval);
+
+	uint64_t total_samples;
+	vector<NamedSampleCount> entries;
+};
+
+/* Statistics about a render, collected by the session once it is done. */
+class RenderStats {
+public:
+	RenderStats();
+
+	/* Fill in the statistics from the profiler, which must be stopped. */
+	void collect_profiling(Scene *scene, Profiler& prof);
+
+	/* Human readable report, for logs. */
+	string full_report();
+	/* Same statistics as a JSON document, for tools comparing renders. */
+	string json_report();
+
+	bool has_profiling;
+
+	/* Seconds the profiler was active and between two of its samples. */
+	double render_time;
+	double sample_interval;
+
+	NamedSampleCountStats kernel;
+	NamedSampleCountStats shaders;
+	NamedSampleCountStats objects;
+	NamedSampleCountStats nodes;
+
+	uint64_t rays[PROFILING_NUM_RAY_TYPES];
+};
+
+CCL_NAMESPACE_END
+
+#endif  /* __RENDER_STATS_H__ */
@@ -16,6 +16,7 @@
 
 #include "device/device.h"
 #include "render/graph.h"
+#include "render/integrator.h"
 #include "render/light.h"
 #include "render/mesh.h"
 #include "render/nodes.h"
@@ -25,6 +26,7 @@
 
 #include "util/util_logging.h"
 #include "util/util_foreach.h"
+#include "util/util_md5.h"
 #include "util/util_progress.h"
 #include "util/util_task.h"
 
@@ -44,29 +46,69 @@ void SVMShaderManager::reset(Scene * /*scene*/)
 {
 }
 
+/* Key of everything the compiled SVM nodes of a shader depend on, empty if
+ * the shader can't be cached. */
+static string svm_compile_key(Scene *scene, Shader *shader)
+{
+	if(shader->graph_hash == "") {
+		return "";
+	}
+
+	MD5Hash md5;
+	md5.append(shader->graph_hash);
+	shader->hash(md5);
+
+	bool background = (shader == scene->default_background);
+	md5.append((uint8_t*)&background, sizeof(background));
+	md5.append((uint8_t*)&shader->used, sizeof(shader->used));
+
+	if(shader->has_integrator_dependency) {
+		float filter_glossy = scene->integrator->filter_glossy;
+		md5.append((uint8_t*)&filter_glossy, sizeof(filter_glossy));
+	}
+
+	return md5.get_hex();
+}
+
 void SVMShaderManager::device_update_shader(Scene *scene,
                                             Shader *shader,
                                             Progress *progress,
-                                            array<int4> *global_svm_nodes)
+                                            array<int4> *global_svm_nodes,
+                                            int *num_cached)
 {
 	if(progress->get_cancel()) {
 		return;
 	}
 	assert(shader->graph);
 
-	array<int4> svm_nodes;
-	svm_nodes.push_back_slow(make_int4(NODE_SHADER_JUMP, 0, 0, 0));
+	/* reuse nodes of the previous compilation if nothing changed */
+	string key = svm_compile_key(scene, shader);
+	bool cached = (key != "" && key == shader->svm_nodes_key);
+
+	if(!cached) {
+		array<int4> svm_nodes;
+		svm_nodes.push_back_slow(make_int4(NODE_SHADER_JUMP, 0, 0, 0));
+
+		SVMCompiler::Summary summary;
+		SVMCompiler compiler(scene->shader_manager, scene->image_manager);
+		compiler.background = (shader == scene->default_background);
+		compiler.compile(scene, shader, svm_nodes, 0, &summary);
 
-	SVMCompiler::Summary summary;
-	SVMCompiler compiler(scene->shader_manager, scene->image_manager);
-	compiler.background = (shader == scene->default_background);
-	compiler.compile(scene, shader, svm_nodes, 0, &summary);
+		VLOG(2) << "Compilation summary:\n"
+		        << "Shader name: " << shader->name << "\n"
+		        << summary.full_report();
 
-	VLOG(2) << "Compilation summary:\n"
-	        << "Shader name: " << shader->name << "\n"
-	        << summary.full_report();
+		shader->svm_nodes.steal_data(svm_nodes);
+		/* compiling sets the integrator dependency, so get the key again */
+		shader->svm_nodes_key = svm_compile_key(scene, shader);
+	}
+
+	const array<int4>& svm_nodes = shader->svm_nodes;
 
 	nodes_lock_.lock();
+	if(cached) {
+		(*num_cached)++;
+	}
 	if(shader->use_mis && shader->has_surface_emission) {
 		scene->light_manager->need_update = true;
 	}
@@ -112,6 +154,8 @@ void SVMShaderManager::device_update(Device *device, DeviceScene *dscene, Scene
 		svm_nodes.push_back_slow(make_int4(NODE_SHADER_JUMP, 0, 0, 0));
 	}
 
+	int num_cached = 0;
+
 	TaskPool task_pool;
 	foreach(Shader *shader, scene->shaders) {
 		task_pool.push(function_bind(&SVMShaderManager::device_update_shader,
@@ -119,7 +163,8 @@ void SVMShaderManager::device_update(Device *device, DeviceScene *dscene, Scene
 		                             scene,
 		                             shader,
 		                             &progress,
-		                             &svm_nodes),
+		                             &svm_nodes,
+		                             &num_cached),
 		               false);
 	}
 	task_pool.wait_work();
@@ -142,7 +187,8 @@ void SVMShaderManager::device_update(Device *device, DeviceScene *dscene, Scene
 
 	VLOG(1) << "Shader manager updated "
 	        << scene->shaders.size() << " shaders in "
-	        << time_dt() - start_time << " seconds.";
+	        << time_dt() - start_time << " seconds, "
+	        << num_cached << " of them reused without compiling.";
 }
 
 void SVMShaderManager::device_free(Device *device, DeviceScene *dscene, Scene *scene)
@@ -55,7 +55,8 @@ protected:
 	void device_update_shader(Scene *scene,
 	                          Shader *shader,
 	                          Progress *progress,
-	                          array<int4> *global_svm_nodes);
+	                          array<int4> *global_svm_nodes,
+	                          int *num_cached);
 };
 
 /* Graph Compiler */
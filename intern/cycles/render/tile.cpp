@@ -79,6 +79,9 @@ inline int2 hilbert_index_to_pos(int n, int d)
 	return xy;
 }
 
+/* Tiles are not split into parts smaller than this. */
+const int TILE_SPLIT_MIN_SIZE = 16;
+
 enum SpiralDirection {
 	DIRECTION_UP,
 	DIRECTION_LEFT,
@@ -102,6 +105,7 @@ TileManager::TileManager(bool progressive_, int num_samples_, int2 tile_size_, i
 	preserve_tile_device = preserve_tile_device_;
 	background = background_;
 	schedule_denoising = false;
+	use_tile_splitting = false;
 
 	range_start_sample = 0;
 	range_num_samples = -1;
@@ -149,6 +153,7 @@ void TileManager::reset(BufferParams& params_, int num_samples_)
 	state.buffer = BufferParams();
 	state.sample = range_start_sample - 1;
 	state.num_tiles = 0;
+	state.num_busy_tiles = 0;
 	state.num_samples = 0;
 	state.resolution_divider = get_divider(params.width, params.height, start_resolution);
 	state.render_tiles.clear();
@@ -351,6 +356,8 @@ int TileManager::gen_tiles(bool sliced)
 void TileManager::gen_render_tiles()
 {
 	/* Regenerate just the render tiles for progressive render. */
+	state.num_busy_tiles = 0;
+
 	foreach(Tile& tile, state.tiles) {
 		state.render_tiles[tile.device].push_back(tile.index);
 	}
@@ -363,6 +370,13 @@ void TileManager::set_tiles()
 	int image_h = max(1, params.height/resolution);
 
 	state.num_tiles = gen_tiles(!background);
+	state.num_busy_tiles = 0;
+
+	/* Reserve room for split tiles up front, tiles that are handed out are
+	 * referenced by pointer and must not be reallocated. */
+	if(use_tile_splitting) {
+		state.tiles.reserve(state.tiles.size()*2);
+	}
 
 	state.buffer.width = image_w;
 	state.buffer.height = image_h;
@@ -412,6 +426,10 @@ bool TileManager::finish_tile(int index, bool &delete_tile)
 {
 	delete_tile = false;
 
+	if(state.tiles[index].state == Tile::RENDER) {
+		state.num_busy_tiles--;
+	}
+
 	if(progressive) {
 		return true;
 	}
@@ -481,7 +499,55 @@ bool TileManager::next_tile(Tile* &tile, int device)
 
 	int idx = state.render_tiles[logical_device].front();
 	state.render_tiles[logical_device].pop_front();
+
+	split_tile(idx, state.render_tiles[logical_device]);
+
 	tile = &state.tiles[idx];
+	state.num_busy_tiles++;
+	return true;
+}
+
+/* Splits the tile in half along its longest side when the remaining tiles
+ * can't keep all threads busy until the end of the render. The second half
+ * is put at the front of the list, so the next idle thread picks it up. */
+bool TileManager::split_tile(int index, list<int>& tile_list)
+{
+	if(!use_tile_splitting || progressive || schedule_denoising) {
+		return false;
+	}
+	if((int)tile_list.size() > state.num_busy_tiles ||
+	   state.tiles.size() == state.tiles.capacity())
+	{
+		return false;
+	}
+
+	Tile first = state.tiles[index];
+	Tile second = first;
+	second.index = state.tiles.size();
+
+	if(first.w >= first.h) {
+		if(first.w < 2*TILE_SPLIT_MIN_SIZE) {
+			return false;
+		}
+		first.w /= 2;
+		second.x += first.w;
+		second.w -= first.w;
+	}
+	else {
+		if(first.h < 2*TILE_SPLIT_MIN_SIZE) {
+			return false;
+		}
+		first.h /= 2;
+		second.y += first.h;
+		second.h -= first.h;
+	}
+
+	state.tiles[index] = first;
+	state.tiles.push_back(second);
+	state.num_tiles++;
+
+	tile_list.push_front(second.index);
+
 	return true;
 }
 
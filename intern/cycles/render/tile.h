@@ -73,6 +73,8 @@ public:
 		int num_samples;
 		int resolution_divider;
 		int num_tiles;
+		/* Number of handed out tiles that are still being rendered. */
+		int num_busy_tiles;
 
 		/* Total samples over all pixels: Generally num_samples*num_pixels,
 		 * but can be higher due to the initial resolution division for previews. */
@@ -114,6 +116,10 @@ public:
 
 	/* Schedule tiles for denoising after they've been rendered. */
 	bool schedule_denoising;
+
+	/* Split tiles in half near the end of the render, when there are fewer
+	 * tiles left than are being rendered, so threads don't go idle. */
+	bool use_tile_splitting;
 protected:
 
 	void set_tiles();
@@ -150,6 +156,8 @@ protected:
 
 	int get_neighbor_index(int index, int neighbor);
 	bool check_neighbor_state(int index, Tile::State state);
+
+	bool split_tile(int index, list<int>& tile_list);
 };
 
 CCL_NAMESPACE_END
@@ -58,17 +58,23 @@ struct SubdParams {
 
 /* EdgeDice Base */
 
+/* Space for all diced geometry is allocated in advance with reserve(), after
+ * which subpatches can be diced in parallel, by copies of the EdgeDice that
+ * each write to their own range of vertices and triangles. */
+
 class EdgeDice {
 public:
 	SubdParams params;
 	float3 *mesh_P;
 	float3 *mesh_N;
+	float3 *mesh_ptex_uv;
+	float *mesh_ptex_face_id;
 	size_t vert_offset;
 	size_t tri_offset;
 
 	explicit EdgeDice(const SubdParams& params);
 
-	void reserve(int num_verts);
+	void reserve(int num_verts, int num_triangles);
 
 	int add_vert(Patch *patch, float2 uv);
 	void add_triangle(Patch *patch, int v0, int v1, int v2);
@@ -109,7 +115,10 @@ public:
 
 	explicit QuadDice(const SubdParams& params);
 
-	void reserve(EdgeFactors& ef, int Mu, int Mv);
+	void grid_size(SubPatch& sub, EdgeFactors& ef, int *Mu, int *Mv);
+	int num_verts(SubPatch& sub, EdgeFactors& ef);
+	int num_triangles(SubPatch& sub, EdgeFactors& ef);
+
 	float3 eval_projected(SubPatch& sub, float u, float v);
 
 	float2 map_uv(SubPatch& sub, float u, float v);
@@ -21,11 +21,18 @@
 #include "subd/subd_patch.h"
 #include "subd/subd_split.h"
 
+#include "util/util_algorithm.h"
 #include "util/util_math.h"
+#include "util/util_task.h"
 #include "util/util_types.h"
 
 CCL_NAMESPACE_BEGIN
 
+/* Number of input subpatches split by one task. */
+#define DSPLIT_TASK_SUBPATCHES 64
+/* Approximate number of vertices diced by one task. */
+#define DSPLIT_TASK_VERTS 16384
+
 /* DiagSplit */
 
 DiagSplit::DiagSplit(const SubdParams& params_)
@@ -238,9 +245,72 @@ void DiagSplit::split_quad(Patch *patch, QuadDice::SubPatch *subpatch)
 	limit_edge_factors(sub_split, ef_split, 1 << params.max_level);
 
 	split(sub_split, ef_split);
+}
+
+void DiagSplit::split_quads_task(vector<QuadDice::SubPatch> *subpatches, size_t start, size_t end)
+{
+	for(size_t i = start; i < end; i++) {
+		QuadDice::SubPatch& sub = (*subpatches)[i];
+		split_quad(sub.patch, &sub);
+	}
+}
+
+void DiagSplit::split_quads(vector<QuadDice::SubPatch>& subpatches)
+{
+	/* Each task splits into its own DiagSplit, so that the results can be
+	 * appended in order afterwards and dicing does not depend on threading. */
+	size_t num_tasks = divide_up(subpatches.size(), DSPLIT_TASK_SUBPATCHES);
+	vector<DiagSplit> splits(num_tasks, DiagSplit(params));
+
+	TaskPool pool;
+	for(size_t i = 0; i < num_tasks; i++) {
+		size_t start = i * DSPLIT_TASK_SUBPATCHES;
+		size_t end = min(start + DSPLIT_TASK_SUBPATCHES, subpatches.size());
+
+		pool.push(function_bind(&DiagSplit::split_quads_task, &splits[i], &subpatches, start, end));
+	}
+	pool.wait_work();
+
+	size_t num_subpatches = subpatches_quad.size();
+	for(size_t i = 0; i < num_tasks; i++) {
+		num_subpatches += splits[i].subpatches_quad.size();
+	}
+
+	subpatches_quad.reserve(num_subpatches);
+	edgefactors_quad.reserve(num_subpatches);
+
+	for(size_t i = 0; i < num_tasks; i++) {
+		subpatches_quad.insert(subpatches_quad.end(),
+		                       splits[i].subpatches_quad.begin(),
+		                       splits[i].subpatches_quad.end());
+		edgefactors_quad.insert(edgefactors_quad.end(),
+		                        splits[i].edgefactors_quad.begin(),
+		                        splits[i].edgefactors_quad.end());
+	}
+}
+
+void DiagSplit::dice_task(QuadDice *dice, size_t start, size_t end, size_t vert_offset, size_t tri_offset)
+{
+	QuadDice task_dice(*dice);
+	task_dice.vert_offset = vert_offset;
+	task_dice.tri_offset = tri_offset;
 
+	for(size_t i = start; i < end; i++) {
+		task_dice.dice(subpatches_quad[i], edgefactors_quad[i]);
+	}
+}
+
+void DiagSplit::dice()
+{
 	QuadDice dice(params);
 
+	/* Count the vertices and triangles of all subpatches so that space for
+	 * them can be allocated at once, and group subpatches into tasks that
+	 * dice a similar number of vertices. */
+	vector<size_t> task_start, task_vert_offset, task_tri_offset;
+	size_t num_verts = 0, num_triangles = 0;
+	size_t last_task_verts = 0;
+
 	for(size_t i = 0; i < subpatches_quad.size(); i++) {
 		QuadDice::SubPatch& sub = subpatches_quad[i];
 		QuadDice::EdgeFactors& ef = edgefactors_quad[i];
@@ -250,8 +320,29 @@ void DiagSplit::split_quad(Patch *patch, QuadDice::SubPatch *subpatch)
 		ef.tv0 = max(ef.tv0, 1);
 		ef.tv1 = max(ef.tv1, 1);
 
-		dice.dice(sub, ef);
+		if(i == 0 || num_verts - last_task_verts >= DSPLIT_TASK_VERTS) {
+			task_start.push_back(i);
+			task_vert_offset.push_back(num_verts);
+			task_tri_offset.push_back(num_triangles);
+			last_task_verts = num_verts;
+		}
+
+		num_verts += dice.num_verts(sub, ef);
+		num_triangles += dice.num_triangles(sub, ef);
+	}
+
+	dice.reserve(num_verts, num_triangles);
+
+	TaskPool pool;
+	for(size_t i = 0; i < task_start.size(); i++) {
+		size_t start = task_start[i];
+		size_t end = (i + 1 < task_start.size()) ? task_start[i + 1] : subpatches_quad.size();
+
+		pool.push(function_bind(&DiagSplit::dice_task, this, &dice, start, end,
+		                        dice.vert_offset + task_vert_offset[i],
+		                        dice.tri_offset + task_tri_offset[i]));
 	}
+	pool.wait_work();
 
 	subpatches_quad.clear();
 	edgefactors_quad.clear();
@@ -51,7 +51,19 @@ public:
 	void dispatch(QuadDice::SubPatch& sub, QuadDice::EdgeFactors& ef);
 	void split(QuadDice::SubPatch& sub, QuadDice::EdgeFactors& ef, int depth=0);
 
+	/* Split patch into subpatches, which are collected until dice() is called. */
 	void split_quad(Patch *patch, QuadDice::SubPatch *subpatch=NULL);
+
+	/* Split many subpatches in parallel, the resulting subpatches are in the
+	 * same order as when splitting them one by one. */
+	void split_quads(vector<QuadDice::SubPatch>& subpatches);
+
+	/* Dice all collected subpatches into the mesh in parallel. */
+	void dice();
+
+protected:
+	void split_quads_task(vector<QuadDice::SubPatch> *subpatches, size_t start, size_t end);
+	void dice_task(QuadDice *dice, size_t start, size_t end, size_t vert_offset, size_t tri_offset);
 };
 
 CCL_NAMESPACE_END
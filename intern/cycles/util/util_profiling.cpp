@@ -0,0 +1,195 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "util/util_profiling.h"
+
+#include "util/util_algorithm.h"
+#include "util/util_foreach.h"
+#include "util/util_function.h"
+#include "util/util_time.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Sampling every millisecond gives enough samples for a frame of a few
+ * seconds, without the worker itself taking noticeable time. */
+#define PROFILING_SAMPLE_INTERVAL 1e-3
+
+Profiler::Profiler()
+: start_time(0.0),
+  active_time(0.0),
+  do_stop_worker(true),
+  worker(NULL)
+{
+	reset(0, 0, 0);
+}
+
+Profiler::~Profiler()
+{
+	stop();
+}
+
+void Profiler::reset(int num_shaders, int num_objects, int num_nodes)
+{
+	thread_scoped_lock lock(mutex);
+
+	event_samples.clear();
+	event_samples.resize(PROFILING_NUM_EVENTS, 0);
+	shader_samples.clear();
+	shader_samples.resize(num_shaders, 0);
+	object_samples.clear();
+	object_samples.resize(num_objects, 0);
+	node_samples.clear();
+	node_samples.resize(num_nodes, 0);
+
+	for(int i = 0; i < PROFILING_NUM_RAY_TYPES; i++) {
+		rays[i] = 0;
+	}
+
+	active_time = 0.0;
+	start_time = time_dt();
+}
+
+void Profiler::start()
+{
+	assert(worker == NULL);
+	start_time = time_dt();
+	do_stop_worker = false;
+	worker = new thread(function_bind(&Profiler::run, this));
+}
+
+void Profiler::stop()
+{
+	if(worker != NULL) {
+		do_stop_worker = true;
+
+		worker->join();
+		delete worker;
+		worker = NULL;
+
+		active_time += time_dt() - start_time;
+	}
+}
+
+void Profiler::add_state(ProfilingState *state)
+{
+	thread_scoped_lock lock(mutex);
+
+	state->reset();
+	states.push_back(state);
+}
+
+void Profiler::remove_state(ProfilingState *state)
+{
+	thread_scoped_lock lock(mutex);
+
+	vector<ProfilingState*>::iterator it = std::find(states.begin(), states.end(), state);
+	if(it == states.end()) {
+		return;
+	}
+	states.erase(it);
+
+	/* Keep the rays of finished threads. */
+	for(int i = 0; i < PROFILING_NUM_RAY_TYPES; i++) {
+		rays[i] += state->rays[i];
+	}
+}
+
+void Profiler::run()
+{
+	double next_sample = time_dt();
+
+	while(!do_stop_worker) {
+		{
+			thread_scoped_lock lock(mutex);
+
+			foreach(ProfilingState *state, states) {
+				uint32_t event = state->event;
+				int32_t shader = state->shader;
+				int32_t object = state->object;
+				int32_t svm_node = state->svm_node;
+
+				if(event < PROFILING_NUM_EVENTS) {
+					event_samples[event]++;
+				}
+				if(shader >= 0 && shader < (int)shader_samples.size()) {
+					shader_samples[shader]++;
+				}
+				if(object >= 0 && object < (int)object_samples.size()) {
+					object_samples[object]++;
+				}
+				if(svm_node >= 0 && svm_node < (int)node_samples.size()) {
+					node_samples[svm_node]++;
+				}
+			}
+		}
+
+		/* Schedule samples at fixed points in time, so the time spent taking
+		 * them does not skew the interval. */
+		next_sample += PROFILING_SAMPLE_INTERVAL;
+		double sleep_time = next_sample - time_dt();
+		if(sleep_time > 0.0) {
+			time_sleep(sleep_time);
+		}
+		else {
+			next_sample = time_dt();
+		}
+	}
+}
+
+double Profiler::sample_interval() const
+{
+	return PROFILING_SAMPLE_INTERVAL;
+}
+
+double Profiler::time_active() const
+{
+	if(worker != NULL) {
+		return active_time + (time_dt() - start_time);
+	}
+	return active_time;
+}
+
+uint64_t Profiler::get_event(ProfilingEvent event) const
+{
+	assert(worker == NULL);
+	return event_samples[event];
+}
+
+uint64_t Profiler::get_shader(int shader) const
+{
+	assert(worker == NULL);
+	return shader_samples[shader];
+}
+
+uint64_t Profiler::get_object(int object) const
+{
+	assert(worker == NULL);
+	return object_samples[object];
+}
+
+uint64_t Profiler::get_node(int node) const
+{
+	assert(worker == NULL);
+	return node_samples[node];
+}
+
+uint64_t Profiler::get_rays(ProfilingRayType type) const
+{
+	assert(worker == NULL);
+	return rays[type];
+}
+
+CCL_NAMESPACE_END
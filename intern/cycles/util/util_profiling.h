@@ -0,0 +1,200 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __UTIL_PROFILING_H__
+#define __UTIL_PROFILING_H__
+
+#include "util/util_thread.h"
+#include "util/util_types.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Parts of the render kernels that time is attributed to. */
+enum ProfilingEvent {
+	PROFILING_UNKNOWN = 0,
+	PROFILING_RAY_SETUP,
+	PROFILING_PATH_INTEGRATE,
+	PROFILING_SCENE_INTERSECT,
+	PROFILING_INDIRECT_EMISSION,
+	PROFILING_VOLUME,
+	PROFILING_SHADER_SETUP,
+	PROFILING_SHADER_EVAL,
+	PROFILING_SHADER_APPLY,
+	PROFILING_AO,
+	PROFILING_SUBSURFACE,
+	PROFILING_CONNECT_LIGHT,
+	PROFILING_SURFACE_BOUNCE,
+	PROFILING_WRITE_RESULT,
+
+	PROFILING_INTERSECT,
+	PROFILING_INTERSECT_LOCAL,
+	PROFILING_INTERSECT_SHADOW_ALL,
+	PROFILING_INTERSECT_VOLUME,
+	PROFILING_INTERSECT_VOLUME_ALL,
+
+	PROFILING_CLOSURE_EVAL,
+	PROFILING_CLOSURE_SAMPLE,
+	PROFILING_CLOSURE_VOLUME_EVAL,
+	PROFILING_CLOSURE_VOLUME_SAMPLE,
+
+	PROFILING_LIGHT_SAMPLE,
+	PROFILING_SHADOW_BLOCKED,
+
+	PROFILING_NUM_EVENTS,
+};
+
+/* Kinds of rays traced through the BVH. */
+enum ProfilingRayType {
+	PROFILING_RAY_CAMERA = 0,
+	PROFILING_RAY_INDIRECT,
+	PROFILING_RAY_SHADOW,
+	PROFILING_RAY_LOCAL,
+	PROFILING_RAY_VOLUME,
+
+	PROFILING_NUM_RAY_TYPES,
+};
+
+/* State of one render thread, written by the kernel and read by the
+ * profiler. Writes are plain stores so the kernels are barely slowed down,
+ * the profiler samples the state periodically instead of timing every
+ * event. */
+struct ProfilingState {
+	volatile uint32_t event;
+	volatile int32_t shader;
+	volatile int32_t object;
+	volatile int32_t svm_node;
+
+	/* Only written by the owning thread, summed up once the thread is done. */
+	uint64_t rays[PROFILING_NUM_RAY_TYPES];
+
+	ProfilingState()
+	{
+		reset();
+	}
+
+	void reset()
+	{
+		event = PROFILING_UNKNOWN;
+		shader = -1;
+		object = -1;
+		svm_node = -1;
+		for(int i = 0; i < PROFILING_NUM_RAY_TYPES; i++) {
+			rays[i] = 0;
+		}
+	}
+};
+
+/* Sampling profiler
+ *
+ * A worker thread samples the state of all registered render threads at a
+ * fixed interval, counting for each sample the active event, shader, object
+ * and SVM node. Counts multiplied by the interval approximate the time spent
+ * in each of them. */
+
+class Profiler {
+public:
+	Profiler();
+	~Profiler();
+
+	/* Clear all counters, with room for the given number of shaders, objects
+	 * and shader node types. */
+	void reset(int num_shaders, int num_objects, int num_nodes);
+
+	void start();
+	void stop();
+
+	bool active() const { return worker != NULL; }
+
+	/* Render threads register their state while rendering. */
+	void add_state(ProfilingState *state);
+	void remove_state(ProfilingState *state);
+
+	/* Time between samples in seconds. */
+	double sample_interval() const;
+	/* Seconds the profiler has been running. */
+	double time_active() const;
+
+	uint64_t get_event(ProfilingEvent event) const;
+	uint64_t get_shader(int shader) const;
+	uint64_t get_object(int object) const;
+	uint64_t get_node(int node) const;
+	uint64_t get_rays(ProfilingRayType type) const;
+
+	int num_shaders() const { return (int)shader_samples.size(); }
+	int num_objects() const { return (int)object_samples.size(); }
+	int num_nodes() const { return (int)node_samples.size(); }
+
+protected:
+	void run();
+
+	/* Guards the states, counters are only written by the worker. */
+	thread_mutex mutex;
+	vector<ProfilingState*> states;
+
+	vector<uint64_t> event_samples;
+	vector<uint64_t> shader_samples;
+	vector<uint64_t> object_samples;
+	vector<uint64_t> node_samples;
+	uint64_t rays[PROFILING_NUM_RAY_TYPES];
+
+	double start_time;
+	double active_time;
+
+	volatile bool do_stop_worker;
+	thread *worker;
+};
+
+/* Scoped event of a render thread, restoring the previous event when going
+ * out of scope. */
+
+class ProfilingHelper {
+public:
+	ProfilingHelper(ProfilingState *state, ProfilingEvent event)
+	: state(state)
+	{
+		previous_event = state->event;
+		state->event = event;
+	}
+
+	~ProfilingHelper()
+	{
+		state->event = previous_event;
+	}
+
+	inline void set_event(ProfilingEvent event)
+	{
+		state->event = event;
+	}
+
+	inline void set_shader(int shader)
+	{
+		state->shader = shader;
+	}
+
+	inline void set_object(int object)
+	{
+		state->object = object;
+	}
+
+protected:
+	ProfilingState *state;
+	uint32_t previous_event;
+};
+
+CCL_NAMESPACE_END
+
+#endif  /* __UTIL_PROFILING_H__ */
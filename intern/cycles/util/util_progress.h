@@ -23,10 +23,12 @@
  * update notifications from a job running in another thread. All methods
  * except for the constructor/destructor are thread safe. */
 
+#include "util/util_algorithm.h"
 #include "util/util_function.h"
 #include "util/util_string.h"
 #include "util/util_time.h"
 #include "util/util_thread.h"
+#include "util/util_vector.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -79,6 +81,7 @@ public:
 		current_tile_sample = 0;
 		rendered_tiles = 0;
 		denoised_tiles = 0;
+		thread_busy_time.clear();
 		start_time = time_dt();
 		render_start_time = time_dt();
 		end_time = 0.0;
@@ -254,6 +257,37 @@ public:
 		return denoised_tiles;
 	}
 
+	/* thread utilization */
+
+	void add_thread_busy_time(int thread_id, double busy_time)
+	{
+		thread_scoped_lock lock(progress_mutex);
+
+		if((size_t)thread_id >= thread_busy_time.size()) {
+			thread_busy_time.resize(thread_id + 1, 0.0);
+		}
+		thread_busy_time[thread_id] += busy_time;
+	}
+
+	/* Fraction of the render time each thread spent rendering tiles, indexed
+	 * by task scheduler thread id. Threads that did not render report zero. */
+	vector<float> get_thread_utilization()
+	{
+		thread_scoped_lock lock(progress_mutex);
+
+		double time = (end_time > 0) ? end_time : time_dt();
+		double render_time = time - render_start_time;
+		vector<float> utilization(thread_busy_time.size(), 0.0f);
+
+		if(render_time > 0.0) {
+			for(size_t i = 0; i < thread_busy_time.size(); i++) {
+				utilization[i] = (float)min(thread_busy_time[i] / render_time, 1.0);
+			}
+		}
+
+		return utilization;
+	}
+
 	/* status messages */
 
 	void set_status(const string& status_, const string& substatus_ = "")
@@ -345,6 +379,8 @@ protected:
 	/* Stores the number of tiles that's already finished.
 	 * Used to determine whether all but the last tile are finished rendering, in which case the current_tile_sample is displayed. */
 	int rendered_tiles, denoised_tiles;
+	/* Time spent rendering tiles per thread, to detect idle threads. */
+	vector<double> thread_busy_time;
 
 	double start_time, render_start_time;
 	/* End time written when render is done, so it doesn't keep increasing on redraws. */
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __UTIL_SPARSE_GRID_H__
+#define __UTIL_SPARSE_GRID_H__
+
+#include <string.h>
+
+#include "util/util_math.h"
+#include "util/util_texture.h"
+#include "util/util_types.h"
+#include "util/util_vector.h"
+
+/* Sparse Grid
+ *
+ * Volume grids are split into tiles of TEX_SPARSE_TILE_SIZE^3 voxels and only
+ * tiles that contain non-zero voxels are stored, one after the other. The
+ * offsets table has an entry for every tile of the grid with the index of the
+ * tile in the packed storage, or -1 for empty tiles which read back as zero.
+ * Voxels of border tiles which are outside of the grid are padded with zeros. */
+
+CCL_NAMESPACE_BEGIN
+
+inline size_t sparse_grid_num_tiles(size_t size)
+{
+	return (size + TEX_SPARSE_TILE_SIZE - 1) >> TEX_SPARSE_TILE_SHIFT;
+}
+
+template<typename T>
+bool sparse_grid_voxel_is_zero(const T& voxel)
+{
+	const uchar *bytes = (const uchar*)&voxel;
+	for(size_t i = 0; i < sizeof(T); i++) {
+		if(bytes[i] != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Fill in the offsets table of the dense grid, returns the number of active
+ * tiles. */
+template<typename T>
+size_t sparse_grid_compute_offsets(const T *voxels,
+                                   const size_t width,
+                                   const size_t height,
+                                   const size_t depth,
+                                   vector<int> *offsets)
+{
+	const size_t tiles_x = sparse_grid_num_tiles(width);
+	const size_t tiles_y = sparse_grid_num_tiles(height);
+	const size_t tiles_z = sparse_grid_num_tiles(depth);
+
+	offsets->clear();
+	offsets->resize(tiles_x*tiles_y*tiles_z, -1);
+
+	for(size_t z = 0; z < depth; z++) {
+		for(size_t y = 0; y < height; y++) {
+			const T *row = voxels + (z*height + y)*width;
+			const size_t tile_yz = ((z >> TEX_SPARSE_TILE_SHIFT)*tiles_y +
+			                        (y >> TEX_SPARSE_TILE_SHIFT))*tiles_x;
+
+			for(size_t x = 0; x < width; x++) {
+				if(!sparse_grid_voxel_is_zero(row[x])) {
+					(*offsets)[tile_yz + (x >> TEX_SPARSE_TILE_SHIFT)] = 0;
+				}
+			}
+		}
+	}
+
+	/* Assign packed indices in tile order. */
+	size_t num_active = 0;
+	for(size_t tile = 0; tile < offsets->size(); tile++) {
+		if((*offsets)[tile] == 0) {
+			(*offsets)[tile] = num_active++;
+		}
+	}
+
+	return num_active;
+}
+
+/* Copy the active tiles of the dense grid into tiles, which must have room for
+ * num_active*TEX_SPARSE_TILE_VOLUME voxels. */
+template<typename T>
+void sparse_grid_fill_tiles(const T *voxels,
+                            const size_t width,
+                            const size_t height,
+                            const size_t depth,
+                            const vector<int>& offsets,
+                            T *tiles)
+{
+	const size_t tiles_x = sparse_grid_num_tiles(width);
+	const size_t tiles_y = sparse_grid_num_tiles(height);
+	const size_t tiles_z = sparse_grid_num_tiles(depth);
+
+	for(size_t tz = 0; tz < tiles_z; tz++) {
+		for(size_t ty = 0; ty < tiles_y; ty++) {
+			for(size_t tx = 0; tx < tiles_x; tx++) {
+				const int offset = offsets[(tz*tiles_y + ty)*tiles_x + tx];
+				if(offset < 0) {
+					continue;
+				}
+
+				T *tile = tiles + (size_t)offset*TEX_SPARSE_TILE_VOLUME;
+				memset(tile, 0, sizeof(T)*TEX_SPARSE_TILE_VOLUME);
+
+				const size_t x0 = tx << TEX_SPARSE_TILE_SHIFT;
+				const size_t y0 = ty << TEX_SPARSE_TILE_SHIFT;
+				const size_t z0 = tz << TEX_SPARSE_TILE_SHIFT;
+				const size_t size_x = min(width - x0, (size_t)TEX_SPARSE_TILE_SIZE);
+				const size_t size_y = min(height - y0, (size_t)TEX_SPARSE_TILE_SIZE);
+				const size_t size_z = min(depth - z0, (size_t)TEX_SPARSE_TILE_SIZE);
+
+				for(size_t z = 0; z < size_z; z++) {
+					for(size_t y = 0; y < size_y; y++) {
+						memcpy(tile + (z*TEX_SPARSE_TILE_SIZE + y)*TEX_SPARSE_TILE_SIZE,
+						       voxels + ((z0 + z)*height + y0 + y)*width + x0,
+						       sizeof(T)*size_x);
+					}
+				}
+			}
+		}
+	}
+}
+
+CCL_NAMESPACE_END
+
+#endif /* __UTIL_SPARSE_GRID_H__ */
@@ -129,14 +129,20 @@ void *mmap(void *UNUSED(start), size_t len, int prot, int flags, int fd, off_t o
 		}
 	}
 
-	/* note len is passed to a 32 bit DWORD, so can't be > 4 GB */
-	maphandle = CreateFileMapping(fhandle, NULL, prot_flags, 0, len, NULL);
+	/* sizes and offsets are passed as high and low 32 bit DWORDs,
+	 * the mapping has to reach the end of the view */
+	{
+		const ULONGLONG map_size = (ULONGLONG)offset + (ULONGLONG)len;
+		maphandle = CreateFileMapping(fhandle, NULL, prot_flags,
+		                              (DWORD)(map_size >> 32), (DWORD)(map_size & 0xFFFFFFFF), NULL);
+	}
 	if (maphandle == 0) {
 		errno = EBADF;
 		return MAP_FAILED;
 	}
 
-	ptr = MapViewOfFile(maphandle, access_flags, 0, offset, 0);
+	ptr = MapViewOfFile(maphandle, access_flags,
+	                    (DWORD)((ULONGLONG)offset >> 32), (DWORD)((ULONGLONG)offset & 0xFFFFFFFF), 0);
 	if (ptr == NULL) {
 		DWORD dwLastErr = GetLastError();
 		if (dwLastErr == ERROR_MAPPED_ALIGNMENT)
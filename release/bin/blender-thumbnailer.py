@@ -84,6 +84,39 @@ def open_wrapper_get():
         return open_local_url
 
 
+def open_chunked_first(blendfile):
+    """ Files saved with "Fast Compression" are split in independently compressed
+    chunks, the thumbnail is in the first one, which is never LZO compressed.
+    Return its data as a file, or None when it can't be read.
+    """
+    import io
+    import zlib
+
+    # file header: magic, version, chunk size, then the first chunk header:
+    # codec (0: stored, 2: zlib), compressed size, size
+    head = blendfile.read(28)
+    if len(head) != 28 or struct.unpack('<I', head[8:12])[0] != 1:
+        return None
+
+    codec, compressed_size, size = struct.unpack('<3I', head[16:28])
+    data = blendfile.read(compressed_size)
+    if len(data) != compressed_size:
+        return None
+
+    if codec == 2:
+        try:
+            data = zlib.decompress(data)
+        except zlib.error:
+            return None
+    elif codec != 0:
+        return None
+
+    if len(data) != size:
+        return None
+
+    return io.BytesIO(data)
+
+
 def blend_extract_thumb(path):
     import os
     open_wrapper = open_wrapper_get()
@@ -100,6 +133,14 @@ def blend_extract_thumb(path):
         blendfile.close()
         blendfile = gzip.GzipFile('', 'rb', 0, open_wrapper(path, 'rb'))
         head = blendfile.read(12)
+    elif head[0:8] == b'BLENDCHK':  # chunked magic
+        blendfile.seek(0)
+        blendfile_chunked = open_chunked_first(blendfile)
+        blendfile.close()
+        if blendfile_chunked is None:
+            return None, 0, 0
+        blendfile = blendfile_chunked
+        head = blendfile.read(12)
 
     if not head.startswith(b'BLENDER'):
         blendfile.close()
@@ -32,6 +32,41 @@
 # } BHead;
 
 
+def open_chunked_first(blendfile):
+    """
+    Files saved with "Fast Compression" are split in independently compressed
+    chunks, the render info is in the first one, which is never LZO compressed.
+    Return its data as a file, or None when it can't be read.
+    """
+    import io
+    import struct
+    import zlib
+
+    # file header: magic, version, chunk size, then the first chunk header:
+    # codec (0: stored, 2: zlib), compressed size, size
+    head = blendfile.read(28)
+    if len(head) != 28 or struct.unpack('<I', head[8:12])[0] != 1:
+        return None
+
+    codec, compressed_size, size = struct.unpack('<3I', head[16:28])
+    data = blendfile.read(compressed_size)
+    if len(data) != compressed_size:
+        return None
+
+    if codec == 2:
+        try:
+            data = zlib.decompress(data)
+        except zlib.error:
+            return None
+    elif codec != 0:
+        return None
+
+    if len(data) != size:
+        return None
+
+    return io.BytesIO(data)
+
+
 def read_blend_rend_chunk(path):
 
     import struct
@@ -45,6 +80,15 @@ def read_blend_rend_chunk(path):
         blendfile.seek(0)
         blendfile = gzip.open(blendfile, "rb")
         head = blendfile.read(7)
+    elif head == b'BLENDCH':  # chunked magic
+        blendfile.seek(0)
+        blendfile_chunked = open_chunked_first(blendfile)
+        blendfile.close()
+        if blendfile_chunked is None:
+            print("unable to read chunked blend file:", path)
+            return []
+        blendfile = blendfile_chunked
+        head = blendfile.read(7)
 
     if head != b'BLENDER':
         print("not a blend file:", path)
@@ -106,6 +106,7 @@ IFACEMETHODIMP CBlendThumb::Initialize(IStream *pStream, DWORD)
 #include <zlib.h>
 #include "Wincodec.h"
 const unsigned char gzip_magic[3] = { 0x1f, 0x8b, 0x08 };
+const char chunked_magic[8] = { 'B', 'L', 'E', 'N', 'D', 'C', 'H', 'K' };
 
 // IThumbnailProvider
 IFACEMETHODIMP CBlendThumb::GetThumbnail(UINT cx, HBITMAP *phbmp, WTS_ALPHATYPE *pdwAlpha)
@@ -176,6 +177,58 @@ IFACEMETHODIMP CBlendThumb::GetThumbnail(UINT cx, HBITMAP *phbmp, WTS_ALPHATYPE
 		delete[] src;
 		delete[] dest;
 	}
+	else
+	{
+		// Chunked compression ("Fast Compression"), the thumbnail is in the first chunk,
+		// which is stored or zlib compressed. File header: magic, version, chunk size,
+		// then the chunk header: codec (0: stored, 2: zlib), compressed size, size.
+		unsigned char header[28];
+		SeekPos.QuadPart = 0;
+		_pStream->Seek(SeekPos,STREAM_SEEK_SET,NULL);
+		_pStream->Read(header,28,&BytesRead);
+
+		if (BytesRead == 28 && memcmp(header, chunked_magic, 8) == 0)
+		{
+			unsigned int codec, source_size, dest_size;
+			memcpy(&codec, &header[16], 4);
+			memcpy(&source_size, &header[20], 4);
+			memcpy(&dest_size, &header[24], 4);
+
+			// chunks are at most 1MB, compression never makes them much larger
+			if ((codec != 0 && codec != 2) || dest_size > (1 << 20) || source_size > (2 << 20))
+				return S_FALSE;
+
+			Bytef* src = new Bytef[source_size];
+			Bytef* dest = new Bytef[dest_size];
+			_pStream->Read(src,source_size,&BytesRead);
+
+			bool ok = (BytesRead == source_size);
+			if (ok && codec == 0)
+			{
+				ok = (source_size == dest_size);
+				if (ok)
+					memcpy(dest, src, dest_size);
+			}
+			else if (ok)
+			{
+				uLongf out_size = dest_size;
+				ok = (uncompress(dest, &out_size, src, source_size) == Z_OK && out_size == dest_size);
+			}
+
+			if (ok)
+			{
+				// Replace the IStream, which is read-only
+				_pStream->Release();
+				_pStream = SHCreateMemStream(dest,dest_size);
+			}
+
+			delete[] src;
+			delete[] dest;
+
+			if (!ok)
+				return S_FALSE;
+		}
+	}
 
 	// Blender version, early out if sub 2.5
 	SeekPos.QuadPart = 9;
@@ -127,7 +127,7 @@ static int read_undosave(bContext *C, UndoElem *uel)
 /* name can be a dynamic string */
 void BKE_undo_write(bContext *C, const char *name)
 {
-	uintptr_t maxmem, totmem, memused;
+	uintptr_t maxmem;
 	int nr /*, success */ /* UNUSED */;
 	UndoElem *uel;
 
@@ -194,37 +194,37 @@ void BKE_undo_write(bContext *C, const char *name)
 
 		if (curundo->prev) prevfile = &(curundo->prev->memfile);
 
-		memused = MEM_get_memory_in_use();
 		/* success = */ /* UNUSED */ BLO_write_file_mem(CTX_data_main(C), prevfile, &curundo->memfile, G.fileflags);
-		curundo->undosize = MEM_get_memory_in_use() - memused;
+		curundo->undosize = curundo->memfile.size_added;
 	}
 
 	if (U.undomemory != 0) {
-		/* limit to maximum memory (afterwards, we can't know in advance) */
-		totmem = 0;
+		/* limit to maximum memory (afterwards, we can't know in advance),
+		 * steps share their data so only the memory still stored after freeing one counts */
+		MemFileStats stats;
 		maxmem = ((uintptr_t)U.undomemory) * 1024 * 1024;
 
+		BLO_memfile_stats_get(&stats);
+
 		/* keep at least two (original + other) */
-		uel = undobase.last;
-		while (uel && uel->prev) {
-			totmem += uel->undosize;
-			if (totmem > maxmem) break;
-			uel = uel->prev;
-		}
+		while ((stats.size_stored > maxmem) && (BLI_listbase_count_ex(&undobase, 3) > 2)) {
+			UndoElem *first = undobase.first;
+			BLI_remlink(&undobase, first);
+			/* the merge is because of compression */
+			BLO_memfile_merge(&first->memfile, &first->next->memfile);
+			MEM_freeN(first);
 
-		if (uel) {
-			if (uel->prev && uel->prev->prev)
-				uel = uel->prev;
-
-			while (undobase.first != uel) {
-				UndoElem *first = undobase.first;
-				BLI_remlink(&undobase, first);
-				/* the merge is because of compression */
-				BLO_memfile_merge(&first->memfile, &first->next->memfile);
-				MEM_freeN(first);
-			}
+			BLO_memfile_stats_get(&stats);
 		}
 	}
+
+	if (G.debug & G_DEBUG) {
+		MemFileStats stats;
+		BLO_memfile_stats_get(&stats);
+		printf("undo push %s: %.2fM added, %d steps use %.2fM (%.2fM without sharing)\n",
+		       curundo->name, (double)(curundo->undosize >> 10) / 1024.0, BLI_listbase_count(&undobase),
+		       (double)(stats.size_stored >> 10) / 1024.0, (double)(stats.size_total >> 10) / 1024.0);
+	}
 }
 
 /* 1 = an undo, -1 is a redo. we have to make sure 'curundo' remains at current situation */
@@ -385,6 +385,24 @@ bool BKE_undo_save_file(const char *filename)
 	return true;
 }
 
+/**
+ * Memory used by global undo.
+ *
+ * \param r_size_stored: Memory used by all steps together.
+ * \param r_size_total: Memory all steps would use when nothing was shared between them.
+ * \return Number of undo steps.
+ */
+int BKE_undo_memory_stats(size_t *r_size_stored, size_t *r_size_total)
+{
+	MemFileStats stats;
+
+	BLO_memfile_stats_get(&stats);
+	*r_size_stored = stats.size_stored;
+	*r_size_total = stats.size_total;
+
+	return BLI_listbase_count(&undobase);
+}
+
 /* sets curscene */
 Main *BKE_undo_get_main(Scene **r_scene)
 {
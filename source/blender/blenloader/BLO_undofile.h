@@ -33,25 +33,44 @@
  *  \ingroup blenloader
  */
 
+struct MemFileChunkData;
+
 typedef struct {
 	void *next, *prev;
 	
-	char *buf;
-	unsigned int ident, size;
+	const char *buf;
+	/* reference counted data, shared by all chunks with the same content */
+	struct MemFileChunkData *data;
+	unsigned int size;
 	
 } MemFileChunk;
 
 typedef struct MemFile {
 	ListBase chunks;
-	unsigned int size;
+	/* size of the file */
+	size_t size;
+	/* size of the chunk data which wasn't stored yet when this file was written */
+	size_t size_added;
+	/* chunk data is owned by this file instead of the shared undo store, for memfiles
+	 * that aren't undo steps, they don't count towards the undo memory usage either */
+	bool is_private;
 } MemFile;
 
+typedef struct MemFileStats {
+	/* number of chunks stored and their total size */
+	unsigned int chunks_num;
+	size_t size_stored;
+	/* size of all memfiles together, as if nothing was shared */
+	size_t size_total;
+} MemFileStats;
+
 /* actually only used writefile.c */
 extern void memfile_chunk_add(MemFile *compare, MemFile *current, const char *buf, unsigned int size);
 
 /* exports */
 extern void BLO_memfile_free(MemFile *memfile);
 extern void BLO_memfile_merge(MemFile *first, MemFile *second);
+extern void BLO_memfile_stats_get(MemFileStats *r_stats);
 
 #endif
 
@@ -38,11 +38,20 @@ struct MemFile;
 struct Main;
 struct ReportList;
 
+typedef struct BlendFileWriteSnapshot BlendFileWriteSnapshot;
+
 extern bool BLO_write_file(
         struct Main *mainvar, const char *filepath, int write_flags,
         struct ReportList *reports, const struct BlendThumbnail *thumb);
 extern bool BLO_write_file_mem(
         struct Main *mainvar, struct MemFile *compare, struct MemFile *current, int write_flags);
 
+extern BlendFileWriteSnapshot *BLO_write_file_snapshot(
+        struct Main *mainvar, const char *filepath, int write_flags,
+        struct ReportList *reports, const struct BlendThumbnail *thumb);
+extern bool BLO_write_file_snapshot_write(
+        BlendFileWriteSnapshot *snapshot, struct ReportList *reports, float *progress);
+extern void BLO_write_file_snapshot_free(BlendFileWriteSnapshot *snapshot);
+
 #endif
 
@@ -0,0 +1,635 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2017 Blender Foundation
+ * All rights reserved.
+ *
+ * The Original Code is: all of this file.
+ *
+ * Contributor(s): none yet.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ * chunked compression of .blend files
+ */
+
+/** \file blender/blenloader/intern/compressfile.c
+ *  \ingroup blenloader
+ *
+ * See compressfile.h for the file layout.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+
+#ifndef WIN32
+#  include <unistd.h> // for write close
+#else
+#  include <io.h> // for open close write
+#endif
+
+#include "zlib.h"
+
+#ifdef WITH_LZO
+#  ifdef WITH_SYSTEM_LZO
+#    include <lzo/lzo1x.h>
+#  else
+#    include "minilzo.h"
+#  endif
+#endif
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_utildefines.h"
+#include "BLI_fileops.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+
+#include "compressfile.h"
+
+/* Large enough for the codecs to find repetitions,
+ * small enough for a file to give work to all threads. */
+#define BLEND_CHUNK_SIZE (1 << 20)
+#define BLEND_CHUNK_VERSION 1
+
+#define BLEND_CHUNK_FILE_HEADER_SIZE 16
+#define BLEND_CHUNK_HEADER_SIZE 12
+#define BLEND_CHUNK_FOOTER_SIZE 24
+
+/* Chunks are compressed in batches of this many per thread, which bounds the memory used. */
+#define BLEND_CHUNK_BATCH_PER_THREAD 2
+#define BLEND_CHUNK_BATCH_MAX 64
+
+enum {
+	BLEND_CHUNK_CODEC_NONE = 0,  /* stored, when compression doesn't make it smaller */
+	BLEND_CHUNK_CODEC_LZO  = 1,
+	BLEND_CHUNK_CODEC_ZLIB = 2,
+};
+
+/* zlib is also used when LZO fails to initialize */
+#ifdef WITH_LZO
+#  define BLEND_CHUNK_COMPRESS_BOUND(size) MAX2((size_t)((size) + (size) / 16 + 64 + 3), (size_t)compressBound(size))
+#else
+#  define BLEND_CHUNK_COMPRESS_BOUND(size) ((size_t)compressBound(size))
+#endif
+
+/* -------------------------------------------------------------------- */
+/** \name Byte Order
+ * \{ */
+
+static void chunk_put_u32(char *dst, unsigned int value)
+{
+	unsigned char *p = (unsigned char *)dst;
+	p[0] = (unsigned char)(value);
+	p[1] = (unsigned char)(value >> 8);
+	p[2] = (unsigned char)(value >> 16);
+	p[3] = (unsigned char)(value >> 24);
+}
+
+static void chunk_put_u64(char *dst, uint64_t value)
+{
+	chunk_put_u32(dst, (unsigned int)(value & 0xffffffff));
+	chunk_put_u32(dst + 4, (unsigned int)(value >> 32));
+}
+
+static unsigned int chunk_get_u32(const char *src)
+{
+	const unsigned char *p = (const unsigned char *)src;
+	return ((unsigned int)p[0]) |
+	       ((unsigned int)p[1] << 8) |
+	       ((unsigned int)p[2] << 16) |
+	       ((unsigned int)p[3] << 24);
+}
+
+static uint64_t chunk_get_u64(const char *src)
+{
+	return ((uint64_t)chunk_get_u32(src)) | ((uint64_t)chunk_get_u32(src + 4) << 32);
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Codecs
+ * \{ */
+
+#ifdef WITH_LZO
+/**
+ * LZO checks it was built correctly for the platform,
+ * this has to succeed before any of its functions are used.
+ */
+static bool chunk_lzo_init(void)
+{
+	return (lzo_init() == LZO_E_OK);
+}
+#endif
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Writing
+ * \{ */
+
+typedef struct ChunkSlot {
+	/* chunk header and compressed data, ready to be written */
+	char *out;
+	size_t out_len;
+#ifdef WITH_LZO
+	void *wrkmem;
+#endif
+} ChunkSlot;
+
+struct ChunkedWriter {
+	int file;
+	bool error;
+	bool use_lzo;
+
+	/* uncompressed data of a batch of chunks, compressed in parallel once it's full */
+	char *buffer;
+	size_t buffer_len, buffer_size;
+	ChunkSlot *slots;
+	int slots_len;
+
+	/* file offset of every chunk written, for the index */
+	uint64_t *offsets;
+	unsigned int offsets_len, offsets_size;
+
+	uint64_t file_offset;
+	uint64_t size;
+};
+
+static bool chunked_write_all(ChunkedWriter *cw, const char *data, size_t data_len)
+{
+	while (data_len) {
+		const unsigned int len = (unsigned int)MIN2(data_len, (size_t)INT_MAX);
+		const int written = write(cw->file, data, len);
+
+		if (written <= 0) {
+			cw->error = true;
+			return false;
+		}
+
+		data += written;
+		data_len -= (size_t)written;
+		cw->file_offset += (uint64_t)written;
+	}
+
+	return true;
+}
+
+static void chunk_compress(ChunkSlot *slot, const char *in, size_t in_len, const bool use_lzo)
+{
+	char *dst = slot->out + BLEND_CHUNK_HEADER_SIZE;
+	unsigned int codec;
+	size_t dst_len;
+	bool ok;
+
+#ifdef WITH_LZO
+	if (use_lzo) {
+		lzo_uint out_len;
+		const int r = lzo1x_1_compress(
+		        (const unsigned char *)in, (lzo_uint)in_len, (unsigned char *)dst, &out_len, slot->wrkmem);
+		ok = (r == LZO_E_OK);
+		dst_len = (size_t)out_len;
+		codec = BLEND_CHUNK_CODEC_LZO;
+	}
+	else
+#else
+	UNUSED_VARS(use_lzo);
+#endif
+	{
+		uLongf out_len = BLEND_CHUNK_COMPRESS_BOUND(in_len);
+		ok = (compress2((Bytef *)dst, &out_len, (const Bytef *)in, (uLong)in_len, 1) == Z_OK);
+		dst_len = (size_t)out_len;
+		codec = BLEND_CHUNK_CODEC_ZLIB;
+	}
+
+	if (!ok || dst_len >= in_len) {
+		memcpy(dst, in, in_len);
+		dst_len = in_len;
+		codec = BLEND_CHUNK_CODEC_NONE;
+	}
+
+	chunk_put_u32(slot->out, codec);
+	chunk_put_u32(slot->out + 4, (unsigned int)dst_len);
+	chunk_put_u32(slot->out + 8, (unsigned int)in_len);
+	slot->out_len = BLEND_CHUNK_HEADER_SIZE + dst_len;
+}
+
+static void chunked_writer_compress_cb(void *__restrict userdata,
+                                       const int i,
+                                       const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	ChunkedWriter *cw = userdata;
+	const size_t offset = (size_t)i * BLEND_CHUNK_SIZE;
+	/* the first chunk holds the file header, render info and thumbnail,
+	 * tools reading those only have zlib, see blend_render_info.py */
+	const bool is_first = (cw->offsets_len == 0 && i == 0);
+
+	chunk_compress(&cw->slots[i], cw->buffer + offset, MIN2(cw->buffer_len - offset, (size_t)BLEND_CHUNK_SIZE),
+	               cw->use_lzo && !is_first);
+}
+
+static void chunked_writer_flush(ChunkedWriter *cw)
+{
+	const int tot = (int)((cw->buffer_len + BLEND_CHUNK_SIZE - 1) / BLEND_CHUNK_SIZE);
+
+	if (tot == 0 || cw->error) {
+		return;
+	}
+
+	ParallelRangeSettings settings;
+	BLI_parallel_range_settings_defaults(&settings);
+	settings.use_threading = (tot > 1);
+	BLI_task_parallel_range(0, tot, cw, chunked_writer_compress_cb, &settings);
+
+	for (int i = 0; i < tot; i++) {
+		if (UNLIKELY(cw->offsets_len == cw->offsets_size)) {
+			cw->offsets_size *= 2;
+			cw->offsets = MEM_reallocN(cw->offsets, sizeof(*cw->offsets) * cw->offsets_size);
+		}
+		cw->offsets[cw->offsets_len++] = cw->file_offset;
+
+		if (!chunked_write_all(cw, cw->slots[i].out, cw->slots[i].out_len)) {
+			break;
+		}
+	}
+
+	cw->size += cw->buffer_len;
+	cw->buffer_len = 0;
+}
+
+ChunkedWriter *blo_chunked_writer_open(const char *filepath)
+{
+	ChunkedWriter *cw;
+	char header[BLEND_CHUNK_FILE_HEADER_SIZE];
+	int file;
+
+	file = BLI_open(filepath, O_BINARY + O_WRONLY + O_CREAT + O_TRUNC, 0666);
+	if (file == -1) {
+		return NULL;
+	}
+
+	cw = MEM_callocN(sizeof(*cw), __func__);
+	cw->file = file;
+#ifdef WITH_LZO
+	cw->use_lzo = chunk_lzo_init();
+#endif
+
+	cw->slots_len = MIN2(BLI_system_thread_count() * BLEND_CHUNK_BATCH_PER_THREAD, BLEND_CHUNK_BATCH_MAX);
+	cw->slots = MEM_calloc_arrayN(cw->slots_len, sizeof(*cw->slots), "ChunkedWriter.slots");
+	for (int i = 0; i < cw->slots_len; i++) {
+		cw->slots[i].out = MEM_mallocN(
+		        BLEND_CHUNK_HEADER_SIZE + BLEND_CHUNK_COMPRESS_BOUND(BLEND_CHUNK_SIZE), "ChunkedWriter.out");
+#ifdef WITH_LZO
+		cw->slots[i].wrkmem = MEM_mallocN(LZO1X_1_MEM_COMPRESS, "ChunkedWriter.wrkmem");
+#endif
+	}
+
+	cw->buffer_size = (size_t)cw->slots_len * BLEND_CHUNK_SIZE;
+	cw->buffer = MEM_mallocN(cw->buffer_size, "ChunkedWriter.buffer");
+
+	cw->offsets_size = 1024;
+	cw->offsets = MEM_malloc_arrayN(cw->offsets_size, sizeof(*cw->offsets), "ChunkedWriter.offsets");
+
+	memcpy(header, BLEND_CHUNK_MAGIC, BLEND_CHUNK_MAGIC_LEN);
+	chunk_put_u32(header + 8, BLEND_CHUNK_VERSION);
+	chunk_put_u32(header + 12, BLEND_CHUNK_SIZE);
+	chunked_write_all(cw, header, sizeof(header));
+
+	return cw;
+}
+
+/**
+ * \return \a data_len on success, like the other write wrappers.
+ */
+size_t blo_chunked_writer_write(ChunkedWriter *cw, const char *data, size_t data_len)
+{
+	size_t remaining = data_len;
+
+	while (remaining && !cw->error) {
+		const size_t len = MIN2(remaining, cw->buffer_size - cw->buffer_len);
+
+		memcpy(cw->buffer + cw->buffer_len, data, len);
+		cw->buffer_len += len;
+		data += len;
+		remaining -= len;
+
+		if (cw->buffer_len == cw->buffer_size) {
+			chunked_writer_flush(cw);
+		}
+	}
+
+	return (cw->error) ? 0 : data_len;
+}
+
+/**
+ * Write the remaining chunks and the index, then close the file.
+ *
+ * \return Success.
+ */
+bool blo_chunked_writer_close(ChunkedWriter *cw)
+{
+	bool ok;
+
+	chunked_writer_flush(cw);
+
+	if (!cw->error) {
+		const size_t index_len = sizeof(uint64_t) * cw->offsets_len;
+		char *tail = MEM_mallocN(index_len + BLEND_CHUNK_FOOTER_SIZE, __func__);
+		char *footer = tail + index_len;
+
+		for (unsigned int i = 0; i < cw->offsets_len; i++) {
+			chunk_put_u64(tail + sizeof(uint64_t) * i, cw->offsets[i]);
+		}
+		chunk_put_u64(footer, cw->size);
+		chunk_put_u32(footer + 8, cw->offsets_len);
+		chunk_put_u32(footer + 12, 0);
+		memcpy(footer + 16, BLEND_CHUNK_MAGIC, BLEND_CHUNK_MAGIC_LEN);
+
+		chunked_write_all(cw, tail, index_len + BLEND_CHUNK_FOOTER_SIZE);
+		MEM_freeN(tail);
+	}
+
+	ok = (close(cw->file) != -1) && !cw->error;
+
+	for (int i = 0; i < cw->slots_len; i++) {
+		MEM_freeN(cw->slots[i].out);
+#ifdef WITH_LZO
+		MEM_freeN(cw->slots[i].wrkmem);
+#endif
+	}
+	MEM_freeN(cw->slots);
+	MEM_freeN(cw->buffer);
+	MEM_freeN(cw->offsets);
+	MEM_freeN(cw);
+
+	return ok;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Reading
+ * \{ */
+
+struct ChunkedReader {
+	/* compressed file, usually memory mapped */
+	const char *mem;
+	size_t mem_size;
+
+	size_t chunk_size;
+	unsigned int tot_chunks;
+	const char *index;
+	size_t size;
+	bool use_lzo;
+
+	/* Decompressed chunks [window_first, window_first + window_len),
+	 * the whole file is never held in memory decompressed. */
+	char *window;
+	unsigned int window_first, window_len, window_size;
+	char *window_ok;
+};
+
+bool blo_chunked_test(const char *mem, size_t mem_size)
+{
+	return (mem_size >= BLEND_CHUNK_FILE_HEADER_SIZE) &&
+	       (memcmp(mem, BLEND_CHUNK_MAGIC, BLEND_CHUNK_MAGIC_LEN) == 0);
+}
+
+/**
+ * Check the header, footer and index of a chunked file, no chunks are decompressed yet.
+ *
+ * \param sequential: The file is read in order, chunks following the one that is read are
+ * decompressed along with it on multiple threads. Otherwise only the chunk that is read is.
+ * \return NULL when \a mem isn't a valid chunked file.
+ */
+ChunkedReader *blo_chunked_reader_new(const char *mem, size_t mem_size, const bool sequential)
+{
+	ChunkedReader *cr;
+	const char *footer;
+	uint64_t size, chunk_size;
+	unsigned int tot_chunks;
+
+	if (!blo_chunked_test(mem, mem_size) ||
+	    mem_size < BLEND_CHUNK_FILE_HEADER_SIZE + BLEND_CHUNK_FOOTER_SIZE)
+	{
+		return NULL;
+	}
+
+	/* the chunk size is fixed, any other value is a corrupt file,
+	 * it also bounds the memory used for decompressed chunks */
+	chunk_size = chunk_get_u32(mem + 12);
+	if (chunk_get_u32(mem + 8) != BLEND_CHUNK_VERSION || chunk_size != BLEND_CHUNK_SIZE) {
+		return NULL;
+	}
+
+	footer = mem + mem_size - BLEND_CHUNK_FOOTER_SIZE;
+	if (memcmp(footer + 16, BLEND_CHUNK_MAGIC, BLEND_CHUNK_MAGIC_LEN) != 0) {
+		return NULL;
+	}
+
+	size = chunk_get_u64(footer);
+	tot_chunks = chunk_get_u32(footer + 8);
+
+	if (tot_chunks == 0 ||
+	    (uint64_t)tot_chunks * sizeof(uint64_t) > mem_size - BLEND_CHUNK_FILE_HEADER_SIZE - BLEND_CHUNK_FOOTER_SIZE ||
+	    size <= (uint64_t)(tot_chunks - 1) * chunk_size ||
+	    size > (uint64_t)tot_chunks * chunk_size ||
+	    size > (uint64_t)SIZE_MAX)
+	{
+		return NULL;
+	}
+
+	cr = MEM_callocN(sizeof(*cr), __func__);
+	cr->mem = mem;
+	cr->mem_size = mem_size;
+	cr->chunk_size = (size_t)chunk_size;
+	cr->tot_chunks = tot_chunks;
+	cr->index = footer - sizeof(uint64_t) * tot_chunks;
+	cr->size = (size_t)size;
+#ifdef WITH_LZO
+	cr->use_lzo = chunk_lzo_init();
+#endif
+
+	if (sequential) {
+		cr->window_size = (unsigned int)MIN2(BLI_system_thread_count() * BLEND_CHUNK_BATCH_PER_THREAD,
+		                                     BLEND_CHUNK_BATCH_MAX);
+		cr->window_size = MIN2(cr->window_size, tot_chunks);
+	}
+	else {
+		cr->window_size = 1;
+	}
+
+	cr->window = MEM_mallocN(cr->chunk_size * cr->window_size, "ChunkedReader.window");
+	cr->window_ok = MEM_callocN(cr->window_size, "ChunkedReader.window_ok");
+
+	return cr;
+}
+
+size_t blo_chunked_reader_size(const ChunkedReader *cr)
+{
+	return cr->size;
+}
+
+static bool chunked_reader_decompress(const ChunkedReader *cr, unsigned int i, char *dst)
+{
+	const size_t index_offset = (size_t)(cr->index - cr->mem);
+	const uint64_t offset = chunk_get_u64(cr->index + sizeof(uint64_t) * i);
+	const size_t expected_len = MIN2(cr->chunk_size, cr->size - cr->chunk_size * i);
+	const char *src;
+	unsigned int codec, src_len, dst_len;
+
+	if (offset < BLEND_CHUNK_FILE_HEADER_SIZE || offset + BLEND_CHUNK_HEADER_SIZE > index_offset) {
+		return false;
+	}
+
+	src = cr->mem + offset;
+	codec = chunk_get_u32(src);
+	src_len = chunk_get_u32(src + 4);
+	dst_len = chunk_get_u32(src + 8);
+	src += BLEND_CHUNK_HEADER_SIZE;
+
+	if (dst_len != expected_len || offset + BLEND_CHUNK_HEADER_SIZE + src_len > index_offset) {
+		return false;
+	}
+
+	switch (codec) {
+		case BLEND_CHUNK_CODEC_NONE:
+		{
+			if (src_len != dst_len) {
+				return false;
+			}
+			memcpy(dst, src, dst_len);
+			break;
+		}
+		case BLEND_CHUNK_CODEC_LZO:
+		{
+#ifdef WITH_LZO
+			lzo_uint out_len = dst_len;
+			int r;
+
+			if (!cr->use_lzo) {
+				return false;
+			}
+
+			r = lzo1x_decompress_safe(
+			        (const unsigned char *)src, src_len, (unsigned char *)dst, &out_len, NULL);
+			if (r != LZO_E_OK || out_len != dst_len) {
+				return false;
+			}
+			break;
+#else
+			/* built without LZO */
+			return false;
+#endif
+		}
+		case BLEND_CHUNK_CODEC_ZLIB:
+		{
+			uLongf out_len = dst_len;
+			if (uncompress((Bytef *)dst, &out_len, (const Bytef *)src, src_len) != Z_OK || out_len != dst_len) {
+				return false;
+			}
+			break;
+		}
+		default:
+			return false;
+	}
+
+	return true;
+}
+
+static void chunked_reader_decompress_cb(void *__restrict userdata,
+                                         const int i,
+                                         const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	ChunkedReader *cr = userdata;
+
+	cr->window_ok[i] = chunked_reader_decompress(
+	        cr, cr->window_first + (unsigned int)i, cr->window + cr->chunk_size * (size_t)i);
+}
+
+/**
+ * Decompress chunk \a i into the window, along with the ones following it for sequential reading.
+ *
+ * \return Success for chunk \a i, later chunks that fail are only reported when they're read.
+ */
+static bool chunked_reader_window_fill(ChunkedReader *cr, unsigned int i)
+{
+	const int tot = (int)MIN2(cr->window_size, cr->tot_chunks - i);
+
+	cr->window_first = i;
+
+	ParallelRangeSettings settings;
+	BLI_parallel_range_settings_defaults(&settings);
+	settings.use_threading = (tot > 1);
+	BLI_task_parallel_range(0, tot, cr, chunked_reader_decompress_cb, &settings);
+
+	/* only keep the chunks up to the first one that failed */
+	cr->window_len = 0;
+	while ((int)cr->window_len < tot && cr->window_ok[cr->window_len]) {
+		cr->window_len++;
+	}
+
+	return (cr->window_len != 0);
+}
+
+/**
+ * Random access read of the decompressed file, only the chunks that are needed are decompressed.
+ *
+ * \return The number of bytes read, zero when a chunk can't be decompressed.
+ */
+size_t blo_chunked_reader_read(ChunkedReader *cr, size_t offset, void *buffer, size_t size)
+{
+	char *dst = buffer;
+	size_t remaining;
+
+	if (offset >= cr->size || size == 0) {
+		return 0;
+	}
+
+	size = MIN2(size, cr->size - offset);
+	remaining = size;
+
+	while (remaining) {
+		const unsigned int i = (unsigned int)(offset / cr->chunk_size);
+		const size_t chunk_offset = offset - cr->chunk_size * i;
+		const size_t len = MIN2(remaining, cr->chunk_size - chunk_offset);
+
+		if (i < cr->window_first || i >= cr->window_first + cr->window_len) {
+			if (!chunked_reader_window_fill(cr, i)) {
+				return 0;
+			}
+		}
+
+		memcpy(dst, cr->window + cr->chunk_size * (i - cr->window_first) + chunk_offset, len);
+		dst += len;
+		offset += len;
+		remaining -= len;
+	}
+
+	return size;
+}
+
+void blo_chunked_reader_free(ChunkedReader *cr)
+{
+	MEM_freeN(cr->window);
+	MEM_freeN(cr->window_ok);
+	MEM_freeN(cr);
+}
+
+/** \} */
@@ -0,0 +1,69 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2017 Blender Foundation
+ * All rights reserved.
+ *
+ * The Original Code is: all of this file.
+ *
+ * Contributor(s): none yet.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ * chunked compression of .blend files
+ */
+
+/** \file blender/blenloader/intern/compressfile.h
+ *  \ingroup blenloader
+ */
+
+#ifndef __COMPRESSFILE_H__
+#define __COMPRESSFILE_H__
+
+/**
+ * Chunked compressed .blend files.
+ *
+ * The file is split in chunks of #BLEND_CHUNK_SIZE bytes which are compressed independently,
+ * so they can be compressed and decompressed on multiple threads, and any part of the file
+ * can be read without decompressing what comes before it.
+ *
+ * Layout, all numbers little endian:
+ * - Header: magic (8 bytes), version (uint32), chunk size (uint32).
+ * - Chunks: codec (uint32), compressed size (uint32), size (uint32), compressed data.
+ *   The first chunk is never LZO compressed, tools reading the file header, render info
+ *   or thumbnail only need zlib.
+ * - Index: file offset of every chunk (uint64).
+ * - Footer: uncompressed file size (uint64), number of chunks (uint32),
+ *   zero (uint32), magic (8 bytes).
+ */
+
+#define BLEND_CHUNK_MAGIC "BLENDCHK"
+#define BLEND_CHUNK_MAGIC_LEN 8
+
+typedef struct ChunkedWriter ChunkedWriter;
+typedef struct ChunkedReader ChunkedReader;
+
+ChunkedWriter *blo_chunked_writer_open(const char *filepath);
+size_t blo_chunked_writer_write(ChunkedWriter *cw, const char *data, size_t data_len);
+bool blo_chunked_writer_close(ChunkedWriter *cw);
+
+bool blo_chunked_test(const char *mem, size_t mem_size);
+ChunkedReader *blo_chunked_reader_new(const char *mem, size_t mem_size, const bool sequential);
+size_t blo_chunked_reader_size(const ChunkedReader *cr);
+size_t blo_chunked_reader_read(ChunkedReader *cr, size_t offset, void *buffer, size_t size);
+void blo_chunked_reader_free(ChunkedReader *cr);
+
+#endif  /* __COMPRESSFILE_H__ */
@@ -46,10 +46,12 @@
 #include "BLI_utildefines.h"
 #ifndef WIN32
 #  include <unistd.h> // for read close
+#  include <sys/mman.h> // for mmap
 #else
 #  include <io.h> // for open close read
 #  include "winsock2.h"
 #  include "BLI_winstuff.h"
+#  include "mmap_win.h"
 #endif
 
 /* allow readfile to use deprecated functionality */
@@ -110,6 +112,8 @@
 #include "BLI_math.h"
 #include "BLI_threads.h"
 #include "BLI_mempool.h"
+#include "BLI_smallhash.h"
+#include "BLI_task.h"
 
 #include "BLT_translation.h"
 
@@ -160,6 +164,7 @@
 #include "RE_engine.h"
 
 #include "readfile.h"
+#include "compressfile.h"
 
 
 #include <errno.h>
@@ -237,11 +242,17 @@ typedef struct OldNew {
 	int nr;
 } OldNew;
 
+/* Entries are kept in the order they were inserted, which is the order they
+ * are usually looked up in, so the entry after the last hit is checked first.
+ * Other lookups go through a hash of the old addresses into the entries. */
 typedef struct OldNewMap {
 	OldNew *entries;
 	int nentries, entriessize;
-	bool sorted;
 	int lasthit;
+	SmallHash hash;
+
+	/* lookup statistics, printed with --debug-io */
+	uint64_t stat_lasthit, stat_hash, stat_miss;
 } OldNewMap;
 
 
@@ -290,27 +301,11 @@ static OldNewMap *oldnewmap_new(void)
 	
 	onm->entriessize = 1024;
 	onm->entries = MEM_malloc_arrayN(onm->entriessize, sizeof(*onm->entries), "OldNewMap.entries");
+	BLI_smallhash_init(&onm->hash);
 	
 	return onm;
 }
 
-static int verg_oldnewmap(const void *v1, const void *v2)
-{
-	const struct OldNew *x1=v1, *x2=v2;
-	
-	if (x1->old > x2->old) return 1;
-	else if (x1->old < x2->old) return -1;
-	return 0;
-}
-
-
-static void oldnewmap_sort(FileData *fd) 
-{
-	BLI_assert(fd->libmap->sorted == false);
-	qsort(fd->libmap->entries, fd->libmap->nentries, sizeof(OldNew), verg_oldnewmap);
-	fd->libmap->sorted = 1;
-}
-
 /* nr is zero for data, and ID code for libdata */
 static void oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void *newaddr, int nr)
 {
@@ -323,10 +318,14 @@ static void oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void *newaddr,
 		onm->entries = MEM_reallocN(onm->entries, sizeof(*onm->entries) * onm->entriessize);
 	}
 
-	entry = &onm->entries[onm->nentries++];
+	entry = &onm->entries[onm->nentries];
 	entry->old = oldaddr;
 	entry->newp = newaddr;
 	entry->nr = nr;
+
+	/* when an address is inserted twice, lookups find the latest entry */
+	BLI_smallhash_reinsert(&onm->hash, (uintptr_t)oldaddr, SET_INT_IN_POINTER(onm->nentries));
+	onm->nentries++;
 }
 
 void blo_do_versions_oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void *newaddr, int nr)
@@ -335,52 +334,21 @@ void blo_do_versions_oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void
 }
 
 /**
- * Do a full search (no state).
- *
- * \param lasthit: Use as a reference position to avoid a full search
- * from either end of the array, giving more efficient lookups.
+ * Find the entry index of \a addr, -1 when it's not in the map.
  *
- * \note This would seem an ideal case for hash or btree lookups.
- * However the data is written in-order, using the \a lasthit will normally avoid calling this function.
- * Creating a btree/hash structure adds overhead for the common-case to optimize the corner-case
- * (since most entries will never be retrieved).
- * So just keep full lookups as a fall-back.
+ * \note The data is written in-order, so checking the entry after \a lasthit
+ * first (see #oldnewmap_lookup_and_inc) avoids most of these lookups.
  */
-static int oldnewmap_lookup_entry_full(const OldNewMap *onm, const void *addr, int lasthit)
+static int oldnewmap_lookup_entry_full(OldNewMap *onm, const void *addr)
 {
-	const int nentries = onm->nentries;
-	const OldNew *entries = onm->entries;
-	int i;
-
-	/* search relative to lasthit where possible */
-	if (lasthit >= 0 && lasthit < nentries) {
+	void **val_p = BLI_smallhash_lookup_p(&onm->hash, (uintptr_t)addr);
 
-		/* search forwards */
-		i = lasthit;
-		while (++i != nentries) {
-			if (entries[i].old == addr) {
-				return i;
-			}
-		}
-
-		/* search backwards */
-		i = lasthit + 1;
-		while (i--) {
-			if (entries[i].old == addr) {
-				return i;
-			}
-		}
-	}
-	else {
-		/* search backwards (full) */
-		i = nentries;
-		while (i--) {
-			if (entries[i].old == addr) {
-				return i;
-			}
-		}
+	if (val_p) {
+		onm->stat_hash++;
+		return GET_INT_FROM_POINTER(*val_p);
 	}
 
+	onm->stat_miss++;
 	return -1;
 }
 
@@ -394,13 +362,14 @@ static void *oldnewmap_lookup_and_inc(OldNewMap *onm, const void *addr, bool inc
 		OldNew *entry = &onm->entries[++onm->lasthit];
 		
 		if (entry->old == addr) {
+			onm->stat_lasthit++;
 			if (increase_users)
 				entry->nr++;
 			return entry->newp;
 		}
 	}
 	
-	i = oldnewmap_lookup_entry_full(onm, addr, onm->lasthit);
+	i = oldnewmap_lookup_entry_full(onm, addr);
 	if (i != -1) {
 		OldNew *entry = &onm->entries[i];
 		BLI_assert(entry->old == addr);
@@ -420,28 +389,14 @@ static void *oldnewmap_liblookup(OldNewMap *onm, const void *addr, const void *l
 		return NULL;
 	}
 
-	/* lasthit works fine for non-libdata, linking there is done in same sequence as writing */
-	if (onm->sorted) {
-		const OldNew entry_s = {.old = addr};
-		OldNew *entry = bsearch(&entry_s, onm->entries, onm->nentries, sizeof(OldNew), verg_oldnewmap);
-		if (entry) {
-			ID *id = entry->newp;
-
-			if (id && (!lib || id->lib)) {
-				return id;
-			}
-		}
-	}
-	else {
-		/* note, this can be a bottle neck when loading some files */
-		const int i = oldnewmap_lookup_entry_full(onm, addr, -1);
-		if (i != -1) {
-			OldNew *entry = &onm->entries[i];
-			ID *id = entry->newp;
-			BLI_assert(entry->old == addr);
-			if (id && (!lib || id->lib)) {
-				return id;
-			}
+	/* lasthit only works for non-libdata, linking there is done in same sequence as writing */
+	const int i = oldnewmap_lookup_entry_full(onm, addr);
+	if (i != -1) {
+		OldNew *entry = &onm->entries[i];
+		ID *id = entry->newp;
+		BLI_assert(entry->old == addr);
+		if (id && (!lib || id->lib)) {
+			return id;
 		}
 	}
 
@@ -465,10 +420,29 @@ static void oldnewmap_clear(OldNewMap *onm)
 {
 	onm->nentries = 0;
 	onm->lasthit = 0;
+
+	BLI_smallhash_release(&onm->hash);
+	BLI_smallhash_init(&onm->hash);
+}
+
+static void oldnewmap_print_stats(const OldNewMap *onm, const char *name)
+{
+	const uint64_t lookups = onm->stat_lasthit + onm->stat_hash + onm->stat_miss;
+
+	if (lookups == 0) {
+		return;
+	}
+
+	printf("%s: %d entries, %llu lookups (%llu last hit, %llu hashed, %llu missed)\n",
+	       name, onm->nentries, (unsigned long long)lookups,
+	       (unsigned long long)onm->stat_lasthit,
+	       (unsigned long long)onm->stat_hash,
+	       (unsigned long long)onm->stat_miss);
 }
 
 static void oldnewmap_free(OldNewMap *onm) 
 {
+	BLI_smallhash_release(&onm->hash);
 	MEM_freeN(onm->entries);
 	MEM_freeN(onm);
 }
@@ -797,13 +771,34 @@ static BHeadN *get_bhead(FileData *fd)
 			/* bhead now contains the (converted) bhead structure. Now read
 			 * the associated data and put everything in a BHeadN (creative naming !)
 			 */
-			if (!fd->eof) {
+			if (!fd->eof && fd->mmap_data && !fd->chunked && !(fd->flags & FD_FLAGS_SWITCH_ENDIAN)) {
+				/* Mapped uncompressed files use the data in place, it's only read and then
+				 * copied into the loaded blocks. Endian switching would have to modify it. */
+				if ((size_t)bhead.len <= fd->mmap_size - fd->mmap_seek) {
+					new_bhead = MEM_mallocN(sizeof(BHeadN), "new_bhead");
+					new_bhead->next = new_bhead->prev = NULL;
+					new_bhead->data = (char *)fd->mmap_data + fd->mmap_seek;
+					new_bhead->read_ahead = NULL;
+					new_bhead->has_read_ahead = false;
+					new_bhead->bhead = bhead;
+
+					fd->mmap_seek += bhead.len;
+					fd->seek += bhead.len;
+				}
+				else {
+					fd->eof = 1;
+				}
+			}
+			else if (!fd->eof) {
 				new_bhead = MEM_mallocN(sizeof(BHeadN) + bhead.len, "new_bhead");
 				if (new_bhead) {
 					new_bhead->next = new_bhead->prev = NULL;
+					new_bhead->data = (char *)(new_bhead + 1);
+					new_bhead->read_ahead = NULL;
+					new_bhead->has_read_ahead = false;
 					new_bhead->bhead = bhead;
 					
-					readsize = fd->read(fd, new_bhead + 1, bhead.len);
+					readsize = fd->read(fd, new_bhead->data, bhead.len);
 					
 					if (readsize != bhead.len) {
 						fd->eof = 1;
@@ -885,7 +880,14 @@ BHead *blo_nextbhead(FileData *fd, BHead *thisblock)
 /* Warning! Caller's responsibility to ensure given bhead **is** and ID one! */
 const char *bhead_id_name(const FileData *fd, const BHead *bhead)
 {
-	return (const char *)POINTER_OFFSET(bhead, sizeof(*bhead) + fd->id_name_offs);
+	return (const char *)blo_bhead_data(bhead) + fd->id_name_offs;
+}
+
+/* data of the block, not necessarily right after the BHead */
+void *blo_bhead_data(const BHead *bhead)
+{
+	const BHeadN *bheadn = (const BHeadN *)POINTER_OFFSET(bhead, -offsetof(BHeadN, bhead));
+	return bheadn->data;
 }
 
 static void decode_blender_header(FileData *fd)
@@ -942,7 +944,7 @@ static bool read_file_dna(FileData *fd, const char **r_error_message)
 		if (bhead->code == DNA1) {
 			const bool do_endian_swap = (fd->flags & FD_FLAGS_SWITCH_ENDIAN) != 0;
 			
-			fd->filesdna = DNA_sdna_from_data(&bhead[1], bhead->len, do_endian_swap, true, r_error_message);
+			fd->filesdna = DNA_sdna_from_data(blo_bhead_data(bhead), bhead->len, do_endian_swap, true, r_error_message);
 			if (fd->filesdna) {
 				fd->compflags = DNA_struct_get_compareflags(fd->filesdna, fd->memsdna);
 				/* used to retrieve ID names from (bhead+1) */
@@ -971,7 +973,7 @@ static int *read_file_thumbnail(FileData *fd)
 	for (bhead = blo_firstbhead(fd); bhead; bhead = blo_nextbhead(fd, bhead)) {
 		if (bhead->code == TEST) {
 			const bool do_endian_swap = (fd->flags & FD_FLAGS_SWITCH_ENDIAN) != 0;
-			int *data = (int *)(bhead + 1);
+			int *data = blo_bhead_data(bhead);
 
 			if (bhead->len < (2 * sizeof(int))) {
 				break;
@@ -1043,6 +1045,34 @@ static int fd_read_from_memory(FileData *filedata, void *buffer, unsigned int si
 	return (readsize);
 }
 
+static int fd_read_from_mmap(FileData *filedata, void *buffer, unsigned int size)
+{
+	/* don't read more bytes then there are available in the mapping */
+	const size_t readsize = MIN2((size_t)size, filedata->mmap_size - filedata->mmap_seek);
+
+	memcpy(buffer, filedata->mmap_data + filedata->mmap_seek, readsize);
+	filedata->mmap_seek += readsize;
+	filedata->seek += (int)readsize;
+
+	return (int)readsize;
+}
+
+static int fd_read_from_chunked_invalid(
+        FileData *UNUSED(filedata), void *UNUSED(buffer), unsigned int UNUSED(size))
+{
+	return 0;
+}
+
+static int fd_read_from_chunked(FileData *filedata, void *buffer, unsigned int size)
+{
+	const size_t readsize = blo_chunked_reader_read(filedata->chunked, filedata->mmap_seek, buffer, size);
+
+	filedata->mmap_seek += readsize;
+	filedata->seek += (int)readsize;
+
+	return (int)readsize;
+}
+
 static int fd_read_from_memfile(FileData *filedata, void *buffer, unsigned int size)
 {
 	static unsigned int seek = (1<<30);	/* the current position */
@@ -1141,11 +1171,80 @@ static FileData *blo_decode_and_check(FileData *fd, ReportList *reports)
 	return fd;
 }
 
+/**
+ * Map uncompressed and chunked compressed files in memory. Blocks of uncompressed files are
+ * then used in place instead of going through zlib and a read call for each of them.
+ *
+ * \param sequential: The whole file is read in order, chunks of a chunked file are then
+ * decompressed in parallel batches, otherwise one by one as they are read.
+ * \return NULL for gzip compressed files or when mapping fails, these are read as a stream.
+ */
+static FileData *blo_openblenderfile_mmap(const char *filepath, const bool sequential)
+{
+	FileData *fd;
+	unsigned char magic[2];
+	const char *mem;
+	size_t size;
+	int file;
+
+	file = BLI_open(filepath, O_BINARY | O_RDONLY, 0);
+	if (file == -1) {
+		return NULL;
+	}
+
+	/* gzip magic, see RFC 1952 */
+	if (read(file, magic, sizeof(magic)) != sizeof(magic) || (magic[0] == 0x1f && magic[1] == 0x8b)) {
+		close(file);
+		return NULL;
+	}
+
+	size = BLI_file_descriptor_size(file);
+	if (size == (size_t)-1 || size < SIZEOFBLENDERHEADER) {
+		close(file);
+		return NULL;
+	}
+
+	/* Blender saves to a temporary file which is then renamed,
+	 * so saving over the file while it's mapped keeps the old contents. */
+	mem = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+	if (mem == MAP_FAILED) {
+		close(file);
+		return NULL;
+	}
+
+	fd = filedata_new();
+	fd->filedes = file;
+	fd->mmap_data = mem;
+	fd->mmap_size = size;
+	fd->read = fd_read_from_mmap;
+
+	if (blo_chunked_test(mem, size)) {
+		fd->chunked = blo_chunked_reader_new(mem, size, sequential);
+		fd->read = fd_read_from_chunked;
+
+		if (fd->chunked == NULL) {
+			/* reads nothing, reported as not a blend file */
+			fd->read = fd_read_from_chunked_invalid;
+		}
+	}
+
+	return fd;
+}
+
 /* cannot be called with relative paths anymore! */
 /* on each new library added, it now checks for the current FileData and expands relativeness */
 FileData *blo_openblenderfile(const char *filepath, ReportList *reports)
 {
 	gzFile gzfile;
+	FileData *fd = blo_openblenderfile_mmap(filepath, true);
+
+	if (fd) {
+		/* needed for library_append and read_libraries */
+		BLI_strncpy(fd->relabase, filepath, sizeof(fd->relabase));
+
+		return blo_decode_and_check(fd, reports);
+	}
+
 	errno = 0;
 	gzfile = BLI_gzopen(filepath, "rb");
 	
@@ -1155,7 +1254,7 @@ FileData *blo_openblenderfile(const char *filepath, ReportList *reports)
 		return NULL;
 	}
 	else {
-		FileData *fd = filedata_new();
+		fd = filedata_new();
 		fd->gzfiledes = gzfile;
 		fd->read = fd_read_gzip_from_file;
 		
@@ -1173,11 +1272,24 @@ FileData *blo_openblenderfile(const char *filepath, ReportList *reports)
 static FileData *blo_openblenderfile_minimal(const char *filepath)
 {
 	gzFile gzfile;
+	FileData *fd = blo_openblenderfile_mmap(filepath, false);
+
+	if (fd) {
+		decode_blender_header(fd);
+
+		if (fd->flags & FD_FLAGS_FILE_OK) {
+			return fd;
+		}
+
+		blo_freefiledata(fd);
+		return NULL;
+	}
+
 	errno = 0;
 	gzfile = BLI_gzopen(filepath, "rb");
 
 	if (gzfile != (gzFile)Z_NULL) {
-		FileData *fd = filedata_new();
+		fd = filedata_new();
 		fd->gzfiledes = gzfile;
 		fd->read = fd_read_gzip_from_file;
 
@@ -1283,6 +1395,14 @@ FileData *blo_openblendermemfile(MemFile *memfile, ReportList *reports)
 void blo_freefiledata(FileData *fd)
 {
 	if (fd) {
+		if (fd->chunked) {
+			blo_chunked_reader_free(fd->chunked);
+		}
+
+		if (fd->mmap_data) {
+			munmap((void *)fd->mmap_data, fd->mmap_size);
+		}
+
 		if (fd->filedes != -1) {
 			close(fd->filedes);
 		}
@@ -1302,7 +1422,12 @@ void blo_freefiledata(FileData *fd)
 			fd->buffer = NULL;
 		}
 		
-		// Free all BHeadN data blocks
+		// Free all BHeadN data blocks, and data read ahead that wasn't used
+		for (BHeadN *bheadn = fd->listbase.first; bheadn; bheadn = bheadn->next) {
+			if (bheadn->read_ahead) {
+				MEM_freeN(bheadn->read_ahead);
+			}
+		}
 		BLI_freelistN(&fd->listbase);
 
 		if (fd->filesdna)
@@ -1310,6 +1435,16 @@ void blo_freefiledata(FileData *fd)
 		if (fd->compflags)
 			MEM_freeN((void *)fd->compflags);
 		
+		if (G.debug & G_DEBUG_IO) {
+			printf("Read %s\n", fd->relabase);
+			if (fd->datamap)
+				oldnewmap_print_stats(fd->datamap, "  datamap");
+			if (fd->globmap)
+				oldnewmap_print_stats(fd->globmap, "  globmap");
+			if (fd->libmap && !(fd->flags & FD_FLAGS_NOT_MY_LIBMAP))
+				oldnewmap_print_stats(fd->libmap, "  libmap");
+		}
+
 		if (fd->datamap)
 			oldnewmap_free(fd->datamap);
 		if (fd->globmap)
@@ -1565,9 +1700,6 @@ static void change_idid_adr_fd(FileData *fd, const void *old, void *new)
 {
 	int i;
 	
-	/* use a binary search if we have a sorted libmap, for now it's not needed. */
-	BLI_assert(fd->libmap->sorted == false);
-
 	for (i = 0; i < fd->libmap->nentries; i++) {
 		OldNew *entry = &fd->libmap->entries[i];
 		
@@ -1887,7 +2019,7 @@ static void switch_endian_structs(const struct SDNA *filesdna, BHead *bhead)
 	int blocksize, nblocks;
 	char *data;
 	
-	data = (char *)(bhead+1);
+	data = blo_bhead_data(bhead);
 	blocksize = filesdna->typelens[ filesdna->structs[bhead->SDNAnr][0] ];
 	
 	nblocks = bhead->nr;
@@ -1900,8 +2032,16 @@ static void switch_endian_structs(const struct SDNA *filesdna, BHead *bhead)
 
 static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
 {
+	BHeadN *bheadn = (BHeadN *)POINTER_OFFSET(bh, -offsetof(BHeadN, bhead));
 	void *temp = NULL;
 	
+	if (bheadn->has_read_ahead) {
+		temp = bheadn->read_ahead;
+		bheadn->read_ahead = NULL;
+		bheadn->has_read_ahead = false;
+		return temp;
+	}
+	
 	if (bh->len) {
 		/* switch is based on file dna */
 		if (bh->SDNAnr && (fd->flags & FD_FLAGS_SWITCH_ENDIAN))
@@ -1909,12 +2049,12 @@ static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
 		
 		if (fd->compflags[bh->SDNAnr] != SDNA_CMP_REMOVED) {
 			if (fd->compflags[bh->SDNAnr] == SDNA_CMP_NOT_EQUAL) {
-				temp = DNA_struct_reconstruct(fd->memsdna, fd->filesdna, fd->compflags, bh->SDNAnr, bh->nr, (bh+1));
+				temp = DNA_struct_reconstruct(fd->memsdna, fd->filesdna, fd->compflags, bh->SDNAnr, bh->nr, blo_bhead_data(bh));
 			}
 			else {
 				/* SDNA_CMP_EQUAL */
 				temp = MEM_mallocN(bh->len, blockname);
-				memcpy(temp, (bh+1), bh->len);
+				memcpy(temp, blo_bhead_data(bh), bh->len);
 			}
 		}
 	}
@@ -1922,6 +2062,88 @@ static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
 	return temp;
 }
 
+/* files with less blocks are read in the main loop directly */
+#define READ_AHEAD_MIN_BLOCKS 1024
+
+typedef struct ReadAheadData {
+	FileData *fd;
+	BHeadN **bheads;
+} ReadAheadData;
+
+static void read_structs_parallel_cb(void *__restrict userdata,
+                                     const int i,
+                                     const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	ReadAheadData *data = userdata;
+	BHeadN *bheadn = data->bheads[i];
+
+	bheadn->read_ahead = read_struct(data->fd, &bheadn->bhead, "read ahead");
+	bheadn->has_read_ahead = true;
+}
+
+/**
+ * Read all blocks of the file, then do the endian switching, DNA reconstruction or copying
+ * of the ones #blo_read_file_internal will pass to #read_struct in parallel.
+ * This only touches the data of each block, pointers are still relinked in file order.
+ *
+ * Blocks that only need to be copied are read ahead as well, files saved by the current
+ * version consist of those only. For memory mapped files the copy is also where the file
+ * is actually read from disk.
+ * Blocks that end up not being used are freed along with the file data.
+ */
+static void read_structs_parallel(FileData *fd)
+{
+	BHead *bhead;
+	BHeadN **bheads;
+	int tot = 0;
+
+	for (bhead = blo_firstbhead(fd); bhead; bhead = blo_nextbhead(fd, bhead)) {
+		if (bhead->code == ENDB) {
+			break;
+		}
+		tot++;
+	}
+
+	if (tot < READ_AHEAD_MIN_BLOCKS) {
+		return;
+	}
+
+	bheads = MEM_malloc_arrayN(tot, sizeof(*bheads), __func__);
+	tot = 0;
+
+	for (bhead = blo_firstbhead(fd); bhead; bhead = blo_nextbhead(fd, bhead)) {
+		if (bhead->code == ENDB) {
+			break;
+		}
+		else if (ELEM(bhead->code, DNA1, TEST, REND) || bhead->len == 0) {
+			continue;
+		}
+		else if (bhead->code == USER && (fd->skip_flags & BLO_READ_SKIP_USERDEF)) {
+			continue;
+		}
+		else if (fd->compflags[bhead->SDNAnr] == SDNA_CMP_REMOVED) {
+			continue;
+		}
+
+		bheads[tot++] = (BHeadN *)POINTER_OFFSET(bhead, -offsetof(BHeadN, bhead));
+	}
+
+	if (tot == 0) {
+		MEM_freeN(bheads);
+		return;
+	}
+
+	ReadAheadData data = {.fd = fd, .bheads = bheads};
+	ParallelRangeSettings settings;
+	BLI_parallel_range_settings_defaults(&settings);
+	/* block sizes vary a lot, from a few bytes to whole meshes */
+	settings.scheduling_mode = TASK_SCHEDULING_DYNAMIC;
+	settings.min_iter_per_thread = 64;
+	BLI_task_parallel_range(0, tot, &data, read_structs_parallel_cb, &settings);
+
+	MEM_freeN(bheads);
+}
+
 typedef void (*link_list_cb)(FileData *fd, void *data);
 
 static void link_list_ex(FileData *fd, ListBase *lb, link_list_cb callback)		/* only direct data */
@@ -8517,8 +8739,6 @@ static void do_versions_after_linking(Main *main)
 
 static void lib_link_all(FileData *fd, Main *main)
 {
-	oldnewmap_sort(fd);
-	
 	/* No load UI for undo memfiles */
 	if (fd->memfile == NULL) {
 		lib_link_windowmanager(fd, main);
@@ -8675,6 +8895,10 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
 		}
 	}
 
+	if (!(fd->skip_flags & BLO_READ_SKIP_DATA)) {
+		read_structs_parallel(fd);
+	}
+
 	while (bhead) {
 		switch (bhead->code) {
 		case DATA:
@@ -62,6 +62,12 @@ typedef struct FileData {
 	int filedes;
 	gzFile gzfiledes;
 
+	// variables needed for reading from a memory mapped file
+	const char *mmap_data;
+	size_t mmap_size, mmap_seek;
+	// chunked compressed file in the mapping, mmap_seek is in the decompressed file
+	struct ChunkedReader *chunked;
+
 	// now only in use for library appending
 	char relabase[FILE_MAX];
 	
@@ -109,6 +115,11 @@ typedef struct FileData {
 
 typedef struct BHeadN {
 	struct BHeadN *next, *prev;
+	/* data of the block, directly after the BHeadN or in the file mapping, see #blo_bhead_data */
+	char *data;
+	/* result of read_struct() when it was done ahead of time, see read_structs_parallel() */
+	void *read_ahead;
+	bool has_read_ahead;
 	struct BHead bhead;
 } BHeadN;
 
@@ -153,6 +164,7 @@ BHead *blo_nextbhead(FileData *fd, BHead *thisblock);
 BHead *blo_prevbhead(FileData *fd, BHead *thisblock);
 
 const char *bhead_id_name(const FileData *fd, const BHead *bhead);
+void *blo_bhead_data(const BHead *bhead);
 
 /* do versions stuff */
 
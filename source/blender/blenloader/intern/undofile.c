@@ -40,46 +40,142 @@
 #include "DNA_listBase.h"
 
 #include "BLI_blenlib.h"
+#include "BLI_ghash.h"
+#include "BLI_hash_mm2a.h"
 
 #include "BLO_undofile.h"
 
 /* **************** support for memory-write, for undo buffers *************** */
 
+/**
+ * Chunk data is shared between all memfiles, identical data is only stored once no matter
+ * where it appears in the file, so inserting or reordering data in the file doesn't cause
+ * everything after it to be stored again for every undo step.
+ * Private memfiles (see #MemFile.is_private) own their chunk data and don't use the store.
+ *
+ * Not thread-safe, memfiles are only written and freed from the main thread,
+ * except for private ones which don't touch any global state.
+ */
+typedef struct MemFileChunkData {
+	const char *buf;
+	unsigned int size;
+	unsigned int hash;
+	unsigned int users;
+	/* data follows */
+} MemFileChunkData;
+
+static struct {
+	GSet *chunks;
+	MemFileStats stats;
+} memfile_store = {NULL};
+
+static unsigned int memfile_chunk_data_hash(const void *key)
+{
+	const MemFileChunkData *data = key;
+	return data->hash;
+}
+
+static bool memfile_chunk_data_cmp(const void *a, const void *b)
+{
+	const MemFileChunkData *data_a = a;
+	const MemFileChunkData *data_b = b;
+
+	return ((data_a->hash != data_b->hash) ||
+	        (data_a->size != data_b->size) ||
+	        (memcmp(data_a->buf, data_b->buf, data_a->size) != 0));
+}
+
+static MemFileChunkData *memfile_chunk_data_new(const char *buf, unsigned int size, unsigned int hash)
+{
+	MemFileChunkData *data = MEM_mallocN(sizeof(*data) + size, "Chunk buffer");
+	memcpy(data + 1, buf, size);
+	data->buf = (const char *)(data + 1);
+	data->size = size;
+	data->hash = hash;
+	data->users = 1;
+	return data;
+}
+
+/**
+ * \return Stored data matching \a buf, adding it to the store when it's not found.
+ */
+static MemFileChunkData *memfile_chunk_data_ensure(const char *buf, unsigned int size, bool *r_added)
+{
+	MemFileChunkData key, *data;
+
+	key.buf = buf;
+	key.size = size;
+	key.hash = BLI_hash_mm2((const unsigned char *)buf, size, 0);
+
+	if (memfile_store.chunks == NULL) {
+		memfile_store.chunks = BLI_gset_new(memfile_chunk_data_hash, memfile_chunk_data_cmp, __func__);
+	}
+	else if ((data = BLI_gset_lookup(memfile_store.chunks, &key))) {
+		data->users++;
+		*r_added = false;
+		return data;
+	}
+
+	data = memfile_chunk_data_new(buf, size, key.hash);
+	BLI_gset_insert(memfile_store.chunks, data);
+
+	memfile_store.stats.chunks_num++;
+	memfile_store.stats.size_stored += size;
+
+	*r_added = true;
+	return data;
+}
+
+static void memfile_chunk_data_release(MemFileChunkData *data)
+{
+	BLI_assert(data->users > 0);
+
+	if (--data->users == 0) {
+		memfile_store.stats.chunks_num--;
+		memfile_store.stats.size_stored -= data->size;
+
+		BLI_gset_remove(memfile_store.chunks, data, NULL);
+		MEM_freeN(data);
+
+		if (BLI_gset_len(memfile_store.chunks) == 0) {
+			BLI_gset_free(memfile_store.chunks, NULL);
+			memfile_store.chunks = NULL;
+		}
+	}
+}
+
 /* not memfile itself */
 void BLO_memfile_free(MemFile *memfile)
 {
 	MemFileChunk *chunk;
 	
 	while ((chunk = BLI_pophead(&memfile->chunks))) {
-		if (chunk->ident == 0)
-			MEM_freeN(chunk->buf);
+		if (memfile->is_private) {
+			MEM_freeN(chunk->data);
+		}
+		else {
+			memfile_store.stats.size_total -= chunk->size;
+			memfile_chunk_data_release(chunk->data);
+		}
 		MEM_freeN(chunk);
 	}
 	memfile->size = 0;
+	memfile->size_added = 0;
 }
 
 /* to keep list of memfiles consistent, 'first' is always first in list */
 /* result is that 'first' is being freed */
-void BLO_memfile_merge(MemFile *first, MemFile *second)
+void BLO_memfile_merge(MemFile *first, MemFile *UNUSED(second))
 {
-	MemFileChunk *fc, *sc;
-	
-	fc = first->chunks.first;
-	sc = second->chunks.first;
-	while (fc || sc) {
-		if (fc && sc) {
-			if (sc->ident) {
-				sc->ident = 0;
-				fc->ident = 1;
-			}
-		}
-		if (fc) fc = fc->next;
-		if (sc) sc = sc->next;
-	}
-	
+	/* data used by 'second' is kept by its own references */
 	BLO_memfile_free(first);
 }
 
+void BLO_memfile_stats_get(MemFileStats *r_stats)
+{
+	*r_stats = memfile_store.stats;
+}
+
 void memfile_chunk_add(MemFile *compare, MemFile *current, const char *buf, unsigned int size)
 {
 	static MemFileChunk *compchunk = NULL;
@@ -97,26 +193,39 @@ void memfile_chunk_add(MemFile *compare, MemFile *current, const char *buf, unsi
 	
 	curchunk = MEM_mallocN(sizeof(MemFileChunk), "MemFileChunk");
 	curchunk->size = size;
-	curchunk->buf = NULL;
-	curchunk->ident = 0;
+	curchunk->data = NULL;
 	BLI_addtail(&current->chunks, curchunk);
+
+	if (current->is_private) {
+		BLI_assert(compchunk == NULL);
+		curchunk->data = memfile_chunk_data_new(buf, size, 0);
+		curchunk->buf = curchunk->data->buf;
+		current->size += size;
+		current->size_added += size;
+		return;
+	}
 	
-	/* we compare compchunk with buf */
+	/* we compare compchunk with buf, unchanged data is found without hashing */
 	if (compchunk) {
 		if (compchunk->size == curchunk->size) {
 			if (memcmp(compchunk->buf, buf, size) == 0) {
-				curchunk->buf = compchunk->buf;
-				curchunk->ident = 1;
+				curchunk->data = compchunk->data;
+				curchunk->data->users++;
 			}
 		}
 		compchunk = compchunk->next;
 	}
 	
-	/* not equal... */
-	if (curchunk->buf == NULL) {
-		curchunk->buf = MEM_mallocN(size, "Chunk buffer");
-		memcpy(curchunk->buf, buf, size);
-		current->size += size;
+	/* not equal, look for the same data anywhere else */
+	if (curchunk->data == NULL) {
+		bool added;
+		curchunk->data = memfile_chunk_data_ensure(buf, size, &added);
+		if (added) {
+			current->size_added += size;
+		}
 	}
-}
 
+	curchunk->buf = curchunk->data->buf;
+	current->size += size;
+	memfile_store.stats.size_total += size;
+}
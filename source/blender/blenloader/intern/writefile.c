@@ -184,6 +184,7 @@
 #include "BLO_blend_defs.h"
 
 #include "readfile.h"
+#include "compressfile.h"
 
 /* for SDNA_TYPE_FROM_STRUCT() macro */
 #include "dna_type_offsets.h"
@@ -203,6 +204,8 @@
 typedef enum {
 	WW_WRAP_NONE = 1,
 	WW_WRAP_ZLIB,
+	WW_WRAP_CHUNKED,
+	WW_WRAP_MEMFILE,
 } eWriteWrapType;
 
 typedef struct WriteWrap WriteWrap;
@@ -216,6 +219,8 @@ struct WriteWrap {
 	union {
 		int file_handle;
 		gzFile gz_handle;
+		ChunkedWriter *chunked_handle;
+		MemFile *memfile_handle;
 	} _user_data;
 };
 
@@ -275,6 +280,56 @@ static size_t ww_write_zlib(WriteWrap *ww, const char *buf, size_t buf_len)
 }
 #undef FILE_HANDLE
 
+/* chunked, see compressfile.h */
+#define FILE_HANDLE(ww) \
+	(ww)->_user_data.chunked_handle
+
+static bool ww_open_chunked(WriteWrap *ww, const char *filepath)
+{
+	ChunkedWriter *file;
+
+	file = blo_chunked_writer_open(filepath);
+
+	if (file != NULL) {
+		FILE_HANDLE(ww) = file;
+		return true;
+	}
+	else {
+		return false;
+	}
+}
+static bool ww_close_chunked(WriteWrap *ww)
+{
+	return blo_chunked_writer_close(FILE_HANDLE(ww));
+}
+static size_t ww_write_chunked(WriteWrap *ww, const char *buf, size_t buf_len)
+{
+	return blo_chunked_writer_write(FILE_HANDLE(ww), buf, buf_len);
+}
+#undef FILE_HANDLE
+
+/* memfile, the data is kept in memory to be written to disk later on,
+ * see #BLO_write_file_snapshot */
+#define FILE_HANDLE(ww) \
+	(ww)->_user_data.memfile_handle
+
+static bool ww_open_memfile(WriteWrap *ww, const char *UNUSED(filepath))
+{
+	/* the memfile is assigned by the caller, only reset the undo comparison state */
+	memfile_chunk_add(NULL, NULL, NULL, 0);
+	return (FILE_HANDLE(ww) != NULL);
+}
+static bool ww_close_memfile(WriteWrap *UNUSED(ww))
+{
+	return true;
+}
+static size_t ww_write_memfile(WriteWrap *ww, const char *buf, size_t buf_len)
+{
+	memfile_chunk_add(NULL, FILE_HANDLE(ww), buf, (unsigned int)buf_len);
+	return buf_len;
+}
+#undef FILE_HANDLE
+
 /* --- end compression types --- */
 
 static void ww_handle_init(eWriteWrapType ww_type, WriteWrap *r_ww)
@@ -289,6 +344,20 @@ static void ww_handle_init(eWriteWrapType ww_type, WriteWrap *r_ww)
 			r_ww->write = ww_write_zlib;
 			break;
 		}
+		case WW_WRAP_CHUNKED:
+		{
+			r_ww->open  = ww_open_chunked;
+			r_ww->close = ww_close_chunked;
+			r_ww->write = ww_write_chunked;
+			break;
+		}
+		case WW_WRAP_MEMFILE:
+		{
+			r_ww->open  = ww_open_memfile;
+			r_ww->close = ww_close_memfile;
+			r_ww->write = ww_write_memfile;
+			break;
+		}
 		default:
 		{
 			r_ww->open  = ww_open_none;
@@ -3946,6 +4015,12 @@ static bool write_file_handle(
 					BLI_assert(0);
 					break;
 			}
+
+			/* For undo every data-block starts a new chunk, otherwise the chunk boundaries
+			 * of all following data-blocks move when one of them changes size. */
+			if (wd->current) {
+				mywrite_flush(wd);
+			}
 		}
 
 		mywrite_flush(wd);
@@ -4030,38 +4105,32 @@ static bool do_history(const char *name, ReportList *reports)
 	return 0;
 }
 
+static eWriteWrapType write_file_wrap_type(const int write_flags)
+{
+	if (write_flags & G_FILE_COMPRESS_CHUNKED) {
+		return WW_WRAP_CHUNKED;
+	}
+	else if (write_flags & G_FILE_COMPRESS) {
+		return WW_WRAP_ZLIB;
+	}
+	else {
+		return WW_WRAP_NONE;
+	}
+}
+
 /**
- * \return Success.
+ * Write \a mainvar into \a ww, remapping relative paths for \a filepath.
+ *
+ * \return True on error.
  */
-bool BLO_write_file(
-        Main *mainvar, const char *filepath, int write_flags,
-        ReportList *reports, const BlendThumbnail *thumb)
+static bool write_file_main(
+        Main *mainvar, WriteWrap *ww, const char *filepath, int write_flags,
+        const BlendThumbnail *thumb)
 {
-	char tempname[FILE_MAX + 1];
-	eWriteWrapType ww_type;
-	WriteWrap ww;
-
 	/* path backup/restore */
 	void     *path_list_backup = NULL;
 	const int path_list_flag = (BKE_BPATH_TRAVERSE_SKIP_LIBRARY | BKE_BPATH_TRAVERSE_SKIP_MULTIFILE);
 
-	/* open temporary file, so we preserve the original in case we crash */
-	BLI_snprintf(tempname, sizeof(tempname), "%s@", filepath);
-
-	if (write_flags & G_FILE_COMPRESS) {
-		ww_type = WW_WRAP_ZLIB;
-	}
-	else {
-		ww_type = WW_WRAP_NONE;
-	}
-
-	ww_handle_init(ww_type, &ww);
-
-	if (ww.open(&ww, tempname) == false) {
-		BKE_reportf(reports, RPT_ERROR, "Cannot open file %s for writing: %s", tempname, strerror(errno));
-		return 0;
-	}
-
 	/* check if we need to backup and restore paths */
 	if (UNLIKELY((write_flags & G_FILE_RELATIVE_REMAP) && (G_FILE_SAVE_COPY & write_flags))) {
 		path_list_backup = BKE_bpath_list_backup(mainvar, path_list_flag);
@@ -4098,22 +4167,25 @@ bool BLO_write_file(
 	}
 
 	/* actual file writing */
-	const bool err = write_file_handle(mainvar, &ww, NULL, NULL, write_flags, thumb);
-
-	ww.close(&ww);
+	const bool err = write_file_handle(mainvar, ww, NULL, NULL, write_flags, thumb);
 
 	if (UNLIKELY(path_list_backup)) {
 		BKE_bpath_list_restore(mainvar, path_list_flag, path_list_backup);
 		BKE_bpath_list_free(path_list_backup);
 	}
 
-	if (err) {
-		BKE_report(reports, RPT_ERROR, strerror(errno));
-		remove(tempname);
-
-		return 0;
-	}
+	return err;
+}
 
+/**
+ * Move the fully written \a tempname over \a filepath, keeping history backups.
+ *
+ * \return Success.
+ */
+static bool write_file_finish(
+        const char *tempname, const char *filepath, const int write_flags,
+        ReportList *reports)
+{
 	/* file save to temporary file was successful */
 	/* now do reverse file history (move .blend1 -> .blend2, .blend -> .blend1) */
 	if (write_flags & G_FILE_HISTORY) {
@@ -4132,6 +4204,149 @@ bool BLO_write_file(
 	return 1;
 }
 
+/**
+ * \return Success.
+ */
+bool BLO_write_file(
+        Main *mainvar, const char *filepath, int write_flags,
+        ReportList *reports, const BlendThumbnail *thumb)
+{
+	char tempname[FILE_MAX + 1];
+	WriteWrap ww;
+
+	/* open temporary file, so we preserve the original in case we crash */
+	BLI_snprintf(tempname, sizeof(tempname), "%s@", filepath);
+
+	ww_handle_init(write_file_wrap_type(write_flags), &ww);
+
+	if (ww.open(&ww, tempname) == false) {
+		BKE_reportf(reports, RPT_ERROR, "Cannot open file %s for writing: %s", tempname, strerror(errno));
+		return 0;
+	}
+
+	bool err = write_file_main(mainvar, &ww, filepath, write_flags, thumb);
+
+	/* compressed writers only write their last data when closing */
+	if (ww.close(&ww) == false) {
+		err = true;
+	}
+
+	if (err) {
+		BKE_report(reports, RPT_ERROR, strerror(errno));
+		remove(tempname);
+
+		return 0;
+	}
+
+	return write_file_finish(tempname, filepath, write_flags, reports);
+}
+
+/** \name Background file writing
+ *
+ * Saving is split in two steps, so the slow part can run in a thread:
+ * - #BLO_write_file_snapshot serializes Main into memory, this must run on the main thread
+ *   but only involves copying data, the result is byte for byte what #BLO_write_file writes.
+ * - #BLO_write_file_snapshot_write compresses and writes the data to disk,
+ *   it doesn't access Main or any global state so it can run in a thread.
+ * \{ */
+
+struct BlendFileWriteSnapshot {
+	MemFile memfile;
+	char filepath[FILE_MAX];
+	int write_flags;
+};
+
+/**
+ * \return The serialized file, or NULL on failure.
+ */
+BlendFileWriteSnapshot *BLO_write_file_snapshot(
+        Main *mainvar, const char *filepath, int write_flags,
+        ReportList *reports, const BlendThumbnail *thumb)
+{
+	BlendFileWriteSnapshot *snapshot = MEM_callocN(sizeof(*snapshot), __func__);
+	WriteWrap ww;
+
+	BLI_strncpy(snapshot->filepath, filepath, sizeof(snapshot->filepath));
+	snapshot->write_flags = write_flags;
+
+	/* keep the data out of the undo store, it would count as undo memory */
+	snapshot->memfile.is_private = true;
+
+	ww_handle_init(WW_WRAP_MEMFILE, &ww);
+	ww._user_data.memfile_handle = &snapshot->memfile;
+
+	bool err = (ww.open(&ww, filepath) == false);
+	if (!err) {
+		err = write_file_main(mainvar, &ww, filepath, write_flags, thumb);
+		ww.close(&ww);
+	}
+
+	if (err) {
+		BKE_reportf(reports, RPT_ERROR, "Cannot save file %s", filepath);
+		BLO_write_file_snapshot_free(snapshot);
+		return NULL;
+	}
+
+	return snapshot;
+}
+
+/**
+ * Write the snapshot to its file, safe to call from any thread.
+ *
+ * \param progress: Optional, set to the written fraction of the file.
+ * \return Success.
+ */
+bool BLO_write_file_snapshot_write(BlendFileWriteSnapshot *snapshot, ReportList *reports, float *progress)
+{
+	const MemFile *memfile = &snapshot->memfile;
+	char tempname[FILE_MAX + 1];
+	size_t written = 0;
+	WriteWrap ww;
+
+	BLI_snprintf(tempname, sizeof(tempname), "%s@", snapshot->filepath);
+
+	ww_handle_init(write_file_wrap_type(snapshot->write_flags), &ww);
+
+	if (ww.open(&ww, tempname) == false) {
+		BKE_reportf(reports, RPT_ERROR, "Cannot open file %s for writing: %s", tempname, strerror(errno));
+		return 0;
+	}
+
+	bool err = false;
+	for (MemFileChunk *chunk = memfile->chunks.first; chunk; chunk = chunk->next) {
+		if (ww.write(&ww, chunk->buf, chunk->size) != chunk->size) {
+			err = true;
+			break;
+		}
+		written += chunk->size;
+		if (progress && memfile->size) {
+			*progress = (float)written / (float)memfile->size;
+		}
+	}
+
+	/* compressed writers only write their last data when closing */
+	if (ww.close(&ww) == false) {
+		err = true;
+	}
+
+	if (err) {
+		BKE_report(reports, RPT_ERROR, strerror(errno));
+		remove(tempname);
+
+		return 0;
+	}
+
+	return write_file_finish(tempname, snapshot->filepath, snapshot->write_flags, reports);
+}
+
+void BLO_write_file_snapshot_free(BlendFileWriteSnapshot *snapshot)
+{
+	BLO_memfile_free(&snapshot->memfile);
+	MEM_freeN(snapshot);
+}
+
+/** \} */
+
 /**
  * \return Success.
  */
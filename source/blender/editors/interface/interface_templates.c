@@ -3679,6 +3679,7 @@ void uiTemplateRunningJobs(uiLayout *layout, bContext *C)
 	uiBlock *block;
 	void *owner = NULL;
 	int handle_event, icon = 0;
+	bool can_stop = true;
 	
 	block = uiLayoutGetBlock(layout);
 	UI_block_layout_set_current(block, layout);
@@ -3758,11 +3759,18 @@ void uiTemplateRunningJobs(uiLayout *layout, bContext *C)
 			}
 		}
 		owner = scene;
+
+		if (owner == NULL && WM_jobs_test(wm, wm, WM_JOB_TYPE_FILE_WRITE)) {
+			/* saving always finishes, a half written file is useless */
+			can_stop = false;
+			icon = ICON_FILE_BLEND;
+			owner = wm;
+		}
 	}
 
 	if (owner) {
 		const uiFontStyle *fstyle = UI_FSTYLE_WIDGET;
-		bool active = !(G.is_break || WM_jobs_is_stopped(wm, owner));
+		bool active = !can_stop || !(G.is_break || WM_jobs_is_stopped(wm, owner));
 		
 		uiLayout *row = uiLayoutRow(layout, false);
 		block = uiLayoutGetBlock(row);
@@ -3795,9 +3803,11 @@ void uiTemplateRunningJobs(uiLayout *layout, bContext *C)
 			UI_but_func_tooltip_set(but_progress, progress_tooltip_func, tip_arg);
 		}
 
-		uiDefIconTextBut(block, UI_BTYPE_BUT, handle_event, ICON_PANEL_CLOSE,
-		                 "", 0, 0, UI_UNIT_X, UI_UNIT_Y,
-		                 NULL, 0.0f, 0.0f, 0, 0, TIP_("Stop this job"));
+		if (can_stop) {
+			uiDefIconTextBut(block, UI_BTYPE_BUT, handle_event, ICON_PANEL_CLOSE,
+			                 "", 0, 0, UI_UNIT_X, UI_UNIT_Y,
+			                 NULL, 0.0f, 0.0f, 0, 0, TIP_("Stop this job"));
+		}
 	}
 
 	if (WM_jobs_test(wm, screen, WM_JOB_TYPE_SCREENCAST))
@@ -36,6 +36,7 @@
 #include "DNA_lattice_types.h"
 #include "DNA_meta_types.h"
 #include "DNA_scene_types.h"
+#include "DNA_userdef_types.h"
 
 #include "BLI_math.h"
 #include "BLI_string.h"
@@ -44,6 +45,7 @@
 #include "BLT_translation.h"
 
 #include "BKE_anim.h"
+#include "BKE_blender_undo.h"
 #include "BKE_blender_version.h"
 #include "BKE_curve.h"
 #include "BKE_displist.h"
@@ -422,7 +424,15 @@ static void stats_string(Scene *scene)
 	ofs = BLI_snprintf(memstr, MAX_INFO_MEM_LEN, IFACE_(" | Mem:%.2fM"),
 	                    (double)((mem_in_use - mmap_in_use) >> 10) / 1024.0);
 	if (mmap_in_use)
-		BLI_snprintf(memstr + ofs, MAX_INFO_MEM_LEN - ofs, IFACE_(" (%.2fM)"), (double)((mmap_in_use) >> 10) / 1024.0);
+		ofs += BLI_snprintf(memstr + ofs, MAX_INFO_MEM_LEN - ofs, IFACE_(" (%.2fM)"), (double)((mmap_in_use) >> 10) / 1024.0);
+
+	if (U.uiflag & USER_GLOBALUNDO) {
+		size_t undo_size_stored, undo_size_total;
+		if (BKE_undo_memory_stats(&undo_size_stored, &undo_size_total) != 0) {
+			BLI_snprintf(memstr + ofs, MAX_INFO_MEM_LEN - ofs, IFACE_(" | Undo:%.2fM"),
+			             (double)(undo_size_stored >> 10) / 1024.0);
+		}
+	}
 
 	if (GPU_mem_stats_supported()) {
 		int gpu_free_mem, gpu_tot_memory;
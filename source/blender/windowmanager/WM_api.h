@@ -460,6 +460,7 @@ enum {
 	WM_JOB_TYPE_POINTCACHE,
 	WM_JOB_TYPE_DPAINT_BAKE,
 	WM_JOB_TYPE_ALEMBIC,
+	WM_JOB_TYPE_FILE_WRITE,
 	/* add as needed, screencast, seq proxy build
 	 * if having hard coded values is a problem */
 };
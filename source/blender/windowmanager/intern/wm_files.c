@@ -358,7 +358,7 @@ static int wm_read_exotic(const char *name)
 {
 	int len;
 	gzFile gzfile;
-	char header[7];
+	char header[8];
 	int retval;
 
 	/* make sure we're not trying to read a directory.... */
@@ -375,7 +375,10 @@ static int wm_read_exotic(const char *name)
 		else {
 			len = gzread(gzfile, header, sizeof(header));
 			gzclose(gzfile);
-			if (len == sizeof(header) && STREQLEN(header, "BLENDER", 7)) {
+			/* regular and chunked compressed blend files, see compressfile.h */
+			if ((len >= 7 && STREQLEN(header, "BLENDER", 7)) ||
+			    (len == 8 && STREQLEN(header, "BLENDCHK", 8)))
+			{
 				retval = BKE_READ_EXOTIC_OK_BLEND;
 			}
 			else {
@@ -1079,10 +1082,116 @@ bool write_crash_blend(void)
 	}
 }
 
+/** \name Background file writing
+ *
+ * Main is serialized into memory on the main thread, the job then compresses and writes it to disk,
+ * see #BLO_write_file_snapshot.
+ * \{ */
+
+typedef struct FileWriteJob {
+	BlendFileWriteSnapshot *snapshot;
+	char filepath[FILE_MAX];
+	ReportList reports;
+	/* thumbnail is created once the file exists, may be NULL */
+	ImBuf *ibuf_thumb;
+	/* autosave only reports into the console and doesn't run save callbacks */
+	bool is_autosave;
+	bool success;
+	/* the file that was saved, post save callbacks don't run once another file is loaded */
+	Main *bmain;
+} FileWriteJob;
+
+static void wm_file_write_job_startjob(void *customdata, short *UNUSED(stop), short *do_update, float *progress)
+{
+	FileWriteJob *fj = customdata;
+
+	/* stop is ignored on purpose, a half written file is useless,
+	 * when starting another save or quitting we wait for it instead */
+	fj->success = BLO_write_file_snapshot_write(fj->snapshot, &fj->reports, progress);
+
+	*do_update = true;
+}
+
+static void wm_file_write_job_endjob(void *customdata)
+{
+	FileWriteJob *fj = customdata;
+
+	if (!fj->is_autosave) {
+		Report *report;
+		for (report = fj->reports.list.first; report; report = report->next) {
+			WM_report(report->type, report->message);
+		}
+	}
+
+	if (fj->success) {
+		/* another file may have been loaded meanwhile, the callbacks are for the saved one */
+		if (!fj->is_autosave && fj->bmain == G.main) {
+			BLI_callback_exec(G.main, NULL, BLI_CB_EVT_SAVE_POST);
+		}
+
+		/* run this function after because the file cant be written before the blend is */
+		if (fj->ibuf_thumb) {
+			IMB_thumb_delete(fj->filepath, THB_FAIL); /* without this a failed thumb overrides */
+			fj->ibuf_thumb = IMB_thumb_create(fj->filepath, THB_LARGE, THB_SOURCE_BLEND, fj->ibuf_thumb);
+		}
+	}
+	else if (!fj->is_autosave && fj->bmain == G.main) {
+		/* the file was tagged as saved when the job started */
+		WM_file_tag_modified();
+	}
+}
+
+static void wm_file_write_job_free(void *customdata)
+{
+	FileWriteJob *fj = customdata;
+
+	BLO_write_file_snapshot_free(fj->snapshot);
+	BKE_reports_clear(&fj->reports);
+	if (fj->ibuf_thumb) {
+		IMB_freeImBuf(fj->ibuf_thumb);
+	}
+	MEM_freeN(fj);
+}
+
+/**
+ * Write \a snapshot to \a filepath in a job, takes ownership of \a snapshot and \a ibuf_thumb.
+ */
+static void wm_file_write_job_start(
+        wmWindowManager *wm, wmWindow *win, BlendFileWriteSnapshot *snapshot, const char *filepath,
+        ImBuf *ibuf_thumb, const bool is_autosave)
+{
+	wmJob *wm_job;
+	FileWriteJob *fj;
+
+	/* wait for the previous save, re-using a running job would only keep its data until it ends */
+	WM_jobs_kill_type(wm, wm, WM_JOB_TYPE_FILE_WRITE);
+
+	fj = MEM_callocN(sizeof(*fj), __func__);
+	fj->snapshot = snapshot;
+	fj->ibuf_thumb = ibuf_thumb;
+	fj->is_autosave = is_autosave;
+	fj->bmain = G.main;
+	BLI_strncpy(fj->filepath, filepath, sizeof(fj->filepath));
+	BKE_reports_init(&fj->reports, is_autosave ? (RPT_STORE | RPT_PRINT) : RPT_STORE);
+
+	wm_job = WM_jobs_get(
+	        wm, win, wm, is_autosave ? "Auto Saving" : "Saving",
+	        WM_JOB_PROGRESS, WM_JOB_TYPE_FILE_WRITE);
+	WM_jobs_customdata_set(wm_job, fj, wm_file_write_job_free);
+	WM_jobs_timer(wm_job, 0.1, 0, 0);
+	WM_jobs_callbacks(wm_job, wm_file_write_job_startjob, NULL, NULL, wm_file_write_job_endjob);
+
+	WM_jobs_start(wm, wm_job);
+}
+
+/** \} */
+
 /**
  * \see #wm_homefile_write_exec wraps #BLO_write_file in a similar way.
+ *
+ * \param use_job: Write the file in a background job, the file doesn't exist yet when this returns.
  */
-static int wm_file_write(bContext *C, const char *filepath, int fileflags, ReportList *reports)
+static int wm_file_write(bContext *C, const char *filepath, int fileflags, const bool use_job, ReportList *reports)
 {
 	Library *li;
 	int len;
@@ -1152,8 +1261,18 @@ static int wm_file_write(bContext *C, const char *filepath, int fileflags, Repor
 
 	/* XXX temp solution to solve bug, real fix coming (ton) */
 	G.main->recovered = 0;
-	
-	if (BLO_write_file(CTX_data_main(C), filepath, fileflags, reports, thumb)) {
+
+	BlendFileWriteSnapshot *snapshot = NULL;
+	bool success;
+	if (use_job) {
+		snapshot = BLO_write_file_snapshot(CTX_data_main(C), filepath, fileflags, reports, thumb);
+		success = (snapshot != NULL);
+	}
+	else {
+		success = BLO_write_file(CTX_data_main(C), filepath, fileflags, reports, thumb);
+	}
+
+	if (success) {
 		const bool do_history = (G.background == false) && (CTX_wm_manager(C)->op_undo_depth == 0);
 
 		if (!(fileflags & G_FILE_SAVE_COPY)) {
@@ -1164,6 +1283,7 @@ static int wm_file_write(bContext *C, const char *filepath, int fileflags, Repor
 		}
 
 		SET_FLAG_FROM_TEST(G.fileflags, fileflags & G_FILE_COMPRESS, G_FILE_COMPRESS);
+		SET_FLAG_FROM_TEST(G.fileflags, fileflags & G_FILE_COMPRESS_CHUNKED, G_FILE_COMPRESS_CHUNKED);
 		SET_FLAG_FROM_TEST(G.fileflags, fileflags & G_FILE_AUTOPLAY, G_FILE_AUTOPLAY);
 
 		/* prevent background mode scripts from clobbering history */
@@ -1171,12 +1291,19 @@ static int wm_file_write(bContext *C, const char *filepath, int fileflags, Repor
 			wm_history_file_update();
 		}
 
-		BLI_callback_exec(G.main, NULL, BLI_CB_EVT_SAVE_POST);
+		if (snapshot) {
+			/* save post callbacks and the thumbnail are handled once the job wrote the file */
+			wm_file_write_job_start(CTX_wm_manager(C), CTX_wm_window(C), snapshot, filepath, ibuf_thumb, false);
+			ibuf_thumb = NULL;
+		}
+		else {
+			BLI_callback_exec(G.main, NULL, BLI_CB_EVT_SAVE_POST);
 
-		/* run this function after because the file cant be written before the blend is */
-		if (ibuf_thumb) {
-			IMB_thumb_delete(filepath, THB_FAIL); /* without this a failed thumb overrides */
-			ibuf_thumb = IMB_thumb_create(filepath, THB_LARGE, THB_SOURCE_BLEND, ibuf_thumb);
+			/* run this function after because the file cant be written before the blend is */
+			if (ibuf_thumb) {
+				IMB_thumb_delete(filepath, THB_FAIL); /* without this a failed thumb overrides */
+				ibuf_thumb = IMB_thumb_create(filepath, THB_LARGE, THB_SOURCE_BLEND, ibuf_thumb);
+			}
 		}
 
 		ret = 0;  /* Success. */
@@ -1269,12 +1396,22 @@ void wm_autosave_timer(const bContext *C, wmWindowManager *wm, wmTimer *UNUSED(w
 	}
 	else {
 		/*  save as regular blend file */
-		int fileflags = G.fileflags & ~(G_FILE_COMPRESS | G_FILE_AUTOPLAY | G_FILE_HISTORY);
+		int fileflags = G.fileflags & ~(G_FILE_COMPRESS | G_FILE_COMPRESS_CHUNKED | G_FILE_AUTOPLAY | G_FILE_HISTORY);
 
 		ED_editors_flush_edits(C, false);
 
-		/* Error reporting into console */
-		BLO_write_file(CTX_data_main(C), filepath, fileflags, NULL, NULL);
+		if (U.flag & USER_SAVE_ASYNC) {
+			/* Error reporting into console */
+			BlendFileWriteSnapshot *snapshot = BLO_write_file_snapshot(
+			        CTX_data_main(C), filepath, fileflags, NULL, NULL);
+			if (snapshot) {
+				wm_file_write_job_start(wm, NULL, snapshot, filepath, NULL, true);
+			}
+		}
+		else {
+			/* Error reporting into console */
+			BLO_write_file(CTX_data_main(C), filepath, fileflags, NULL, NULL);
+		}
 	}
 	/* do timer after file write, just in case file write takes a long time */
 	wm->autosavetimer = WM_event_add_timer(wm, NULL, TIMERAUTOSAVE, U.savetime * 60.0);
@@ -1396,7 +1533,7 @@ static int wm_homefile_write_exec(bContext *C, wmOperator *op)
 	ED_editors_flush_edits(C, false);
 
 	/*  force save as regular blend file */
-	fileflags = G.fileflags & ~(G_FILE_COMPRESS | G_FILE_AUTOPLAY | G_FILE_HISTORY);
+	fileflags = G.fileflags & ~(G_FILE_COMPRESS | G_FILE_COMPRESS_CHUNKED | G_FILE_AUTOPLAY | G_FILE_HISTORY);
 
 	if (BLO_write_file(CTX_data_main(C), filepath, fileflags | G_FILE_USERPREFS, op->reports, NULL) == 0) {
 		printf("fail\n");
@@ -1993,6 +2130,11 @@ static void save_set_compress(wmOperator *op)
 			RNA_property_boolean_set(op->ptr, prop, (U.flag & USER_FILECOMPRESS) != 0);
 		}
 	}
+
+	prop = RNA_struct_find_property(op->ptr, "compress_chunked");
+	if (!RNA_property_is_set(op->ptr, prop) && G.save_over) {
+		RNA_property_boolean_set(op->ptr, prop, (G.fileflags & G_FILE_COMPRESS_CHUNKED) != 0);
+	}
 }
 
 static void save_set_filepath(wmOperator *op)
@@ -2049,6 +2191,9 @@ static int wm_save_as_mainfile_exec(bContext *C, wmOperator *op)
 	SET_FLAG_FROM_TEST(
 	        fileflags, RNA_boolean_get(op->ptr, "compress"),
 	        G_FILE_COMPRESS);
+	SET_FLAG_FROM_TEST(
+	        fileflags, RNA_boolean_get(op->ptr, "compress_chunked"),
+	        G_FILE_COMPRESS_CHUNKED);
 	SET_FLAG_FROM_TEST(
 	        fileflags, RNA_boolean_get(op->ptr, "relative_remap"),
 	        G_FILE_RELATIVE_REMAP);
@@ -2068,7 +2213,10 @@ static int wm_save_as_mainfile_exec(bContext *C, wmOperator *op)
 #  error "don't remove by accident"
 #endif
 
-	if (wm_file_write(C, path, fileflags, op->reports) != 0)
+	/* only write in the background for interactive saves, scripts expect the file to exist afterwards */
+	const bool use_job = (U.flag & USER_SAVE_ASYNC) && (op->flag & OP_IS_INVOKE) && !G.background;
+
+	if (wm_file_write(C, path, fileflags, use_job, op->reports) != 0)
 		return OPERATOR_CANCELLED;
 
 	WM_event_add_notifier(C, NC_WM | ND_FILESAVE, NULL);
@@ -2108,6 +2256,8 @@ void WM_OT_save_as_mainfile(wmOperatorType *ot)
 	        ot, FILE_TYPE_FOLDER | FILE_TYPE_BLENDER, FILE_BLENDER, FILE_SAVE,
 	        WM_FILESEL_FILEPATH, FILE_DEFAULTDISPLAY, FILE_SORT_ALPHA);
 	RNA_def_boolean(ot->srna, "compress", false, "Compress", "Write compressed .blend file");
+	RNA_def_boolean(ot->srna, "compress_chunked", false, "Fast Compression",
+	                "Compress using multiple threads, the file can't be opened by older Blender versions");
 	RNA_def_boolean(ot->srna, "relative_remap", true, "Remap Relative",
 	                "Remap relative paths when saving in a different directory");
 	prop = RNA_def_boolean(ot->srna, "copy", false, "Save Copy",
@@ -2174,6 +2324,8 @@ void WM_OT_save_mainfile(wmOperatorType *ot)
 	        ot, FILE_TYPE_FOLDER | FILE_TYPE_BLENDER, FILE_BLENDER, FILE_SAVE,
 	        WM_FILESEL_FILEPATH, FILE_DEFAULTDISPLAY, FILE_SORT_ALPHA);
 	RNA_def_boolean(ot->srna, "compress", false, "Compress", "Write compressed .blend file");
+	RNA_def_boolean(ot->srna, "compress_chunked", false, "Fast Compression",
+	                "Compress using multiple threads, the file can't be opened by older Blender versions");
 	RNA_def_boolean(ot->srna, "relative_remap", false, "Remap Relative",
 	                "Remap relative paths when saving in a different directory");
 }
@@ -0,0 +1,91 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+
+#include "BLI_utildefines.h"
+#include "BLI_string.h"
+
+#include "DNA_genfile.h"
+#include "DNA_text_types.h"
+
+#include "BKE_library.h"
+#include "BKE_main.h"
+#include "BKE_text.h"
+
+#include "BLO_undofile.h"
+#include "BLO_writefile.h"
+}
+
+#define TEXTS_NUM 16
+#define LINES_NUM 64
+#define LINE_LEN 60
+
+class BlendfileUndoTest : public testing::Test
+{
+protected:
+	Main *bmain;
+	Text *texts[TEXTS_NUM];
+
+	virtual void SetUp()
+	{
+		DNA_sdna_current_init();
+		bmain = BKE_main_new();
+
+		char line[LINE_LEN + 2];
+		memset(line, 'x', LINE_LEN);
+		line[LINE_LEN] = '\n';
+		line[LINE_LEN + 1] = '\0';
+
+		for (int i = 0; i < TEXTS_NUM; i++) {
+			char name[MAX_ID_NAME - 2];
+			BLI_snprintf(name, sizeof(name), "Text.%03d", i);
+			texts[i] = BKE_text_add(bmain, name);
+			for (int j = 0; j < LINES_NUM; j++) {
+				BKE_text_write(texts[i], line);
+			}
+		}
+	}
+
+	virtual void TearDown()
+	{
+		BKE_main_free(bmain);
+		DNA_sdna_current_free();
+	}
+};
+
+/* Editing one data-block must not store the unchanged ones again, their chunks
+ * stay the same even when the edited data-block before them changes size. */
+TEST_F(BlendfileUndoTest, EditSharesOtherDataBlocks)
+{
+	MemFile first = {{NULL}};
+	MemFile second = {{NULL}};
+	MemFile third = {{NULL}};
+
+	EXPECT_TRUE(BLO_write_file_mem(bmain, NULL, &first, 0));
+	EXPECT_TRUE(BLO_write_file_mem(bmain, &first, &second, 0));
+	EXPECT_EQ(second.size, first.size);
+	EXPECT_EQ(second.size_added, (size_t)0);
+
+	/* Insert a line at the start of the first text written, so everything
+	 * written after it is shifted. */
+	Text *text = (Text *)bmain->text.first;
+	txt_move_bof(text, false);
+	txt_insert_buf(text, "inserted line\n");
+
+	EXPECT_TRUE(BLO_write_file_mem(bmain, &second, &third, 0));
+	EXPECT_GT(third.size, second.size);
+	EXPECT_GT(third.size_added, (size_t)0);
+
+	/* Generous upper bound for the edited text alone (lines, their structs and two
+	 * block headers each), all texts together are many times larger. */
+	const size_t text_size_max = (LINES_NUM + 2) * (LINE_LEN + sizeof(TextLine) + 2 * 32) +
+	                             sizeof(Text) + 1024;
+	EXPECT_LT(third.size_added, text_size_max);
+
+	BLO_memfile_free(&first);
+	BLO_memfile_free(&second);
+	BLO_memfile_free(&third);
+}
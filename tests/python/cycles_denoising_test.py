@@ -0,0 +1,108 @@
+# Apache License, Version 2.0
+
+# ./blender.bin --background -noaudio --factory-startup --python tests/python/cycles_denoising_test.py -- --verbose
+
+# Denoises a render made of a single non-square tile, so the filter storage
+# has different width and height. A mix up of the two dimensions reads and
+# writes outside of the storage and shows up as invalid or far too dark or
+# bright pixels in the denoised result.
+
+import math
+import os
+import tempfile
+import unittest
+
+import bpy
+
+
+class TestCyclesDenoising(unittest.TestCase):
+    samples = 32
+    resolution_x = 48
+    resolution_y = 20
+    # Relative difference of the average brightness allowed for the filter.
+    tolerance = 0.1
+
+    @classmethod
+    def setUpClass(cls):
+        bpy.ops.wm.read_factory_settings()
+
+        scene = bpy.context.scene
+        for ob in list(scene.objects):
+            bpy.data.objects.remove(ob, do_unlink=True)
+
+        scene.render.engine = 'CYCLES'
+        scene.render.resolution_x = cls.resolution_x
+        scene.render.resolution_y = cls.resolution_y
+        scene.render.resolution_percentage = 100
+        scene.render.tile_x = cls.resolution_x
+        scene.render.tile_y = cls.resolution_y
+        scene.render.image_settings.file_format = 'OPEN_EXR'
+        scene.render.image_settings.color_depth = '32'
+        scene.world.horizon_color = (0.0, 0.0, 0.0)
+
+        cscene = scene.cycles
+        cscene.device = 'CPU'
+        cscene.progressive = 'PATH'
+        cscene.samples = cls.samples
+        cscene.seed = 0
+
+        bpy.ops.mesh.primitive_plane_add(radius=4.0)
+        bpy.ops.mesh.primitive_uv_sphere_add(size=0.5, location=(0.0, 0.0, 0.5))
+
+        lamp_data = bpy.data.lamps.new("Lamp", 'AREA')
+        lamp_data.size = 2.0
+        lamp_data.use_nodes = True
+        lamp_data.node_tree.nodes["Emission"].inputs["Strength"].default_value = 200.0
+        lamp = bpy.data.objects.new("Lamp", lamp_data)
+        lamp.location = (1.0, -1.0, 3.0)
+        scene.objects.link(lamp)
+
+        camera_data = bpy.data.cameras.new("Camera")
+        camera = bpy.data.objects.new("Camera", camera_data)
+        camera.location = (0.0, 0.0, 6.0)
+        scene.objects.link(camera)
+        scene.camera = camera
+
+    def render_pixels(self, use_denoising):
+        scene = bpy.context.scene
+        scene.render.layers[0].cycles.use_denoising = use_denoising
+
+        filepath = os.path.join(tempfile.gettempdir(),
+                                "cycles_denoising_%d.exr" % use_denoising)
+        scene.render.filepath = filepath
+        bpy.ops.render.render(write_still=True)
+
+        image = bpy.data.images.load(filepath)
+        size = tuple(image.size)
+        pixels = image.pixels[:]
+        bpy.data.images.remove(image)
+        os.remove(filepath)
+
+        self.assertEqual(size, (self.resolution_x, self.resolution_y))
+        return pixels
+
+    @staticmethod
+    def average(pixels):
+        num_pixels = len(pixels) // 4
+        return sum(sum(pixels[i * 4:i * 4 + 3]) for i in range(num_pixels)) / (3 * num_pixels)
+
+    def test_non_square_tile(self):
+        noisy = self.render_pixels(False)
+        denoised = self.render_pixels(True)
+
+        for value in denoised:
+            self.assertTrue(math.isfinite(value), "denoised render has invalid pixels")
+
+        reference = self.average(noisy)
+        result = self.average(denoised)
+
+        self.assertGreater(reference, 0.0)
+        self.assertLess(abs(result - reference) / reference, self.tolerance,
+                        "denoised average %f differs from noisy %f" % (result, reference))
+
+
+if __name__ == '__main__':
+    import sys
+
+    sys.argv = [__file__] + (sys.argv[sys.argv.index("--") + 1:] if "--" in sys.argv else [])
+    unittest.main()
@@ -0,0 +1,105 @@
+# Apache License, Version 2.0
+
+# ./blender.bin --background -noaudio --factory-startup --python tests/python/cycles_path_guiding_test.py -- --verbose
+
+# Path guiding changes how bounces are sampled but must not change the result,
+# the lamp is weighted against guided bounces with multiple importance sampling.
+# Renders a small scene lit by a large MIS lamp with and without guiding and
+# compares the average brightness, a mismatch in the MIS weights shows up as a
+# brighter or darker guided render.
+
+import os
+import tempfile
+import unittest
+
+import bpy
+
+
+class TestCyclesPathGuiding(unittest.TestCase):
+    samples = 512
+    resolution = 32
+    # Relative difference of the average brightness allowed for noise.
+    tolerance = 0.02
+
+    @classmethod
+    def setUpClass(cls):
+        bpy.ops.wm.read_factory_settings()
+
+        scene = bpy.context.scene
+        for ob in list(scene.objects):
+            bpy.data.objects.remove(ob, do_unlink=True)
+
+        scene.render.engine = 'CYCLES'
+        scene.render.resolution_x = cls.resolution
+        scene.render.resolution_y = cls.resolution
+        scene.render.resolution_percentage = 100
+        scene.render.tile_x = cls.resolution
+        scene.render.tile_y = cls.resolution
+        scene.render.image_settings.file_format = 'OPEN_EXR'
+        scene.render.image_settings.color_depth = '32'
+        scene.world.horizon_color = (0.0, 0.0, 0.0)
+
+        cscene = scene.cycles
+        cscene.device = 'CPU'
+        cscene.progressive = 'PATH'
+        cscene.use_progressive_refine = True
+        cscene.samples = cls.samples
+        cscene.seed = 0
+        cscene.max_bounces = 4
+        cscene.sample_clamp_direct = 0.0
+        cscene.sample_clamp_indirect = 0.0
+        cscene.guiding_training_samples = cls.samples // 4
+
+        # Closed diffuse box with a sphere, seen from inside.
+        bpy.ops.mesh.primitive_cube_add(location=(0.0, 0.0, 1.0))
+        bpy.ops.mesh.primitive_uv_sphere_add(size=0.5, location=(0.3, -0.2, 0.5))
+
+        # Large area lamp close to the floor, so both light sampling and
+        # bounces find it and the MIS weights matter.
+        lamp_data = bpy.data.lamps.new("Lamp", 'AREA')
+        lamp_data.size = 1.0
+        lamp_data.use_nodes = True
+        lamp_data.node_tree.nodes["Emission"].inputs["Strength"].default_value = 50.0
+        lamp_data.cycles.use_multiple_importance_sampling = True
+        lamp = bpy.data.objects.new("Lamp", lamp_data)
+        lamp.location = (-0.4, 0.4, 1.6)
+        scene.objects.link(lamp)
+
+        camera_data = bpy.data.cameras.new("Camera")
+        camera = bpy.data.objects.new("Camera", camera_data)
+        camera.location = (0.0, 0.0, 1.9)
+        camera_data.lens = 12.0
+        scene.objects.link(camera)
+        scene.camera = camera
+
+    def render_average(self, use_path_guiding):
+        scene = bpy.context.scene
+        scene.cycles.use_path_guiding = use_path_guiding
+
+        filepath = os.path.join(tempfile.gettempdir(),
+                                "cycles_path_guiding_%d.exr" % use_path_guiding)
+        scene.render.filepath = filepath
+        bpy.ops.render.render(write_still=True)
+
+        image = bpy.data.images.load(filepath)
+        pixels = image.pixels[:]
+        bpy.data.images.remove(image)
+        os.remove(filepath)
+
+        num_pixels = len(pixels) // 4
+        return sum(sum(pixels[i * 4:i * 4 + 3]) for i in range(num_pixels)) / (3 * num_pixels)
+
+    def test_guided_matches_unguided(self):
+        reference = self.render_average(False)
+        guided = self.render_average(True)
+
+        self.assertGreater(reference, 0.0)
+        self.assertLess(abs(guided - reference) / reference, self.tolerance,
+                        "guided average %f differs from unguided %f" % (guided, reference))
+
+
+if __name__ == '__main__':
+    import sys
+
+    sys.argv = [__file__] + (sys.argv[sys.argv.index("--") + 1:] if "--" in sys.argv else [])
+    unittest.main()